@@ -0,0 +1,195 @@
+/*
+* Python bindings: load data once, run simulations in-process and read ticks and trades as NumPy arrays.
+*
+* TickStore.records is a view over the store (no copy), it keeps the store alive and is read-only.
+* SimulationRun.trades() is a read-only view over the trade log so far (no copy) which keeps the run alive. The log reallocates
+* while it grows, so a run refuses to replay further while any of its views exists: delete them, or keep .copy() of them.
+* aggregate_instrument and aggregate_pair return dicts of NumPy columns which share one heap-allocated BarSeries.
+* Long calls release the GIL, so several runs can progress on Python threads at once. A run object may be shared between
+* threads: its calls are serialized by its own lock.
+*/
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include "../src/aggregation.hpp"
+#include "../src/data_cache.hpp"
+#include "../src/runner.hpp"
+
+namespace py = pybind11;
+using namespace ArbSimulation;
+
+namespace
+{
+    template<typename T>
+    py::array_t<T> makeView(const T* data, size_t size, py::handle owner)
+    {
+        py::array_t<T> result({size}, {sizeof(T)}, data, owner);
+        result.attr("setflags")(py::arg("write") = false);
+        return result;
+    }
+
+    std::shared_ptr<TickStore> load(const std::vector<std::string>& paths, const std::string& cacheDir, bool verify)
+    {
+        py::gil_scoped_release release;
+        TickStorePtr store = cacheDir.empty() ? LoadTickStore(paths) : DataCache(cacheDir, verify).LoadOrBuild(paths);
+        return std::const_pointer_cast<TickStore>(store);
+    }
+
+    struct RunHandle
+    {
+        //SimulationRun as seen from Python: calls on the run are serialized, trades() views are counted
+        std::unique_ptr<SimulationRun> Run;
+        std::mutex Mutex;
+        size_t Views = 0;                                   //guarded by the GIL
+
+        template<typename Function>
+        auto Replay(Function function)
+        {
+            if (Views > 0)
+                throw std::runtime_error("trades() views of this run are alive and the replay would move the trade log: "
+                    "delete them or keep copies of them (trades().copy()) before replaying further");
+            py::gil_scoped_release release;
+            std::lock_guard lock(Mutex);
+            return function(*Run);
+        }
+
+        template<typename Function>
+        auto Read(Function function)
+        {
+            //the lock is taken without the GIL, so a replay on another thread is not blocked
+            std::unique_lock<std::mutex> lock(Mutex, std::defer_lock);
+            {
+                py::gil_scoped_release release;
+                lock.lock();
+            }
+            return function(*Run);
+        }
+    };
+
+    py::dict toColumns(BarSeries&& series)
+    {
+        auto bars = new BarSeries(std::move(series));
+        py::capsule owner(bars, [](void* data){ delete static_cast<BarSeries*>(data); });
+        py::dict columns;
+        columns["bucket_ns"] = bars->BucketNs;
+        columns["timestamps"] = makeView(bars->Timestamps.data(), bars->Size(), owner);
+        columns["counts"] = makeView(bars->Counts.data(), bars->Size(), owner);
+        std::pair<const char*, const std::vector<double>*> prices[] = {
+            {"open", &bars->Open}, {"high", &bars->High}, {"low", &bars->Low}, {"close", &bars->Close}, {"mean", &bars->Mean},
+            {"vwap_of_top", &bars->VwapOfTop}, {"spread_min", &bars->SpreadMin}, {"spread_max", &bars->SpreadMax}, {"spread_mean", &bars->SpreadMean}};
+        for (auto& [name, column]: prices)
+            columns[name] = makeView(column->data(), bars->Size(), owner);
+        return columns;
+    }
+}
+
+PYBIND11_MODULE(arbsim, m)
+{
+    m.doc() = "ArbSimulation bindings";
+
+    PYBIND11_NUMPY_DTYPE(TickRecord, Timestamp, InstrumentId, Flags, BidSize, BidPrice, AskPrice, AskSize);
+    PYBIND11_NUMPY_DTYPE(TradeRecord, SentTimestamp, ExecutedTimestamp, ExecPrice, Qty, InstrumentIndex, Side, Type, Reserved);
+
+    py::class_<TickStore, std::shared_ptr<TickStore>>(m, "TickStore")
+        .def_property_readonly("records", [](py::object self)
+            {
+                auto& store = self.cast<const TickStore&>();
+                return makeView(store.Data(), store.Size(), self);
+            })
+        .def_property_readonly("security_ids", &TickStore::GetSecurityIds)
+        .def_property_readonly("is_mapped", &TickStore::IsMapped)
+        .def("__len__", &TickStore::Size);
+
+    m.def("load", &load, py::arg("paths"), py::arg("cache_dir") = "", py::arg("verify") = true,
+        "Loads CSV files and tick images into one sorted store, optionally through the data cache");
+
+    py::class_<RunParameters>(m, "RunParameters")
+        .def_readonly("x", &RunParameters::X)
+        .def_readonly("y", &RunParameters::Y)
+        .def_readonly("z", &RunParameters::Z)
+        .def_readonly("latencies", &RunParameters::Latencies);
+
+    py::class_<RunResult>(m, "RunResult")
+        .def_readonly("parameters", &RunResult::Parameters)
+        .def_readonly("pnl", &RunResult::PnL)
+        .def_readonly("trades", &RunResult::Trades)
+        .def_readonly("ticks", &RunResult::Ticks)
+        .def_readonly("error", &RunResult::Error);
+
+    py::class_<RunHandle, std::shared_ptr<RunHandle>>(m, "SimulationRun")
+        .def(py::init([](std::shared_ptr<TickStore> store, double x, double y, double z, const std::unordered_map<std::string, u_int64_t>& latencies)
+            {
+                auto handle = std::make_shared<RunHandle>();
+                handle->Run = std::make_unique<SimulationRun>(store, RunParameters{x, y, z, latencies});
+                return handle;
+            }), py::arg("store"), py::arg("x"), py::arg("y"), py::arg("z"), py::arg("latencies"))
+        .def("run", [](RunHandle& handle)
+            {
+                return handle.Replay([](SimulationRun& run){ return run.Run(); });
+            }, "Replays the remaining ticks")
+        .def("step", [](RunHandle& handle, size_t count)
+            {
+                return handle.Replay([count](SimulationRun& run)
+                {
+                    size_t before = run.GetTicks();
+                    run.RunUntil(before + count);
+                    return run.GetTicks() - before;
+                });
+            }, py::arg("count") = 1, "Replays up to count ticks, returns the number of ticks processed")
+        .def_property_readonly("result", [](RunHandle& handle)
+            {
+                return handle.Read([](SimulationRun& run){ return run.GetResult(); });
+            })
+        .def("trades", [](std::shared_ptr<RunHandle> handle)
+            {
+                //the capsule keeps the run alive and counts the view until the array is released
+                ++handle->Views;
+                py::capsule owner(new std::shared_ptr<RunHandle>(handle), [](void* data)
+                {
+                    auto handle = static_cast<std::shared_ptr<RunHandle>*>(data);
+                    --(*handle)->Views;
+                    delete handle;
+                });
+                return handle->Read([&owner](SimulationRun& run)
+                {
+                    auto& log = run.GetStrategy()->GetPositionKeeper().GetTradeLog();
+                    return makeView(log.data(), log.size(), owner);
+                });
+            }, "Read-only view of the trades so far, the run does not replay further while it exists")
+        .def_property_readonly("trade_instruments", [](RunHandle& handle)
+            {
+                return handle.Read([](SimulationRun& run){ return run.GetStrategy()->GetPositionKeeper().GetTradeInstruments(); });
+            });
+
+    m.def("sweep", [](std::shared_ptr<TickStore> store, const std::vector<double>& xs, const std::vector<double>& ys, const std::vector<double>& zs,
+            const std::unordered_map<std::string, u_int64_t>& latencies, size_t threads)
+        {
+            auto grid = SweepRunner::MakeGrid(xs, ys, zs, latencies);
+            py::gil_scoped_release release;
+            return SweepRunner(store, threads == 0 ? GetHardwareThreads() : threads).Run(grid);
+        }, py::arg("store"), py::arg("xs"), py::arg("ys"), py::arg("zs"), py::arg("latencies"), py::arg("threads") = 0,
+        "Runs the X/Y/Z grid in parallel over the store");
+
+    m.def("aggregate_instrument", [](std::shared_ptr<TickStore> store, const std::string& securityId, double bucketSeconds, size_t threads)
+        {
+            BarSeries bars;
+            {
+                py::gil_scoped_release release;
+                bars = BarAggregator(store, threads == 0 ? GetHardwareThreads() : threads).GetInstrumentBars(securityId, bucketSeconds * 1e9);
+            }
+            return toColumns(std::move(bars));
+        }, py::arg("store"), py::arg("security_id"), py::arg("bucket_sec"), py::arg("threads") = 0,
+        "Resamples one instrument into time bars");
+
+    m.def("aggregate_pair", [](std::shared_ptr<TickStore> store, const std::string& first, const std::string& second, double bucketSeconds, size_t threads)
+        {
+            BarSeries bars;
+            {
+                py::gil_scoped_release release;
+                bars = BarAggregator(store, threads == 0 ? GetHardwareThreads() : threads).GetPairBars(first, second, bucketSeconds * 1e9);
+            }
+            return toColumns(std::move(bars));
+        }, py::arg("store"), py::arg("first"), py::arg("second"), py::arg("bucket_sec"), py::arg("threads") = 0,
+        "Resamples the as-of joined mid difference first - second into time bars");
+}
@@ -0,0 +1,55 @@
+"""
+Smoke test of the arbsim module: loads the test data, runs simulations and reads trades.
+Run from the binary directory (ctest does, see ARBSIM_PYTHON in CMakeLists.txt) with the module on PYTHONPATH.
+"""
+import threading
+
+import arbsim
+
+DATA = ["../../tests/data/arb_strategy_test_A.csv", "../../tests/data/arb_strategy_test_B.csv"]
+LATENCIES = {"FutureA": 0, "FutureB": 0}
+
+store = arbsim.load(DATA)
+assert len(store) == len(store.records) > 0
+assert not store.records.flags.writeable
+
+run = arbsim.SimulationRun(store, 5, 2, -150, LATENCIES)
+result = run.run()
+assert result.pnl == 77, result.pnl
+trades = run.trades()
+assert len(trades) == result.trades > 0
+assert not trades.flags.writeable
+assert set(trades["InstrumentIndex"]) <= set(range(len(run.trade_instruments)))
+
+# views keep the run alive and block replays until they are released
+stepped = arbsim.SimulationRun(store, 5, 2, -150, LATENCIES)
+assert stepped.step(10) == 10
+view = stepped.trades()
+try:
+    stepped.step(1)
+    raise AssertionError("a replay must be refused while a trades() view exists")
+except RuntimeError:
+    pass
+kept = view.copy()
+del view
+stepped.run()
+assert len(stepped.trades()) == result.trades and len(kept) <= result.trades
+
+# independent runs progress on Python threads, a shared run is serialized
+runs = [arbsim.SimulationRun(store, 5, 2, -150, LATENCIES) for _ in range(4)]
+shared = arbsim.SimulationRun(store, 5, 2, -150, LATENCIES)
+def replay(run):
+    run.run()
+    while shared.step(5) > 0:
+        pass
+threads = [threading.Thread(target=replay, args=(run,)) for run in runs]
+for thread in threads:
+    thread.start()
+for thread in threads:
+    thread.join()
+for run in runs + [shared]:
+    assert run.result.pnl == 77 and run.result.ticks == len(store)
+
+results = arbsim.sweep(store, [1, 5], [1, 2], [-150], LATENCIES, threads=2)
+assert max(result.pnl for result in results) == 77
+print("arbsim smoke test passed")
@@ -40,6 +40,7 @@ namespace ArbSimulation
     {
         std::string SecurityId;
         double PriceStep = 1;
+        u_int32_t Id = 0;                       //index in the InstrumentManager that created it
     }; 
     typedef std::shared_ptr<Instrument> InstrumentPtr;
 
@@ -63,6 +64,8 @@ namespace ArbSimulation
         u_int64_t SentTimestamp = 0;
         u_int64_t ExecutedTimestamp = 0;
         OrderType Type = OrderType::Market;
+        u_int64_t ComputeDelay = 0;             //ns the strategy spent before sending, added to SentTimestamp
+        u_int64_t Id = 0;                       //sequence number of the order within its strategy
     };
     typedef std::shared_ptr<Order> OrderPtr;
 
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <limits>
+
+#include "threading.hpp"
+#include "tick_store.hpp"
+
+namespace ArbSimulation
+{
+    struct BarSeries
+    {
+        /*
+        * Time-bucketed bars, one entry per bucket in every column (structure of arrays).
+        * Instrument bars: OHLC and mean of the mid, size-weighted price of the top of book, bid-ask spread statistics.
+        * Pair bars: OHLC and mean of the as-of joined mid difference, Spread* repeat its min/max/mean, VwapOfTop is NaN.
+        * Empty buckets have NaN prices and zero count.
+        */
+        u_int64_t BucketNs = 0;
+        std::vector<u_int64_t> Timestamps;                  //bucket starts
+        std::vector<u_int64_t> Counts;
+        std::vector<double> Open;
+        std::vector<double> High;
+        std::vector<double> Low;
+        std::vector<double> Close;
+        std::vector<double> Mean;
+        std::vector<double> VwapOfTop;
+        std::vector<double> SpreadMin;
+        std::vector<double> SpreadMax;
+        std::vector<double> SpreadMean;
+
+        inline size_t Size() const
+        {
+            return Timestamps.size();
+        }
+
+        void Resize(size_t size)
+        {
+            Timestamps.resize(size);
+            Counts.assign(size, 0);
+            for (auto column: {&Open, &High, &Low, &Close, &Mean, &VwapOfTop, &SpreadMin, &SpreadMax, &SpreadMean})
+                column->assign(size, std::nan(""));
+        }
+
+        void Write(const std::string& path) const
+        {
+            /*
+            * Layout: "ARBBARS1" | u64 bucketNs | u64 count | u64 timestamps[count] | u64 counts[count]
+            *         | f64 open, high, low, close, mean, vwapOfTop, spreadMin, spreadMax, spreadMean [count each]
+            */
+            std::ofstream file{path, std::ios::binary | std::ios::trunc};
+            if (!file)
+                throw Exception("Unable to create " + path);
+            u_int64_t count = Size();
+            file.write("ARBBARS1", 8);
+            file.write(reinterpret_cast<const char*>(&BucketNs), sizeof(BucketNs));
+            file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            file.write(reinterpret_cast<const char*>(Timestamps.data()), count * sizeof(u_int64_t));
+            file.write(reinterpret_cast<const char*>(Counts.data()), count * sizeof(u_int64_t));
+            for (auto column: {&Open, &High, &Low, &Close, &Mean, &VwapOfTop, &SpreadMin, &SpreadMax, &SpreadMean})
+                file.write(reinterpret_cast<const char*>(column->data()), count * sizeof(double));
+        }
+    };
+
+    class BarAggregator
+    {
+    /*
+    * Resamples a TickStore into bars.
+    * Records are split once into per-instrument columns (mid, spread, size-weighted top), so bucket reductions
+    * run over contiguous doubles with independent lanes the compiler turns into SIMD min/max/add.
+    * Buckets are processed in parallel chunks; pair bars find the as-of state at every bucket start by binary search.
+    */
+    public:
+        static constexpr size_t BUCKETS_PER_TASK = 64;
+        static constexpr size_t RECORDS_PER_TASK = 1 << 18;
+
+        BarAggregator(TickStorePtr store, size_t threads): _store(store), _threads(threads)
+        {
+            //two passes over fixed chunks of the store: count records per instrument, then fill the columns at known offsets
+            auto& securityIds = _store->GetSecurityIds();
+            size_t instruments = securityIds.size();
+            size_t chunks = (_store->Size() + RECORDS_PER_TASK - 1) / RECORDS_PER_TASK;
+            std::vector<size_t> offsets(chunks * instruments);
+            ParallelFor(chunks, _threads, [&](size_t chunk, size_t worker)
+            {
+                size_t end = std::min(_store->Size(), (chunk + 1) * RECORDS_PER_TASK);
+                for (size_t i = chunk * RECORDS_PER_TASK; i < end; ++i)
+                    ++offsets[chunk * instruments + (*_store)[i].InstrumentId];
+            });
+
+            _columns.resize(instruments);
+            for (size_t id = 0; id < instruments; ++id)
+            {
+                size_t total = 0;
+                for (size_t chunk = 0; chunk < chunks; ++chunk)
+                {
+                    size_t count = offsets[chunk * instruments + id];
+                    offsets[chunk * instruments + id] = total;
+                    total += count;
+                }
+                _columns[id].Resize(total);
+                _indices[securityIds[id]] = id;
+            }
+
+            ParallelFor(chunks, _threads, [&](size_t chunk, size_t worker)
+            {
+                size_t end = std::min(_store->Size(), (chunk + 1) * RECORDS_PER_TASK);
+                size_t* positions = offsets.data() + chunk * instruments;
+                for (size_t i = chunk * RECORDS_PER_TASK; i < end; ++i)
+                {
+                    auto& record = (*_store)[i];
+                    auto& columns = _columns[record.InstrumentId];
+                    size_t position = positions[record.InstrumentId]++;
+                    columns.Timestamps[position] = record.Timestamp;
+                    columns.Mid[position] = (record.BidPrice + record.AskPrice) / 2;
+                    columns.Spread[position] = record.AskPrice - record.BidPrice;
+                    columns.TopNotional[position] = record.BidPrice * record.BidSize + record.AskPrice * record.AskSize;
+                    columns.TopSize[position] = record.BidSize + record.AskSize;
+                }
+            });
+        }
+
+        BarSeries GetInstrumentBars(const std::string& securityId, u_int64_t bucketNs) const
+        {
+            auto& columns = _getColumns(securityId);
+            auto bars = _makeSeries(bucketNs);
+            _forEachBucket(bars, [&](size_t bucket)
+            {
+                auto begin = _lowerBound(columns.Timestamps, bars.Timestamps[bucket]);
+                auto end = _lowerBound(columns.Timestamps, bars.Timestamps[bucket] + bucketNs);
+                if (begin == end)
+                    return;
+                size_t count = end - begin;
+                auto mid = _reduce(columns.Mid.data() + begin, count);
+                auto spread = _reduce(columns.Spread.data() + begin, count);
+                double notional = _sum(columns.TopNotional.data() + begin, count);
+                double size = _sum(columns.TopSize.data() + begin, count);
+
+                bars.Counts[bucket] = count;
+                bars.Open[bucket] = columns.Mid[begin];
+                bars.High[bucket] = mid.Max;
+                bars.Low[bucket] = mid.Min;
+                bars.Close[bucket] = columns.Mid[end - 1];
+                bars.Mean[bucket] = mid.Sum / count;
+                bars.VwapOfTop[bucket] = size > 0 ? notional / size : std::nan("");
+                bars.SpreadMin[bucket] = spread.Min;
+                bars.SpreadMax[bucket] = spread.Max;
+                bars.SpreadMean[bucket] = spread.Sum / count;
+            });
+            return bars;
+        }
+
+        BarSeries GetPairBars(const std::string& first, const std::string& second, u_int64_t bucketNs) const
+        {
+            //value is mid(first) - mid(second) after every update of either leg once both legs were seen, ties apply the first leg first
+            auto& a = _getColumns(first);
+            auto& b = _getColumns(second);
+            auto bars = _makeSeries(bucketNs);
+            _forEachBucket(bars, [&](size_t bucket)
+            {
+                u_int64_t start = bars.Timestamps[bucket];
+                size_t i = _lowerBound(a.Timestamps, start);
+                size_t j = _lowerBound(b.Timestamps, start);
+                size_t endA = _lowerBound(a.Timestamps, start + bucketNs);
+                size_t endB = _lowerBound(b.Timestamps, start + bucketNs);
+                bool hasA = i > 0;
+                bool hasB = j > 0;
+                double midA = hasA ? a.Mid[i - 1] : 0;
+                double midB = hasB ? b.Mid[j - 1] : 0;
+
+                size_t count = 0;
+                double open = 0, close = 0, low = 0, high = 0, sum = 0;
+                while (i < endA || j < endB)
+                {
+                    if (j >= endB || (i < endA && a.Timestamps[i] <= b.Timestamps[j]))
+                    {
+                        midA = a.Mid[i++];
+                        hasA = true;
+                    }
+                    else
+                    {
+                        midB = b.Mid[j++];
+                        hasB = true;
+                    }
+                    if (!hasA || !hasB)
+                        continue;
+                    double value = midA - midB;
+                    if (count == 0)
+                        open = low = high = value;
+                    low = std::min(low, value);
+                    high = std::max(high, value);
+                    sum += value;
+                    close = value;
+                    ++count;
+                }
+                if (count == 0)
+                    return;
+
+                bars.Counts[bucket] = count;
+                bars.Open[bucket] = open;
+                bars.High[bucket] = bars.SpreadMax[bucket] = high;
+                bars.Low[bucket] = bars.SpreadMin[bucket] = low;
+                bars.Close[bucket] = close;
+                bars.Mean[bucket] = bars.SpreadMean[bucket] = sum / count;
+            });
+            return bars;
+        }
+
+    private:
+        template<typename T>
+        struct Column
+        {
+            //uninitialized storage, every element is written by the constructor before it is read
+            std::unique_ptr<T[]> Values;
+            size_t Count = 0;
+
+            inline T* data() const { return Values.get(); }
+            inline T* begin() const { return Values.get(); }
+            inline T* end() const { return Values.get() + Count; }
+            inline T& operator[](size_t index) const { return Values[index]; }
+        };
+
+        struct Columns
+        {
+            Column<u_int64_t> Timestamps;
+            Column<double> Mid;
+            Column<double> Spread;
+            Column<double> TopNotional;
+            Column<double> TopSize;
+
+            void Resize(size_t size)
+            {
+                for (auto column: {&Mid, &Spread, &TopNotional, &TopSize})
+                    *column = Column<double>{std::unique_ptr<double[]>(new double[size]), size};
+                Timestamps = Column<u_int64_t>{std::unique_ptr<u_int64_t[]>(new u_int64_t[size]), size};
+            }
+        };
+
+        struct Reduction
+        {
+            double Min;
+            double Max;
+            double Sum;
+        };
+
+        const Columns& _getColumns(const std::string& securityId) const
+        {
+            auto iter = _indices.find(securityId);
+            if (iter == _indices.end())
+                throw Exception("Unknown instrument " + securityId);
+            return _columns[iter->second];
+        }
+
+        BarSeries _makeSeries(u_int64_t bucketNs) const
+        {
+            if (bucketNs == 0)
+                throw Exception("Bucket size must be positive");
+            BarSeries bars;
+            bars.BucketNs = bucketNs;
+            if (_store->Size() == 0)
+                return bars;
+            u_int64_t first = (*_store)[0].Timestamp / bucketNs * bucketNs;
+            u_int64_t last = (*_store)[_store->Size() - 1].Timestamp;
+            bars.Resize((last - first) / bucketNs + 1);
+            for (size_t i = 0; i < bars.Size(); ++i)
+                bars.Timestamps[i] = first + i * bucketNs;
+            return bars;
+        }
+
+        template<typename Function>
+        void _forEachBucket(BarSeries& bars, Function function) const
+        {
+            size_t tasks = (bars.Size() + BUCKETS_PER_TASK - 1) / BUCKETS_PER_TASK;
+            ParallelFor(tasks, _threads, [&](size_t task, size_t worker)
+            {
+                size_t end = std::min(bars.Size(), (task + 1) * BUCKETS_PER_TASK);
+                for (size_t bucket = task * BUCKETS_PER_TASK; bucket < end; ++bucket)
+                    function(bucket);
+            });
+        }
+
+        static inline size_t _lowerBound(const Column<u_int64_t>& timestamps, u_int64_t timestamp)
+        {
+            return std::lower_bound(timestamps.begin(), timestamps.end(), timestamp) - timestamps.begin();
+        }
+
+        static inline Reduction _reduce(const double* values, size_t count)
+        {
+            //four independent lanes, no loop-carried dependency between them
+            double min[4] = {values[0], values[0], values[0], values[0]};
+            double max[4] = {values[0], values[0], values[0], values[0]};
+            double sum[4] = {0, 0, 0, 0};
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+                for (size_t lane = 0; lane < 4; ++lane)
+                {
+                    double value = values[i + lane];
+                    min[lane] = value < min[lane] ? value : min[lane];
+                    max[lane] = value > max[lane] ? value : max[lane];
+                    sum[lane] += value;
+                }
+            for (; i < count; ++i)
+            {
+                min[0] = std::min(min[0], values[i]);
+                max[0] = std::max(max[0], values[i]);
+                sum[0] += values[i];
+            }
+            return Reduction{
+                std::min(std::min(min[0], min[1]), std::min(min[2], min[3])),
+                std::max(std::max(max[0], max[1]), std::max(max[2], max[3])),
+                (sum[0] + sum[1]) + (sum[2] + sum[3])};
+        }
+
+        static inline double _sum(const double* values, size_t count)
+        {
+            double sum[4] = {0, 0, 0, 0};
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+                for (size_t lane = 0; lane < 4; ++lane)
+                    sum[lane] += values[i + lane];
+            for (; i < count; ++i)
+                sum[0] += values[i];
+            return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+        }
+
+    private:
+        TickStorePtr _store;
+        size_t _threads;
+        std::vector<Columns> _columns;
+        std::unordered_map<std::string, size_t> _indices;
+    };
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "definitions.h"
+#include "exceptions.hpp"
+
+namespace ArbSimulation
+{
+    class PerformanceAnalytics
+    {
+    /*
+    * Online equity-curve statistics. Every update is O(1) (apart from gaps spanning several buckets),
+    * curve samples are taken at bucket boundaries into a buffer preallocated for the whole replay.
+    * Returns are PnL increments per bucket, there is no notion of capital in the simulation.
+    */
+    public:
+        static constexpr double NANOSECONDS_PER_YEAR = 365.0 * 24 * 3600 * 1e9;
+
+        PerformanceAnalytics(u_int64_t bucketNs, size_t capacity): _bucketNs(bucketNs)
+        {
+            if (_bucketNs == 0)
+                throw Exception("Analytics bucket must be positive");
+            _sampleTimestamps.reserve(capacity);
+            _sampleEquity.reserve(capacity);
+        }
+
+        static size_t GetCapacity(u_int64_t firstTimestamp, u_int64_t lastTimestamp, u_int64_t bucketNs)
+        {
+            return (lastTimestamp - firstTimestamp) / bucketNs + 2;
+        }
+
+        inline void OnEquity(u_int64_t timestamp, double equity)
+        {
+            if (!_started)
+            {
+                _started = true;
+                _bucketStart = timestamp - timestamp % _bucketNs;
+                _bucketOpenEquity = _peak = _lastEquity = equity;
+                _lastTimestamp = timestamp;
+                return;
+            }
+            if (timestamp < _lastTimestamp)
+                timestamp = _lastTimestamp;
+
+            if (_lastEquity < _peak)
+                _timeUnderWater += timestamp - _lastTimestamp;
+
+            while (timestamp >= _bucketStart + _bucketNs)
+                _closeBucket();
+
+            _lastEquity = equity;
+            _lastTimestamp = timestamp;
+            if (equity >= _peak)
+            {
+                if (_isUnderWater)
+                    _longestUnderWater = std::max(_longestUnderWater, timestamp - _underWaterSince);
+                _isUnderWater = false;
+                _peak = equity;
+            }
+            else
+            {
+                if (!_isUnderWater)
+                {
+                    _isUnderWater = true;
+                    _underWaterSince = timestamp;
+                }
+                _maxDrawdown = std::max(_maxDrawdown, _peak - equity);
+            }
+        }
+
+        inline void OnFill(double qty, double price)
+        {
+            _turnover += std::abs(qty * price);
+            ++_fills;
+        }
+
+        void Finish()
+        {
+            if (!_started || _finished)
+                return;
+            _finished = true;
+            _closeBucket();
+            if (_isUnderWater)
+                _longestUnderWater = std::max(_longestUnderWater, _lastTimestamp - _underWaterSince);
+        }
+
+        inline double GetMaxDrawdown() const { return _maxDrawdown; }
+        inline u_int64_t GetTimeUnderWater() const { return _timeUnderWater; }
+        inline u_int64_t GetLongestUnderWater() const { return _longestUnderWater; }
+        inline double GetTurnover() const { return _turnover; }
+        inline size_t GetFills() const { return _fills; }
+        inline size_t GetReturnsCount() const { return _returns; }
+        inline double GetFinalEquity() const { return _lastEquity; }
+        inline u_int64_t GetBucketNs() const { return _bucketNs; }
+        inline const std::vector<u_int64_t>& GetSampleTimestamps() const { return _sampleTimestamps; }
+        inline const std::vector<double>& GetSampleEquity() const { return _sampleEquity; }
+        inline size_t GetDroppedSamples() const { return _droppedSamples; }
+
+        inline double GetMeanReturn() const
+        {
+            return _meanReturn;
+        }
+
+        inline double GetReturnStdDev() const
+        {
+            return _returns > 1 ? std::sqrt(_m2Return / (_returns - 1)) : 0;
+        }
+
+        inline double GetSharpe() const
+        {
+            //per bucket, multiply by GetAnnualizationFactor() for the annual figure
+            double stdDev = GetReturnStdDev();
+            return stdDev > MAX_PRECISION ? _meanReturn / stdDev : 0;
+        }
+
+        inline double GetSortino() const
+        {
+            double downside = _returns > 0 ? std::sqrt(_downsideSquares / _returns) : 0;
+            return downside > MAX_PRECISION ? _meanReturn / downside : 0;
+        }
+
+        inline double GetAnnualizationFactor() const
+        {
+            return std::sqrt(NANOSECONDS_PER_YEAR / _bucketNs);
+        }
+
+        void WriteCurve(const std::string& path) const
+        {
+            /*
+            * Layout: "ARBEQTY1" | u64 bucketNs | u64 count | u64 timestamps[count] | f64 equity[count]
+            */
+            std::ofstream file{path, std::ios::binary | std::ios::trunc};
+            if (!file)
+                throw Exception("Unable to create " + path);
+            u_int64_t count = _sampleTimestamps.size();
+            file.write("ARBEQTY1", 8);
+            file.write(reinterpret_cast<const char*>(&_bucketNs), sizeof(_bucketNs));
+            file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            file.write(reinterpret_cast<const char*>(_sampleTimestamps.data()), count * sizeof(u_int64_t));
+            file.write(reinterpret_cast<const char*>(_sampleEquity.data()), count * sizeof(double));
+        }
+
+        std::vector<std::vector<std::string>> GetSummary() const
+        {
+            return {
+                {"FinalEquity", std::to_string(_lastEquity)},
+                {"MaxDrawdown", std::to_string(_maxDrawdown)},
+                {"TimeUnderWaterSec", std::to_string(_timeUnderWater / 1e9)},
+                {"LongestUnderWaterSec", std::to_string(_longestUnderWater / 1e9)},
+                {"BucketSec", std::to_string(_bucketNs / 1e9)},
+                {"Buckets", std::to_string(_returns)},
+                {"MeanReturn", std::to_string(GetMeanReturn())},
+                {"ReturnStdDev", std::to_string(GetReturnStdDev())},
+                {"Sharpe", std::to_string(GetSharpe())},
+                {"Sortino", std::to_string(GetSortino())},
+                {"AnnualizedSharpe", std::to_string(GetSharpe() * GetAnnualizationFactor())},
+                {"AnnualizedSortino", std::to_string(GetSortino() * GetAnnualizationFactor())},
+                {"Turnover", std::to_string(_turnover)},
+                {"Fills", std::to_string(_fills)}};
+        }
+
+    private:
+        inline void _closeBucket()
+        {
+            double bucketReturn = _lastEquity - _bucketOpenEquity;
+            ++_returns;
+            double delta = bucketReturn - _meanReturn;
+            _meanReturn += delta / _returns;
+            _m2Return += delta * (bucketReturn - _meanReturn);
+            if (bucketReturn < 0)
+                _downsideSquares += bucketReturn * bucketReturn;
+
+            _bucketStart += _bucketNs;
+            _bucketOpenEquity = _lastEquity;
+            if (_sampleTimestamps.size() < _sampleTimestamps.capacity())
+            {
+                _sampleTimestamps.push_back(_bucketStart);
+                _sampleEquity.push_back(_lastEquity);
+            }
+            else
+                ++_droppedSamples;
+        }
+
+    private:
+        u_int64_t _bucketNs;
+        bool _started = false;
+        bool _finished = false;
+
+        u_int64_t _lastTimestamp = 0;
+        double _lastEquity = 0;
+
+        double _peak = 0;
+        double _maxDrawdown = 0;
+        bool _isUnderWater = false;
+        u_int64_t _underWaterSince = 0;
+        u_int64_t _timeUnderWater = 0;
+        u_int64_t _longestUnderWater = 0;
+
+        u_int64_t _bucketStart = 0;
+        double _bucketOpenEquity = 0;
+        size_t _returns = 0;
+        double _meanReturn = 0;
+        double _m2Return = 0;
+        double _downsideSquares = 0;
+
+        double _turnover = 0;
+        size_t _fills = 0;
+
+        std::vector<u_int64_t> _sampleTimestamps;
+        std::vector<double> _sampleEquity;
+        size_t _droppedSamples = 0;
+    };
+    typedef std::shared_ptr<PerformanceAnalytics> PerformanceAnalyticsPtr;
+}
@@ -1,15 +1,41 @@
+#pragma once
+
+#include <optional>
+
+#include "rolling_stats.hpp"
 #include "strategy_base.hpp"
 
 namespace ArbSimulation
 {
+    enum class SignalType
+    {
+        Absolute,                           //X is the minimal executable spread
+        ZScore,                             //X is the minimal z-score of the mid spread over a rolling window
+        Ewma                                //X is the minimal z-score of the mid spread against its EWMA
+    };
+
+    struct SignalOptions
+    {
+        SignalType Type = SignalType::Absolute;
+        WindowOptions Window;               //ZScore
+        u_int64_t HalfLifeNs = 0;           //Ewma, time decay
+        double Alpha = 0;                   //Ewma, per-sample decay when HalfLifeNs is 0
+        size_t WarmUp = 2;                  //samples required before the first signal
+    };
+
     class ArbitrageStrategy: public BasicStrategy
     {
     public:
         ArbitrageStrategy(double X, double Y, double Z, 
-            std::shared_ptr<InstrumentManager> instrManager): 
+            std::shared_ptr<InstrumentManager> instrManager, const SignalOptions& signal = {}): 
             BasicStrategy(instrManager), 
-            _parameterX(X), _parameterY(Y), _parameterZ(Z)
-        {}
+            _parameterX(X), _parameterY(Y), _parameterZ(Z), _signal(signal)
+        {
+            if (signal.Type == SignalType::ZScore)
+                _window.emplace(signal.Window);
+            else if (signal.Type == SignalType::Ewma)
+                _ewma = signal.HalfLifeNs > 0 ? Ewma::FromHalfLife(signal.HalfLifeNs) : Ewma::FromAlpha(signal.Alpha);
+        }
 
         void OnL1Update(L1UpdatePtr update) override
         {
@@ -23,6 +49,11 @@ namespace ArbSimulation
             //do not act until we receive first update on FutureA
                 return;
 
+            //statistics see every spread, signals are evaluated against the history before the current one
+            double zScore = 0;
+            if (_signal.Type != SignalType::Absolute)
+                zScore = _updateSignal(update);
+
             if (!_isAOrderConfirmed || !_isBOrderConfirmed)
             //do not act while orders are pending
                 return;
@@ -56,7 +87,16 @@ namespace ArbSimulation
                 return;
             }
 
-            if (positionA.GetNetQty() > -_parameterY && _lastAUpdate->BidPrice - update->AskPrice >= _parameterX)
+            bool sellA = _lastAUpdate->BidPrice - update->AskPrice >= _parameterX;
+            bool buyA = update->BidPrice - _lastAUpdate->AskPrice >= _parameterX;
+            if (_signal.Type != SignalType::Absolute)
+            {
+                //A is rich against B when the mid spread is far above its usual level
+                sellA = zScore >= _parameterX;
+                buyA = zScore <= -_parameterX;
+            }
+
+            if (positionA.GetNetQty() > -_parameterY && sellA)
             {
                 //std::cout << "\n\nCondition A is met:\n\tFutureB.Bid:" << update->BidPrice  <<";FutureB.Ask:"<< update->AskPrice;
                 //std::cout << "\n\tFutureA.Bid:" << _lastAUpdate->BidPrice  <<";FutureA.Ask:"<< _lastAUpdate->AskPrice;
@@ -65,7 +105,7 @@ namespace ArbSimulation
                 _isAOrderConfirmed = false;
                 _isBOrderConfirmed = false;         
             }
-            else if (positionA.GetNetQty() < _parameterY && update->BidPrice - _lastAUpdate->AskPrice >= _parameterX)
+            else if (positionA.GetNetQty() < _parameterY && buyA)
             {
                 //std::cout << "\n\nCondition B is met:\n\tFutureB.Bid:" << update->BidPrice  <<";FutureB.Ask:"<< update->AskPrice;
                 //std::cout << "\n\tFutureA.Bid:" << _lastAUpdate->BidPrice  <<";FutureA.Ask:"<< _lastAUpdate->AskPrice;
@@ -76,6 +116,18 @@ namespace ArbSimulation
             }
         }
 
+        bool SamplesEveryUpdate() const override
+        {
+            //every B update is one sample of the spread statistics
+            return _signal.Type != SignalType::Absolute;
+        }
+
+        inline bool IsFinished() const
+        {
+            //the stop-loss has been hit and filled: positions are flat and the strategy never trades again, so PnL is final
+            return _tradingRestricted && _isAOrderConfirmed && _isBOrderConfirmed;
+        }
+
         void OnOrderFilled(OrderPtr order) override
         {
             if (order->Instrument->SecurityId == "FutureA")
@@ -92,6 +144,27 @@ namespace ArbSimulation
                 throw Exception("Unknown instrument");
         }
 
+    private:
+        double _updateSignal(const L1UpdatePtr& update)
+        {
+            double spread = (_lastAUpdate->BidPrice + _lastAUpdate->AskPrice - update->BidPrice - update->AskPrice) / 2;
+            double zScore = std::nan("");
+            if (_window)
+            {
+                if (_window->Size() >= _signal.WarmUp)
+                    zScore = _window->GetZScore(spread);
+                _window->Add(spread, update->Timestamp);
+            }
+            else
+            {
+                if (_ewma->Size() >= _signal.WarmUp)
+                    zScore = _ewma->GetZScore(spread);
+                _ewma->Add(spread, update->Timestamp);
+            }
+            //NaN (warm-up, flat history) compares false against any threshold
+            return zScore;
+        }
+
     private:
         L1UpdatePtr _lastAUpdate = nullptr;
         bool _isAOrderConfirmed = true;
@@ -100,5 +173,8 @@ namespace ArbSimulation
         double _parameterX = 0;
         double _parameterY = 0;
         double _parameterZ = 0;   
+        SignalOptions _signal;
+        std::optional<RollingStats> _window;
+        std::optional<Ewma> _ewma;
     };
 }
\ No newline at end of file
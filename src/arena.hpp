@@ -0,0 +1,441 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <new>
+#include <mutex>
+#include <sys/mman.h>
+
+#include "exceptions.hpp"
+
+namespace ArbSimulation
+{
+    enum class PageBacking
+    {
+        HugeTlb,                            //explicit 2MB pages from the hugetlbfs pool
+        Transparent,                        //regular mapping advised for transparent huge pages
+        Normal                              //4KB pages: small blocks, or huge pages are disabled or not supported
+    };
+
+    struct MappedBlock
+    {
+        void* Address = nullptr;
+        size_t Size = 0;
+        PageBacking Backing = PageBacking::Normal;
+    };
+
+    struct MemoryUsage
+    {
+        size_t Bytes[3] = {};               //currently mapped, by PageBacking
+        size_t PeakBytes = 0;               //of all mappings together
+        size_t Mappings = 0;
+    };
+
+    class HugePages
+    {
+    /*
+    * Anonymous mappings in 2MB pages with a transparent fallback: MAP_HUGETLB first (needs a reserved pool,
+    * see vm.nr_hugepages), then a 2MB-aligned mapping advised with MADV_HUGEPAGE, which the kernel backs with huge pages
+    * when transparent huge pages are enabled, otherwise regular pages. Either way one TLB entry then covers 2MB
+    * instead of 4KB, which matters when a replay walks hundreds of megabytes of ticks.
+    * Mappings are registered, so their use can be reported and they can be released by address.
+    */
+    public:
+        static constexpr size_t HUGE_PAGE = 2 << 20;
+        static constexpr size_t SMALL_PAGE = 4096;
+
+        static inline void SetEnabled(bool enabled)
+        {
+            //disabled: plain page-aligned mappings, e.g. to compare replay times
+            _enabled().store(enabled);
+        }
+
+        static inline bool IsEnabled()
+        {
+            return _enabled().load(std::memory_order_relaxed);
+        }
+
+        static MappedBlock Map(size_t bytes)
+        {
+            //less than a huge page is not worth one, a huge page would be faulted in whole
+            if (bytes < HUGE_PAGE)
+            {
+                size_t size = (bytes + SMALL_PAGE - 1) / SMALL_PAGE * SMALL_PAGE;
+                void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (address == MAP_FAILED)
+                    throw std::bad_alloc();
+                MappedBlock block{address, size, PageBacking::Normal};
+                _register(block);
+                return block;
+            }
+
+            size_t size = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+            MappedBlock block{nullptr, size, PageBacking::Normal};
+            if (IsEnabled() && _hugeTlb().load(std::memory_order_relaxed))
+            {
+                void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                if (address != MAP_FAILED)
+                {
+                    block.Address = address;
+                    block.Backing = PageBacking::HugeTlb;
+                    _register(block);
+                    return block;
+                }
+                //the pool is empty or missing, do not try again for every block
+                _hugeTlb().store(false);
+            }
+
+            //map one huge page more and trim, so the block starts on a 2MB boundary
+            void* raw = ::mmap(nullptr, size + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED)
+                throw std::bad_alloc();
+            auto begin = (reinterpret_cast<uintptr_t>(raw) + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+            size_t head = begin - reinterpret_cast<uintptr_t>(raw);
+            if (head > 0)
+                ::munmap(raw, head);
+            ::munmap(reinterpret_cast<void*>(begin + size), HUGE_PAGE - head);
+            block.Address = reinterpret_cast<void*>(begin);
+            if (IsEnabled() && ::madvise(block.Address, size, MADV_HUGEPAGE) == 0)
+                block.Backing = PageBacking::Transparent;
+            _register(block);
+            return block;
+        }
+
+        static size_t Unmap(void* address)
+        {
+            //returns the size of the mapping
+            MappedBlock block;
+            {
+                auto& registry = _registry();
+                std::lock_guard<std::mutex> lock(registry.Mutex);
+                auto iter = registry.Blocks.find(address);
+                if (iter == registry.Blocks.end())
+                    throw Exception("Unknown huge page mapping");
+                block = iter->second;
+                registry.Blocks.erase(iter);
+                registry.Usage.Bytes[size_t(block.Backing)] -= block.Size;
+                --registry.Usage.Mappings;
+            }
+            ::munmap(block.Address, block.Size);
+            return block.Size;
+        }
+
+        static MemoryUsage GetUsage()
+        {
+            auto& registry = _registry();
+            std::lock_guard<std::mutex> lock(registry.Mutex);
+            return registry.Usage;
+        }
+
+        static const char* GetBackingName(PageBacking backing)
+        {
+            static const char* names[] = {"hugetlb", "transparent huge pages", "4KB pages"};
+            return names[size_t(backing)];
+        }
+
+    private:
+        struct Registry
+        {
+            std::mutex Mutex;
+            std::map<void*, MappedBlock> Blocks;
+            MemoryUsage Usage;
+        };
+
+        static Registry& _registry()
+        {
+            static Registry registry;
+            return registry;
+        }
+
+        static std::atomic<bool>& _enabled()
+        {
+            static std::atomic<bool> enabled{true};
+            return enabled;
+        }
+
+        static std::atomic<bool>& _hugeTlb()
+        {
+            static std::atomic<bool> available{true};
+            return available;
+        }
+
+        static void _register(const MappedBlock& block)
+        {
+            auto& registry = _registry();
+            std::lock_guard<std::mutex> lock(registry.Mutex);
+            registry.Blocks[block.Address] = block;
+            registry.Usage.Bytes[size_t(block.Backing)] += block.Size;
+            ++registry.Usage.Mappings;
+            size_t total = 0;
+            for (size_t bytes: registry.Usage.Bytes)
+                total += bytes;
+            registry.Usage.PeakBytes = std::max(registry.Usage.PeakBytes, total);
+        }
+    };
+
+    template<typename T>
+    class HugePageAllocator
+    {
+    /*
+    * Allocator for large contiguous arrays (e.g. tick records): blocks of HUGE_PAGE and more are mapped by HugePages
+    * (on huge page boundaries), smaller ones come from operator new aligned to a cache line, so vectorized loops over them
+    * never start mid-line.
+    */
+    public:
+        using value_type = T;
+        static constexpr size_t ALIGNMENT = 64;
+
+        HugePageAllocator() = default;
+
+        template<typename U>
+        HugePageAllocator(const HugePageAllocator<U>&)
+        {}
+
+        T* allocate(size_t count)
+        {
+            size_t bytes = count * sizeof(T);
+            if (bytes < HugePages::HUGE_PAGE)
+                return static_cast<T*>(::operator new(bytes, std::align_val_t(ALIGNMENT)));
+            return static_cast<T*>(HugePages::Map(bytes).Address);
+        }
+
+        void deallocate(T* pointer, size_t count)
+        {
+            if (count * sizeof(T) < HugePages::HUGE_PAGE)
+                ::operator delete(pointer, std::align_val_t(ALIGNMENT));
+            else
+                HugePages::Unmap(pointer);
+        }
+
+        template<typename U>
+        inline bool operator==(const HugePageAllocator<U>&) const
+        {
+            return true;
+        }
+    };
+
+    struct ArenaStats
+    {
+        size_t Chunks = 0;
+        size_t ReservedBytes = 0;           //chunks and large blocks mapped by the arena
+        size_t UsedBytes = 0;               //handed out and not freed, rounded to size classes
+        size_t PeakBytes = 0;
+        size_t Allocations = 0;
+        size_t Reused = 0;                  //allocations served from a free list
+        PageBacking Backing = PageBacking::Normal;   //of the last chunk
+    };
+
+    class Arena;
+    typedef std::shared_ptr<Arena> ArenaPtr;
+
+    class Arena
+    {
+    /*
+    * Per-run memory for hot state (matcher queues, orders, trade log, book updates): blocks are carved from
+    * HugePages chunks, so one run's working set sits on a few pages instead of being spread over the heap,
+    * and runs on different threads never share a cache line (blocks are multiples of CACHE_LINE, aligned to it).
+    * Chunks double from MIN_CHUNK up to chunkSize: a short run stays small, a long one ends up on huge pages.
+    * Freed blocks go to power-of-two free lists, blocks above half of chunkSize get their own mapping.
+    * Not thread-safe: an arena belongs to one run, see ArenaScope.
+    */
+    public:
+        static constexpr size_t CACHE_LINE = 64;
+        static constexpr size_t MIN_CHUNK = 64 << 10;
+
+        explicit Arena(size_t chunkSize = HugePages::HUGE_PAGE): _chunkSize(chunkSize)
+        {
+            for (size_t block = CACHE_LINE; block <= _chunkSize / 2; block <<= 1)
+                ++_classes;
+            _free.assign(_classes, nullptr);
+        }
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        ~Arena()
+        {
+            for (void* chunk: _chunks)
+                HugePages::Unmap(chunk);
+        }
+
+        void* Allocate(size_t bytes)
+        {
+            ++_stats.Allocations;
+            size_t sizeClass = _getClass(bytes);
+            if (sizeClass >= _classes)
+            {
+                auto block = HugePages::Map(bytes);
+                _stats.ReservedBytes += block.Size;
+                _use(block.Size);
+                return block.Address;
+            }
+            _use(CACHE_LINE << sizeClass);
+            if (auto block = _free[sizeClass])
+            {
+                ++_stats.Reused;
+                _free[sizeClass] = block->Next;
+                return block;
+            }
+            size_t size = CACHE_LINE << sizeClass;
+            if (_cursor == nullptr || _cursor + size > _end)
+                _addChunk(size);
+            void* block = _cursor;
+            _cursor += size;
+            return block;
+        }
+
+        void Deallocate(void* pointer, size_t bytes)
+        {
+            size_t sizeClass = _getClass(bytes);
+            if (sizeClass >= _classes)
+            {
+                size_t size = HugePages::Unmap(pointer);
+                _stats.ReservedBytes -= size;
+                _stats.UsedBytes -= size;
+                return;
+            }
+            _stats.UsedBytes -= CACHE_LINE << sizeClass;
+            auto block = static_cast<Block*>(pointer);
+            block->Next = _free[sizeClass];
+            _free[sizeClass] = block;
+        }
+
+        inline const ArenaStats& GetStats() const
+        {
+            return _stats;
+        }
+
+        static inline const ArenaPtr& GetCurrent()
+        {
+            //the arena of the run on this thread, nullptr outside of an ArenaScope
+            return _current();
+        }
+
+    private:
+        friend class ArenaScope;
+
+        struct Block
+        {
+            Block* Next;
+        };
+
+        static ArenaPtr& _current()
+        {
+            thread_local ArenaPtr current;
+            return current;
+        }
+
+        inline size_t _getClass(size_t bytes) const
+        {
+            size_t sizeClass = 0;
+            for (size_t block = CACHE_LINE; block < bytes && sizeClass < _classes; block <<= 1)
+                ++sizeClass;
+            return sizeClass;
+        }
+
+        inline void _use(size_t bytes)
+        {
+            _stats.UsedBytes += bytes;
+            _stats.PeakBytes = std::max(_stats.PeakBytes, _stats.UsedBytes);
+        }
+
+        void _addChunk(size_t minimum)
+        {
+            //the tail of the previous chunk is left unused, it is smaller than the block that did not fit
+            size_t size = std::max(minimum, std::min(_chunkSize, MIN_CHUNK << std::min<size_t>(_stats.Chunks, 20)));
+            auto chunk = HugePages::Map(size);
+            _chunks.push_back(chunk.Address);
+            _cursor = static_cast<std::byte*>(chunk.Address);
+            _end = _cursor + chunk.Size;
+            ++_stats.Chunks;
+            _stats.Backing = chunk.Backing;
+            _stats.ReservedBytes += chunk.Size;
+        }
+
+    private:
+        size_t _chunkSize;
+        size_t _classes = 0;
+        std::vector<Block*> _free;
+        std::vector<void*> _chunks;
+        std::byte* _cursor = nullptr;
+        std::byte* _end = nullptr;
+        ArenaStats _stats;
+    };
+
+    class ArenaScope
+    {
+    /*
+    * Makes an arena current on this thread: ArenaAllocators created in the scope allocate from it.
+    * Scopes nest, the previous arena is restored on exit.
+    */
+    public:
+        explicit ArenaScope(ArenaPtr arena): _previous(std::move(Arena::_current()))
+        {
+            Arena::_current() = std::move(arena);
+        }
+
+        ArenaScope(const ArenaScope&) = delete;
+        ArenaScope& operator=(const ArenaScope&) = delete;
+
+        ~ArenaScope()
+        {
+            Arena::_current() = std::move(_previous);
+        }
+
+    private:
+        ArenaPtr _previous;
+    };
+
+    template<typename T>
+    class ArenaAllocator
+    {
+    /*
+    * Allocates from the arena current when the allocator was created and keeps it alive,
+    * so containers and shared objects may outlive their run. Without a current arena it uses operator new.
+    */
+    public:
+        using value_type = T;
+
+        ArenaAllocator(): _arena(Arena::GetCurrent())
+        {}
+
+        explicit ArenaAllocator(ArenaPtr arena): _arena(std::move(arena))
+        {}
+
+        //no move constructor: a moved-from allocator must still free what it allocated
+        ArenaAllocator(const ArenaAllocator&) = default;
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other): _arena(other.GetArena())
+        {}
+
+        inline T* allocate(size_t count)
+        {
+            if (_arena)
+                return static_cast<T*>(_arena->Allocate(count * sizeof(T)));
+            return static_cast<T*>(::operator new(count * sizeof(T)));
+        }
+
+        inline void deallocate(T* pointer, size_t count)
+        {
+            if (_arena)
+                _arena->Deallocate(pointer, count * sizeof(T));
+            else
+                ::operator delete(pointer);
+        }
+
+        inline const ArenaPtr& GetArena() const
+        {
+            return _arena;
+        }
+
+        template<typename U>
+        inline bool operator==(const ArenaAllocator<U>& other) const
+        {
+            return _arena == other.GetArena();
+        }
+
+    private:
+        ArenaPtr _arena;
+    };
+}
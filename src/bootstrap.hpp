@@ -0,0 +1,179 @@
+#pragma once
+
+#include "hashing.hpp"
+#include "random.hpp"
+#include "tick_store.hpp"
+
+namespace ArbSimulation
+{
+    struct PathSegment
+    {
+        size_t SnapshotBegin = 0;           //range of ReplayPath::Snapshots dispatched before the block
+        size_t SnapshotEnd = 0;
+        size_t Begin = 0;                   //range of store records
+        size_t End = 0;
+        u_int64_t Start = 0;                //replayed timestamp of the block start, snapshots carry it
+        u_int64_t TimeShift = 0;            //added to record timestamps (wraps around for earlier blocks)
+        double PriceShift = 0;              //added to bid and ask prices
+    };
+
+    struct ReplayPath
+    {
+    /*
+    * A replay order over a TickStore: segments are index ranges of the shared store, nothing is copied.
+    * Snapshots are store indices re-sent at the start of a segment (with its time and price shift).
+    */
+        std::vector<PathSegment> Segments;
+        std::shared_ptr<const std::vector<size_t>> Snapshots;
+        u_int64_t Key = 0;                  //of the block order over its store, equal keys replay equally; 0 - unknown
+    };
+    typedef std::shared_ptr<const ReplayPath> ReplayPathPtr;
+
+    class BootstrapBlocks
+    {
+    /*
+    * Splits a TickStore into consecutive time blocks of BlockNs and stitches random blocks into resampled paths
+    * (non-overlapping block bootstrap: paths have as many blocks as the data, drawn with replacement).
+    *
+    * Books stay consistent at seams: when a block does not follow its original predecessor, the last record of every
+    * instrument before the block is re-sent at the seam, so the strategy and the matcher never mix books of two blocks.
+    * With rebasing all prices of a block move by one common offset that joins the mean mid of the instruments
+    * to the end of the previous block: spreads between instruments are kept, level jumps do not turn into PnL.
+    * Replaying the blocks in their original order reproduces the original replay exactly.
+    */
+    public:
+        BootstrapBlocks(const TickStore& store, u_int64_t blockNs): _blockNs(blockNs)
+        {
+            if (blockNs == 0)
+                throw Exception("Bootstrap block must be positive");
+            if (store.Size() == 0)
+                return;
+
+            size_t instruments = store.GetSecurityIds().size();
+            std::vector<double> mids(instruments, std::nan(""));
+            std::vector<size_t> last(instruments, store.Size());
+            auto snapshots = std::make_shared<std::vector<size_t>>();
+            u_int64_t first = store[0].Timestamp;
+            for (size_t begin = 0; begin < store.Size();)
+            {
+                Block block;
+                block.Begin = begin;
+                block.Start = first + (store[begin].Timestamp - first) / blockNs * blockNs;
+                block.End = begin;
+                while (block.End < store.Size() && store[block.End].Timestamp < block.Start + blockNs)
+                    ++block.End;
+
+                block.SnapshotBegin = snapshots->size();
+                for (size_t instrument = 0; instrument < instruments; ++instrument)
+                    if (last[instrument] < store.Size())
+                        snapshots->push_back(last[instrument]);
+                block.SnapshotEnd = snapshots->size();
+
+                //instruments without a book yet are opened by their first record in the block
+                std::vector<double> opening = mids;
+                for (size_t i = block.Begin; i < block.End; ++i)
+                {
+                    auto& record = store[i];
+                    if (std::isnan(opening[record.InstrumentId]))
+                        opening[record.InstrumentId] = (record.BidPrice + record.AskPrice) / 2;
+                    mids[record.InstrumentId] = (record.BidPrice + record.AskPrice) / 2;
+                    last[record.InstrumentId] = i;
+                }
+                block.OpenMid = _mean(opening);
+                block.CloseMid = _mean(mids);
+                _blocks.push_back(block);
+                begin = block.End;
+            }
+            //a block lasts until the next non-empty one, so gaps in the data are kept within paths
+            for (size_t i = 0; i + 1 < _blocks.size(); ++i)
+                _blocks[i].Duration = _blocks[i + 1].Start - _blocks[i].Start;
+            _blocks.back().Duration = store[store.Size() - 1].Timestamp + 1 - _blocks.back().Start;
+            _snapshots = snapshots;
+        }
+
+        inline size_t Size() const
+        {
+            return _blocks.size();
+        }
+
+        inline u_int64_t GetBlockNs() const
+        {
+            return _blockNs;
+        }
+
+        ReplayPathPtr MakePath(const std::vector<size_t>& blocks, bool rebase = true) const
+        {
+            auto path = std::make_shared<ReplayPath>();
+            path->Snapshots = _snapshots;
+            Hasher key;
+            key.Add(_blockNs).Add(rebase).Add(u_int64_t(blocks.size())).Update(blocks.data(), blocks.size() * sizeof(size_t));
+            path->Key = key.Digest() | 1;                  //never unknown
+            path->Segments.reserve(blocks.size());
+            u_int64_t start = _blocks.empty() ? 0 : _blocks[0].Start;
+            double priceShift = 0;
+            for (size_t i = 0; i < blocks.size(); ++i)
+            {
+                if (blocks[i] >= _blocks.size())
+                    throw Exception("Bootstrap block is out of range");
+                auto& block = _blocks[blocks[i]];
+                bool follows = i > 0 && blocks[i] == blocks[i - 1] + 1;
+                if (i > 0 && rebase && !follows)
+                    priceShift += _blocks[blocks[i - 1]].CloseMid - block.OpenMid;
+
+                PathSegment segment;
+                segment.SnapshotBegin = follows ? 0 : block.SnapshotBegin;
+                segment.SnapshotEnd = follows ? 0 : block.SnapshotEnd;
+                segment.Begin = block.Begin;
+                segment.End = block.End;
+                segment.Start = start;
+                segment.TimeShift = start - block.Start;
+                segment.PriceShift = std::isnan(priceShift) ? 0 : priceShift;
+                path->Segments.push_back(segment);
+                start += block.Duration;
+            }
+            return path;
+        }
+
+        ReplayPathPtr Resample(u_int64_t seed, u_int64_t pathIndex, bool rebase = true) const
+        {
+            //path i draws from the counter-based stream (seed, i), so paths do not depend on the number of threads
+            CounterRng rng(seed, pathIndex);
+            std::vector<size_t> blocks(_blocks.size());
+            for (auto& block: blocks)
+                block = std::min<size_t>(rng.Uniform() * _blocks.size(), _blocks.size() - 1);
+            return MakePath(blocks, rebase);
+        }
+
+    private:
+        struct Block
+        {
+            size_t Begin = 0;
+            size_t End = 0;
+            size_t SnapshotBegin = 0;
+            size_t SnapshotEnd = 0;
+            u_int64_t Start = 0;
+            u_int64_t Duration = 0;
+            double OpenMid = 0;
+            double CloseMid = 0;
+        };
+
+        static double _mean(const std::vector<double>& values)
+        {
+            double sum = 0;
+            size_t count = 0;
+            for (double value: values)
+                if (!std::isnan(value))
+                {
+                    sum += value;
+                    ++count;
+                }
+            return count > 0 ? sum / count : std::nan("");
+        }
+
+    private:
+        u_int64_t _blockNs;
+        std::vector<Block> _blocks;
+        std::shared_ptr<const std::vector<size_t>> _snapshots;
+    };
+    typedef std::shared_ptr<const BootstrapBlocks> BootstrapBlocksPtr;
+}
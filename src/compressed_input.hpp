@@ -0,0 +1,382 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "exceptions.hpp"
+#include "threading.hpp"
+
+#ifdef ARBSIM_HAS_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ARBSIM_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace ArbSimulation
+{
+    enum class Compression
+    {
+        None,
+        Gzip,
+        Zstd
+    };
+
+    class MappedFile
+    {
+    /*
+    * Read-only mapping of a whole file, empty files map to an empty range.
+    */
+    public:
+        MappedFile(const MappedFile&) = delete;
+
+        MappedFile(const std::string& path)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw Exception("Unable to open " + path);
+            struct stat st;
+            if (::fstat(fd, &st) != 0)
+            {
+                ::close(fd);
+                throw Exception("Unable to stat " + path);
+            }
+            _size = st.st_size;
+            if (_size > 0)
+            {
+                void* address = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address == MAP_FAILED)
+                {
+                    ::close(fd);
+                    throw Exception("Unable to map " + path);
+                }
+                ::madvise(address, _size, MADV_SEQUENTIAL);
+                _data = static_cast<const char*>(address);
+            }
+            ::close(fd);
+        }
+
+        ~MappedFile()
+        {
+            if (_data != nullptr)
+                ::munmap(const_cast<char*>(_data), _size);
+        }
+
+        inline const char* Data() const
+        {
+            return _data;
+        }
+
+        inline size_t Size() const
+        {
+            return _size;
+        }
+
+    private:
+        const char* _data{nullptr};
+        size_t _size{0};
+    };
+
+    class CompressedInput
+    {
+    /*
+    * Decompression of archived DataFiles without temporary files.
+    * Multi-frame zstd files whose frames record their content size are decompressed frame by frame in parallel into one buffer.
+    * Gzip (including concatenated members) and other zstd files are decompressed in a streaming pipeline:
+    * a producer thread fills a few fixed-size chunks while the caller consumes the previous ones.
+    * Support is compiled in with ARBSIM_HAS_ZLIB / ARBSIM_HAS_ZSTD (set by CMake when the libraries are found).
+    */
+    public:
+        static constexpr size_t CHUNK_SIZE = 4 << 20;
+        static constexpr size_t CHUNKS_IN_FLIGHT = 4;
+
+        typedef std::function<void(const char*, size_t)> ChunkHandler;
+
+        struct Buffer
+        {
+            std::unique_ptr<char[]> Data;
+            size_t Size = 0;
+        };
+
+        static Compression Detect(const char* data, size_t size)
+        {
+            static constexpr unsigned char GZIP_MAGIC[2] = {0x1f, 0x8b};
+            static constexpr unsigned char ZSTD_MAGIC[4] = {0x28, 0xb5, 0x2f, 0xfd};
+            if (size >= 4 && std::memcmp(data, ZSTD_MAGIC, 4) == 0)
+                return Compression::Zstd;
+            if (size >= 2 && std::memcmp(data, GZIP_MAGIC, 2) == 0)
+                return Compression::Gzip;
+            return Compression::None;
+        }
+
+        static size_t GetContentSize(const char* data, size_t size, Compression compression)
+        {
+            //decompressed size when the archive records it (zstd frame headers), 0 when unknown
+            if (compression == Compression::None)
+                return size;
+            std::vector<Frame> frames;
+            if (compression != Compression::Zstd || !_findFrames(data, size, frames))
+                return 0;
+            return frames.back().OutputOffset + frames.back().OutputSize;
+        }
+
+        static bool DecompressFrames(const char* data, size_t size, size_t threads, Buffer& output)
+        {
+            /*
+            * Decompresses every zstd frame on its own worker straight to its offset in output.
+            * Returns false when there is a single frame or a frame does not record its size, such files are streamed instead.
+            */
+            std::vector<Frame> frames;
+            if (!_findFrames(data, size, frames) || frames.size() < 2)
+                return false;
+#ifdef ARBSIM_HAS_ZSTD
+            output.Size = frames.back().OutputOffset + frames.back().OutputSize;
+            output.Data.reset(new char[output.Size]);
+            std::vector<std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)>> contexts;
+            threads = std::max<size_t>(1, std::min(threads, frames.size()));
+            for (size_t i = 0; i < threads; ++i)
+                contexts.emplace_back(ZSTD_createDCtx(), ZSTD_freeDCtx);
+            ParallelFor(frames.size(), threads, [&](size_t index, size_t worker)
+            {
+                auto& frame = frames[index];
+                size_t written = ZSTD_decompressDCtx(contexts[worker].get(), output.Data.get() + frame.OutputOffset, frame.OutputSize,
+                    data + frame.InputOffset, frame.InputSize);
+                if (ZSTD_isError(written) || written != frame.OutputSize)
+                    throw Exception("Corrupted zstd frame at offset " + std::to_string(frame.InputOffset));
+            });
+#endif
+            return true;
+        }
+
+        static void Stream(const char* data, size_t size, Compression compression, ChunkHandler handler)
+        {
+            //calls handler with consecutive pieces of the decompressed stream, in order, on the calling thread
+            if (compression == Compression::None)
+            {
+                handler(data, size);
+                return;
+            }
+            Pipeline pipeline;
+            std::thread producer([&]()
+            {
+                try
+                {
+                    if (compression == Compression::Gzip)
+                        _inflate(data, size, pipeline);
+                    else
+                        _decompressStream(data, size, pipeline);
+                    pipeline.Finish(nullptr);
+                }
+                catch(...)
+                {
+                    pipeline.Finish(std::current_exception());
+                }
+            });
+            try
+            {
+                pipeline.Consume(handler);
+            }
+            catch(...)
+            {
+                pipeline.Cancel();
+                producer.join();
+                throw;
+            }
+            producer.join();
+        }
+
+    private:
+        struct Frame
+        {
+            size_t InputOffset;
+            size_t InputSize;
+            size_t OutputOffset;
+            size_t OutputSize;
+        };
+
+        static bool _findFrames(const char* data, size_t size, std::vector<Frame>& frames)
+        {
+            //false when a frame does not record its decompressed size
+#ifdef ARBSIM_HAS_ZSTD
+            size_t total = 0;
+            for (size_t offset = 0; offset < size;)
+            {
+                size_t frameSize = ZSTD_findFrameCompressedSize(data + offset, size - offset);
+                if (ZSTD_isError(frameSize))
+                    throw Exception(std::string("Corrupted zstd input: ") + ZSTD_getErrorName(frameSize));
+                unsigned long long contentSize = ZSTD_getFrameContentSize(data + offset, size - offset);
+                if (contentSize == ZSTD_CONTENTSIZE_UNKNOWN || contentSize == ZSTD_CONTENTSIZE_ERROR)
+                    return false;
+                frames.push_back({offset, frameSize, total, size_t(contentSize)});
+                total += contentSize;
+                offset += frameSize;
+            }
+            return !frames.empty();
+#else
+            throw Exception("zstd input is not supported: built without ARBSIM_HAS_ZSTD");
+#endif
+        }
+
+        class Pipeline
+        {
+        /*
+        * Bounded queue of decompressed chunks between the producer and the consumer.
+        * Chunks are recycled, so the pipeline holds at most CHUNKS_IN_FLIGHT * CHUNK_SIZE bytes.
+        */
+        public:
+            Pipeline()
+            {
+                for (size_t i = 0; i < CHUNKS_IN_FLIGHT; ++i)
+                    _free.push(std::make_unique<Chunk>());
+            }
+
+            char* Acquire()
+            {
+                std::unique_lock lock(_mutex);
+                _changed.wait(lock, [this](){ return !_free.empty() || _cancelled; });
+                if (_cancelled)
+                    throw Exception("Decompression is cancelled");
+                _current = std::move(_free.front());
+                _free.pop();
+                return _current->Data;
+            }
+
+            void Publish(size_t size)
+            {
+                std::lock_guard lock(_mutex);
+                _current->Size = size;
+                _ready.push(std::move(_current));
+                _changed.notify_all();
+            }
+
+            void Finish(std::exception_ptr error)
+            {
+                std::lock_guard lock(_mutex);
+                _finished = true;
+                _error = error;
+                _changed.notify_all();
+            }
+
+            void Cancel()
+            {
+                std::lock_guard lock(_mutex);
+                _cancelled = true;
+                _changed.notify_all();
+            }
+
+            void Consume(const ChunkHandler& handler)
+            {
+                while (true)
+                {
+                    std::unique_ptr<Chunk> chunk;
+                    {
+                        std::unique_lock lock(_mutex);
+                        _changed.wait(lock, [this](){ return !_ready.empty() || _finished; });
+                        if (_ready.empty())
+                        {
+                            if (_error)
+                                std::rethrow_exception(_error);
+                            return;
+                        }
+                        chunk = std::move(_ready.front());
+                        _ready.pop();
+                    }
+                    handler(chunk->Data, chunk->Size);
+                    std::lock_guard lock(_mutex);
+                    _free.push(std::move(chunk));
+                    _changed.notify_all();
+                }
+            }
+
+        private:
+            struct Chunk
+            {
+                char Data[CHUNK_SIZE];
+                size_t Size = 0;
+            };
+
+            std::mutex _mutex;
+            std::condition_variable _changed;
+            std::queue<std::unique_ptr<Chunk>> _free;
+            std::queue<std::unique_ptr<Chunk>> _ready;
+            std::unique_ptr<Chunk> _current;
+            bool _finished{false};
+            bool _cancelled{false};
+            std::exception_ptr _error;
+        };
+
+        static void _inflate(const char* data, size_t size, Pipeline& pipeline)
+        {
+#ifdef ARBSIM_HAS_ZLIB
+            z_stream stream{};
+            if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+                throw Exception("Unable to initialise zlib");
+            std::unique_ptr<z_stream, int(*)(z_stream*)> guard(&stream, inflateEnd);
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            int result = Z_OK;
+            auto consumed = [&](){ return size_t(reinterpret_cast<const char*>(stream.next_in) - data); };
+            while (consumed() < size)
+            {
+                stream.next_out = reinterpret_cast<Bytef*>(pipeline.Acquire());
+                stream.avail_out = CHUNK_SIZE;
+                while (stream.avail_out > 0 && consumed() < size)
+                {
+                    //zlib counts in uInt, large mappings are fed piecewise
+                    if (stream.avail_in == 0)
+                        stream.avail_in = std::min<size_t>(size - consumed(), 1u << 30);
+                    result = inflate(&stream, Z_NO_FLUSH);
+                    //concatenated members (pigz, appended archives) continue after the end of a member
+                    if (result == Z_STREAM_END && consumed() < size)
+                        inflateReset(&stream);
+                    else if (result != Z_OK && result != Z_STREAM_END)
+                        throw Exception("Corrupted gzip input");
+                }
+                pipeline.Publish(CHUNK_SIZE - stream.avail_out);
+            }
+            //the last member may still hold output after all input is consumed
+            while (result == Z_OK)
+            {
+                stream.next_out = reinterpret_cast<Bytef*>(pipeline.Acquire());
+                stream.avail_out = CHUNK_SIZE;
+                result = inflate(&stream, Z_NO_FLUSH);
+                pipeline.Publish(CHUNK_SIZE - stream.avail_out);
+                if (result == Z_BUF_ERROR)
+                    throw Exception("Truncated gzip input");
+                if (result != Z_OK && result != Z_STREAM_END)
+                    throw Exception("Corrupted gzip input");
+            }
+#else
+            throw Exception("gzip input is not supported: built without ARBSIM_HAS_ZLIB");
+#endif
+        }
+
+        static void _decompressStream(const char* data, size_t size, Pipeline& pipeline)
+        {
+#ifdef ARBSIM_HAS_ZSTD
+            std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+            ZSTD_inBuffer input{data, size, 0};
+            size_t result = 0;
+            bool more = true;
+            while (more)
+            {
+                ZSTD_outBuffer output{pipeline.Acquire(), CHUNK_SIZE, 0};
+                result = ZSTD_decompressStream(context.get(), &output, &input);
+                if (ZSTD_isError(result))
+                    throw Exception(std::string("Corrupted zstd input: ") + ZSTD_getErrorName(result));
+                pipeline.Publish(output.pos);
+                //a full output buffer may leave decoded data inside the context
+                more = input.pos < input.size || output.pos == output.size;
+            }
+            if (result != 0)
+                throw Exception("Truncated zstd input");
+#else
+            throw Exception("zstd input is not supported: built without ARBSIM_HAS_ZSTD");
+#endif
+        }
+    };
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <limits>
+
+#include "tick_store.hpp"
+
+namespace ArbSimulation
+{
+    struct ConflationOptions
+    {
+        bool CoalesceTimestamps = true;                     //keep only the final state of an instrument within one timestamp
+        bool SuppressUnchangedPrices = false;               //skip updates which only change sizes while no order is outstanding
+        u_int64_t BucketNs = 0;                             //> 0 - approximate: keep only the final state of an instrument per time bucket
+    };
+
+    struct ConflationStats
+    {
+        size_t Input = 0;
+        size_t Dispatched = 0;
+        size_t Coalesced = 0;
+        size_t Unchanged = 0;
+    };
+
+    class ConflationSchedule
+    {
+    /*
+    * Records of a TickStore left after coalescing same-timestamp bursts, built once and shared by every run over the store.
+    * Coalescing is exact for the matcher: fills need a strictly later timestamp and execute at the last state before it.
+    * Strategies only observe settled states, intermediate ones which existed for zero nanoseconds are not replayed.
+    * Suppression of unchanged prices depends on the order flow, so it is applied during the replay, not here.
+    * With BucketNs the schedule decimates instead: only the last update of every instrument within each time bucket is kept,
+    * at its own timestamp. That is not exact (orders fill at the bucket's last state, intermediate signals are missed),
+    * it is meant for exploratory sweeps whose error is measured against exact replays (see SweepRunner::RunApproximate).
+    */
+    public:
+        ConflationSchedule(const TickStore& store, const ConflationOptions& options): _options(options), _storeSize(store.Size())
+        {
+            _stats.Input = store.Size();
+            if (_options.BucketNs > 0)
+                _options.CoalesceTimestamps = true;
+            if (!_options.CoalesceTimestamps)
+                return;
+            if (store.Size() > std::numeric_limits<u_int32_t>::max())
+                throw Exception("TickStore is too large to be conflated");
+            _indices.reserve(store.Size());
+
+            std::vector<size_t> seenInGroup(store.GetSecurityIds().size(), std::numeric_limits<size_t>::max());
+            std::vector<u_int32_t> group;
+            u_int64_t bucket = std::max<u_int64_t>(1, _options.BucketNs);
+            for (size_t begin = 0, end = 0; begin < store.Size(); begin = end)
+            {
+                end = begin + 1;
+                u_int64_t key = store[begin].Timestamp / bucket;
+                while (end < store.Size() && store[end].Timestamp / bucket == key)
+                    ++end;
+
+                //walking the group backwards keeps the last record of every instrument
+                group.clear();
+                for (size_t i = end; i-- > begin;)
+                {
+                    auto instrument = store[i].InstrumentId;
+                    if (seenInGroup[instrument] == begin)
+                    {
+                        ++_stats.Coalesced;
+                        continue;
+                    }
+                    seenInGroup[instrument] = begin;
+                    group.push_back(u_int32_t(i));
+                }
+                _indices.insert(_indices.end(), group.rbegin(), group.rend());
+            }
+        }
+
+        inline size_t Size() const
+        {
+            return _options.CoalesceTimestamps ? _indices.size() : _storeSize;
+        }
+
+        inline size_t operator[](size_t index) const
+        {
+            return _options.CoalesceTimestamps ? _indices[index] : index;
+        }
+
+        inline const ConflationStats& GetStats() const
+        {
+            //Input and Coalesced only, Dispatched and Unchanged are counted by the replay
+            return _stats;
+        }
+
+        inline const ConflationOptions& GetOptions() const
+        {
+            return _options;
+        }
+
+        inline bool IsApproximate() const
+        {
+            return _options.BucketNs > 0;
+        }
+
+    private:
+        ConflationOptions _options;
+        size_t _storeSize;
+        ConflationStats _stats;
+        std::vector<u_int32_t> _indices;
+    };
+    typedef std::shared_ptr<const ConflationSchedule> ConflationSchedulePtr;
+}
@@ -0,0 +1,507 @@
+#pragma once
+
+#include <array>
+#include <coroutine>
+#include <optional>
+#include <utility>
+
+#include "strategy_base.hpp"
+
+namespace ArbSimulation
+{
+    struct FramePoolStats
+    {
+        size_t Allocations = 0;                             //frames handed out
+        size_t Chunks = 0;                                  //heap allocations made to refill the free lists
+        size_t HeapFallbacks = 0;                           //frames larger than MAX_BLOCK, allocated on the heap
+        size_t InUse = 0;
+    };
+
+    class FramePool
+    {
+    /*
+    * Free lists of coroutine frames in power-of-two size classes from MIN_BLOCK to MAX_BLOCK.
+    * Blocks are carved from chunks kept until the pool is destroyed and a freed frame goes back to its list,
+    * so once a workflow has run, starting it again takes a block off the list without touching the heap.
+    * Not thread-safe: one pool per strategy, used from the thread that runs it.
+    */
+    public:
+        static constexpr size_t MIN_BLOCK = 64;
+        static constexpr size_t MAX_BLOCK = 4096;
+        static constexpr size_t BLOCKS_PER_CHUNK = 16;
+
+        FramePool() = default;
+        FramePool(const FramePool&) = delete;
+        FramePool& operator=(const FramePool&) = delete;
+
+        void* Allocate(size_t size)
+        {
+            ++_stats.Allocations;
+            ++_stats.InUse;
+            size_t sizeClass = _getClass(size);
+            if (sizeClass >= CLASSES)
+            {
+                ++_stats.HeapFallbacks;
+                return ::operator new(size);
+            }
+            if (_free[sizeClass] == nullptr)
+                _refill(sizeClass);
+            Block* block = _free[sizeClass];
+            _free[sizeClass] = block->Next;
+            return block;
+        }
+
+        void Deallocate(void* pointer, size_t size)
+        {
+            --_stats.InUse;
+            size_t sizeClass = _getClass(size);
+            if (sizeClass >= CLASSES)
+            {
+                ::operator delete(pointer);
+                return;
+            }
+            auto block = static_cast<Block*>(pointer);
+            block->Next = _free[sizeClass];
+            _free[sizeClass] = block;
+        }
+
+        inline const FramePoolStats& GetStats() const
+        {
+            return _stats;
+        }
+
+    private:
+        struct Block
+        {
+            Block* Next;
+        };
+        static constexpr size_t CLASSES = 7;                //64 .. 4096
+
+        static inline size_t _getClass(size_t size)
+        {
+            size_t sizeClass = 0;
+            for (size_t block = MIN_BLOCK; block < size && sizeClass < CLASSES; block <<= 1)
+                ++sizeClass;
+            return sizeClass;
+        }
+
+        void _refill(size_t sizeClass)
+        {
+            size_t blockSize = MIN_BLOCK << sizeClass;
+            _chunks.push_back(std::make_unique<std::byte[]>(blockSize * BLOCKS_PER_CHUNK));
+            ++_stats.Chunks;
+            std::byte* chunk = _chunks.back().get();
+            for (size_t i = BLOCKS_PER_CHUNK; i-- > 0;)
+            {
+                auto block = reinterpret_cast<Block*>(chunk + i * blockSize);
+                block->Next = _free[sizeClass];
+                _free[sizeClass] = block;
+            }
+        }
+
+    private:
+        std::array<Block*, CLASSES> _free{};
+        std::vector<std::unique_ptr<std::byte[]>> _chunks;
+        FramePoolStats _stats;
+    };
+
+    template<typename T = void>
+    class Task;
+
+    namespace Detail
+    {
+        struct TaskPromiseBase
+        {
+            //the pool is saved in front of the frame, so frames can be freed without knowing their strategy
+            static constexpr size_t HEADER = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+            template<typename Owner, typename... Args>
+            static void* operator new(size_t size, Owner& owner, Args&...)
+            {
+                //Task coroutines are members of a CoroutineStrategy or take it as their first parameter
+                FramePool& pool = owner.GetFramePool();
+                auto raw = static_cast<std::byte*>(pool.Allocate(size + HEADER));
+                *reinterpret_cast<FramePool**>(raw) = &pool;
+                return raw + HEADER;
+            }
+
+            static void* operator new(size_t size) = delete;
+
+            static void operator delete(void* pointer, size_t size)
+            {
+                auto raw = static_cast<std::byte*>(pointer) - HEADER;
+                (*reinterpret_cast<FramePool**>(raw))->Deallocate(raw, size + HEADER);
+            }
+
+            struct FinalAwaiter
+            {
+                inline bool await_ready() noexcept
+                {
+                    return false;
+                }
+
+                template<typename Promise>
+                inline std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+                {
+                    //the awaiting coroutine resumes right away, without going back through the strategy
+                    auto continuation = handle.promise().Continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+
+                inline void await_resume() noexcept
+                {}
+            };
+
+            inline std::suspend_always initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            inline FinalAwaiter final_suspend() noexcept
+            {
+                return {};
+            }
+
+            inline void unhandled_exception()
+            {
+                Error = std::current_exception();
+            }
+
+            std::coroutine_handle<> Continuation;
+            std::exception_ptr Error;
+        };
+
+        template<typename T>
+        struct TaskPromise: public TaskPromiseBase
+        {
+            Task<T> get_return_object() noexcept;
+
+            template<typename Value>
+            inline void return_value(Value&& value)
+            {
+                Result.emplace(std::forward<Value>(value));
+            }
+
+            inline T TakeResult()
+            {
+                return std::move(*Result);
+            }
+
+            std::optional<T> Result;
+        };
+
+        template<>
+        struct TaskPromise<void>: public TaskPromiseBase
+        {
+            Task<void> get_return_object() noexcept;
+
+            inline void return_void() noexcept
+            {}
+
+            inline void TakeResult()
+            {}
+        };
+    }
+
+    template<typename T>
+    class Task
+    {
+    /*
+    * Lazily started coroutine: it runs when awaited (or spawned by a CoroutineStrategy)
+    * and resumes its caller when it returns. Exceptions are rethrown to the caller.
+    */
+    public:
+        using promise_type = Detail::TaskPromise<T>;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        explicit Task(Handle handle): _handle(handle)
+        {}
+
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        Task(Task&& other) noexcept: _handle(std::exchange(other._handle, {}))
+        {}
+
+        Task& operator=(Task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                _destroy();
+                _handle = std::exchange(other._handle, {});
+            }
+            return *this;
+        }
+
+        ~Task()
+        {
+            _destroy();
+        }
+
+        inline bool await_ready() const noexcept
+        {
+            return IsDone();
+        }
+
+        inline std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+        {
+            _handle.promise().Continuation = caller;
+            return _handle;
+        }
+
+        inline T await_resume()
+        {
+            if (_handle.promise().Error)
+                std::rethrow_exception(_handle.promise().Error);
+            return _handle.promise().TakeResult();
+        }
+
+        inline bool IsDone() const
+        {
+            return !_handle || _handle.done();
+        }
+
+        inline std::exception_ptr GetError() const
+        {
+            return _handle ? _handle.promise().Error : nullptr;
+        }
+
+        inline Handle GetHandle() const
+        {
+            return _handle;
+        }
+
+    private:
+        inline void _destroy()
+        {
+            if (_handle)
+                _handle.destroy();
+            _handle = {};
+        }
+
+    private:
+        Handle _handle;
+    };
+
+    namespace Detail
+    {
+        template<typename T>
+        inline Task<T> TaskPromise<T>::get_return_object() noexcept
+        {
+            return Task<T>(Task<T>::Handle::from_promise(*this));
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() noexcept
+        {
+            return Task<void>(Task<void>::Handle::from_promise(*this));
+        }
+    }
+
+    class CoroutineStrategy: public BasicStrategy
+    {
+    /*
+    * Base for strategies written as coroutines instead of callbacks. Run() starts on the first update
+    * (GetLastUpdate() returns it) and can co_await:
+    *   NextTick()                  - the next update, returned as L1UpdatePtr
+    *   Sleep(ns)                   - the first update at or after now + ns
+    *   WaitFill(order[, timeoutNs]) - the fill of the order, nullptr if no fill came before the timeout
+    *   another Task<T>             - e.g. a legging or retry step written as its own coroutine
+    * Spawn() starts more workflows that run side by side; waiters resume in the order they started waiting.
+    * Time is replay time, the last update or fill seen: timeouts expire on the first update at or after their deadline.
+    *
+    * Frames come from the strategy's FramePool, so Task coroutines must be members of the strategy
+    * or take it as their first parameter. Suspending and resuming does not allocate:
+    * a resume is an indirect call, waiter lists keep their capacity.
+    * An exception escaping a workflow is rethrown from the callback that resumed it.
+    */
+    public:
+        CoroutineStrategy(std::shared_ptr<InstrumentManager> instrManager): BasicStrategy(instrManager)
+        {
+            _tickWaiters.reserve(WAITERS);
+            _tickScratch.reserve(WAITERS);
+            _fillWaiters.reserve(WAITERS);
+            _workflows.reserve(WAITERS);
+        }
+
+        virtual Task<> Run() = 0;
+
+        void Spawn(Task<> workflow)
+        {
+            auto handle = workflow.GetHandle();
+            _workflows.push_back(std::move(workflow));
+            handle.resume();
+            _collect();
+        }
+
+        struct TickAwaiter
+        {
+            CoroutineStrategy& Strategy;
+            u_int64_t Deadline;
+
+            inline bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            inline void await_suspend(std::coroutine_handle<> handle)
+            {
+                Strategy._tickWaiters.push_back({handle, Deadline});
+            }
+
+            inline L1UpdatePtr await_resume() const
+            {
+                return Strategy._lastUpdate;
+            }
+        };
+
+        struct FillAwaiter
+        {
+            CoroutineStrategy& Strategy;
+            OrderPtr Order;
+            u_int64_t Deadline;
+            bool TimedOut = false;
+
+            inline bool await_ready() const noexcept
+            {
+                //the matcher sets the execution time when it fills, a fill may arrive before the wait starts
+                return !Order || Order->ExecutedTimestamp != 0;
+            }
+
+            inline void await_suspend(std::coroutine_handle<> handle)
+            {
+                Strategy._fillWaiters.push_back({handle, Order.get(), Deadline, &TimedOut});
+            }
+
+            inline OrderPtr await_resume() const
+            {
+                return TimedOut ? nullptr : Order;
+            }
+        };
+
+        inline TickAwaiter NextTick()
+        {
+            return {*this, 0};
+        }
+
+        inline TickAwaiter Sleep(u_int64_t ns)
+        {
+            return {*this, _lastTimestamp + ns};
+        }
+
+        inline FillAwaiter WaitFill(OrderPtr order, u_int64_t timeoutNs = 0)
+        {
+            return {*this, std::move(order), timeoutNs > 0 ? _lastTimestamp + timeoutNs : std::numeric_limits<u_int64_t>::max()};
+        }
+
+        inline const L1UpdatePtr& GetLastUpdate() const
+        {
+            return _lastUpdate;
+        }
+
+        inline FramePool& GetFramePool()
+        {
+            return _framePool;
+        }
+
+        inline size_t GetWorkflows() const
+        {
+            return _workflows.size();
+        }
+
+        void OnL1Update(L1UpdatePtr update) final
+        {
+            _lastUpdate = std::move(update);
+            _lastTimestamp = _lastUpdate->Timestamp;
+            if (!_started)
+            {
+                _started = true;
+                Spawn(Run());
+                return;
+            }
+
+            for (size_t i = 0; i < _fillWaiters.size();)
+            {
+                if (_fillWaiters[i].Deadline > _lastTimestamp)
+                {
+                    ++i;
+                    continue;
+                }
+                auto waiter = _fillWaiters[i];
+                _fillWaiters.erase(_fillWaiters.begin() + i);
+                *waiter.TimedOut = true;
+                waiter.Handle.resume();
+            }
+
+            //waiters added while resuming wait for the next update
+            _tickScratch.swap(_tickWaiters);
+            for (auto& waiter: _tickScratch)
+            {
+                if (waiter.Deadline <= _lastTimestamp)
+                    waiter.Handle.resume();
+                else
+                    _tickWaiters.push_back(waiter);
+            }
+            _tickScratch.clear();
+            _collect();
+        }
+
+        void OnOrderFilled(OrderPtr order) final
+        {
+            //a fill is delivered before the update that reveals it, replay time moves to the execution
+            _lastTimestamp = std::max(_lastTimestamp, order->ExecutedTimestamp);
+            for (size_t i = 0; i < _fillWaiters.size(); ++i)
+                if (_fillWaiters[i].Order == order.get())
+                {
+                    auto handle = _fillWaiters[i].Handle;
+                    _fillWaiters.erase(_fillWaiters.begin() + i);
+                    handle.resume();
+                    _collect();
+                    return;
+                }
+        }
+
+    private:
+        struct TickWaiter
+        {
+            std::coroutine_handle<> Handle;
+            u_int64_t Deadline;
+        };
+
+        struct FillWaiter
+        {
+            std::coroutine_handle<> Handle;
+            const ArbSimulation::Order* Order;
+            u_int64_t Deadline;
+            bool* TimedOut;
+        };
+
+        static constexpr size_t WAITERS = 16;
+
+        void _collect()
+        {
+            //finished workflows return their frames to the pool, the first error is rethrown
+            for (size_t i = 0; i < _workflows.size();)
+            {
+                if (!_workflows[i].IsDone())
+                {
+                    ++i;
+                    continue;
+                }
+                auto error = _workflows[i].GetError();
+                _workflows.erase(_workflows.begin() + i);
+                if (error)
+                    std::rethrow_exception(error);
+            }
+        }
+
+    private:
+        FramePool _framePool;                               //declared first: frames are destroyed before the pool
+        std::vector<Task<>> _workflows;
+        std::vector<TickWaiter> _tickWaiters;
+        std::vector<TickWaiter> _tickScratch;
+        std::vector<FillWaiter> _fillWaiters;
+        L1UpdatePtr _lastUpdate;
+        u_int64_t _lastTimestamp = 0;
+        bool _started = false;
+    };
+}
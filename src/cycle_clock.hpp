@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <sys/types.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ARBSIM_HAS_RDTSC 1
+#endif
+
+namespace ArbSimulation
+{
+    class CycleClock
+    {
+    /*
+    * Cheap high-resolution timestamps for measuring short code paths.
+    * On x86 it reads the time stamp counter (invariant on every CPU this is expected to run on), elsewhere steady_clock.
+    * Cycles are converted to nanoseconds with a ratio calibrated once per process against steady_clock.
+    */
+    public:
+        static inline u_int64_t Now()
+        {
+#ifdef ARBSIM_HAS_RDTSC
+            //lfence keeps the read from being hoisted above the code being measured
+            _mm_lfence();
+            return __rdtsc();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+
+        static double GetNsPerCycle()
+        {
+            static const double nsPerCycle = _calibrate();
+            return nsPerCycle;
+        }
+
+        static inline double ToNs(u_int64_t cycles)
+        {
+            return cycles * GetNsPerCycle();
+        }
+
+    private:
+        static double _calibrate()
+        {
+#ifdef ARBSIM_HAS_RDTSC
+            auto start = std::chrono::steady_clock::now();
+            u_int64_t startCycles = Now();
+            auto elapsed = std::chrono::nanoseconds(0);
+            while (elapsed < std::chrono::milliseconds(20))
+                elapsed = std::chrono::steady_clock::now() - start;
+            u_int64_t cycles = Now() - startCycles;
+            return cycles > 0 ? double(elapsed.count()) / cycles : 1.0;
+#else
+            return 1.0;
+#endif
+        }
+    };
+
+    class ThreadCpuClock
+    {
+    /*
+    * CPU time consumed by the calling thread in nanoseconds: time the thread is preempted or waiting is not counted,
+    * so measurements do not grow with the load of the machine. A read is a system call, far slower than CycleClock.
+    */
+    public:
+        static inline u_int64_t Now()
+        {
+            timespec time;
+            ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+            return u_int64_t(time.tv_sec) * 1000000000ull + time.tv_nsec;
+        }
+    };
+}
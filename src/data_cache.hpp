@@ -0,0 +1,645 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+#include "hashing.hpp"
+#include "tick_store.hpp"
+
+namespace ArbSimulation
+{
+    struct SourceInfo
+    {
+        std::string Path;
+        u_int64_t Size = 0;
+        int64_t MTime = 0;
+        u_int64_t ContentHash = 0;
+
+        static SourceInfo Stat(const std::string& path)
+        {
+            SourceInfo info;
+            info.Path = std::filesystem::absolute(path).lexically_normal().string();
+            std::error_code error;
+            info.Size = std::filesystem::file_size(path, error);
+            if (error)
+                throw CacheError("Unable to stat " + path);
+            info.MTime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+            return info;
+        }
+    };
+
+    class TickImage
+    {
+    /*
+    * Binary image of a sorted TickStore:
+    *   header | meta (sources, security ids, cleaning policy and report) | padding to 64 bytes | TickRecord[] | footer
+    * An image can be read straight from any read-only mapping without parsing.
+    * The cleaning report of the load which built it comes back with the mapped store; version 1 images have none.
+    */
+    public:
+        static constexpr char MAGIC[8] = {'A', 'R', 'B', 'T', 'I', 'C', 'K', 'S'};
+        static constexpr char FOOTER_MAGIC[8] = {'A', 'R', 'B', 'T', 'E', 'N', 'D', '\0'};
+        static constexpr u_int32_t VERSION = 2;
+
+        struct Header
+        {
+            char Magic[8];
+            u_int32_t Version;
+            u_int32_t SourceCount;
+            u_int64_t RecordCount;
+            u_int64_t MetaSize;
+            u_int64_t PayloadOffset;
+            u_int64_t PayloadChecksum;
+            u_int64_t MetaChecksum;
+            u_int64_t HeaderChecksum;
+        };
+
+        struct Footer
+        {
+            char Magic[8];
+            u_int64_t RecordCount;
+        };
+
+        struct Contents
+        {
+            std::vector<SourceInfo> Sources;
+            TickStorePtr Store;
+        };
+
+        static void Write(const std::string& path, const TickStore& store, const std::vector<SourceInfo>& sources)
+        {
+            Writer writer(path, store.GetSecurityIds(), sources, store.GetCleaningPolicy(), store.GetCleaningReport());
+            writer.Append(store.Data(), store.Size());
+            writer.Close();
+        }
+
+        class Writer
+        {
+        /*
+        * Streams records into an image, so images larger than memory can be produced.
+        * Records must be appended in timestamp order.
+        */
+        public:
+            Writer(const std::string& path, const std::vector<std::string>& securityIds, const std::vector<SourceInfo>& sources,
+                const CleaningPolicy& cleaning = CleaningPolicy(), const CleaningReport& report = CleaningReport()):
+                _path(path), _file(path, std::ios::binary | std::ios::trunc)
+            {
+                if (!_file)
+                    throw CacheError("Unable to create " + path);
+                std::string meta = _makeMeta(securityIds, sources, cleaning, report);
+                _header = _makeHeader(meta, sources.size());
+
+                std::string padding(_header.PayloadOffset - sizeof(Header) - meta.size(), '\0');
+                _file.write(reinterpret_cast<const char*>(&_header), sizeof(Header));
+                _file.write(meta.data(), meta.size());
+                _file.write(padding.data(), padding.size());
+            }
+
+            inline void Append(const TickRecord* records, size_t count)
+            {
+                _payloadHasher.Update(records, count * sizeof(TickRecord));
+                _file.write(reinterpret_cast<const char*>(records), count * sizeof(TickRecord));
+                _header.RecordCount += count;
+            }
+
+            void Close()
+            {
+                Footer footer = _makeFooter(_header.RecordCount);
+                _file.write(reinterpret_cast<const char*>(&footer), sizeof(Footer));
+
+                _header.PayloadChecksum = _payloadHasher.Digest();
+                _header.HeaderChecksum = Hasher::HashBytes(&_header, offsetof(Header, HeaderChecksum));
+                _file.seekp(0);
+                _file.write(reinterpret_cast<const char*>(&_header), sizeof(Header));
+                _file.close();
+                if (!_file)
+                    throw CacheError("Unable to write " + _path);
+            }
+
+        private:
+            std::string _path;
+            std::ofstream _file;
+            Header _header{};
+            Hasher _payloadHasher;
+        };
+
+        static size_t GetSize(const TickStore& store, const std::vector<SourceInfo>& sources)
+        {
+            return _makeHeader(_makeMeta(store.GetSecurityIds(), sources, store.GetCleaningPolicy(), store.GetCleaningReport()), sources.size()).PayloadOffset
+                + store.Size() * sizeof(TickRecord) + sizeof(Footer);
+        }
+
+        static void WriteTo(char* destination, const TickStore& store, const std::vector<SourceInfo>& sources)
+        {
+            //destination must hold GetSize() bytes, the header is written last
+            std::string meta = _makeMeta(store.GetSecurityIds(), sources, store.GetCleaningPolicy(), store.GetCleaningReport());
+            Header header = _makeHeader(meta, sources.size());
+            header.RecordCount = store.Size();
+            size_t payloadSize = store.Size() * sizeof(TickRecord);
+            std::memcpy(destination + sizeof(Header), meta.data(), meta.size());
+            std::memset(destination + sizeof(Header) + meta.size(), 0, header.PayloadOffset - sizeof(Header) - meta.size());
+            if (payloadSize > 0)
+                std::memcpy(destination + header.PayloadOffset, store.Data(), payloadSize);
+            Footer footer = _makeFooter(header.RecordCount);
+            std::memcpy(destination + header.PayloadOffset + payloadSize, &footer, sizeof(Footer));
+
+            header.PayloadChecksum = Hasher::HashBytes(destination + header.PayloadOffset, payloadSize);
+            header.HeaderChecksum = Hasher::HashBytes(&header, offsetof(Header, HeaderChecksum));
+            std::memcpy(destination, &header, sizeof(Header));
+        }
+
+        static bool IsImage(const std::string& path)
+        {
+            char magic[8] = {0};
+            std::ifstream file{path, std::ios::binary};
+            file.read(magic, 8);
+            return file.gcount() == 8 && std::memcmp(magic, MAGIC, 8) == 0;
+        }
+
+        static Contents Read(const void* data, size_t size, std::shared_ptr<const void> mapping, bool verifyPayload)
+        {
+            auto bytes = static_cast<const char*>(data);
+            if (size < sizeof(Header) + sizeof(Footer))
+                throw CacheError("Image is truncated");
+
+            Header header;
+            std::memcpy(&header, bytes, sizeof(Header));
+            if (std::memcmp(header.Magic, MAGIC, 8) != 0)
+                throw CacheError("Bad image magic");
+            if (header.Version == 0 || header.Version > VERSION)
+                throw CacheError("Unsupported image version");
+            if (header.HeaderChecksum != Hasher::HashBytes(&header, offsetof(Header, HeaderChecksum)))
+                throw CacheError("Image header checksum mismatch");
+            if (header.PayloadOffset < sizeof(Header) + header.MetaSize ||
+                header.PayloadOffset + header.RecordCount * sizeof(TickRecord) + sizeof(Footer) != size)
+                throw CacheError("Image size mismatch");
+
+            Footer footer;
+            std::memcpy(&footer, bytes + size - sizeof(Footer), sizeof(Footer));
+            if (std::memcmp(footer.Magic, FOOTER_MAGIC, 8) != 0 || footer.RecordCount != header.RecordCount)
+                throw CacheError("Bad image footer");
+
+            const char* meta = bytes + sizeof(Header);
+            if (header.MetaChecksum != Hasher::HashBytes(meta, header.MetaSize))
+                throw CacheError("Image meta checksum mismatch");
+
+            auto records = reinterpret_cast<const TickRecord*>(bytes + header.PayloadOffset);
+            if (verifyPayload && header.PayloadChecksum != Hasher::HashBytes(records, header.RecordCount * sizeof(TickRecord)))
+                throw CacheError("Image payload checksum mismatch");
+
+            Contents result;
+            size_t offset = 0;
+            u_int64_t sourceCount = _getU64(meta, header.MetaSize, offset);
+            for (u_int64_t i = 0; i < sourceCount; ++i)
+            {
+                SourceInfo source;
+                source.Path = _getString(meta, header.MetaSize, offset);
+                source.Size = _getU64(meta, header.MetaSize, offset);
+                source.MTime = int64_t(_getU64(meta, header.MetaSize, offset));
+                source.ContentHash = _getU64(meta, header.MetaSize, offset);
+                result.Sources.push_back(source);
+            }
+            std::vector<std::string> securityIds;
+            u_int64_t instrumentCount = _getU64(meta, header.MetaSize, offset);
+            for (u_int64_t i = 0; i < instrumentCount; ++i)
+                securityIds.push_back(_getString(meta, header.MetaSize, offset));
+
+            auto store = std::make_shared<TickStore>(std::move(securityIds), records, header.RecordCount, std::move(mapping));
+            if (header.Version >= 2)
+            {
+                CleaningPolicy cleaning;
+                CleaningReport report;
+                for (auto& action: cleaning.Actions)
+                    action = CleaningAction(_getU64(meta, header.MetaSize, offset));
+                report.Lines = _getU64(meta, header.MetaSize, offset);
+                report.Kept = _getU64(meta, header.MetaSize, offset);
+                for (auto& counters: report.Rules)
+                    for (u_int64_t* counter: {&counters.Matched, &counters.Flagged, &counters.Repaired, &counters.Dropped})
+                        *counter = _getU64(meta, header.MetaSize, offset);
+                store->SetCleaning(cleaning);
+                store->MergeCleaningReport(report);
+            }
+            result.Store = store;
+            return result;
+        }
+
+        static Contents Map(const std::string& path, bool verifyPayload)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw CacheError("Unable to open " + path);
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || st.st_size == 0)
+            {
+                ::close(fd);
+                throw CacheError("Unable to stat " + path);
+            }
+            size_t size = st.st_size;
+            void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (address == MAP_FAILED)
+                throw CacheError("Unable to map " + path);
+            std::shared_ptr<const void> mapping(address, [size](const void* p){ ::munmap(const_cast<void*>(p), size); });
+            return Read(address, size, mapping, verifyPayload);
+        }
+
+    private:
+        static inline size_t _alignUp(size_t value, size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        static std::string _makeMeta(const std::vector<std::string>& securityIds, const std::vector<SourceInfo>& sources,
+            const CleaningPolicy& cleaning, const CleaningReport& report)
+        {
+            std::string meta;
+            _putU64(meta, sources.size());
+            for (auto& source: sources)
+            {
+                _putString(meta, source.Path);
+                _putU64(meta, source.Size);
+                _putU64(meta, u_int64_t(source.MTime));
+                _putU64(meta, source.ContentHash);
+            }
+            _putU64(meta, securityIds.size());
+            for (auto& securityId: securityIds)
+                _putString(meta, securityId);
+            for (auto action: cleaning.Actions)
+                _putU64(meta, u_int64_t(action));
+            _putU64(meta, report.Lines);
+            _putU64(meta, report.Kept);
+            for (auto& counters: report.Rules)
+                for (u_int64_t counter: {counters.Matched, counters.Flagged, counters.Repaired, counters.Dropped})
+                    _putU64(meta, counter);
+            return meta;
+        }
+
+        static Header _makeHeader(const std::string& meta, size_t sourceCount)
+        {
+            Header header{};
+            std::memcpy(header.Magic, MAGIC, 8);
+            header.Version = VERSION;
+            header.SourceCount = sourceCount;
+            header.MetaSize = meta.size();
+            header.PayloadOffset = _alignUp(sizeof(Header) + meta.size(), 64);
+            header.MetaChecksum = Hasher::HashBytes(meta.data(), meta.size());
+            return header;
+        }
+
+        static Footer _makeFooter(u_int64_t recordCount)
+        {
+            Footer footer{};
+            std::memcpy(footer.Magic, FOOTER_MAGIC, 8);
+            footer.RecordCount = recordCount;
+            return footer;
+        }
+
+        static void _putU64(std::string& out, u_int64_t value)
+        {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        static void _putString(std::string& out, const std::string& value)
+        {
+            _putU64(out, value.size());
+            out.append(value);
+        }
+
+        static u_int64_t _getU64(const char* meta, size_t size, size_t& offset)
+        {
+            if (offset + sizeof(u_int64_t) > size)
+                throw CacheError("Image meta is truncated");
+            u_int64_t value;
+            std::memcpy(&value, meta + offset, sizeof(value));
+            offset += sizeof(value);
+            return value;
+        }
+
+        static std::string _getString(const char* meta, size_t size, size_t& offset)
+        {
+            u_int64_t length = _getU64(meta, size, offset);
+            if (offset + length > size)
+                throw CacheError("Image meta is truncated");
+            std::string value(meta + offset, length);
+            offset += length;
+            return value;
+        }
+    };
+
+    class SharedTickStore
+    {
+    /*
+    * Publishes a TickImage into shared memory, so any number of processes on the box map one physical copy of a dataset.
+    * A name starting with '/' and containing no other '/' is a POSIX shared memory object (shm_open),
+    * any other name is a file path, e.g. on a hugetlbfs mount.
+    * Layout: segment header | padding to 4096 bytes | TickImage
+    * The segment header is written and marked ready after the image, so a reader never maps a half-written dataset.
+    * Republishing a name unlinks the old segment: processes attached to it keep their mapping, the memory is freed after the last one detaches.
+    */
+    public:
+        static constexpr char MAGIC[8] = {'A', 'R', 'B', 'S', 'H', 'M', '\0', '\0'};
+        static constexpr u_int32_t VERSION = 1;
+        static constexpr u_int32_t READY = 1;
+        static constexpr size_t IMAGE_OFFSET = 4096;
+        static constexpr const char* PREFIX = "shm:";
+
+        struct SegmentHeader
+        {
+            char Magic[8];
+            u_int32_t Version;
+            u_int32_t State;                    //READY once the image is complete
+            u_int64_t ImageOffset;
+            u_int64_t ImageSize;
+            u_int64_t PublishedAt;              //ns since epoch
+            u_int64_t PublisherPid;
+        };
+
+        static size_t Publish(const std::string& name, const TickStore& store, const std::vector<SourceInfo>& sources)
+        {
+            //returns the size of the segment in bytes
+            Remove(name);
+            int fd = _open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+            if (fd < 0)
+                throw CacheError("Unable to create shared segment " + name);
+
+            size_t imageSize = TickImage::GetSize(store, sources);
+            size_t size = _roundToPage(IMAGE_OFFSET + imageSize, fd);
+            //tmpfs reserves no pages on ftruncate: without fallocate a full /dev/shm raises SIGBUS on the write below
+            void* address = MAP_FAILED;
+            if (::ftruncate(fd, size) == 0 && ::posix_fallocate(fd, 0, size) == 0)
+                address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (address == MAP_FAILED)
+            {
+                Remove(name);
+                throw CacheError("Unable to allocate " + std::to_string(size) + " bytes for shared segment " + name);
+            }
+
+            auto bytes = static_cast<char*>(address);
+            TickImage::WriteTo(bytes + IMAGE_OFFSET, store, sources);
+
+            SegmentHeader header{};
+            std::memcpy(header.Magic, MAGIC, 8);
+            header.Version = VERSION;
+            header.ImageOffset = IMAGE_OFFSET;
+            header.ImageSize = imageSize;
+            header.PublishedAt = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            header.PublisherPid = ::getpid();
+            std::memcpy(bytes, &header, sizeof(SegmentHeader));
+            std::atomic_ref<u_int32_t>(reinterpret_cast<SegmentHeader*>(bytes)->State).store(READY, std::memory_order_release);
+            ::munmap(address, size);
+            return size;
+        }
+
+        static TickStorePtr Attach(const std::string& name, bool verifyPayload = false)
+        {
+            int fd = _open(name, O_RDONLY, 0);
+            if (fd < 0)
+                throw CacheError("Shared segment " + name + " does not exist");
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || size_t(st.st_size) < IMAGE_OFFSET)
+            {
+                ::close(fd);
+                throw CacheError("Shared segment " + name + " is not published yet");
+            }
+            size_t size = st.st_size;
+            void* address = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (address == MAP_FAILED)
+                throw CacheError("Unable to map shared segment " + name);
+            std::shared_ptr<const void> mapping(address, [size](const void* p){ ::munmap(const_cast<void*>(p), size); });
+
+            auto header = static_cast<SegmentHeader*>(address);
+            if (std::atomic_ref<u_int32_t>(header->State).load(std::memory_order_acquire) != READY)
+                throw CacheError("Shared segment " + name + " is not published yet");
+            if (std::memcmp(header->Magic, MAGIC, 8) != 0 || header->Version != VERSION)
+                throw CacheError("Shared segment " + name + " has an unsupported layout");
+            if (header->ImageOffset + header->ImageSize > size)
+                throw CacheError("Shared segment " + name + " is truncated");
+            return TickImage::Read(static_cast<const char*>(address) + header->ImageOffset, header->ImageSize, mapping, verifyPayload).Store;
+        }
+
+        static void Remove(const std::string& name)
+        {
+            if (_isPosixName(name))
+                ::shm_unlink(name.c_str());
+            else
+                ::unlink(name.c_str());
+        }
+
+        static inline bool IsSharedPath(const std::string& path)
+        {
+            return path.rfind(PREFIX, 0) == 0;
+        }
+
+        static inline std::string GetName(const std::string& path)
+        {
+            return path.substr(std::strlen(PREFIX));
+        }
+
+    private:
+        static inline bool _isPosixName(const std::string& name)
+        {
+            return name.size() > 1 && name[0] == '/' && name.find('/', 1) == std::string::npos;
+        }
+
+        static int _open(const std::string& name, int flags, mode_t mode)
+        {
+            return _isPosixName(name) ? ::shm_open(name.c_str(), flags, mode) : ::open(name.c_str(), flags, mode);
+        }
+
+        static size_t _roundToPage(size_t size, int fd)
+        {
+            //hugetlbfs only accepts multiples of its page size, which it reports as the block size
+            struct statfs fs;
+            size_t page = ::fstatfs(fd, &fs) == 0 && fs.f_bsize > 0 ? fs.f_bsize : 4096;
+            return (size + page - 1) / page * page;
+        }
+    };
+
+    inline TickStorePtr LoadTickStore(const std::vector<std::string>& paths, const CleaningPolicy& cleaning = CleaningPolicy())
+    {
+        /*
+        * DataFiles may be CSV files, tick images (see TickImage) or published shared segments ("shm:<name>", see SharedTickStore).
+        * A single image or segment is mapped as is, anything else is merged and sorted in memory.
+        * CSV files are cleaned while they are parsed, images and segments hold data which was cleaned when they were built, with its report.
+        */
+        if (paths.size() == 1 && SharedTickStore::IsSharedPath(paths[0]))
+            return SharedTickStore::Attach(SharedTickStore::GetName(paths[0]));
+        if (paths.size() == 1 && TickImage::IsImage(paths[0]))
+            return TickImage::Map(paths[0], false).Store;
+
+        auto store = std::make_shared<TickStore>();
+        store->SetCleaning(cleaning);
+        for (auto& path: paths)
+        {
+            bool shared = SharedTickStore::IsSharedPath(path);
+            if (!shared && !TickImage::IsImage(path))
+            {
+                store->LoadFile(path);
+                continue;
+            }
+            auto image = shared ? SharedTickStore::Attach(SharedTickStore::GetName(path)) : TickImage::Map(path, false).Store;
+            store->MergeCleaningReport(image->GetCleaningReport());
+            std::vector<u_int32_t> ids;
+            for (auto& securityId: image->GetSecurityIds())
+                ids.push_back(store->GetOrAddInstrument(securityId));
+            for (size_t i = 0; i < image->Size(); ++i)
+            {
+                TickRecord record = (*image)[i];
+                record.InstrumentId = ids[record.InstrumentId];
+                store->Append(record);
+            }
+        }
+        store->Sort();
+        return store;
+    }
+
+    class DataCache
+    {
+    /*
+    * Persistent cache of parsed and sorted DataFiles.
+    * An entry is located by the list of source paths (and the cleaning policy, when it is not the default one) and is valid
+    * while every source has the same size and either the same mtime or the same content hash.
+    * An entry matched through the content hash is rewritten with the new mtimes, so only the first load after a touch hashes.
+    * Sources are hashed before they are parsed and a load during which any of them changes is returned without being cached.
+    * Entries keep cleaned data and the cleaning report of the load which built them (see TickImage).
+    * The payload checksum of an entry is verified when it is mapped (one pass over the records), unless turned off.
+    */
+    public:
+        DataCache(const std::string& directory, bool verifyPayload = true, const CleaningPolicy& cleaning = CleaningPolicy()):
+            _directory(directory), _verifyPayload(verifyPayload), _cleaning(cleaning)
+        {
+            std::filesystem::create_directories(_directory);
+        }
+
+        TickStorePtr LoadOrBuild(const std::vector<std::string>& paths)
+        {
+            std::vector<SourceInfo> sources;
+            for (auto& path: paths)
+                sources.push_back(SourceInfo::Stat(path));
+
+            std::string entryPath = GetEntryPath(sources);
+            if (std::filesystem::exists(entryPath))
+            {
+                try
+                {
+                    auto contents = TickImage::Map(entryPath, _verifyPayload);
+                    bool touched = false;
+                    if (_isUpToDate(contents.Sources, sources, touched))
+                    {
+                        _lastStatus = "hit";
+                        if (touched)
+                            _refreshEntry(entryPath, *contents.Store, sources);
+                        return contents.Store;
+                    }
+                    _lastStatus = "stale";
+                }
+                catch(CacheError& ex)
+                {
+                    _lastStatus = std::string("corrupt (") + ex.what() + ")";
+                }
+            }
+            else
+                _lastStatus = "miss";
+
+            //hashed before parsing and checked again after it: a source written meanwhile is loaded but not cached
+            for (auto& source: sources)
+                source.ContentHash = Hasher::HashFile(source.Path);
+            auto store = LoadTickStore(paths, _cleaning);
+            for (auto& source: sources)
+            {
+                auto current = SourceInfo::Stat(source.Path);
+                if (current.Size != source.Size || current.MTime != source.MTime)
+                {
+                    _lastStatus += ", not cached (" + source.Path + " changed while loading)";
+                    return store;
+                }
+            }
+
+            _writeEntry(entryPath, *store, sources);
+            return store;
+        }
+
+        std::string GetEntryPath(const std::vector<SourceInfo>& sources) const
+        {
+            Hasher hasher;
+            hasher.Add(TickImage::VERSION);
+            for (auto& source: sources)
+                hasher.Add(source.Path);
+            if (!_cleaning.IsDefault())
+                hasher.Add(_cleaning.ToString());
+            return (std::filesystem::path(_directory) / ("ticks_" + Hasher::ToHex(hasher.Digest()) + ".bin")).string();
+        }
+
+        inline const std::string& GetLastStatus() const
+        {
+            return _lastStatus;
+        }
+
+    private:
+        static bool _isUpToDate(const std::vector<SourceInfo>& cached, std::vector<SourceInfo>& actual, bool& touched)
+        {
+            //on success actual gets the cached content hashes, touched tells whether any mtime differs
+            if (cached.size() != actual.size())
+                return false;
+            for (size_t i = 0; i < cached.size(); ++i)
+            {
+                if (cached[i].Path != actual[i].Path || cached[i].Size != actual[i].Size)
+                    return false;
+                //touched but possibly unchanged file: fall back to the content hash
+                if (cached[i].MTime != actual[i].MTime)
+                {
+                    if (cached[i].ContentHash != Hasher::HashFile(actual[i].Path))
+                        return false;
+                    touched = true;
+                }
+                actual[i].ContentHash = cached[i].ContentHash;
+            }
+            return true;
+        }
+
+        static void _writeEntry(const std::string& entryPath, const TickStore& store, const std::vector<SourceInfo>& sources)
+        {
+            std::string tempPath = entryPath + ".tmp." + std::to_string(::getpid());
+            try
+            {
+                TickImage::Write(tempPath, store, sources);
+                std::filesystem::rename(tempPath, entryPath);
+            }
+            catch(...)
+            {
+                //e.g. a full disk: no partial image is left behind
+                std::error_code error;
+                std::filesystem::remove(tempPath, error);
+                throw;
+            }
+        }
+
+        static void _refreshEntry(const std::string& entryPath, const TickStore& store, const std::vector<SourceInfo>& sources)
+        {
+            //records the new mtimes so the following loads do not hash the sources again;
+            //the hit stands even when the entry cannot be rewritten
+            try
+            {
+                _writeEntry(entryPath, store, sources);
+            }
+            catch(std::exception&)
+            {
+            }
+        }
+
+    private:
+        std::string _directory;
+        bool _verifyPayload;
+        CleaningPolicy _cleaning;
+        std::string _lastStatus;
+    };
+}
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+
+#include "tick_record.hpp"
+
+namespace ArbSimulation
+{
+    enum class CleaningRule
+    {
+        Malformed,                                  //unparsable or missing fields
+        BadPrice,                                   //bid or ask price not positive (or nan)
+        BadSize,                                    //bid or ask size not positive (or nan)
+        CrossedBook,                                //bid above ask
+        Duplicate,                                  //same as the previous kept update of the instrument
+        OutOfOrder                                  //older than the previous kept update of the instrument
+    };
+    static constexpr size_t CLEANING_RULES = 6;
+
+    enum class CleaningAction
+    {
+        Keep,                                       //not checked
+        Flag,                                       //kept with the rule's bit set in TickRecord::Flags
+        Repair,                                     //quote rules: last valid quote of the instrument, OutOfOrder: previous timestamp
+        Drop,
+        Fail                                        //the load throws
+    };
+
+    struct CleaningPolicy
+    {
+    /*
+    * What to do when a loaded update breaks a rule. The default only fails on malformed lines, as the loader always did.
+    * Malformed lines can only be dropped or fail, duplicates cannot be repaired.
+    */
+        std::array<CleaningAction, CLEANING_RULES> Actions{CleaningAction::Fail, CleaningAction::Keep, CleaningAction::Keep,
+            CleaningAction::Keep, CleaningAction::Keep, CleaningAction::Keep};
+
+        inline CleaningAction operator[](CleaningRule rule) const
+        {
+            return Actions[size_t(rule)];
+        }
+
+        void Set(CleaningRule rule, CleaningAction action)
+        {
+            if (rule == CleaningRule::Malformed && action != CleaningAction::Drop && action != CleaningAction::Fail)
+                throw Exception("Malformed lines can only be dropped or fail the load");
+            if (rule == CleaningRule::Duplicate && action == CleaningAction::Repair)
+                throw Exception("Duplicates cannot be repaired, drop or flag them");
+            Actions[size_t(rule)] = action;
+        }
+
+        inline bool IsDefault() const
+        {
+            return Actions == CleaningPolicy().Actions;
+        }
+
+        inline bool IsSequential() const
+        {
+            //rules which need the previous update of the instrument are applied while chunks are merged in file order
+            for (size_t rule = 0; rule < CLEANING_RULES; ++rule)
+                if (Actions[rule] == CleaningAction::Repair)
+                    return true;
+            return (*this)[CleaningRule::Duplicate] != CleaningAction::Keep || (*this)[CleaningRule::OutOfOrder] != CleaningAction::Keep;
+        }
+
+        std::string ToString() const
+        {
+            std::string result;
+            for (size_t rule = 0; rule < CLEANING_RULES; ++rule)
+                result += std::string(result.empty() ? "" : ", ") + GetRuleName(CleaningRule(rule)) + ": " + GetActionName(Actions[rule]);
+            return result;
+        }
+
+        static inline const char* GetRuleName(CleaningRule rule)
+        {
+            static const char* names[] = {"Malformed", "BadPrice", "BadSize", "CrossedBook", "Duplicate", "OutOfOrder"};
+            return names[size_t(rule)];
+        }
+
+        static inline const char* GetActionName(CleaningAction action)
+        {
+            static const char* names[] = {"Keep", "Flag", "Repair", "Drop", "Fail"};
+            return names[size_t(action)];
+        }
+
+        static CleaningRule ParseRule(std::string_view name)
+        {
+            for (size_t rule = 0; rule < CLEANING_RULES; ++rule)
+                if (name == GetRuleName(CleaningRule(rule)))
+                    return CleaningRule(rule);
+            throw Exception("Unknown cleaning rule: " + std::string(name));
+        }
+
+        static CleaningAction ParseAction(std::string_view name)
+        {
+            for (size_t action = 0; action <= size_t(CleaningAction::Fail); ++action)
+                if (name == GetActionName(CleaningAction(action)))
+                    return CleaningAction(action);
+            throw Exception("Unknown cleaning action: " + std::string(name));
+        }
+    };
+
+    struct CleaningCounters
+    {
+        u_int64_t Matched = 0;
+        u_int64_t Flagged = 0;
+        u_int64_t Repaired = 0;
+        u_int64_t Dropped = 0;
+    };
+
+    struct CleaningReport
+    {
+        u_int64_t Lines = 0;                        //non-empty lines parsed
+        u_int64_t Kept = 0;
+        std::array<CleaningCounters, CLEANING_RULES> Rules;
+
+        inline CleaningCounters& operator[](CleaningRule rule)
+        {
+            return Rules[size_t(rule)];
+        }
+
+        inline const CleaningCounters& operator[](CleaningRule rule) const
+        {
+            return Rules[size_t(rule)];
+        }
+
+        void Merge(const CleaningReport& other)
+        {
+            Lines += other.Lines;
+            Kept += other.Kept;
+            for (size_t rule = 0; rule < CLEANING_RULES; ++rule)
+            {
+                Rules[rule].Matched += other.Rules[rule].Matched;
+                Rules[rule].Flagged += other.Rules[rule].Flagged;
+                Rules[rule].Repaired += other.Rules[rule].Repaired;
+                Rules[rule].Dropped += other.Rules[rule].Dropped;
+            }
+        }
+
+        std::vector<std::vector<std::string>> ToReport(const CleaningPolicy& policy) const
+        {
+            std::vector<std::vector<std::string>> lines{{"Rule", "Action", "Matched", "Flagged", "Repaired", "Dropped"}};
+            for (size_t rule = 0; rule < CLEANING_RULES; ++rule)
+                lines.push_back({
+                    CleaningPolicy::GetRuleName(CleaningRule(rule)),
+                    CleaningPolicy::GetActionName(policy.Actions[rule]),
+                    std::to_string(Rules[rule].Matched),
+                    std::to_string(Rules[rule].Flagged),
+                    std::to_string(Rules[rule].Repaired),
+                    std::to_string(Rules[rule].Dropped)});
+            lines.push_back({"Lines", "", std::to_string(Lines), "", "", ""});
+            lines.push_back({"Kept", "", std::to_string(Kept), "", "", ""});
+            return lines;
+        }
+    };
+
+    class TickCleaner
+    {
+    /*
+    * Cleaning rules applied to parsed updates. Quote rules (BadPrice, BadSize, CrossedBook) only look at the update itself
+    * and run in the parallel parse of each chunk; a quote to repair is marked PENDING_REPAIR there.
+    * Duplicate, OutOfOrder and repairs need the previous updates of the instrument, so they run in file order
+    * while the chunks are appended to the store, which copies every record anyway. Results do not depend on the number of threads.
+    */
+    public:
+        static constexpr u_int32_t PENDING_REPAIR = 1u << 31;
+
+        static inline u_int32_t GetFlag(CleaningRule rule)
+        {
+            return 1u << size_t(rule);
+        }
+
+        static bool CheckQuote(TickRecord& record, const CleaningPolicy& policy, CleaningReport& report, std::string_view line)
+        {
+            //false - the update is dropped
+            for (auto rule: {CleaningRule::BadPrice, CleaningRule::BadSize, CleaningRule::CrossedBook})
+            {
+                auto action = policy[rule];
+                if (action == CleaningAction::Keep || !_isBroken(rule, record))
+                    continue;
+                ++report[rule].Matched;
+                switch(action)
+                {
+                    case CleaningAction::Flag:
+                        record.Flags |= GetFlag(rule);
+                        ++report[rule].Flagged;
+                        break;
+                    case CleaningAction::Repair:
+                        record.Flags |= GetFlag(rule) | PENDING_REPAIR;
+                        break;
+                    case CleaningAction::Drop:
+                        ++report[rule].Dropped;
+                        return false;
+                    default:
+                        throw Exception(std::string(CleaningPolicy::GetRuleName(rule)) + " tick line: " + std::string(line));
+                }
+            }
+            return true;
+        }
+
+        void SetPolicy(const CleaningPolicy& policy)
+        {
+            _policy = policy;
+        }
+
+        inline const CleaningPolicy& GetPolicy() const
+        {
+            return _policy;
+        }
+
+        void Restart()
+        {
+            //instruments of a new file start without history
+            _states.clear();
+        }
+
+        bool Apply(TickRecord& record, CleaningReport& report, const std::vector<std::string>& securityIds)
+        {
+            //record has its store instrument id, false - the update is dropped
+            if (record.InstrumentId >= _states.size())
+                _states.resize(record.InstrumentId + 1);
+            auto& state = _states[record.InstrumentId];
+            if (record.Flags & PENDING_REPAIR)
+            {
+                bool repaired = state.HasQuote;
+                for (auto rule: {CleaningRule::BadPrice, CleaningRule::BadSize, CleaningRule::CrossedBook})
+                    if ((record.Flags & GetFlag(rule)) && _policy[rule] == CleaningAction::Repair)
+                        ++(repaired ? report[rule].Repaired : report[rule].Dropped);
+                if (!repaired)
+                    return false;
+                record.Flags &= ~PENDING_REPAIR;
+                record.BidSize = state.Quote.BidSize;
+                record.BidPrice = state.Quote.BidPrice;
+                record.AskPrice = state.Quote.AskPrice;
+                record.AskSize = state.Quote.AskSize;
+            }
+
+            auto apply = [&](CleaningRule rule)
+            {
+                ++report[rule].Matched;
+                switch(_policy[rule])
+                {
+                    case CleaningAction::Flag:
+                        record.Flags |= GetFlag(rule);
+                        ++report[rule].Flagged;
+                        return true;
+                    case CleaningAction::Repair:
+                        record.Flags |= GetFlag(rule);
+                        record.Timestamp = state.Last.Timestamp;
+                        ++report[rule].Repaired;
+                        return true;
+                    case CleaningAction::Drop:
+                        ++report[rule].Dropped;
+                        return false;
+                    default:
+                        throw Exception(std::string(CleaningPolicy::GetRuleName(rule)) + " tick: " + securityIds[record.InstrumentId]
+                            + " at " + std::to_string(record.Timestamp));
+                }
+            };
+            if (state.HasLast && _policy[CleaningRule::Duplicate] != CleaningAction::Keep && _isSame(record, state.Last)
+                && !apply(CleaningRule::Duplicate))
+                return false;
+            if (state.HasLast && _policy[CleaningRule::OutOfOrder] != CleaningAction::Keep && record.Timestamp < state.Last.Timestamp
+                && !apply(CleaningRule::OutOfOrder))
+                return false;
+
+            state.Last = record;
+            state.HasLast = true;
+            if (!_hasBrokenFlag(record))
+            {
+                state.Quote = record;
+                state.HasQuote = true;
+            }
+            return true;
+        }
+
+    private:
+        struct InstrumentState
+        {
+            TickRecord Last{};
+            TickRecord Quote{};                     //last update with a valid quote
+            bool HasLast = false;
+            bool HasQuote = false;
+        };
+
+        static inline bool _isBroken(CleaningRule rule, const TickRecord& record)
+        {
+            switch(rule)
+            {
+                case CleaningRule::BadPrice:
+                    return !(record.BidPrice > 0) || !(record.AskPrice > 0) || !std::isfinite(record.BidPrice) || !std::isfinite(record.AskPrice);
+                case CleaningRule::BadSize:
+                    return !(record.BidSize > 0) || !(record.AskSize > 0) || !std::isfinite(record.BidSize) || !std::isfinite(record.AskSize);
+                case CleaningRule::CrossedBook:
+                    return record.BidPrice > record.AskPrice + MAX_PRECISION;
+                default:
+                    return false;
+            }
+        }
+
+        inline bool _hasBrokenFlag(const TickRecord& record) const
+        {
+            //flagged broken quotes are never used for repairs, repaired ones are copies of a valid quote
+            for (auto rule: {CleaningRule::BadPrice, CleaningRule::BadSize, CleaningRule::CrossedBook})
+                if ((record.Flags & GetFlag(rule)) && _policy[rule] == CleaningAction::Flag)
+                    return true;
+            return false;
+        }
+
+        static inline bool _isSame(const TickRecord& a, const TickRecord& b)
+        {
+            return a.Timestamp == b.Timestamp && a.BidSize == b.BidSize && a.BidPrice == b.BidPrice
+                && a.AskPrice == b.AskPrice && a.AskSize == b.AskSize;
+        }
+
+    private:
+        CleaningPolicy _policy;
+        std::vector<InstrumentState> _states;
+    };
+}
@@ -35,5 +35,11 @@ namespace ArbSimulation
         explicit StrategyException(const std::string &message) : Exception(message) {};
     };
 
+    class CacheError : public Exception
+    {
+    public:
+        explicit CacheError(const std::string &message) : Exception(message) {};
+    };
+
 
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "exceptions.hpp"
+
+namespace ArbSimulation
+{
+    enum class FlightEvent: u_int8_t
+    {
+        Start,                              //a strategy received its first message on this thread
+        L1Update,                           //Price - bid, Value - ask
+        NewOrder,                           //Price - 0, Value - qty, Timestamp - last update seen
+        OrderFilled,                        //Price - exec price, Value - qty, Timestamp - execution
+        Exception,                          //StrategyException thrown from a strategy callback
+        Mark                                //user event, see FlightRecorder::Record
+    };
+
+    struct FlightRecord
+    {
+        u_int64_t Tick;                     //number of updates the strategy had received
+        u_int64_t Timestamp;
+        double Price;
+        double Value;
+        u_int64_t OrderId;
+        u_int32_t InstrumentId;             //InstrumentManager id, names are saved with the dump
+        FlightEvent Event;
+        u_int8_t Side;                      //OrderSide
+        u_int8_t OrderType;
+        u_int8_t Reserved;
+    };
+    static_assert(sizeof(FlightRecord) == 48, "FlightRecord is a part of the dump format");
+
+    struct FlightDump
+    {
+        std::string Reason;
+        u_int64_t ThreadId = 0;
+        u_int64_t DumpedAt = 0;             //unix ns
+        u_int64_t Recorded = 0;             //records written since the thread started, older ones are overwritten
+        std::vector<std::string> Instruments;
+        std::vector<FlightRecord> Records;  //oldest first
+    };
+
+    class FlightRecorder
+    {
+    /*
+    * Always-on event trace: every thread writes compact binary records into its own fixed ring,
+    * a record costs one 48-byte store and an increment, nothing is formatted or flushed while replaying.
+    * The ring is saved to a file when a strategy throws StrategyException (if a dump directory is set)
+    * or on demand with Dump(); tools/flight_recorder_decoder.cpp prints dumps.
+    * Configure() before starting threads: it changes rings created afterwards.
+    */
+    public:
+        static constexpr char MAGIC[8] = {'A', 'R', 'B', 'F', 'L', 'T', '1', '\0'};
+        static constexpr u_int32_t VERSION = 1;
+        static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+        static constexpr size_t MAX_FAILURE_DUMPS = 32;     //per process, a failing sweep would otherwise write one per point
+
+        FlightRecorder(size_t capacity)
+        {
+            size_t rounded = 1;
+            while (rounded < std::max<size_t>(1, capacity))
+                rounded <<= 1;
+            _records = std::make_unique<FlightRecord[]>(rounded);
+            _mask = rounded - 1;
+        }
+
+        static void Configure(size_t capacity, const std::string& dumpDirectory)
+        {
+            //capacity 0 disables recording on threads that have not recorded yet
+            _capacity = capacity;
+            _dumpDirectory = dumpDirectory;
+        }
+
+        static inline const std::string& GetDumpDirectory()
+        {
+            return _dumpDirectory;
+        }
+
+        static inline FlightRecorder* Local()
+        {
+            //nullptr when recording is disabled
+            static thread_local std::unique_ptr<FlightRecorder> local;
+            if (!local && _capacity > 0)
+                local = std::make_unique<FlightRecorder>(_capacity);
+            return local.get();
+        }
+
+        inline void Record(const FlightRecord& record)
+        {
+            _records[_recorded++ & _mask] = record;
+        }
+
+        inline size_t Size() const
+        {
+            return std::min<u_int64_t>(_recorded, _mask + 1);
+        }
+
+        inline u_int64_t GetRecorded() const
+        {
+            return _recorded;
+        }
+
+        std::vector<FlightRecord> Snapshot() const
+        {
+            std::vector<FlightRecord> records;
+            records.reserve(Size());
+            for (u_int64_t i = _recorded - Size(); i < _recorded; ++i)
+                records.push_back(_records[i & _mask]);
+            return records;
+        }
+
+        void Dump(const std::string& path, const std::string& reason, const std::vector<std::string>& instruments) const
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            if (!file)
+                throw Exception("Unable to create " + path);
+            Header header{};
+            std::memcpy(header.Magic, MAGIC, sizeof(MAGIC));
+            header.Version = VERSION;
+            header.RecordSize = sizeof(FlightRecord);
+            header.ThreadId = syscall(SYS_gettid);
+            header.DumpedAt = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            header.Recorded = _recorded;
+            header.Count = Size();
+            header.InstrumentCount = instruments.size();
+            header.ReasonSize = reason.size();
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reason.data(), reason.size());
+            for (auto& name: instruments)
+            {
+                u_int32_t size = name.size();
+                file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+                file.write(name.data(), size);
+            }
+            //oldest first: the part after the write position, then the beginning of the ring
+            size_t first = (_recorded - header.Count) & _mask;
+            size_t tail = std::min<size_t>(header.Count, _mask + 1 - first);
+            file.write(reinterpret_cast<const char*>(&_records[first]), tail * sizeof(FlightRecord));
+            file.write(reinterpret_cast<const char*>(&_records[0]), (header.Count - tail) * sizeof(FlightRecord));
+            if (!file)
+                throw Exception("Unable to write " + path);
+        }
+
+        static std::string DumpOnFailure(const std::string& reason, const std::vector<std::string>& instruments)
+        {
+            //returns the path of the dump, empty if there is no dump directory, recording is off or the limit is reached
+            static std::atomic<size_t> dumps{0};
+            FlightRecorder* recorder = Local();
+            if (_dumpDirectory.empty() || recorder == nullptr)
+                return "";
+            size_t index = dumps++;
+            if (index >= MAX_FAILURE_DUMPS)
+                return "";
+            std::filesystem::create_directories(_dumpDirectory);
+            std::string path = (std::filesystem::path(_dumpDirectory) / ("flight_" + std::to_string(::getpid()) + "_"
+                + std::to_string(syscall(SYS_gettid)) + "_" + std::to_string(index) + ".bin")).string();
+            recorder->Dump(path, reason, instruments);
+            return path;
+        }
+
+        static FlightDump Read(const std::string& path)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+                throw Exception("Unable to open " + path);
+            Header header;
+            if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.Magic, MAGIC, sizeof(MAGIC)) != 0)
+                throw Exception(path + " is not a flight recorder dump");
+            if (header.Version != VERSION || header.RecordSize != sizeof(FlightRecord))
+                throw Exception(path + ": unsupported dump version");
+
+            FlightDump dump;
+            dump.ThreadId = header.ThreadId;
+            dump.DumpedAt = header.DumpedAt;
+            dump.Recorded = header.Recorded;
+            dump.Reason.resize(header.ReasonSize);
+            file.read(dump.Reason.data(), header.ReasonSize);
+            for (u_int32_t i = 0; i < header.InstrumentCount; ++i)
+            {
+                u_int32_t size = 0;
+                file.read(reinterpret_cast<char*>(&size), sizeof(size));
+                std::string name(size, '\0');
+                file.read(name.data(), size);
+                dump.Instruments.push_back(name);
+            }
+            dump.Records.resize(header.Count);
+            file.read(reinterpret_cast<char*>(dump.Records.data()), header.Count * sizeof(FlightRecord));
+            if (!file)
+                throw Exception(path + " is truncated");
+            return dump;
+        }
+
+        static const char* GetEventName(FlightEvent event)
+        {
+            switch(event)
+            {
+                case FlightEvent::Start: return "Start";
+                case FlightEvent::L1Update: return "L1Update";
+                case FlightEvent::NewOrder: return "NewOrder";
+                case FlightEvent::OrderFilled: return "OrderFilled";
+                case FlightEvent::Exception: return "Exception";
+                case FlightEvent::Mark: return "Mark";
+            }
+            return "Unknown";
+        }
+
+    private:
+        struct Header
+        {
+            char Magic[8];
+            u_int32_t Version;
+            u_int32_t RecordSize;
+            u_int64_t ThreadId;
+            u_int64_t DumpedAt;
+            u_int64_t Recorded;
+            u_int64_t Count;
+            u_int32_t InstrumentCount;
+            u_int32_t ReasonSize;
+        };
+
+        static inline size_t _capacity = DEFAULT_CAPACITY;
+        static inline std::string _dumpDirectory;
+
+        std::unique_ptr<FlightRecord[]> _records;
+        u_int64_t _mask = 0;
+        u_int64_t _recorded = 0;
+    };
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#include "exceptions.hpp"
+
+namespace ArbSimulation
+{
+    class Hasher
+    {
+    /*
+    * Fast non-cryptographic 64-bit hash used to key caches.
+    * Processes input word by word; the result depends only on the byte sequence,
+    * not on how it was split between Update() calls.
+    */
+    public:
+        explicit Hasher(u_int64_t seed = 0x9E3779B97F4A7C15ull): _state(seed ^ 0xC2B2AE3D27D4EB4Full)
+        {}
+
+        Hasher& Update(const void* data, size_t size)
+        {
+            auto bytes = static_cast<const unsigned char*>(data);
+            _length += size;
+            if (_pendingSize > 0)
+            {
+                size_t count = std::min(size, 8 - _pendingSize);
+                std::memcpy(_pending + _pendingSize, bytes, count);
+                _pendingSize += count;
+                bytes += count;
+                size -= count;
+                if (_pendingSize < 8)
+                    return *this;
+                _mixWord(_pending);
+                _pendingSize = 0;
+            }
+            for (; size >= 8; bytes += 8, size -= 8)
+                _mixWord(bytes);
+            std::memcpy(_pending, bytes, size);
+            _pendingSize = size;
+            return *this;
+        }
+
+        template<typename T>
+        Hasher& Add(const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            return Update(&value, sizeof(T));
+        }
+
+        Hasher& Add(const std::string& value)
+        {
+            Add(u_int64_t(value.size()));
+            return Update(value.data(), value.size());
+        }
+
+        u_int64_t Digest() const
+        {
+            u_int64_t state = _state;
+            unsigned char tail[8] = {0};
+            std::memcpy(tail, _pending, _pendingSize);
+            u_int64_t word;
+            std::memcpy(&word, tail, 8);
+            state = _mix(state ^ word ^ (u_int64_t(_pendingSize) << 56));
+            return _mix(state ^ _length);
+        }
+
+        static u_int64_t HashBytes(const void* data, size_t size, u_int64_t seed = 0x9E3779B97F4A7C15ull)
+        {
+            return Hasher(seed).Update(data, size).Digest();
+        }
+
+        static u_int64_t HashFile(const std::string& path)
+        {
+            std::ifstream file{path, std::ios::binary};
+            if (!file)
+                throw Exception("Unable to open " + path);
+            Hasher hasher;
+            std::vector<char> buffer(1 << 20);
+            while (file)
+            {
+                file.read(buffer.data(), buffer.size());
+                hasher.Update(buffer.data(), file.gcount());
+            }
+            return hasher.Digest();
+        }
+
+        static std::string ToHex(u_int64_t value)
+        {
+            char buffer[17];
+            std::snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)value);
+            return buffer;
+        }
+
+    private:
+        static inline u_int64_t _mix(u_int64_t x)
+        {
+            x ^= x >> 30;
+            x *= 0xBF58476D1CE4E5B9ull;
+            x ^= x >> 27;
+            x *= 0x94D049BB133111EBull;
+            x ^= x >> 31;
+            return x;
+        }
+
+        inline void _mixWord(const unsigned char* bytes)
+        {
+            u_int64_t word;
+            std::memcpy(&word, bytes, 8);
+            _state = (_state ^ _mix(word)) * 0x9FB21C651E98DF25ull;
+            _state ^= _state >> 29;
+        }
+
+    private:
+        u_int64_t _state;
+        u_int64_t _length{0};
+        unsigned char _pending[8];
+        size_t _pendingSize{0};
+    };
+}
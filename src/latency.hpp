@@ -0,0 +1,152 @@
+#pragma once
+
+#include <numeric>
+
+#include "hashing.hpp"
+#include "random.hpp"
+
+namespace ArbSimulation
+{
+    class LatencyDistribution
+    {
+    /*
+    * Order latency in nanoseconds: constant, shifted lognormal, empirical histogram or a weighted mixture of those.
+    * Sampling draws from a caller-owned CounterRng, so a replication is reproducible from its seed and stream.
+    */
+    public:
+        enum class Kind
+        {
+            Constant,
+            LogNormal,
+            Empirical,
+            Mixture
+        };
+
+        static LatencyDistribution Constant(u_int64_t latency)
+        {
+            LatencyDistribution distribution(Kind::Constant);
+            distribution._value = latency;
+            return distribution;
+        }
+
+        static LatencyDistribution LogNormal(double median, double sigma, u_int64_t shift = 0)
+        {
+            if (median <= 0 || sigma < 0)
+                throw Exception("LogNormal latency requires positive median and non-negative sigma");
+            LatencyDistribution distribution(Kind::LogNormal);
+            distribution._median = median;
+            distribution._sigma = sigma;
+            distribution._value = shift;
+            return distribution;
+        }
+
+        static LatencyDistribution Empirical(const std::vector<u_int64_t>& edges, const std::vector<double>& weights)
+        {
+            //bucket i covers [edges[i], edges[i + 1]), sampled uniformly inside the bucket
+            if (weights.empty() || edges.size() != weights.size() + 1 || !std::is_sorted(edges.begin(), edges.end()))
+                throw Exception("Empirical latency requires sorted edges and one weight per bucket");
+            LatencyDistribution distribution(Kind::Empirical);
+            distribution._edges = edges;
+            distribution._cumulative = _normalize(weights);
+            return distribution;
+        }
+
+        static LatencyDistribution Mixture(const std::vector<LatencyDistribution>& components, const std::vector<double>& weights)
+        {
+            if (components.empty() || components.size() != weights.size())
+                throw Exception("Mixture latency requires one weight per component");
+            LatencyDistribution distribution(Kind::Mixture);
+            distribution._components = components;
+            distribution._cumulative = _normalize(weights);
+            return distribution;
+        }
+
+        u_int64_t Sample(CounterRng& rng) const
+        {
+            switch (_kind)
+            {
+                case Kind::Constant:
+                    return _value;
+                case Kind::LogNormal:
+                    return _value + u_int64_t(_median * std::exp(_sigma * rng.Normal()));
+                case Kind::Empirical:
+                {
+                    size_t bucket = _pick(rng.Uniform());
+                    return _edges[bucket] + u_int64_t((_edges[bucket + 1] - _edges[bucket]) * rng.Uniform());
+                }
+                case Kind::Mixture:
+                    return _components[_pick(rng.Uniform())].Sample(rng);
+            }
+            return _value;
+        }
+
+        u_int64_t GetMinimum() const
+        {
+            //lower bound of the support, usable as a lookahead
+            switch (_kind)
+            {
+                case Kind::Empirical:
+                    return _edges.front();
+                case Kind::Mixture:
+                {
+                    u_int64_t minimum = _components.front().GetMinimum();
+                    for (auto& component: _components)
+                        minimum = std::min(minimum, component.GetMinimum());
+                    return minimum;
+                }
+                default:
+                    return _value;
+            }
+        }
+
+        inline Kind GetKind() const
+        {
+            return _kind;
+        }
+
+        void AddTo(Hasher& hasher) const
+        {
+            //everything sampling depends on, e.g. for cache keys
+            hasher.Add(u_int32_t(_kind)).Add(_value).Add(_median).Add(_sigma);
+            hasher.Add(u_int64_t(_edges.size())).Update(_edges.data(), _edges.size() * sizeof(u_int64_t));
+            hasher.Add(u_int64_t(_cumulative.size())).Update(_cumulative.data(), _cumulative.size() * sizeof(double));
+            hasher.Add(u_int64_t(_components.size()));
+            for (auto& component: _components)
+                component.AddTo(hasher);
+        }
+
+    private:
+        explicit LatencyDistribution(Kind kind): _kind(kind)
+        {}
+
+        static std::vector<double> _normalize(const std::vector<double>& weights)
+        {
+            double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+            if (total <= 0 || std::any_of(weights.begin(), weights.end(), [](double w){ return w < 0; }))
+                throw Exception("Latency weights must be non-negative with a positive sum");
+            std::vector<double> cumulative(weights.size());
+            double sum = 0;
+            for (size_t i = 0; i < weights.size(); ++i)
+                cumulative[i] = (sum += weights[i]) / total;
+            cumulative.back() = 1;
+            return cumulative;
+        }
+
+        inline size_t _pick(double u) const
+        {
+            return std::upper_bound(_cumulative.begin(), _cumulative.end() - 1, u) - _cumulative.begin();
+        }
+
+    private:
+        Kind _kind;
+        u_int64_t _value = 0;
+        double _median = 0;
+        double _sigma = 0;
+        std::vector<u_int64_t> _edges;
+        std::vector<double> _cumulative;
+        std::vector<LatencyDistribution> _components;
+    };
+
+    typedef std::unordered_map<std::string, LatencyDistribution> LatencyModel;
+    typedef std::shared_ptr<const LatencyModel> LatencyModelPtr;
+}
@@ -1,7 +1,120 @@
 #include <simdjson.h>
 #include <chrono>
 
-#include "arbitrage.hpp"
+#include "data_cache.hpp"
+#include "parameter_search.hpp"
+#include "process_sweep.hpp"
+#include "result_cache.hpp"
+#include "sharded_simulation.hpp"
+#include "strategy_host.hpp"
+
+void ReportPerfCounters(u_int64_t loadedTicks, const std::string& filename)
+{
+    using namespace ArbSimulation;
+    if (!PerfCounters::IsCompiled())
+        return;
+    if (!PerfCounters::IsAvailable())
+    {
+        std::cout << "\tHardware counters are unavailable: " << PerfCounters::GetError() << "\n";
+        return;
+    }
+    auto report = PerfCounters::ToReport(PerfCounters::Collect(), loadedTicks);
+    std::cout << "\tHardware counters (IPC, cache / branch / dTLB misses per tick):\n";
+    for (size_t i = 1; i < report.size(); ++i)
+        std::cout << "\t\t" << report[i][0] << " " << report[i][1] << ": " << report[i][5] << " IPC, "
+            << report[i][6] << " / " << report[i][7] << " / " << report[i][8] << "\n";
+    CSVIO::WriteFile(filename, report, ';');
+    std::cout << "\tCounters are saved: " + filename + "\n";
+}
+
+void ReportResultCache(const ArbSimulation::ResultCachePtr& cache)
+{
+    if (!cache)
+        return;
+    auto stats = cache->GetStats();
+    std::cout << "\tResult cache: " << stats.Hits << " of " << stats.Lookups << " runs reused (" << stats.GetHitRate() * 100 << "%), "
+        << stats.Stored << " stored";
+    if (stats.Uncacheable > 0)
+        std::cout << ", " << stats.Uncacheable << " not cacheable";
+    std::cout << "\n";
+}
+
+ArbSimulation::LatencyDistribution ParseLatencyDistribution(simdjson::dom::object object)
+{
+    using namespace ArbSimulation;
+    std::string type = std::string(object["Type"]);
+    if (type == "Constant")
+        return LatencyDistribution::Constant(u_int64_t(object["Value"]));
+    if (type == "LogNormal")
+    {
+        u_int64_t shift = 0;
+        if (object["Shift"].get(shift) != simdjson::SUCCESS)
+            shift = 0;
+        return LatencyDistribution::LogNormal(double(object["Median"]), double(object["Sigma"]), shift);
+    }
+    if (type == "Empirical")
+    {
+        std::vector<u_int64_t> edges;
+        std::vector<double> weights;
+        for (auto value: object["Edges"].get_array())
+            edges.push_back(u_int64_t(value));
+        for (auto value: object["Weights"].get_array())
+            weights.push_back(double(value));
+        return LatencyDistribution::Empirical(edges, weights);
+    }
+    if (type == "Mixture")
+    {
+        std::vector<LatencyDistribution> components;
+        std::vector<double> weights;
+        for (auto value: object["Components"].get_array())
+        {
+            simdjson::dom::object component = value.get_object();
+            components.push_back(ParseLatencyDistribution(component));
+            weights.push_back(double(component["Weight"]));
+        }
+        return LatencyDistribution::Mixture(components, weights);
+    }
+    throw Exception("Unknown latency distribution type " + type);
+}
+
+ArbSimulation::SignalOptions ParseSignal(simdjson::dom::object object)
+{
+    using namespace ArbSimulation;
+    SignalOptions signal;
+    std::string type = std::string(object["Type"]);
+    if (type == "ZScore")
+        signal.Type = SignalType::ZScore;
+    else if (type == "Ewma")
+        signal.Type = SignalType::Ewma;
+    else if (type != "Absolute")
+        throw Exception("Unknown signal type " + type);
+
+    double seconds = 0;
+    u_int64_t count = 0;
+    if (object["Window"].get(count) == simdjson::SUCCESS)
+        signal.Window.Count = count;
+    if (object["WindowSec"].get(seconds) == simdjson::SUCCESS)
+        signal.Window.DurationNs = seconds * 1e9;
+    if (object["Capacity"].get(count) == simdjson::SUCCESS)
+        signal.Window.Capacity = count;
+    if (object["HalfLifeSec"].get(seconds) == simdjson::SUCCESS)
+        signal.HalfLifeNs = seconds * 1e9;
+    if (object["Alpha"].get(signal.Alpha) != simdjson::SUCCESS)
+        signal.Alpha = 0;
+    if (object["WarmUp"].get(count) == simdjson::SUCCESS)
+        signal.WarmUp = count;
+    return signal;
+}
+
+struct HostedStrategyConfig
+{
+    std::string Name;
+    double X = 0;
+    double Y = 0;
+    double Z = 0;
+    std::unordered_map<std::string, u_int64_t> Latencies;
+    ArbSimulation::SignalOptions Signal;
+};
 
 struct Config
 {
@@ -11,6 +124,39 @@ struct Config
     std::unordered_map<std::string, u_int64_t> Latencies;
     std::vector<std::string> DataFiles;
     std::string ReportsFolder;
+    std::string CacheDir;
+    std::string ResultCacheDir;
+    bool CacheVerify = true;
+    double AnalyticsBucketSeconds = 0;
+    u_int64_t Shards = 0;
+    std::vector<double> SweepX;
+    std::vector<double> SweepY;
+    std::vector<double> SweepZ;
+    u_int64_t SweepThreads = 0;
+    bool Search = false;
+    ArbSimulation::SearchOptions SearchOptions;
+    u_int64_t ApproximateBucketNs = 0;
+    u_int64_t ApproximateExactEvery = 20;
+    bool SweepInProcesses = false;
+    ArbSimulation::ProcessSweepOptions SweepProcesses;
+    std::shared_ptr<ArbSimulation::LatencyModel> LatencyModels;
+    u_int64_t Seed = 0;
+    u_int64_t Replications = 0;
+    u_int64_t MonteCarloThreads = 0;
+    std::vector<double> Quantiles{0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+    std::vector<double> BootstrapQuantiles{0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+    bool Bootstrapping = false;
+    ArbSimulation::BootstrapOptions Bootstrap;
+    u_int64_t BootstrapThreads = 0;
+    bool Conflation = false;
+    double ComputeTimeScale = 0;
+    bool HugePages = true;
+    ArbSimulation::CleaningPolicy Cleaning;
+    ArbSimulation::SignalOptions Signal;
+    u_int64_t FlightRecords = ArbSimulation::FlightRecorder::DEFAULT_CAPACITY;
+    std::string FlightDumpDir;
+    std::vector<HostedStrategyConfig> Strategies;
+    ArbSimulation::ConflationOptions ConflationOptions;
 
     bool Loaded = false;
 
@@ -48,7 +194,252 @@ struct Config
             }
             
             ReportsFolder = std::string(object["Reports"]);
-            std::cout << "\tReportsFolder: " << ReportsFolder << "\n\n";
+            std::cout << "\tReportsFolder: " << ReportsFolder << "\n";
+
+            simdjson::dom::object cleaning;
+            if (object["Cleaning"].get(cleaning) == simdjson::SUCCESS)
+            {
+                for (auto [key, value] : cleaning)
+                    Cleaning.Set(ArbSimulation::CleaningPolicy::ParseRule(key), ArbSimulation::CleaningPolicy::ParseAction(std::string_view(value)));
+                std::cout << "\tCleaning: " << Cleaning.ToString() << "\n";
+            }
+
+            std::string_view cacheDir;
+            if (object["CacheDir"].get(cacheDir) == simdjson::SUCCESS)
+            {
+                CacheDir = std::string(cacheDir);
+                bool cacheVerify;
+                if (object["CacheVerify"].get(cacheVerify) == simdjson::SUCCESS)
+                    CacheVerify = cacheVerify;
+                std::cout << "\tCacheDir: " << CacheDir << (CacheVerify ? "" : " (payload not verified)") << "\n";
+            }
+
+            std::string_view resultCacheDir;
+            if (object["ResultCache"].get(resultCacheDir) == simdjson::SUCCESS)
+            {
+                ResultCacheDir = std::string(resultCacheDir);
+                std::cout << "\tResultCache: " << ResultCacheDir << "\n";
+            }
+
+            simdjson::dom::object analytics;
+            if (object["Analytics"].get(analytics) == simdjson::SUCCESS)
+            {
+                AnalyticsBucketSeconds = double(analytics["BucketSeconds"]);
+                std::cout << "\tAnalytics: " << AnalyticsBucketSeconds << "s buckets\n";
+            }
+
+            if (object["Shards"].get(Shards) == simdjson::SUCCESS && Shards > 0)
+                std::cout << "\tShards: " << Shards << "\n";
+
+            simdjson::dom::object sweep;
+            if (object["Sweep"].get(sweep) == simdjson::SUCCESS)
+            {
+                auto readAxis = [&](const char* name, double value)
+                {
+                    std::vector<double> axis;
+                    simdjson::dom::array values;
+                    if (sweep[name].get(values) == simdjson::SUCCESS)
+                        for (auto item: values)
+                            axis.push_back(double(item));
+                    if (axis.empty())
+                        axis.push_back(value);
+                    std::cout << "\t\t" << name << ":";
+                    for (auto item: axis)
+                        std::cout << " " << item;
+                    std::cout << "\n";
+                    return axis;
+                };
+                std::cout << "\tSweep:\n";
+                SweepX = readAxis("X", X);
+                SweepY = readAxis("Y", Y);
+                SweepZ = readAxis("Z", Z);
+                if (sweep["Threads"].get(SweepThreads) != simdjson::SUCCESS || SweepThreads == 0)
+                    SweepThreads = ArbSimulation::GetHardwareThreads();
+                std::cout << "\t\tThreads: " << SweepThreads << "\n";
+
+                simdjson::dom::object processes;
+                if (sweep["Processes"].get(processes) == simdjson::SUCCESS)
+                {
+                    SweepInProcesses = true;
+                    u_int64_t value;
+                    if (processes["Count"].get(value) == simdjson::SUCCESS)
+                        SweepProcesses.Processes = value;
+                    if (processes["Retries"].get(value) == simdjson::SUCCESS)
+                        SweepProcesses.Retries = value;
+                    if (processes["JobTimeoutMs"].get(value) == simdjson::SUCCESS)
+                        SweepProcesses.JobTimeoutMs = value;
+                    if (processes["MemoryLimitMb"].get(value) == simdjson::SUCCESS)
+                        SweepProcesses.MemoryLimitMb = value;
+                    if (SweepProcesses.Processes == 0)
+                        SweepProcesses.Processes = ArbSimulation::GetHardwareThreads();
+                    std::cout << "\t\tProcesses: " << SweepProcesses.Processes << ", " << SweepProcesses.Retries << " retries";
+                    if (SweepProcesses.JobTimeoutMs > 0)
+                        std::cout << ", job timeout " << SweepProcesses.JobTimeoutMs << " ms";
+                    if (SweepProcesses.MemoryLimitMb > 0)
+                        std::cout << ", " << SweepProcesses.MemoryLimitMb << " MB per worker";
+                    std::cout << "\n";
+                }
+
+                simdjson::dom::object search;
+                if (sweep["Search"].get(search) == simdjson::SUCCESS)
+                {
+                    Search = true;
+                    double eta = 0;
+                    if (search["Eta"].get(eta) == simdjson::SUCCESS)
+                        SearchOptions.Eta = eta;
+                    u_int64_t minSurvivors = 0;
+                    if (search["MinSurvivors"].get(minSurvivors) == simdjson::SUCCESS)
+                        SearchOptions.MinSurvivors = minSurvivors;
+                    u_int64_t checkpoints = 0;
+                    if (search["Checkpoints"].get(checkpoints) == simdjson::SUCCESS)
+                        SearchOptions.Checkpoints = checkpoints;
+                    double drawdownWeight = 0;
+                    if (search["DrawdownWeight"].get(drawdownWeight) == simdjson::SUCCESS)
+                        SearchOptions.DrawdownWeight = drawdownWeight;
+                    std::cout << "\t\tSearch: eta " << SearchOptions.Eta << ", min survivors " << SearchOptions.MinSurvivors
+                        << ", drawdown weight " << SearchOptions.DrawdownWeight << "\n";
+                }
+
+                simdjson::dom::object approximate;
+                if (sweep["Approximate"].get(approximate) == simdjson::SUCCESS)
+                {
+                    double bucketMs = double(approximate["BucketMs"]);
+                    if (bucketMs <= 0)
+                        throw ArbSimulation::Exception("Approximate BucketMs must be positive");
+                    ApproximateBucketNs = bucketMs * 1e6;
+                    if (approximate["ExactEvery"].get(ApproximateExactEvery) != simdjson::SUCCESS)
+                        ApproximateExactEvery = 20;
+                    std::cout << "\t\tApproximate: " << bucketMs << " ms buckets, every " << ApproximateExactEvery << " point replayed exactly\n";
+                }
+            }
+
+            simdjson::dom::object signal;
+            if (object["Signal"].get(signal) == simdjson::SUCCESS)
+            {
+                Signal = ParseSignal(signal);
+                std::cout << "\tSignal: " << std::string_view(signal["Type"]) << "\n";
+            }
+
+            simdjson::dom::array strategies;
+            if (object["Strategies"].get(strategies) == simdjson::SUCCESS)
+            {
+                std::cout << "\tStrategies:\n";
+                for (auto item: strategies)
+                {
+                    HostedStrategyConfig strategy{std::string(item["Name"]), double(item["X"]), double(item["Y"]), double(item["Z"]), Latencies, Signal};
+                    simdjson::dom::object strategyLatencies;
+                    if (item["Latencies"].get(strategyLatencies) == simdjson::SUCCESS)
+                        for (auto [key, value] : strategyLatencies)
+                            strategy.Latencies[std::string(key)] = u_int64_t(value);
+                    simdjson::dom::object strategySignal;
+                    if (item["Signal"].get(strategySignal) == simdjson::SUCCESS)
+                        strategy.Signal = ParseSignal(strategySignal);
+                    std::cout << "\t\t" << strategy.Name << ": X = " << strategy.X << ", Y = " << strategy.Y << ", Z = " << strategy.Z << "\n";
+                    Strategies.push_back(strategy);
+                }
+            }
+
+            simdjson::dom::object conflation;
+            if (object["Conflation"].get(conflation) == simdjson::SUCCESS)
+            {
+                Conflation = true;
+                bool value;
+                if (conflation["Timestamps"].get(value) == simdjson::SUCCESS)
+                    ConflationOptions.CoalesceTimestamps = value;
+                if (conflation["UnchangedPrices"].get(value) == simdjson::SUCCESS)
+                    ConflationOptions.SuppressUnchangedPrices = value;
+                std::cout << "\tConflation: timestamps " << (ConflationOptions.CoalesceTimestamps ? "on" : "off")
+                    << ", unchanged prices " << (ConflationOptions.SuppressUnchangedPrices ? "on" : "off") << "\n";
+            }
+
+            if (object["ComputeTimeScale"].get(ComputeTimeScale) == simdjson::SUCCESS && ComputeTimeScale > 0)
+                std::cout << "\tComputeTimeScale: " << ComputeTimeScale << "\n";
+
+            simdjson::dom::object latencyModels;
+            if (object["LatencyModels"].get(latencyModels) == simdjson::SUCCESS)
+            {
+                LatencyModels = std::make_shared<ArbSimulation::LatencyModel>();
+                std::cout << "\tLatencyModels:\n";
+                for (auto [key, value] : latencyModels)
+                {
+                    std::cout << "\t\t" << std::string(key) << ": " << std::string_view(value["Type"]) << "\n";
+                    LatencyModels->insert({std::string(key), ParseLatencyDistribution(value.get_object())});
+                }
+                if (object["Seed"].get(Seed) != simdjson::SUCCESS)
+                    Seed = 0;
+                std::cout << "\tSeed: " << Seed << "\n";
+            }
+
+            //failures are dumped next to the reports unless configured otherwise
+            FlightDumpDir = ReportsFolder;
+            if (object["HugePages"].get(HugePages) == simdjson::SUCCESS && !HugePages)
+                std::cout << "\tHuge pages: disabled\n";
+
+            simdjson::dom::object flightRecorder;
+            if (object["FlightRecorder"].get(flightRecorder) == simdjson::SUCCESS)
+            {
+                u_int64_t records;
+                if (flightRecorder["Records"].get(records) == simdjson::SUCCESS)
+                    FlightRecords = records;
+                std::string_view directory;
+                if (flightRecorder["Dir"].get(directory) == simdjson::SUCCESS)
+                    FlightDumpDir = std::string(directory);
+                std::cout << "\tFlightRecorder: " << FlightRecords << " records per thread, dumps to " << FlightDumpDir << "\n";
+            }
+
+            simdjson::dom::object monteCarlo;
+            if (object["MonteCarlo"].get(monteCarlo) == simdjson::SUCCESS)
+            {
+                Replications = u_int64_t(monteCarlo["Replications"]);
+                if (monteCarlo["Threads"].get(MonteCarloThreads) != simdjson::SUCCESS || MonteCarloThreads == 0)
+                    MonteCarloThreads = ArbSimulation::GetHardwareThreads();
+                simdjson::dom::array quantiles;
+                if (monteCarlo["Quantiles"].get(quantiles) == simdjson::SUCCESS)
+                {
+                    Quantiles.clear();
+                    for (auto item: quantiles)
+                        Quantiles.push_back(double(item));
+                }
+                std::cout << "\tMonteCarlo: " << Replications << " replications on " << MonteCarloThreads << " threads\n";
+            }
+
+            simdjson::dom::object bootstrap;
+            if (object["Bootstrap"].get(bootstrap) == simdjson::SUCCESS)
+            {
+                Bootstrapping = true;
+                Bootstrap.Paths = u_int64_t(bootstrap["Paths"]);
+                double blockSec;
+                if (bootstrap["BlockSec"].get(blockSec) == simdjson::SUCCESS)
+                    Bootstrap.BlockNs = blockSec * 1e9;
+                u_int64_t seed;
+                if (bootstrap["Seed"].get(seed) == simdjson::SUCCESS)
+                    Bootstrap.Seed = seed;
+                bool rebase;
+                if (bootstrap["Rebase"].get(rebase) == simdjson::SUCCESS)
+                    Bootstrap.RebasePrices = rebase;
+                if (bootstrap["Threads"].get(BootstrapThreads) != simdjson::SUCCESS || BootstrapThreads == 0)
+                    BootstrapThreads = ArbSimulation::GetHardwareThreads();
+                simdjson::dom::array quantiles;
+                if (bootstrap["Quantiles"].get(quantiles) == simdjson::SUCCESS)
+                {
+                    BootstrapQuantiles.clear();
+                    for (auto item: quantiles)
+                        BootstrapQuantiles.push_back(double(item));
+                }
+                std::cout << "\tBootstrap: " << Bootstrap.Paths << " paths of " << Bootstrap.BlockNs / 1e9 << "s blocks on "
+                    << BootstrapThreads << " threads" << (Bootstrap.RebasePrices ? ", rebased" : "") << "\n";
+            }
+            //ZScore and Ewma statistics sample every update, conflated and decimated replays would change them
+            bool signals = Signal.Type != ArbSimulation::SignalType::Absolute;
+            for (auto& strategy: Strategies)
+                signals |= strategy.Signal.Type != ArbSimulation::SignalType::Absolute;
+            if (Conflation && signals)
+                throw ArbSimulation::Exception("Conflation is supported with the Absolute signal only");
+            if (ApproximateBucketNs > 0 && Signal.Type != ArbSimulation::SignalType::Absolute)
+                throw ArbSimulation::Exception("Approximate sweeps are supported with the Absolute signal only");
+            if (ApproximateBucketNs > 0 && Conflation)
+                throw ArbSimulation::Exception("Approximate sweeps replay their own decimated data, remove Conflation");
+            std::cout << "\n";
             Loaded = true;
         }
         catch(std::exception& ex)
@@ -61,6 +452,7 @@ struct Config
 int main(int argc, char* argv[])
 {
     using namespace ArbSimulation;
+    ARBSIM_PERF_THREAD("main");
 
     std::string configPath = "../../configs/default.json";
     if (argc > 1)
@@ -71,30 +463,362 @@ int main(int argc, char* argv[])
     if (!config.Loaded)
         return -1;
     
+    FlightRecorder::Configure(config.FlightRecords, config.FlightDumpDir);
+    HugePages::SetEnabled(config.HugePages);
     auto instrManager = std::make_shared<InstrumentManager>();
 
-    std::cout << "Loading data\n\n";
-    auto marketDataManager = std::make_shared<MarketDataSimulationManager>(instrManager, config.DataFiles);
-    auto orderMatcher = std::make_shared<OrderMatcher>(config.Latencies);
-    auto arbStrategy = std::make_shared<ArbitrageStrategy>(config.X, config.Y, config.Z, instrManager);    
-    
-    arbStrategy->AddSubscriber(orderMatcher);
-    orderMatcher->AddSubscriber(arbStrategy);
-    marketDataManager->AddSubscriber(orderMatcher);
-    marketDataManager->AddSubscriber(arbStrategy);
+    std::cout << "Loading data\n";
+    auto loadStart = std::chrono::steady_clock::now();
+    TickStorePtr tickStore;
+    bool shared = std::any_of(config.DataFiles.begin(), config.DataFiles.end(), SharedTickStore::IsSharedPath);
+    if (!config.CacheDir.empty() && !shared)
+    {
+        DataCache cache(config.CacheDir, config.CacheVerify, config.Cleaning);
+        tickStore = cache.LoadOrBuild(config.DataFiles);
+        std::cout << "\tCache: " << cache.GetLastStatus() << "\n";
+    }
+    else
+        tickStore = LoadTickStore(config.DataFiles, config.Cleaning);
+    auto loadTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - loadStart);
+    std::cout << "\tLoaded " << tickStore->Size() << " updates in " << loadTime.count() << " ms\n";
+    auto memory = HugePages::GetUsage();
+    std::cout << "\tMapped memory: " << memory.Bytes[size_t(PageBacking::HugeTlb)] / double(1 << 20) << " MB on hugetlb, "
+        << memory.Bytes[size_t(PageBacking::Transparent)] / double(1 << 20) << " MB on transparent huge pages, "
+        << memory.Bytes[size_t(PageBacking::Normal)] / double(1 << 20) << " MB on 4KB pages\n";
 
-    std::cout << "Running simulation...\n\n";
-    while(marketDataManager->Step());
+    ConflationSchedulePtr conflation;
+    if (config.Conflation)
+    {
+        conflation = std::make_shared<ConflationSchedule>(*tickStore, config.ConflationOptions);
+        std::cout << "\tConflation coalesced " << conflation->GetStats().Coalesced << " updates\n";
+    }
+
+    ResultCachePtr resultCache;
+    u_int64_t datasetHash = 0;
+    if (!config.ResultCacheDir.empty())
+    {
+        auto hashStart = std::chrono::steady_clock::now();
+        resultCache = std::make_shared<ResultCache>(config.ResultCacheDir);
+        datasetHash = ResultCache::HashDataset(*tickStore);
+        auto hashTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - hashStart);
+        std::cout << "\tResult cache: " << resultCache->Size() << " results, dataset " << Hasher::ToHex(datasetHash)
+            << " hashed in " << hashTime.count() << " ms\n";
+    }
+    std::cout << "\n";
 
-    std::cout << "Simulation is done!\n***\n\tFinal PnL is " << arbStrategy->GetFullPnL() << '\n';//*/
     std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
     std::time_t now_c = std::chrono::system_clock::to_time_t(now);
     std::tm now_tm = *std::localtime(&now_c);
     char datetime[256];
     strftime(datetime, 1024, "%F_%T", &now_tm);
-    std::string filename = config.ReportsFolder + 
-        (config.ReportsFolder.back() != '/' ? "/": "") + 
-        "trades_" + datetime + ".csv";
+    std::string reportsPrefix = config.ReportsFolder + (config.ReportsFolder.back() != '/' ? "/": "");
+    std::string perfCountersFile = reportsPrefix + "perf_counters_" + datetime + ".csv";
+
+    if (!config.Cleaning.IsDefault() || !tickStore->GetCleaningPolicy().IsDefault())
+    {
+        //a cache hit or a mapped image carries the report of the load which built it
+        auto& cleaning = tickStore->GetCleaningReport();
+        if (cleaning.Lines == 0)
+            std::cout << "No cleaning report is available: the data was not parsed in this run and its image carries none\n\n";
+        else
+        {
+            std::cout << "Cleaning kept " << cleaning.Kept << " of " << cleaning.Lines << " lines\n";
+            for (size_t rule = 0; rule < CLEANING_RULES; ++rule)
+                if (cleaning.Rules[rule].Matched > 0)
+                    std::cout << "\t" << CleaningPolicy::GetRuleName(CleaningRule(rule)) << ": " << cleaning.Rules[rule].Matched << " matched, "
+                        << cleaning.Rules[rule].Flagged << " flagged, " << cleaning.Rules[rule].Repaired << " repaired, "
+                        << cleaning.Rules[rule].Dropped << " dropped\n";
+            std::string cleaningFile = reportsPrefix + "cleaning_" + datetime + ".csv";
+            CSVIO::WriteFile(cleaningFile, cleaning.ToReport(tickStore->GetCleaningPolicy()), ';');
+            std::cout << "\tCleaning report is saved: " + cleaningFile + "\n\n";
+        }
+    }
+
+    if (!config.Strategies.empty())
+    {
+        //a hosted ArbitrageStrategy replays like a SimulationRun of its parameters, so both share cached results
+        std::vector<RunParameters> points;
+        for (auto& strategy: config.Strategies)
+            points.push_back(RunParameters{strategy.X, strategy.Y, strategy.Z, strategy.Latencies, config.LatencyModels, config.Seed, 0,
+                conflation, config.ComputeTimeScale, strategy.Signal});
+        auto replay = [&](const std::vector<RunParameters>& batch)
+        {
+            StrategyHost host(tickStore);
+            for (auto& parameters: batch)
+                host.Add("", [parameters](std::shared_ptr<InstrumentManager> instrManager)
+                {
+                    return std::make_shared<ArbitrageStrategy>(parameters.X, parameters.Y, parameters.Z, instrManager, parameters.Signal);
+                }, parameters.Latencies, HostedOptions{parameters.StochasticLatencies, parameters.Seed, parameters.Conflation, parameters.ComputeTimeScale});
+            std::vector<RunResult> runs;
+            for (auto& hosted: host.Run())
+                runs.push_back(RunResult{{}, hosted.PnL, hosted.Trades, hosted.Ticks, hosted.Error});
+            return runs;
+        };
+
+        std::cout << "Running " << points.size() << " strategies side by side...\n\n";
+        auto hostStart = std::chrono::steady_clock::now();
+        auto runs = resultCache ? resultCache->Run(datasetHash, points, replay) : replay(points);
+        auto hostTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - hostStart);
+
+        std::vector<HostedResult> results;
+        for (size_t i = 0; i < runs.size(); ++i)
+            results.push_back(HostedResult{config.Strategies[i].Name, runs[i].PnL, runs[i].Trades, runs[i].Ticks, runs[i].Error});
+        std::cout << "Strategies are done in " << hostTime.count() << " ms!\n***\n";
+        for (auto& result: results)
+            std::cout << "\t" << result.Name << " PnL is " << result.PnL << (result.Error.empty() ? "" : " (" + result.Error + ")") << "\n";
+        ReportResultCache(resultCache);
+        std::string filename = reportsPrefix + "strategies_" + datetime + ".csv";
+        CSVIO::WriteFile(filename, StrategyHost::ToReport(results), ';');
+        std::cout << "\tResults are saved: " + filename + "\n";
+        ReportPerfCounters(tickStore->Size(), perfCountersFile);
+        return 0;
+    }
+
+    if (config.Replications > 0)
+    {
+        RunParameters parameters{config.X, config.Y, config.Z, config.Latencies, config.LatencyModels, config.Seed, 0, conflation, config.ComputeTimeScale, config.Signal};
+        std::cout << "Running " << config.Replications << " Monte Carlo replications on " << config.MonteCarloThreads << " threads...\n\n";
+        auto monteCarloStart = std::chrono::steady_clock::now();
+        auto replications = MonteCarloRunner::MakeReplications(parameters, config.Replications);
+        auto replay = [&](const std::vector<RunParameters>& points){ return MonteCarloRunner(tickStore, config.MonteCarloThreads).Run(points); };
+        auto results = resultCache ? resultCache->Run(datasetHash, replications, replay) : replay(replications);
+        auto monteCarloTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - monteCarloStart);
+
+        auto quantiles = MonteCarloRunner::ToQuantileReport(results, config.Quantiles);
+        std::cout << "Monte Carlo is done in " << monteCarloTime.count() << " ms!\n***\n";
+        for (size_t i = 1; i < quantiles.size(); ++i)
+            std::cout << "\tPnL q" << quantiles[i][0] << ": " << quantiles[i][1] << "\n";
+        ReportResultCache(resultCache);
+        std::string filename = reportsPrefix + "montecarlo_" + datetime + ".csv";
+        std::string quantilesFile = reportsPrefix + "montecarlo_quantiles_" + datetime + ".csv";
+        CSVIO::WriteFile(filename, MonteCarloRunner::ToReport(results), ';');
+        CSVIO::WriteFile(quantilesFile, quantiles, ';');
+        std::cout << "\tResults are saved: " + filename + "\n";
+        std::cout << "\tQuantiles are saved: " + quantilesFile + "\n";
+        ReportPerfCounters(tickStore->Size(), perfCountersFile);
+        return 0;
+    }
+
+    if (config.Bootstrapping && config.Bootstrap.Paths > 0)
+    {
+        RunParameters parameters{config.X, config.Y, config.Z, config.Latencies, config.LatencyModels, config.Seed, 0, nullptr, config.ComputeTimeScale, config.Signal};
+        if (conflation)
+            std::cout << "Conflation is not supported with Bootstrap, replaying all updates\n";
+        std::cout << "Running " << config.Bootstrap.Paths << " bootstrap paths on " << config.BootstrapThreads << " threads...\n\n";
+        auto bootstrapStart = std::chrono::steady_clock::now();
+        BootstrapRunner bootstrap(tickStore, config.BootstrapThreads);
+        if (resultCache)
+            bootstrap.SetMemo(ResultCache::MakeMemo(resultCache, datasetHash));
+        auto results = bootstrap.Run(parameters, config.Bootstrap);
+        auto bootstrapTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - bootstrapStart);
+
+        auto quantiles = BootstrapRunner::ToQuantileReport(results, config.BootstrapQuantiles);
+        std::cout << "Bootstrap is done in " << bootstrapTime.count() << " ms!\n***\n";
+        for (size_t i = 1; i < quantiles.size(); ++i)
+            std::cout << "\tq" << quantiles[i][0] << ": PnL " << quantiles[i][1] << ", max drawdown " << quantiles[i][2] << "\n";
+        ReportResultCache(resultCache);
+        std::string filename = reportsPrefix + "bootstrap_" + datetime + ".csv";
+        std::string quantilesFile = reportsPrefix + "bootstrap_quantiles_" + datetime + ".csv";
+        CSVIO::WriteFile(filename, BootstrapRunner::ToReport(results), ';');
+        CSVIO::WriteFile(quantilesFile, quantiles, ';');
+        std::cout << "\tResults are saved: " + filename + "\n";
+        std::cout << "\tQuantiles are saved: " + quantilesFile + "\n";
+        ReportPerfCounters(tickStore->Size(), perfCountersFile);
+        return 0;
+    }
+
+    if (!config.SweepX.empty())
+    {
+        auto grid = SweepRunner::MakeGrid(config.SweepX, config.SweepY, config.SweepZ, config.Latencies);
+        for (auto& parameters: grid)
+        {
+            parameters.StochasticLatencies = config.LatencyModels;
+            parameters.Seed = config.Seed;
+            parameters.Conflation = conflation;
+            parameters.ComputeTimeScale = config.ComputeTimeScale;
+            parameters.Signal = config.Signal;
+            if (config.AnalyticsBucketSeconds > 0)
+                parameters.AnalyticsBucketNs = config.AnalyticsBucketSeconds * 1e9;
+        }
+        if (config.Search)
+        {
+            std::cout << "Running successive halving search over " << grid.size() << " runs on " << config.SweepThreads << " threads...\n\n";
+            auto searchStart = std::chrono::steady_clock::now();
+            HalvingSearch search(tickStore, config.SweepThreads);
+            if (resultCache)
+                search.SetResultCache(resultCache, datasetHash);
+            auto result = search.Run(grid, config.SearchOptions);
+            auto searchTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - searchStart);
+
+            auto& best = result.Candidates[result.Best];
+            std::cout << "Search is done in " << searchTime.count() << " ms!\n***\n\tBest PnL is " << best.PnL
+                << " (X = " << best.Parameters.X << ", Y = " << best.Parameters.Y << ", Z = " << best.Parameters.Z << ")\n";
+            std::cout << "\tEvaluated " << result.EvaluatedTicks << " of " << result.FullGridTicks << " ticks of the full grid (saved "
+                << result.GetSavedShare() * 100 << "%)\n";
+            ReportResultCache(resultCache);
+            std::string filename = reportsPrefix + "search_" + datetime + ".csv";
+            CSVIO::WriteFile(filename, HalvingSearch::ToReport(result), ';');
+            std::cout << "\tResults are saved: " + filename + "\n";
+            ReportPerfCounters(tickStore->Size(), perfCountersFile);
+            return 0;
+        }
+        if (config.ApproximateBucketNs > 0)
+        {
+            ConflationOptions options;
+            options.BucketNs = config.ApproximateBucketNs;
+            auto decimation = std::make_shared<ConflationSchedule>(*tickStore, options);
+            std::cout << "Running approximate sweep of " << grid.size() << " runs over " << decimation->Size() << " of " << tickStore->Size()
+                << " updates on " << config.SweepThreads << " threads...\n\n";
+            auto sweepStart = std::chrono::steady_clock::now();
+            SweepRunner sweep(tickStore, config.SweepThreads);
+            if (resultCache)
+                sweep.SetMemo(ResultCache::MakeMemo(resultCache, datasetHash));
+            auto result = sweep.RunApproximate(grid, decimation, config.ApproximateExactEvery);
+            auto sweepTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - sweepStart);
+
+            auto& best = result.Results[result.Best];
+            auto exactBest = std::find(result.Checked.begin(), result.Checked.end(), result.Best) - result.Checked.begin();
+            std::cout << "Approximate sweep is done in " << sweepTime.count() << " ms!\n***\n\tBest approximate PnL is " << best.PnL
+                << ", exact " << result.Exact[exactBest].PnL << " (X = " << best.Parameters.X << ", Y = " << best.Parameters.Y
+                << ", Z = " << best.Parameters.Z << ")\n";
+            std::cout << "\tPnL error over " << result.Checked.size() << " exact runs: mean " << result.MeanAbsError << ", max " << result.MaxAbsError
+                << ", rms " << result.RmsError << " (" << result.GetRelativeError() * 100 << "% of mean |PnL|)\n";
+            std::cout << "\tReplayed " << result.ApproximateTicks + result.ExactTicks << " ticks instead of about " << result.FullGridTicks
+                << " (x" << result.GetSpeedup() << ")\n";
+            ReportResultCache(resultCache);
+            std::string filename = reportsPrefix + "sweep_approximate_" + datetime + ".csv";
+            CSVIO::WriteFile(filename, SweepRunner::ToReport(result), ';');
+            std::cout << "\tResults are saved: " + filename + "\n";
+            ReportPerfCounters(tickStore->Size(), perfCountersFile);
+            return 0;
+        }
+        if (config.SweepInProcesses)
+        {
+            std::cout << "Running sweep of " << grid.size() << " runs on " << config.SweepProcesses.Processes << " worker processes...\n\n";
+            auto sweepStart = std::chrono::steady_clock::now();
+            ProcessSweepResult workers;
+            auto replay = [&](const std::vector<RunParameters>& points)
+            {
+                size_t finished = 0;
+                workers = ProcessSweep(tickStore, config.SweepProcesses).Run(points, [&](size_t, const RunResult& run)
+                {
+                    ++finished;
+                    if (!run.Error.empty())
+                        std::cout << "\tRun X = " << run.Parameters.X << ", Y = " << run.Parameters.Y << ", Z = " << run.Parameters.Z
+                            << " failed: " << run.Error << "\n";
+                    else if (finished % std::max<size_t>(1, points.size() / 10) == 0)
+                        std::cout << "\t" << finished << " of " << points.size() << " runs are done\n";
+                });
+                return workers.Results;
+            };
+            auto results = resultCache ? resultCache->Run(datasetHash, grid, replay) : replay(grid);
+            auto sweepTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - sweepStart);
+
+            auto best = results.begin() + SweepRunner::FindBest(results);
+            std::cout << "Sweep is done in " << sweepTime.count() << " ms!\n***\n\tBest PnL is " << best->PnL
+                << " (X = " << best->Parameters.X << ", Y = " << best->Parameters.Y << ", Z = " << best->Parameters.Z << ")\n";
+            if (!workers.Results.empty())
+                std::cout << "\tWorkers: " << workers.Crashes << " crashed, " << workers.Restarts << " restarted, " << workers.Retries << " jobs retried, "
+                    << workers.Failed << " given up; dataset " << (workers.SharedDataset ? "shared read-only" : "inherited") << "\n";
+            ReportResultCache(resultCache);
+            std::string filename = reportsPrefix + "sweep_" + datetime + ".csv";
+            CSVIO::WriteFile(filename, SweepRunner::ToReport(results), ';');
+            std::cout << "\tResults are saved: " + filename + "\n";
+            ReportPerfCounters(tickStore->Size(), perfCountersFile);
+            return 0;
+        }
+        std::cout << "Running sweep of " << grid.size() << " runs on " << config.SweepThreads << " threads...\n\n";
+        auto sweepStart = std::chrono::steady_clock::now();
+        SweepRunner sweep(tickStore, config.SweepThreads);
+        if (resultCache)
+            sweep.SetMemo(ResultCache::MakeMemo(resultCache, datasetHash));
+        auto results = sweep.Run(grid);
+        auto sweepTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - sweepStart);
+
+        auto best = results.begin() + SweepRunner::FindBest(results);
+        std::cout << "Sweep is done in " << sweepTime.count() << " ms!\n***\n\tBest PnL is " << best->PnL
+            << " (X = " << best->Parameters.X << ", Y = " << best->Parameters.Y << ", Z = " << best->Parameters.Z << ")\n";
+        ReportResultCache(resultCache);
+        std::string filename = reportsPrefix + "sweep_" + datetime + ".csv";
+        CSVIO::WriteFile(filename, SweepRunner::ToReport(results), ';');
+        std::cout << "\tResults are saved: " + filename + "\n";
+        ReportPerfCounters(tickStore->Size(), perfCountersFile);
+        return 0;
+    }
+
+    //orders, trades and matcher queues of the run are kept together in its arena
+    auto arena = std::make_shared<Arena>();
+    ArenaScope arenaScope(arena);
+    auto arbStrategy = std::make_shared<ArbitrageStrategy>(config.X, config.Y, config.Z, instrManager, config.Signal);
+    if (config.AnalyticsBucketSeconds > 0 && tickStore->Size() > 0)
+    {
+        u_int64_t bucketNs = config.AnalyticsBucketSeconds * 1e9;
+        size_t capacity = PerformanceAnalytics::GetCapacity((*tickStore)[0].Timestamp, (*tickStore)[tickStore->Size() - 1].Timestamp, bucketNs);
+        arbStrategy->EnableAnalytics(std::make_shared<PerformanceAnalytics>(bucketNs, capacity));
+    }
+    if (config.ComputeTimeScale > 0)
+        arbStrategy->EnableComputeLatency(config.ComputeTimeScale);
+
+    bool sharded = config.Shards > 0 && !config.LatencyModels && !conflation && config.ComputeTimeScale <= 0;
+    if (config.Shards > 0 && !sharded)
+        std::cout << "Shards are not supported with LatencyModels, Conflation or ComputeTimeScale, running on one thread\n";
+    try
+    {
+        if (sharded)
+        {
+            ShardedSimulation simulation(instrManager, tickStore, arbStrategy, config.Latencies, config.Shards);
+            std::cout << "Running simulation on " << simulation.GetShardsCount() << " shards...\n\n";
+            simulation.Run();
+        }
+        else
+        {
+            auto marketDataManager = std::make_shared<MarketDataSimulationManager>(instrManager, tickStore);
+            if (conflation)
+                marketDataManager->EnableConflation(conflation);
+            auto orderMatcher = std::make_shared<OrderMatcher>(config.Latencies);
+            if (config.LatencyModels)
+                orderMatcher->SetLatencyModel(config.LatencyModels, config.Seed);
+
+            arbStrategy->AddSubscriber(orderMatcher);
+            orderMatcher->AddSubscriber(arbStrategy);
+            marketDataManager->AddSubscriber(orderMatcher);
+            marketDataManager->AddSubscriber(arbStrategy);
+            if (conflation && config.ConflationOptions.SuppressUnchangedPrices)
+            {
+                arbStrategy->AddSubscriber(marketDataManager);
+                orderMatcher->AddSubscriber(marketDataManager);
+            }
+
+            std::cout << "Running simulation...\n\n";
+            while(marketDataManager->Step());
+            if (conflation)
+            {
+                auto stats = marketDataManager->GetConflationStats();
+                std::cout << "Conflation removed " << stats.Input - stats.Dispatched << " of " << stats.Input << " updates ("
+                    << stats.Coalesced << " coalesced, " << stats.Unchanged << " with unchanged prices)\n";
+            }
+        }
+    }
+    catch(StrategyException& ex)
+    {
+        //positions and trades up to the failure are still reported
+        std::cout << "Simulation is stopped: " << ex.what() << "\n";
+        if (!arbStrategy->GetFlightDumpPath().empty())
+            std::cout << "\tFlight record is saved: " << arbStrategy->GetFlightDumpPath() << "\n";
+    }
+
+    std::cout << "Simulation is done!\n***\n\tFinal PnL is " << arbStrategy->GetFullPnL() << '\n';//*/
+    auto& arenaStats = arena->GetStats();
+    std::cout << "\tRun arena: " << arenaStats.PeakBytes / 1024 << " KB at peak of " << arenaStats.ReservedBytes / 1024 << " KB reserved in "
+        << arenaStats.Chunks << " chunks (" << HugePages::GetBackingName(arenaStats.Backing) << ")\n";
+    if (config.ComputeTimeScale > 0)
+    {
+        auto& compute = arbStrategy->GetComputeTimeStats();
+        std::cout << "\tStrategy compute time: " << compute.TotalNs << " ns over " << compute.Callbacks << " callbacks (max "
+            << compute.MaxNs << " ns), " << compute.Orders << " orders delayed\n";
+    }
+    ReportPerfCounters(tickStore->Size(), perfCountersFile);
+    std::string filename = reportsPrefix + "trades_" + datetime + ".csv";
     
     auto& trades = arbStrategy->GetTrades();
     std::vector<std::vector<std::string>> reportLines{
@@ -122,5 +846,21 @@ int main(int argc, char* argv[])
     CSVIO::WriteFile(filename, reportLines, ';');
 
     std::cout << "\tTrades are saved: " + filename + "\n";
+
+    if (auto analytics = arbStrategy->GetAnalytics())
+    {
+        analytics->Finish();
+        auto summary = analytics->GetSummary();
+        std::cout << "***\n";
+        for (auto& line: summary)
+            std::cout << "\t" << line[0] << ": " << line[1] << "\n";
+
+        std::string summaryFile = reportsPrefix + "analytics_" + datetime + ".csv";
+        std::string curveFile = reportsPrefix + "equity_" + datetime + ".bin";
+        CSVIO::WriteFile(summaryFile, summary, ';');
+        analytics->WriteCurve(curveFile);
+        std::cout << "\tAnalytics are saved: " + summaryFile + "\n";
+        std::cout << "\tEquity curve is saved: " + curveFile + "\n";
+    }
     return 0; 
 }
\ No newline at end of file
@@ -24,6 +24,22 @@ namespace ArbSimulation
         {
             _subscribers.push_back(subscriber);
         }
+
+        inline void RemoveSubscriber(const std::shared_ptr<Subscriber>& subscriber)
+        {
+            std::erase(_subscribers, subscriber);
+        }
+
+        inline size_t GetSubscribersCount() const
+        {
+            return _subscribers.size();
+        }
+
+        inline void ClearSubscribers()
+        {
+            //subscriptions are usually mutual (strategy <-> matcher), clearing them breaks the ownership cycle
+            _subscribers.clear();
+        }
     
     private:
         std::vector<std::shared_ptr<Subscriber>> _subscribers;
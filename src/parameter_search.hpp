@@ -0,0 +1,252 @@
+#pragma once
+
+#include "result_cache.hpp"
+
+namespace ArbSimulation
+{
+    struct SearchOptions
+    {
+        double Eta = 3;                                     //1 / Eta of the ranked candidates survive a checkpoint
+        size_t MinSurvivors = 3;                            //never keep fewer candidates than this
+        size_t Checkpoints = 0;                             //0 - enough halvings to get down to MinSurvivors
+        double DrawdownWeight = 0;                          //score = PnL - DrawdownWeight * max drawdown
+    };
+
+    enum class CandidateStatus
+    {
+        Completed,                                          //replayed to the end
+        Finished,                                           //stopped once the stop-loss made its PnL final
+        Eliminated,                                         //ranked out at a checkpoint
+        Failed                                              //StrategyException
+    };
+
+    struct SearchCandidate
+    {
+        RunParameters Parameters;
+        CandidateStatus Status = CandidateStatus::Completed;
+        size_t Checkpoint = 0;                              //last checkpoint reached
+        size_t Ticks = 0;                                   //replayed by the search
+        double PnL = 0;                                     //final, or at the checkpoint where the candidate was eliminated
+        double MaxDrawdown = 0;
+        size_t Trades = 0;
+        std::string Error;
+    };
+
+    struct SearchResult
+    {
+        std::vector<SearchCandidate> Candidates;            //in grid order
+        size_t Best = 0;
+        u_int64_t EvaluatedTicks = 0;
+        u_int64_t FullGridTicks = 0;                        //what an exhaustive grid replays
+
+        inline double GetSavedShare() const
+        {
+            return FullGridTicks > 0 ? 1 - double(EvaluatedTicks) / FullGridTicks : 0;
+        }
+    };
+
+    class HalvingSearch
+    {
+    /*
+    * Successive halving over a parameter grid: every candidate replays up to the first checkpoint, candidates are ranked
+    * by PnL (optionally penalized by drawdown) and only the best 1/Eta resume, until the survivors replay to the end.
+    * Checkpoints grow geometrically (T/Eta^k, ..., T/Eta), so most of the budget goes to the promising candidates.
+    * Runs are resumed, not restarted, and each checkpoint is replayed in parallel over one shared TickStore.
+    * A candidate whose stop-loss has been hit and filled is stopped at once: its PnL can no longer change,
+    * so it keeps competing with that final PnL without replaying the rest of the data.
+    * The best candidate is chosen among those with a final PnL, like the best point of a full sweep.
+    * With a ResultCache the survivors of the last checkpoint are looked up before they replay to the end (they count
+    * as Completed), and the ones which do are stored; candidates stopped early are not full runs and are not stored.
+    */
+    public:
+        static constexpr u_int64_t DRAWDOWN_BUCKET_NS = 60000000000ull;    //candidates without RunParameters::AnalyticsBucketNs
+
+        HalvingSearch(TickStorePtr store, size_t threads): _store(store), _threads(threads)
+        {}
+
+        void SetResultCache(ResultCachePtr cache, u_int64_t datasetHash)
+        {
+            _cache = cache;
+            _datasetHash = datasetHash;
+        }
+
+        SearchResult Run(const std::vector<RunParameters>& grid, const SearchOptions& options)
+        {
+            if (options.Eta <= 1)
+                throw Exception("Search Eta must be greater than 1");
+            SearchResult result;
+            result.Candidates.resize(grid.size());
+            result.FullGridTicks = u_int64_t(grid.size()) * _store->Size();
+            if (grid.empty())
+                return result;
+
+            //drawdown is tracked on every update, the bucket only matters to the Sharpe ratio of the full runs
+            std::vector<RunParameters> tracked(grid);
+            for (auto& parameters: tracked)
+                if (parameters.AnalyticsBucketNs == 0)
+                    parameters.AnalyticsBucketNs = DRAWDOWN_BUCKET_NS;
+            std::vector<std::unique_ptr<Candidate>> runs(grid.size());
+            ParallelFor(grid.size(), _threads, [&](size_t index, size_t worker)
+            {
+                runs[index] = std::make_unique<Candidate>(_store, tracked[index]);
+                result.Candidates[index].Parameters = grid[index];
+            });
+
+            size_t checkpoints = options.Checkpoints;
+            size_t minSurvivors = std::max<size_t>(1, options.MinSurvivors);
+            if (checkpoints == 0 && grid.size() > minSurvivors)
+                checkpoints = std::ceil(std::log(double(grid.size()) / minSurvivors) / std::log(options.Eta) - 1e-9);
+
+            std::vector<size_t> alive(grid.size());
+            std::iota(alive.begin(), alive.end(), 0);
+            for (size_t checkpoint = 1; checkpoint <= checkpoints + 1 && !alive.empty(); ++checkpoint)
+            {
+                bool last = checkpoint == checkpoints + 1;
+                size_t limit = last ? std::numeric_limits<size_t>::max()
+                    : size_t(_store->Size() / std::pow(options.Eta, double(checkpoints + 1 - checkpoint)));
+                if (last && _cache)
+                    alive = _findCached(alive, tracked, checkpoint, result);
+                ParallelFor(alive.size(), _threads, [&](size_t index, size_t worker)
+                {
+                    ARBSIM_PERF_THREAD("search worker " + std::to_string(worker));
+                    size_t candidate = alive[index];
+                    runs[candidate]->Advance(limit, checkpoint, result.Candidates[candidate]);
+                });
+                if (last && _cache)
+                    for (size_t candidate: alive)
+                        if (result.Candidates[candidate].Status == CandidateStatus::Completed && ResultCache::IsCacheable(tracked[candidate]))
+                            _cache->Store(ResultCache::MakeKey(_datasetHash, tracked[candidate]), runs[candidate]->Finish());
+
+                //candidates with a final PnL leave the race, the others are ranked
+                std::vector<size_t> active;
+                for (size_t candidate: alive)
+                    if (runs[candidate])
+                    {
+                        if (result.Candidates[candidate].Status == CandidateStatus::Completed && !runs[candidate]->IsOver())
+                            active.push_back(candidate);
+                        else
+                            runs[candidate].reset();
+                    }
+                if (last)
+                    break;
+
+                auto score = [&](size_t candidate){ return _getScore(result.Candidates[candidate], options); };
+                std::stable_sort(active.begin(), active.end(), [&](size_t a, size_t b){ return score(a) > score(b); });
+                size_t keep = std::max(minSurvivors, size_t(std::ceil(active.size() / options.Eta)));
+                for (size_t i = keep; i < active.size(); ++i)
+                {
+                    result.Candidates[active[i]].Status = CandidateStatus::Eliminated;
+                    runs[active[i]].reset();
+                }
+                active.resize(std::min(keep, active.size()));
+                alive = active;
+            }
+
+            bool found = false;
+            for (size_t i = 0; i < result.Candidates.size(); ++i)
+            {
+                auto& candidate = result.Candidates[i];
+                result.EvaluatedTicks += candidate.Ticks;
+                bool final = candidate.Status == CandidateStatus::Completed || candidate.Status == CandidateStatus::Finished;
+                if (final && (!found || _getScore(candidate, options) > _getScore(result.Candidates[result.Best], options)))
+                {
+                    result.Best = i;
+                    found = true;
+                }
+            }
+            return result;
+        }
+
+        static std::vector<std::vector<std::string>> ToReport(const SearchResult& result)
+        {
+            static const char* statuses[] = {"Completed", "Finished", "Eliminated", "Failed"};
+            std::vector<std::vector<std::string>> lines{{"X", "Y", "Z", "Status", "Checkpoint", "Ticks", "PnL", "MaxDrawdown", "Trades", "Error"}};
+            for (auto& candidate: result.Candidates)
+                lines.push_back({
+                    std::to_string(candidate.Parameters.X),
+                    std::to_string(candidate.Parameters.Y),
+                    std::to_string(candidate.Parameters.Z),
+                    statuses[size_t(candidate.Status)],
+                    std::to_string(candidate.Checkpoint),
+                    std::to_string(candidate.Ticks),
+                    std::to_string(candidate.PnL),
+                    std::to_string(candidate.MaxDrawdown),
+                    std::to_string(candidate.Trades),
+                    candidate.Error});
+            return lines;
+        }
+
+    private:
+        class Candidate
+        {
+        public:
+            Candidate(TickStorePtr store, const RunParameters& parameters): _run(store, parameters)
+            {}
+
+            void Advance(size_t ticks, size_t checkpoint, SearchCandidate& state)
+            {
+                _over = !_run.RunUntil(ticks, true);
+                auto result = _run.GetResult();
+                state.Checkpoint = checkpoint;
+                state.Ticks = result.Ticks;
+                state.PnL = result.PnL;
+                state.MaxDrawdown = result.MaxDrawdown;
+                state.Trades = result.Trades;
+                state.Error = result.Error;
+                if (!result.Error.empty())
+                    state.Status = CandidateStatus::Failed;
+                else if (_run.GetStrategy()->IsFinished())
+                    state.Status = CandidateStatus::Finished;
+            }
+
+            inline bool IsOver() const
+            {
+                return _over;
+            }
+
+            RunResult Finish()
+            {
+                //of a candidate replayed to the end: closes its analytics, the result is the one of a full run
+                return _run.Run();
+            }
+
+        private:
+            SimulationRun _run;
+            bool _over = false;
+        };
+
+        std::vector<size_t> _findCached(const std::vector<size_t>& alive, const std::vector<RunParameters>& tracked, size_t checkpoint,
+            SearchResult& result)
+        {
+            //returns the candidates which still have to replay to the end
+            std::vector<size_t> missing;
+            for (size_t candidate: alive)
+            {
+                RunResult cached;
+                if (!ResultCache::IsCacheable(tracked[candidate])
+                    || !_cache->Find(ResultCache::MakeKey(_datasetHash, tracked[candidate]), cached))
+                {
+                    missing.push_back(candidate);
+                    continue;
+                }
+                auto& state = result.Candidates[candidate];
+                state.Checkpoint = checkpoint;
+                state.PnL = cached.PnL;
+                state.MaxDrawdown = cached.MaxDrawdown;
+                state.Trades = cached.Trades;
+            }
+            return missing;
+        }
+
+        static inline double _getScore(const SearchCandidate& candidate, const SearchOptions& options)
+        {
+            return candidate.PnL - options.DrawdownWeight * candidate.MaxDrawdown;
+        }
+
+    private:
+        TickStorePtr _store;
+        size_t _threads;
+        ResultCachePtr _cache;
+        u_int64_t _datasetHash = 0;
+    };
+}
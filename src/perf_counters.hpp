@@ -0,0 +1,385 @@
+#pragma once
+
+/*
+* Hardware performance counters per replay stage, built with -DARBSIM_PERF_COUNTERS (CMake option ARBSIM_PERF_COUNTERS).
+* Without it ARBSIM_PERF_SCOPE and ARBSIM_PERF_THREAD expand to nothing and no counter code is compiled in.
+*/
+
+#include <array>
+#include <atomic>
+#include <mutex>
+
+#include "definitions.h"
+
+#ifdef ARBSIM_PERF_COUNTERS
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ArbSimulation
+{
+    enum class PerfStage
+    {
+        Load,                               //parsing DataFiles into a TickStore
+        Sort,
+        Dispatch,                           //replay loop without the subscribers below
+        Matcher,                            //OrderMatcher message handling
+        Strategy                            //strategy callbacks with position keeping
+    };
+    static constexpr size_t PERF_STAGES = 5;
+
+    enum class PerfEvent
+    {
+        Cycles,
+        Instructions,
+        CacheMisses,
+        BranchMisses,
+        DtlbMisses
+    };
+    static constexpr size_t PERF_EVENTS = 5;
+
+    struct PerfValues
+    {
+        std::array<u_int64_t, PERF_EVENTS> Counts{};
+        u_int64_t Calls = 0;
+
+        inline u_int64_t operator[](PerfEvent event) const
+        {
+            return Counts[size_t(event)];
+        }
+
+        inline void Add(const PerfValues& other)
+        {
+            for (size_t i = 0; i < PERF_EVENTS; ++i)
+                Counts[i] += other.Counts[i];
+            Calls += other.Calls;
+        }
+    };
+
+    struct PerfThreadProfile
+    {
+        std::string Name;
+        std::array<PerfValues, PERF_STAGES> Stages;
+    };
+
+    class PerfCounters
+    {
+    /*
+    * One group of counters per thread (cycles, instructions, cache, branch and dTLB misses of user code),
+    * opened with perf_event_open on first use. Counters are read with rdpmc when the kernel allows it,
+    * otherwise with read(), which costs a system call per scope and inflates the counts of short stages.
+    * Stages nest: a scope's counts exclude the scopes inside it, so Dispatch is the replay loop alone.
+    * Threads report their totals when they exit, Collect() returns those and the calling thread's live totals.
+    * Counters may be unavailable (perf_event_paranoid, containers): IsAvailable() is false and counts stay 0.
+    */
+    public:
+        static inline const char* GetStageName(PerfStage stage)
+        {
+            static const char* names[] = {"Load", "Sort", "Dispatch", "Matcher", "Strategy"};
+            return names[size_t(stage)];
+        }
+
+        static inline bool IsCompiled()
+        {
+#ifdef ARBSIM_PERF_COUNTERS
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        static std::vector<PerfThreadProfile> Collect()
+        {
+            std::vector<PerfThreadProfile> profiles;
+            {
+                auto& registry = _registry();
+                std::lock_guard<std::mutex> lock(registry.Mutex);
+                profiles = registry.Finished;
+            }
+#ifdef ARBSIM_PERF_COUNTERS
+            auto& local = _local();
+            if (local.Used)
+                profiles.push_back(local.Profile);
+#endif
+            return profiles;
+        }
+
+        static void Reset()
+        {
+            auto& registry = _registry();
+            std::lock_guard<std::mutex> lock(registry.Mutex);
+            registry.Finished.clear();
+#ifdef ARBSIM_PERF_COUNTERS
+            _local().Profile.Stages = {};
+            _local().Used = false;
+#endif
+        }
+
+        static std::vector<std::vector<std::string>> ToReport(const std::vector<PerfThreadProfile>& profiles, u_int64_t loadedTicks)
+        {
+            /*
+            * One line per thread and stage, plus replay totals.
+            * Misses are per tick: per loaded tick for Load and Sort, per dispatched tick of the thread otherwise.
+            */
+            std::vector<std::vector<std::string>> lines{{"Thread", "Stage", "Calls", "Cycles", "Instructions", "IPC",
+                "CacheMissesPerTick", "BranchMissesPerTick", "DtlbMissesPerTick"}};
+            auto add = [&](const std::string& thread, const std::string& stage, const PerfValues& values, u_int64_t ticks)
+            {
+                double cycles = values[PerfEvent::Cycles];
+                auto perTick = [&](PerfEvent event){ return std::to_string(ticks > 0 ? values[event] / double(ticks) : 0); };
+                lines.push_back({thread, stage, std::to_string(values.Calls), std::to_string(values[PerfEvent::Cycles]),
+                    std::to_string(values[PerfEvent::Instructions]), std::to_string(cycles > 0 ? values[PerfEvent::Instructions] / cycles : 0),
+                    perTick(PerfEvent::CacheMisses), perTick(PerfEvent::BranchMisses), perTick(PerfEvent::DtlbMisses)});
+            };
+            PerfValues replay;
+            u_int64_t dispatched = 0;
+            for (auto& profile: profiles)
+            {
+                u_int64_t ticks = profile.Stages[size_t(PerfStage::Dispatch)].Calls;
+                dispatched += ticks;
+                for (size_t stage = 0; stage < PERF_STAGES; ++stage)
+                {
+                    auto& values = profile.Stages[stage];
+                    if (values.Calls == 0)
+                        continue;
+                    bool loading = PerfStage(stage) == PerfStage::Load || PerfStage(stage) == PerfStage::Sort;
+                    add(profile.Name, GetStageName(PerfStage(stage)), values, loading ? loadedTicks : ticks);
+                    if (!loading)
+                        replay.Add(values);
+                }
+            }
+            replay.Calls = dispatched;
+            add("All", "Replay", replay, dispatched);
+            return lines;
+        }
+
+        static void SetThreadName(const std::string& name)
+        {
+#ifdef ARBSIM_PERF_COUNTERS
+            _local().Profile.Name = name;
+#endif
+        }
+
+        static inline bool IsAvailable()
+        {
+#ifdef ARBSIM_PERF_COUNTERS
+            return _local().Group.IsOpen();
+#else
+            return false;
+#endif
+        }
+
+        static inline std::string GetError()
+        {
+#ifdef ARBSIM_PERF_COUNTERS
+            return _local().Group.Error;
+#else
+            return "built without ARBSIM_PERF_COUNTERS";
+#endif
+        }
+
+#ifdef ARBSIM_PERF_COUNTERS
+
+        class Scope
+        {
+        public:
+            explicit Scope(PerfStage stage): _stage(stage)
+            {
+                auto& local = _local();
+                _parent = local.Current;
+                local.Current = this;
+                local.Group.Read(_start);
+            }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+            ~Scope()
+            {
+                auto& local = _local();
+                std::array<u_int64_t, PERF_EVENTS> end;
+                local.Group.Read(end);
+                auto& values = local.Profile.Stages[size_t(_stage)];
+                for (size_t i = 0; i < PERF_EVENTS; ++i)
+                {
+                    u_int64_t delta = end[i] - _start[i];
+                    values.Counts[i] += delta - _children[i];
+                    if (_parent)
+                        _parent->_children[i] += delta;
+                }
+                ++values.Calls;
+                local.Used = true;
+                local.Current = _parent;
+            }
+
+        private:
+            PerfStage _stage;
+            Scope* _parent;
+            std::array<u_int64_t, PERF_EVENTS> _start;
+            std::array<u_int64_t, PERF_EVENTS> _children{};
+        };
+#endif
+
+    private:
+        struct Registry
+        {
+            std::mutex Mutex;
+            std::vector<PerfThreadProfile> Finished;
+            size_t Threads = 0;
+        };
+
+        static Registry& _registry()
+        {
+            static Registry registry;
+            return registry;
+        }
+
+#ifdef ARBSIM_PERF_COUNTERS
+        class CounterGroup
+        {
+        public:
+            CounterGroup()
+            {
+                static const std::pair<u_int32_t, u_int64_t> events[PERF_EVENTS] = {
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+                    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)}};
+                for (size_t i = 0; i < PERF_EVENTS; ++i)
+                {
+                    perf_event_attr attr{};
+                    attr.size = sizeof(attr);
+                    attr.type = events[i].first;
+                    attr.config = events[i].second;
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+                    //an event the CPU does not have stays closed and reads 0, the others are still counted
+                    _fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, _fds[0] >= 0 ? _fds[0] : -1, 0);
+                    if (_fds[i] < 0 && i == 0)
+                        Error = std::string("perf_event_open: ") + std::strerror(errno);
+                    if (_fds[i] >= 0)
+                    {
+                        void* page = ::mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, _fds[i], 0);
+                        _pages[i] = page == MAP_FAILED ? nullptr : static_cast<perf_event_mmap_page*>(page);
+                    }
+                }
+            }
+
+            CounterGroup(const CounterGroup&) = delete;
+            CounterGroup& operator=(const CounterGroup&) = delete;
+
+            ~CounterGroup()
+            {
+                for (size_t i = 0; i < PERF_EVENTS; ++i)
+                {
+                    if (_pages[i])
+                        ::munmap(_pages[i], sysconf(_SC_PAGESIZE));
+                    if (_fds[i] >= 0)
+                        ::close(_fds[i]);
+                }
+            }
+
+            inline bool IsOpen() const
+            {
+                return _fds[0] >= 0;
+            }
+
+            inline void Read(std::array<u_int64_t, PERF_EVENTS>& values) const
+            {
+                for (size_t i = 0; i < PERF_EVENTS; ++i)
+                    values[i] = _fds[i] >= 0 ? _read(i) : 0;
+            }
+
+        private:
+            inline u_int64_t _read(size_t i) const
+            {
+#if defined(__x86_64__)
+                //self-monitoring through the mapped page: no system call when the kernel allows rdpmc
+                if (auto page = _pages[i])
+                {
+                    u_int32_t sequence;
+                    u_int64_t count;
+                    bool rdpmc;
+                    do
+                    {
+                        sequence = page->lock;
+                        std::atomic_signal_fence(std::memory_order_seq_cst);
+                        u_int32_t index = page->index;
+                        count = page->offset;
+                        rdpmc = page->cap_user_rdpmc && index != 0;
+                        if (rdpmc)
+                        {
+                            u_int32_t low, high;
+                            asm volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(index - 1));
+                            int64_t pmc = (u_int64_t(high) << 32) | low;
+                            u_int32_t shift = 64 - page->pmc_width;
+                            count += (pmc << shift) >> shift;
+                        }
+                        std::atomic_signal_fence(std::memory_order_seq_cst);
+                    }
+                    while (page->lock != sequence);
+                    if (rdpmc)
+                        return count;
+                }
+#endif
+                u_int64_t value = 0;
+                if (::read(_fds[i], &value, sizeof(value)) != sizeof(value))
+                    return 0;
+                return value;
+            }
+
+        public:
+            std::string Error;
+
+        private:
+            std::array<int, PERF_EVENTS> _fds{-1, -1, -1, -1, -1};
+            std::array<perf_event_mmap_page*, PERF_EVENTS> _pages{};
+        };
+
+        struct Local
+        {
+            Local()
+            {
+                auto& registry = _registry();
+                std::lock_guard<std::mutex> lock(registry.Mutex);
+                Profile.Name = "thread " + std::to_string(registry.Threads++);
+            }
+
+            ~Local()
+            {
+                if (!Used)
+                    return;
+                auto& registry = _registry();
+                std::lock_guard<std::mutex> lock(registry.Mutex);
+                registry.Finished.push_back(Profile);
+            }
+
+            CounterGroup Group;
+            PerfThreadProfile Profile;
+            Scope* Current = nullptr;
+            bool Used = false;
+        };
+
+        static Local& _local()
+        {
+            thread_local Local local;
+            return local;
+        }
+#endif
+    };
+}
+
+#ifdef ARBSIM_PERF_COUNTERS
+#define ARBSIM_PERF_CONCAT_(a, b) a##b
+#define ARBSIM_PERF_CONCAT(a, b) ARBSIM_PERF_CONCAT_(a, b)
+#define ARBSIM_PERF_SCOPE(stage) ArbSimulation::PerfCounters::Scope ARBSIM_PERF_CONCAT(_perfScope, __LINE__)(ArbSimulation::PerfStage::stage)
+#define ARBSIM_PERF_THREAD(name) ArbSimulation::PerfCounters::SetThreadName(name)
+#else
+#define ARBSIM_PERF_SCOPE(stage)
+#define ARBSIM_PERF_THREAD(name)
+#endif
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "tick_record.hpp"
+
+namespace ArbSimulation
+{
+    class Portfolio
+    {
+    /*
+    * Positions of many instruments in structure-of-arrays form, indexed by instrument id (Instrument::Id or TickRecord::InstrumentId).
+    * Hot arrays (net qty, cash, marks) are contiguous and cache-line aligned (on huge pages once they are large, see HugePageAllocator),
+    * so marking all positions and the portfolio reductions are straight loops the compiler vectorizes.
+    * Traded quantities and notionals, needed only for average prices, are kept apart.
+    * PnL of a position is cash + net qty * mark, the value Position::GetPnL() computes before its rounding to MAX_PRECISION.
+    * Reductions sum LANES independent partial sums: they vectorize without -ffast-math and do not depend on the instruction set.
+    */
+    public:
+        static constexpr size_t LANES = 8;
+
+        explicit Portfolio(size_t instruments = 0)
+        {
+            Resize(instruments);
+        }
+
+        void Resize(size_t instruments)
+        {
+            //new positions are flat and unmarked
+            for (auto column: {&_netQty, &_cash, &_marks, &_qtyBought, &_qtySold, &_notionalBought, &_notionalSold})
+                column->resize(instruments, 0);
+        }
+
+        inline size_t Size() const
+        {
+            return _netQty.size();
+        }
+
+        void OnTrade(u_int32_t instrument, double qty, double price, OrderSide side)
+        {
+            if (instrument >= Size())
+                Resize(std::max<size_t>(instrument + 1, Size() * 2));
+            switch(side)
+            {
+                case OrderSide::Buy:
+                    _qtyBought[instrument] += qty;
+                    _notionalBought[instrument] += qty * price;
+                    _cash[instrument] -= qty * price;
+                    break;
+                case OrderSide::Sell:
+                    _qtySold[instrument] += qty;
+                    _notionalSold[instrument] += qty * price;
+                    _cash[instrument] += qty * price;
+                    break;
+                default:
+                    throw CalculationError("Wrong OrderSide");
+            }
+            _netQty[instrument] = _qtyBought[instrument] - _qtySold[instrument];
+        }
+
+        inline void OnFill(const OrderPtr& order)
+        {
+            OnTrade(order->Instrument->Id, order->Qty, order->ExecPrice, order->Side);
+        }
+
+        inline void Mark(u_int32_t instrument, double price)
+        {
+            if (instrument >= Size())
+                Resize(std::max<size_t>(instrument + 1, Size() * 2));
+            _marks[instrument] = price;
+        }
+
+        inline void OnL1Update(const L1UpdatePtr& update)
+        {
+            Mark(update->Instrument->Id, (update->BidPrice + update->AskPrice) / 2);
+        }
+
+        void MarkAll(const double* prices)
+        {
+            //prices of all Size() instruments
+            std::copy(prices, prices + Size(), _marks.data());
+        }
+
+        void MarkAll(const double* bids, const double* asks)
+        {
+            //mid prices of all Size() instruments
+            double* marks = _marks.data();
+            for (size_t i = 0, size = Size(); i < size; ++i)
+                marks[i] = (bids[i] + asks[i]) / 2;
+        }
+
+        void MarkRecords(const TickRecord* records, size_t count)
+        {
+            //a batch of updates, e.g. a slice of a TickStore, later updates of an instrument win
+            for (size_t i = 0; i < count; ++i)
+                Mark(records[i].InstrumentId, (records[i].BidPrice + records[i].AskPrice) / 2);
+        }
+
+        double GetPnL() const
+        {
+            const double* cash = _cash.data();
+            const double* netQty = _netQty.data();
+            const double* marks = _marks.data();
+            return _reduce([=](size_t i){ return cash[i] + netQty[i] * marks[i]; });
+        }
+
+        double GetNetExposure() const
+        {
+            const double* netQty = _netQty.data();
+            const double* marks = _marks.data();
+            return _reduce([=](size_t i){ return netQty[i] * marks[i]; });
+        }
+
+        double GetGrossExposure() const
+        {
+            const double* netQty = _netQty.data();
+            const double* marks = _marks.data();
+            return _reduce([=](size_t i){ return std::abs(netQty[i] * marks[i]); });
+        }
+
+        void GetPnLs(double* result) const
+        {
+            //PnL of every position
+            for (size_t i = 0, size = Size(); i < size; ++i)
+                result[i] = _cash[i] + _netQty[i] * _marks[i];
+        }
+
+        inline double GetPnL(u_int32_t instrument) const
+        {
+            return instrument < Size() ? _cash[instrument] + _netQty[instrument] * _marks[instrument] : 0;
+        }
+
+        inline double GetNetQty(u_int32_t instrument) const
+        {
+            return instrument < Size() ? _netQty[instrument] : 0;
+        }
+
+        inline double GetMark(u_int32_t instrument) const
+        {
+            return instrument < Size() ? _marks[instrument] : 0;
+        }
+
+        inline double GetAvgPriceBought(u_int32_t instrument) const
+        {
+            return instrument < Size() && _qtyBought[instrument] > 0 ? _notionalBought[instrument] / _qtyBought[instrument] : 0;
+        }
+
+        inline double GetAvgPriceSold(u_int32_t instrument) const
+        {
+            return instrument < Size() && _qtySold[instrument] > 0 ? _notionalSold[instrument] / _qtySold[instrument] : 0;
+        }
+
+    private:
+        typedef std::vector<double, HugePageAllocator<double>> Column;
+
+        template<typename Value>
+        inline double _reduce(Value value) const
+        {
+            double lanes[LANES] = {};
+            size_t size = Size(), i = 0;
+            for (; i + LANES <= size; i += LANES)
+                for (size_t lane = 0; lane < LANES; ++lane)
+                    lanes[lane] += value(i + lane);
+            for (; i < size; ++i)
+                lanes[i % LANES] += value(i);
+            double result = 0;
+            for (double lane: lanes)
+                result += lane;
+            return result;
+        }
+
+    private:
+        Column _netQty;
+        Column _cash;                                       //sold minus bought notional
+        Column _marks;
+        Column _qtyBought;
+        Column _qtySold;
+        Column _notionalBought;
+        Column _notionalSold;
+    };
+}
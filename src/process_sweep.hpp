@@ -0,0 +1,367 @@
+#pragma once
+
+#include <csignal>
+#include <functional>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "data_cache.hpp"
+#include "runner.hpp"
+
+namespace ArbSimulation
+{
+    struct ProcessSweepOptions
+    {
+        size_t Processes = 0;                               //0 - one per hardware thread
+        size_t Retries = 2;                                 //a job is given up after crashing 1 + Retries workers
+        size_t JobsInFlight = 2;                            //jobs queued on a worker, hides the round trip to the coordinator
+        u_int64_t JobTimeoutMs = 0;                         //> 0 - a worker stuck on one job longer is killed and the job retried
+        u_int64_t MemoryLimitMb = 0;                        //> 0 - address space limit of a worker, allocations over it fail the job
+    };
+
+    struct ProcessSweepResult
+    {
+        std::vector<RunResult> Results;                     //in grid order
+        size_t Crashes = 0;                                 //workers which died or were killed
+        size_t Restarts = 0;
+        size_t Retries = 0;                                 //jobs run again after their worker crashed
+        size_t Failed = 0;                                  //jobs given up, their Error says why
+        bool SharedDataset = false;                         //workers replayed a read-only mapping, not a copy-on-write heap
+    };
+
+    class ProcessSweep
+    {
+    /*
+    * Runs a parameter grid on local worker processes, so a crash, an abort or running out of memory in one run
+    * costs a worker, not the sweep. The coordinator maps the dataset read-only (publishing it to an anonymous shared
+    * segment when it was parsed into memory), then forks the workers, which inherit the mapping.
+    * Each worker is connected by a UNIX socket pair: it receives grid indices and streams back results.
+    * When a worker dies its oldest job, the one it was running, is charged an attempt; queued jobs go back without one.
+    * Dead workers are replaced while jobs remain. Results are merged into grid order as they arrive.
+    * When the coordinator itself fails (poll, socketpair or fork errors, a garbled answer) its workers are killed and reaped.
+    * Must be called before the process starts threads of its own: only the calling thread survives fork().
+    */
+    public:
+        typedef std::function<RunResult(const TickStorePtr&, const RunParameters&)> Job;
+        typedef std::function<void(size_t, const RunResult&)> ResultCallback;
+
+        ProcessSweep(TickStorePtr store, const ProcessSweepOptions& options = ProcessSweepOptions()): _store(store), _options(options)
+        {
+            if (_options.Processes == 0)
+                _options.Processes = GetHardwareThreads();
+            _options.JobsInFlight = std::max<size_t>(1, _options.JobsInFlight);
+        }
+
+        void SetJob(Job job)
+        {
+            //replaces the default SimulationRun of the parameters, e.g. with another strategy
+            _job = std::move(job);
+        }
+
+        ProcessSweepResult Run(const std::vector<RunParameters>& grid, ResultCallback onResult = nullptr)
+        {
+            ProcessSweepResult result;
+            result.Results.resize(grid.size());
+            if (grid.empty())
+                return result;
+            TickStorePtr store = _mapStore(result.SharedDataset);
+
+            std::vector<size_t> attempts(grid.size(), 0);
+            std::deque<size_t> pending;
+            for (size_t index = 0; index < grid.size(); ++index)
+                pending.push_back(index);
+            size_t done = 0;
+            std::vector<Worker> workers(std::min(_options.Processes, grid.size()));
+            Reaper reaper{workers};
+            for (auto& worker: workers)
+                _start(worker, workers, store, grid);
+
+            auto finish = [&](size_t index, RunResult&& run)
+            {
+                run.Parameters = grid[index];
+                result.Results[index] = std::move(run);
+                ++done;
+                if (onResult)
+                    onResult(index, result.Results[index]);
+            };
+            auto crash = [&](Worker& worker, const std::string& reason)
+            {
+                ++result.Crashes;
+                for (size_t i = 0; i < worker.Jobs.size(); ++i)
+                {
+                    size_t index = worker.Jobs[i];
+                    if (i == 0 && ++attempts[index] > _options.Retries)
+                    {
+                        RunResult failed;
+                        failed.Error = "Worker " + reason;
+                        ++result.Failed;
+                        finish(index, std::move(failed));
+                        continue;
+                    }
+                    ++result.Retries;
+                    pending.push_front(index);
+                }
+                worker.Jobs.clear();
+                if (!pending.empty())
+                {
+                    _start(worker, workers, store, grid);
+                    ++result.Restarts;
+                }
+            };
+
+            while (done < grid.size())
+            {
+                std::vector<pollfd> fds;
+                for (auto& worker: workers)
+                {
+                    while (worker.Socket >= 0 && worker.Jobs.size() < _options.JobsInFlight && !pending.empty())
+                    {
+                        u_int64_t index = pending.front();
+                        if (::send(worker.Socket, &index, sizeof(index), MSG_NOSIGNAL) != sizeof(index))
+                            break;
+                        pending.pop_front();
+                        worker.Jobs.push_back(index);
+                        if (worker.Jobs.size() == 1)
+                            worker.JobStart = std::chrono::steady_clock::now();
+                    }
+                    fds.push_back(pollfd{worker.Socket, POLLIN, 0});
+                }
+                int ready = ::poll(fds.data(), fds.size(), _options.JobTimeoutMs > 0 ? 100 : -1);
+                if (ready < 0 && errno != EINTR)
+                    throw Exception("Sweep coordinator poll failed: " + std::string(std::strerror(errno)));
+
+                for (size_t i = 0; i < workers.size(); ++i)
+                {
+                    auto& worker = workers[i];
+                    if (worker.Socket < 0)
+                        continue;
+                    if (ready > 0 && fds[i].revents != 0 && !_receive(worker, finish))
+                    {
+                        crash(worker, _stop(worker));
+                        continue;
+                    }
+                    if (_options.JobTimeoutMs > 0 && !worker.Jobs.empty()
+                        && std::chrono::steady_clock::now() - worker.JobStart > std::chrono::milliseconds(_options.JobTimeoutMs))
+                    {
+                        ::kill(worker.Pid, SIGKILL);
+                        _stop(worker);
+                        crash(worker, "timed out after " + std::to_string(_options.JobTimeoutMs) + " ms");
+                    }
+                }
+            }
+            for (auto& worker: workers)
+                _stop(worker);
+            return result;
+        }
+
+    private:
+        struct Worker
+        {
+            pid_t Pid = -1;
+            int Socket = -1;
+            std::deque<size_t> Jobs;                        //sent, not answered, in the order the worker runs them
+            std::chrono::steady_clock::time_point JobStart; //of Jobs.front()
+            std::string Buffer;                             //partial result message
+        };
+
+        struct Reaper
+        {
+            //on unwinding: workers still running are killed, none is left behind or unreaped
+            std::vector<Worker>& Workers;
+
+            ~Reaper()
+            {
+                for (auto& worker: Workers)
+                    if (worker.Pid > 0)
+                    {
+                        ::kill(worker.Pid, SIGKILL);
+                        _stop(worker);
+                    }
+            }
+        };
+
+        struct Message
+        {
+            u_int64_t Index;
+            double PnL;
+            u_int64_t Trades;
+            u_int64_t Ticks;
+            double MaxDrawdown;
+            double Sharpe;
+            u_int64_t ErrorSize;
+        };
+
+        TickStorePtr _mapStore(bool& shared) const
+        {
+            //the segment is unlinked at once: the coordinator's mapping lives on in every forked worker and goes with the last of them
+            shared = _store->IsMapped();
+            if (shared)
+                return _store;
+            static std::atomic<size_t> counter{0};
+            std::string name = "/arbsim_sweep_" + std::to_string(::getpid()) + "_" + std::to_string(counter++);
+            try
+            {
+                SharedTickStore::Publish(name, *_store, {});
+                auto store = SharedTickStore::Attach(name);
+                SharedTickStore::Remove(name);
+                shared = true;
+                return store;
+            }
+            catch(CacheError&)
+            {
+                //no shared memory: workers read the inherited heap, which they never write either
+                SharedTickStore::Remove(name);
+                return _store;
+            }
+        }
+
+        void _start(Worker& worker, std::vector<Worker>& workers, const TickStorePtr& store, const std::vector<RunParameters>& grid)
+        {
+            int sockets[2];
+            if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+                throw Exception("Unable to create a socket for a sweep worker: " + std::string(std::strerror(errno)));
+            //buffered output would be written again by the child
+            std::cout.flush();
+            std::fflush(nullptr);
+            pid_t pid = ::fork();
+            if (pid < 0)
+            {
+                ::close(sockets[0]);
+                ::close(sockets[1]);
+                throw Exception("Unable to fork a sweep worker: " + std::string(std::strerror(errno)));
+            }
+            if (pid == 0)
+            {
+                //other workers' sockets must not be kept open here, their EOF tells the coordinator they are gone
+                for (auto& other: workers)
+                    if (other.Socket >= 0)
+                        ::close(other.Socket);
+                ::close(sockets[0]);
+                _serve(sockets[1], store, grid);
+            }
+            ::close(sockets[1]);
+            worker.Pid = pid;
+            worker.Socket = sockets[0];
+            worker.Buffer.clear();
+        }
+
+        [[noreturn]] void _serve(int socket, const TickStorePtr& store, const std::vector<RunParameters>& grid)
+        {
+            if (_options.MemoryLimitMb > 0)
+            {
+                rlimit limit{_options.MemoryLimitMb << 20, _options.MemoryLimitMb << 20};
+                ::setrlimit(RLIMIT_AS, &limit);
+            }
+            u_int64_t index;
+            while (_readAll(socket, &index, sizeof(index)))
+            {
+                RunResult run;
+                try
+                {
+                    if (_job)
+                        run = _job(store, grid[index]);
+                    else
+                        run = SimulationRun(store, grid[index]).Run();
+                }
+                catch(std::exception& ex)
+                {
+                    run.Error = ex.what();
+                }
+                Message message{index, run.PnL, run.Trades, run.Ticks, run.MaxDrawdown, run.Sharpe, run.Error.size()};
+                if (!_writeAll(socket, &message, sizeof(message)) || !_writeAll(socket, run.Error.data(), run.Error.size()))
+                    break;
+            }
+            //no destructors or atexit handlers: they belong to the coordinator
+            ::_exit(0);
+        }
+
+        template<typename Finish>
+        bool _receive(Worker& worker, Finish& finish)
+        {
+            //false - the worker is gone
+            char buffer[4096];
+            ssize_t size = ::recv(worker.Socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (size < 0)
+                return errno == EAGAIN || errno == EINTR;
+            if (size == 0)
+                return false;
+            worker.Buffer.append(buffer, size);
+            while (worker.Buffer.size() >= sizeof(Message))
+            {
+                Message message;
+                std::memcpy(&message, worker.Buffer.data(), sizeof(Message));
+                if (worker.Buffer.size() < sizeof(Message) + message.ErrorSize)
+                    break;
+                if (worker.Jobs.empty() || worker.Jobs.front() != message.Index)
+                    throw Exception("Sweep worker answered job " + std::to_string(message.Index) + " out of order");
+                RunResult run;
+                run.PnL = message.PnL;
+                run.Trades = message.Trades;
+                run.Ticks = message.Ticks;
+                run.MaxDrawdown = message.MaxDrawdown;
+                run.Sharpe = message.Sharpe;
+                run.Error = worker.Buffer.substr(sizeof(Message), message.ErrorSize);
+                worker.Buffer.erase(0, sizeof(Message) + message.ErrorSize);
+                worker.Jobs.pop_front();
+                worker.JobStart = std::chrono::steady_clock::now();
+                finish(message.Index, std::move(run));
+            }
+            return true;
+        }
+
+        static std::string _stop(Worker& worker)
+        {
+            //closing the socket ends an idle worker, returns how the worker ended
+            if (worker.Socket >= 0)
+                ::close(worker.Socket);
+            worker.Socket = -1;
+            pid_t pid = worker.Pid;
+            worker.Pid = -1;
+            int status = 0;
+            if (pid <= 0 || ::waitpid(pid, &status, 0) != pid)
+                return "was lost";
+            if (WIFSIGNALED(status))
+                return "killed by signal " + std::to_string(WTERMSIG(status)) + " (" + ::strsignal(WTERMSIG(status)) + ")";
+            return "exited with code " + std::to_string(WEXITSTATUS(status));
+        }
+
+        static bool _readAll(int socket, void* data, size_t size)
+        {
+            auto bytes = static_cast<char*>(data);
+            while (size > 0)
+            {
+                ssize_t read = ::recv(socket, bytes, size, 0);
+                if (read < 0 && errno == EINTR)
+                    continue;
+                if (read <= 0)
+                    return false;
+                bytes += read;
+                size -= read;
+            }
+            return true;
+        }
+
+        static bool _writeAll(int socket, const void* data, size_t size)
+        {
+            auto bytes = static_cast<const char*>(data);
+            while (size > 0)
+            {
+                ssize_t written = ::send(socket, bytes, size, MSG_NOSIGNAL);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                if (written <= 0)
+                    return false;
+                bytes += written;
+                size -= written;
+            }
+            return true;
+        }
+
+    private:
+        TickStorePtr _store;
+        ProcessSweepOptions _options;
+        Job _job;
+    };
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "definitions.h"
+
+namespace ArbSimulation
+{
+    class CounterRng
+    {
+    /*
+    * Counter-based generator: the n-th value of a stream is a pure function of (seed, stream, n).
+    * Streams are independent and can be handed to any thread, results never depend on scheduling.
+    * Distributions are written out explicitly instead of using std:: ones, whose output is implementation-defined.
+    */
+    public:
+        CounterRng(u_int64_t seed = 0, u_int64_t stream = 0):
+            _key(Mix(seed ^ Mix(stream + 0x632BE59BD9B4E019ull))), _counter(0)
+        {}
+
+        static inline u_int64_t Mix(u_int64_t z)
+        {
+            //splitmix64 finalizer
+            z += 0x9E3779B97F4A7C15ull;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        inline u_int64_t Next()
+        {
+            return Mix(_key + 0x9E3779B97F4A7C15ull * ++_counter);
+        }
+
+        inline u_int64_t At(u_int64_t counter) const
+        {
+            return Mix(_key + 0x9E3779B97F4A7C15ull * counter);
+        }
+
+        inline double Uniform()
+        {
+            //[0, 1)
+            return (Next() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        inline double Normal()
+        {
+            //Box-Muller, one value per call to stay a pure function of the counter
+            double u1 = 1 - Uniform();
+            double u2 = Uniform();
+            return std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+        }
+
+        inline double Exponential(double mean)
+        {
+            return -std::log(1 - Uniform()) * mean;
+        }
+
+        inline u_int64_t Geometric(double mean)
+        {
+            //number of failures before success, mean = (1 - p) / p
+            if (mean <= 0)
+                return 0;
+            double p = 1 / (1 + mean);
+            return u_int64_t(std::floor(std::log(1 - Uniform()) / std::log(1 - p)));
+        }
+
+        inline u_int64_t GetCounter() const
+        {
+            return _counter;
+        }
+
+        inline void SetCounter(u_int64_t counter)
+        {
+            _counter = counter;
+        }
+
+    private:
+        u_int64_t _key;
+        u_int64_t _counter;
+    };
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <filesystem>
+#include <fcntl.h>
+#include <functional>
+#include <mutex>
+#include <unistd.h>
+
+#include "hashing.hpp"
+#include "runner.hpp"
+
+#ifndef ARBSIM_BUILD_ID
+//a rebuild gets a new id, define ARBSIM_BUILD_ID (e.g. to a release tag) to share results between builds of the same sources
+#define ARBSIM_BUILD_ID __VERSION__ " " __DATE__ " " __TIME__
+#endif
+
+namespace ArbSimulation
+{
+    struct ResultCacheStats
+    {
+        size_t Lookups = 0;
+        size_t Hits = 0;
+        size_t Uncacheable = 0;                             //runs which are always replayed, see ResultCache::IsCacheable
+        size_t Stored = 0;
+
+        inline double GetHitRate() const
+        {
+            return Lookups > 0 ? double(Hits) / Lookups : 0;
+        }
+    };
+
+    class ResultCache
+    {
+    /*
+    * Content-addressed memo of run results. The key hashes the dataset contents (see HashDataset), every field of
+    * RunParameters a replay depends on and the simulator build, so a changed tick, parameter or binary never hits a stale result.
+    * Runs timed by the wall clock (ComputeTimeScale) or replaying a Path without a Key are never cached, failed runs are not stored.
+    * Entries are appended to one file of checksummed records: processes sharing a directory (sweeps, batch jobs, notebooks)
+    * add to it concurrently with one O_APPEND write per record, a record torn by a killed writer is skipped on load.
+    * Entries written by other processes are seen on the next open.
+    */
+    public:
+        static constexpr char MAGIC[8] = {'A', 'R', 'B', 'M', 'E', 'M', 'O', '1'};
+        static constexpr u_int32_t VERSION = 3;
+        typedef RunBatch Compute;
+
+        ResultCache(const ResultCache&) = delete;
+
+        explicit ResultCache(const std::string& directory):
+            _path((std::filesystem::path(directory) / "results.bin").string())
+        {
+            std::filesystem::create_directories(directory);
+            _fd = ::open(_path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+            if (_fd < 0)
+                throw CacheError("Unable to open " + _path);
+            _load();
+        }
+
+        ~ResultCache()
+        {
+            ::close(_fd);
+        }
+
+        static u_int64_t HashDataset(const TickStore& store)
+        {
+            Hasher hasher;
+            hasher.Add(u_int64_t(store.GetSecurityIds().size()));
+            for (auto& securityId: store.GetSecurityIds())
+                hasher.Add(securityId);
+            hasher.Update(store.Data(), store.Size() * sizeof(TickRecord));
+            return hasher.Digest();
+        }
+
+        static inline std::string GetBuildId()
+        {
+            return ARBSIM_BUILD_ID;
+        }
+
+        static inline bool IsCacheable(const RunParameters& parameters)
+        {
+            return parameters.ComputeTimeScale <= 0 && (!parameters.Path || parameters.Path->Key != 0);
+        }
+
+        static u_int64_t MakeKey(u_int64_t datasetHash, const RunParameters& parameters)
+        {
+            Hasher hasher;
+            hasher.Add(VERSION).Add(GetBuildId()).Add(datasetHash);
+            hasher.Add(parameters.X).Add(parameters.Y).Add(parameters.Z);
+
+            //unordered maps are hashed in name order
+            std::map<std::string, u_int64_t> latencies(parameters.Latencies.begin(), parameters.Latencies.end());
+            hasher.Add(u_int64_t(latencies.size()));
+            for (auto& [name, latency]: latencies)
+                hasher.Add(name).Add(latency);
+            hasher.Add(u_int64_t(parameters.StochasticLatencies ? parameters.StochasticLatencies->size() : 0));
+            if (parameters.StochasticLatencies)
+            {
+                std::map<std::string, const LatencyDistribution*> models;
+                for (auto& [name, model]: *parameters.StochasticLatencies)
+                    models[name] = &model;
+                for (auto& [name, model]: models)
+                {
+                    hasher.Add(name);
+                    model->AddTo(hasher);
+                }
+            }
+            hasher.Add(parameters.Seed).Add(parameters.Replication);
+
+            hasher.Add(bool(parameters.Conflation));
+            if (parameters.Conflation)
+            {
+                auto& options = parameters.Conflation->GetOptions();
+                hasher.Add(options.CoalesceTimestamps).Add(options.SuppressUnchangedPrices).Add(options.BucketNs);
+            }
+            auto& signal = parameters.Signal;
+            hasher.Add(u_int32_t(signal.Type)).Add(u_int64_t(signal.Window.Count)).Add(signal.Window.DurationNs)
+                .Add(u_int64_t(signal.Window.Capacity)).Add(signal.HalfLifeNs).Add(signal.Alpha).Add(u_int64_t(signal.WarmUp));
+            hasher.Add(parameters.AnalyticsBucketNs);
+            hasher.Add(parameters.Path ? parameters.Path->Key : u_int64_t(0));
+            return hasher.Digest();
+        }
+
+        bool Find(u_int64_t key, RunResult& result)
+        {
+            //fills the outcome, not the parameters
+            std::lock_guard lock(_mutex);
+            ++_stats.Lookups;
+            auto entry = _entries.find(key);
+            if (entry == _entries.end())
+                return false;
+            ++_stats.Hits;
+            result.PnL = entry->second.PnL;
+            result.Trades = entry->second.Trades;
+            result.Ticks = entry->second.Ticks;
+            result.MaxDrawdown = entry->second.MaxDrawdown;
+            result.Sharpe = entry->second.Sharpe;
+            result.Error = entry->second.Error;
+            return true;
+        }
+
+        void Store(u_int64_t key, const RunResult& result)
+        {
+            Entry entry{result.PnL, result.Trades, result.Ticks, result.MaxDrawdown, result.Sharpe, result.Error};
+            std::string record = _makeRecord(key, entry);
+            std::lock_guard lock(_mutex);
+            if (!_entries.emplace(key, std::move(entry)).second)
+                return;
+            if (::write(_fd, record.data(), record.size()) != ssize_t(record.size()))
+                throw CacheError("Unable to write " + _path);
+            ++_stats.Stored;
+        }
+
+        std::vector<RunResult> Run(u_int64_t datasetHash, const std::vector<RunParameters>& grid, const Compute& compute)
+        {
+            /*
+            * Results of the grid in order: cached ones are reused, compute() replays the others (in grid order) and they are stored.
+            * Failed runs are not stored: a crashed or timed out worker, or an allocation over a memory limit, depends on the machine
+            * and the load, not on the key, and the next Run replays them.
+            */
+            std::vector<RunResult> results(grid.size());
+            std::vector<u_int64_t> keys(grid.size(), 0);
+            std::vector<RunParameters> missing;
+            std::vector<size_t> missingIndices;
+            for (size_t index = 0; index < grid.size(); ++index)
+            {
+                results[index].Parameters = grid[index];
+                bool cacheable = IsCacheable(grid[index]);
+                if (cacheable)
+                    keys[index] = MakeKey(datasetHash, grid[index]);
+                else
+                {
+                    std::lock_guard lock(_mutex);
+                    ++_stats.Uncacheable;
+                }
+                if (!cacheable || !Find(keys[index], results[index]))
+                {
+                    missing.push_back(grid[index]);
+                    missingIndices.push_back(index);
+                }
+            }
+            if (missing.empty())
+                return results;
+
+            auto computed = compute(missing);
+            for (size_t i = 0; i < missing.size(); ++i)
+            {
+                size_t index = missingIndices[i];
+                results[index] = computed[i];
+                results[index].Parameters = grid[index];
+                if (IsCacheable(grid[index]) && computed[i].Error.empty())
+                    Store(keys[index], computed[i]);
+            }
+            return results;
+        }
+
+        static RunMemo MakeMemo(std::shared_ptr<ResultCache> cache, u_int64_t datasetHash)
+        {
+            //binds the cache to a dataset for the runners (SweepRunner::SetMemo and the like)
+            return [cache, datasetHash](const std::vector<RunParameters>& grid, const RunBatch& replay)
+            {
+                return cache->Run(datasetHash, grid, replay);
+            };
+        }
+
+        inline ResultCacheStats GetStats() const
+        {
+            std::lock_guard lock(_mutex);
+            return _stats;
+        }
+
+        inline size_t Size() const
+        {
+            std::lock_guard lock(_mutex);
+            return _entries.size();
+        }
+
+        inline const std::string& GetPath() const
+        {
+            return _path;
+        }
+
+    private:
+        struct Entry
+        {
+            double PnL;
+            u_int64_t Trades;
+            u_int64_t Ticks;
+            double MaxDrawdown;
+            double Sharpe;
+            std::string Error;
+        };
+
+        struct RecordHeader
+        {
+            char Magic[8];
+            u_int64_t Key;
+            double PnL;
+            u_int64_t Trades;
+            u_int64_t Ticks;
+            double MaxDrawdown;
+            double Sharpe;
+            u_int64_t ErrorSize;
+            u_int64_t Checksum;                             //of the header up to here and the error text
+        };
+
+        static std::string _makeRecord(u_int64_t key, const Entry& entry)
+        {
+            RecordHeader header{};
+            std::memcpy(header.Magic, MAGIC, 8);
+            header.Key = key;
+            header.PnL = entry.PnL;
+            header.Trades = entry.Trades;
+            header.Ticks = entry.Ticks;
+            header.MaxDrawdown = entry.MaxDrawdown;
+            header.Sharpe = entry.Sharpe;
+            header.ErrorSize = entry.Error.size();
+            header.Checksum = _checksum(header, entry.Error.data());
+            std::string record(reinterpret_cast<const char*>(&header), sizeof(header));
+            return record + entry.Error;
+        }
+
+        static u_int64_t _checksum(const RecordHeader& header, const char* error)
+        {
+            return Hasher().Update(&header, offsetof(RecordHeader, Checksum)).Update(error, header.ErrorSize).Digest();
+        }
+
+        void _load()
+        {
+            std::ifstream file{_path, std::ios::binary};
+            std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            size_t offset = 0;
+            while (offset + sizeof(RecordHeader) <= data.size())
+            {
+                RecordHeader header;
+                std::memcpy(&header, data.data() + offset, sizeof(header));
+                const char* error = data.data() + offset + sizeof(header);
+                //the header fits (see the loop), a garbage ErrorSize must not wrap the bounds check around
+                if (std::memcmp(header.Magic, MAGIC, 8) != 0 || header.ErrorSize > data.size() - offset - sizeof(header)
+                    || header.Checksum != _checksum(header, error))
+                {
+                    //torn record: resynchronize on the next magic
+                    auto next = data.find(std::string_view(MAGIC, 8), offset + 1);
+                    offset = next == std::string::npos ? data.size() : next;
+                    continue;
+                }
+                _entries[header.Key] = Entry{header.PnL, header.Trades, header.Ticks, header.MaxDrawdown, header.Sharpe,
+                    std::string(error, header.ErrorSize)};
+                offset += sizeof(header) + header.ErrorSize;
+            }
+        }
+
+    private:
+        std::string _path;
+        int _fd = -1;
+        mutable std::mutex _mutex;
+        std::unordered_map<u_int64_t, Entry> _entries;
+        ResultCacheStats _stats;
+    };
+    typedef std::shared_ptr<ResultCache> ResultCachePtr;
+}
@@ -0,0 +1,331 @@
+#pragma once
+
+#include "definitions.h"
+#include "exceptions.hpp"
+
+namespace ArbSimulation
+{
+    template<typename T>
+    class RingBuffer
+    {
+    /*
+    * Fixed-capacity FIFO over storage allocated once in the constructor.
+    * Capacity is rounded up to a power of two so indices wrap with a mask.
+    */
+    public:
+        RingBuffer(size_t capacity)
+        {
+            size_t rounded = 1;
+            while (rounded < std::max<size_t>(1, capacity))
+                rounded <<= 1;
+            _items.resize(rounded);
+            _mask = rounded - 1;
+        }
+
+        inline void PushBack(const T& item)
+        {
+            _items[(_head + _size) & _mask] = item;
+            ++_size;
+        }
+
+        inline void PopFront()
+        {
+            _head = (_head + 1) & _mask;
+            --_size;
+        }
+
+        inline void PopBack()
+        {
+            --_size;
+        }
+
+        inline const T& Front() const
+        {
+            return _items[_head];
+        }
+
+        inline const T& Back() const
+        {
+            return _items[(_head + _size - 1) & _mask];
+        }
+
+        inline const T& operator[](size_t index) const
+        {
+            return _items[(_head + index) & _mask];
+        }
+
+        inline size_t Size() const
+        {
+            return _size;
+        }
+
+        inline bool Empty() const
+        {
+            return _size == 0;
+        }
+
+        inline bool Full() const
+        {
+            return _size == _items.size();
+        }
+
+        inline void Clear()
+        {
+            _head = 0;
+            _size = 0;
+        }
+
+    private:
+        std::vector<T> _items;
+        size_t _mask = 0;
+        size_t _head = 0;
+        size_t _size = 0;
+    };
+
+    struct WindowOptions
+    {
+        size_t Count = 0;                   //keep at most the last Count samples, 0 - no count limit
+        u_int64_t DurationNs = 0;           //keep samples newer than the last timestamp - DurationNs, 0 - no time limit
+        size_t Capacity = 0;                //preallocated samples for time windows, defaults to Count
+    };
+
+    class RollingStats
+    {
+    /*
+    * Mean, variance, min and max over a sliding window of samples in O(1) amortized per sample.
+    * Mean and variance follow Welford's update with removal; min and max keep monotonic deques.
+    * Sums are recomputed from the window once per Capacity removals, so rounding errors do not accumulate.
+    * A time window holding Capacity samples drops the oldest one on overflow (see GetOverflows()).
+    * Nothing is allocated after construction.
+    */
+    public:
+        RollingStats(const WindowOptions& options):
+            _options(options),
+            _samples(_getCapacity(options)),
+            _minimums(_getCapacity(options)),
+            _maximums(_getCapacity(options)),
+            _capacity(_getCapacity(options))
+        {}
+
+        void Add(double value, u_int64_t timestamp = 0)
+        {
+            if (_options.DurationNs > 0)
+                while (!_samples.Empty() && _samples.Front().Timestamp + _options.DurationNs <= timestamp)
+                    _evict();
+            if (_samples.Size() == _capacity)
+            {
+                if (_options.Count == 0)
+                    ++_overflows;
+                _evict();
+            }
+
+            Sample sample{value, timestamp, _sequence++};
+            _samples.PushBack(sample);
+            double delta = value - _mean;
+            _mean += delta / _samples.Size();
+            _m2 += delta * (value - _mean);
+
+            while (!_minimums.Empty() && _minimums.Back().Value >= value)
+                _minimums.PopBack();
+            _minimums.PushBack(sample);
+            while (!_maximums.Empty() && _maximums.Back().Value <= value)
+                _maximums.PopBack();
+            _maximums.PushBack(sample);
+        }
+
+        inline size_t Size() const
+        {
+            return _samples.Size();
+        }
+
+        inline double GetMean() const
+        {
+            return _samples.Empty() ? std::nan("") : _mean;
+        }
+
+        inline double GetVariance() const
+        {
+            //sample variance, NaN below two samples
+            return _samples.Size() < 2 ? std::nan("") : std::max(0.0, _m2) / (_samples.Size() - 1);
+        }
+
+        inline double GetStdDev() const
+        {
+            return std::sqrt(GetVariance());
+        }
+
+        inline double GetMin() const
+        {
+            return _minimums.Empty() ? std::nan("") : _minimums.Front().Value;
+        }
+
+        inline double GetMax() const
+        {
+            return _maximums.Empty() ? std::nan("") : _maximums.Front().Value;
+        }
+
+        inline double GetZScore(double value) const
+        {
+            double deviation = GetStdDev();
+            return deviation > 0 ? (value - _mean) / deviation : std::nan("");
+        }
+
+        inline size_t GetOverflows() const
+        {
+            return _overflows;
+        }
+
+    private:
+        struct Sample
+        {
+            double Value;
+            u_int64_t Timestamp;
+            u_int64_t Sequence;
+        };
+
+        static size_t _getCapacity(const WindowOptions& options)
+        {
+            size_t capacity = options.Count > 0 ? options.Count : options.Capacity;
+            if (options.Count > 0 && options.Capacity > 0)
+                capacity = std::min(options.Count, options.Capacity);
+            if (capacity == 0)
+                throw Exception("Rolling window needs a Count or a Capacity");
+            return capacity;
+        }
+
+        void _evict()
+        {
+            const Sample& oldest = _samples.Front();
+            if (!_minimums.Empty() && _minimums.Front().Sequence == oldest.Sequence)
+                _minimums.PopFront();
+            if (!_maximums.Empty() && _maximums.Front().Sequence == oldest.Sequence)
+                _maximums.PopFront();
+
+            double value = oldest.Value;
+            _samples.PopFront();
+            if (_samples.Empty())
+            {
+                _mean = 0;
+                _m2 = 0;
+            }
+            else if (++_removals >= _capacity)
+                _recompute();
+            else
+            {
+                double delta = value - _mean;
+                _mean -= delta / _samples.Size();
+                _m2 -= delta * (value - _mean);
+            }
+        }
+
+        void _recompute()
+        {
+            _removals = 0;
+            double sum = 0;
+            for (size_t i = 0; i < _samples.Size(); ++i)
+                sum += _samples[i].Value;
+            _mean = sum / _samples.Size();
+            _m2 = 0;
+            for (size_t i = 0; i < _samples.Size(); ++i)
+                _m2 += (_samples[i].Value - _mean) * (_samples[i].Value - _mean);
+        }
+
+    private:
+        WindowOptions _options;
+        RingBuffer<Sample> _samples;
+        RingBuffer<Sample> _minimums;
+        RingBuffer<Sample> _maximums;
+        size_t _capacity;
+        u_int64_t _sequence = 0;
+        size_t _removals = 0;
+        size_t _overflows = 0;
+        double _mean = 0;
+        double _m2 = 0;
+    };
+
+    class Ewma
+    {
+    /*
+    * Exponentially weighted mean and variance.
+    * With a half-life the weight of a sample halves every halfLifeNs of market time (irregular ticks are handled),
+    * otherwise every new sample gets the fixed weight alpha.
+    */
+    public:
+        static Ewma FromAlpha(double alpha)
+        {
+            if (alpha <= 0 || alpha > 1)
+                throw Exception("EWMA alpha must be in (0, 1]");
+            Ewma ewma;
+            ewma._alpha = alpha;
+            return ewma;
+        }
+
+        static Ewma FromHalfLife(u_int64_t halfLifeNs)
+        {
+            if (halfLifeNs == 0)
+                throw Exception("EWMA half-life must be positive");
+            Ewma ewma;
+            ewma._decayPerNs = std::log(2.0) / halfLifeNs;
+            return ewma;
+        }
+
+        void Add(double value, u_int64_t timestamp = 0)
+        {
+            double alpha = _alpha;
+            if (_decayPerNs > 0)
+            {
+                //alpha is the share of the new sample in the decayed total weight, so samples sharing a timestamp are averaged
+                double elapsed = _count > 0 && timestamp > _lastTimestamp ? double(timestamp - _lastTimestamp) : 0;
+                _weight = _weight * std::exp(-_decayPerNs * elapsed) + 1;
+                alpha = 1 / _weight;
+                _lastTimestamp = std::max(_lastTimestamp, timestamp);
+            }
+            if (_count++ == 0)
+            {
+                _mean = value;
+                _variance = 0;
+                return;
+            }
+            double delta = value - _mean;
+            _mean += alpha * delta;
+            _variance = (1 - alpha) * (_variance + alpha * delta * delta);
+        }
+
+        inline size_t Size() const
+        {
+            return _count;
+        }
+
+        inline double GetMean() const
+        {
+            return _count == 0 ? std::nan("") : _mean;
+        }
+
+        inline double GetVariance() const
+        {
+            return _count < 2 ? std::nan("") : _variance;
+        }
+
+        inline double GetStdDev() const
+        {
+            return std::sqrt(GetVariance());
+        }
+
+        inline double GetZScore(double value) const
+        {
+            double deviation = GetStdDev();
+            return deviation > 0 ? (value - _mean) / deviation : std::nan("");
+        }
+
+    private:
+        Ewma() = default;
+
+        double _alpha = 0;
+        double _decayPerNs = 0;
+        double _weight = 0;
+        u_int64_t _lastTimestamp = 0;
+        size_t _count = 0;
+        double _mean = 0;
+        double _variance = 0;
+    };
+}
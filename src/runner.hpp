@@ -0,0 +1,555 @@
+#pragma once
+
+#include <functional>
+
+#include "arbitrage.hpp"
+#include "threading.hpp"
+
+namespace ArbSimulation
+{
+    struct RunParameters
+    {
+        double X = 0;
+        double Y = 0;
+        double Z = 0;
+        std::unordered_map<std::string, u_int64_t> Latencies;
+        LatencyModelPtr StochasticLatencies;                //optional, overrides Latencies for the instruments it covers
+        u_int64_t Seed = 0;
+        u_int64_t Replication = 0;                          //RNG stream, one per Monte Carlo replication
+        ConflationSchedulePtr Conflation;                   //optional, shared by all runs over the store
+        double ComputeTimeScale = 0;                        //> 0 delays orders by the measured strategy compute time times this
+        SignalOptions Signal;                               //entry signal, absolute spreads by default
+        ReplayPathPtr Path;                                 //optional, e.g. a bootstrap path, replaces the store order
+        u_int64_t AnalyticsBucketNs = 0;                    //> 0 - the run tracks its max drawdown and Sharpe ratio per bucket
+    };
+
+    struct RunResult
+    {
+        RunParameters Parameters;
+        double PnL = 0;
+        size_t Trades = 0;
+        size_t Ticks = 0;
+        std::string Error;
+        double MaxDrawdown = 0;                             //with RunParameters::AnalyticsBucketNs only
+        double Sharpe = 0;                                  //per bucket, with RunParameters::AnalyticsBucketNs only
+    };
+
+    //replays a batch of runs, results in batch order
+    typedef std::function<std::vector<RunResult>(const std::vector<RunParameters>&)> RunBatch;
+    //returns the results of a batch, replaying with the RunBatch only the runs it cannot answer itself, e.g. ResultCache::MakeMemo
+    typedef std::function<std::vector<RunResult>(const std::vector<RunParameters>&, const RunBatch&)> RunMemo;
+
+    class SimulationRun
+    {
+    /*
+    * One ArbitrageStrategy replay over a shared, read-only TickStore.
+    * Owns its own instruments, matcher and positions, so runs are independent and can live on different threads.
+    * Their hot state (order queues, orders, trades, book updates) is allocated from the run's own Arena.
+    */
+    public:
+        SimulationRun() = delete;
+        SimulationRun(SimulationRun&) = delete;
+        SimulationRun(const SimulationRun&) = delete;
+        SimulationRun(SimulationRun&&) = delete;
+
+        SimulationRun(TickStorePtr store, const RunParameters& parameters): _arena(std::make_shared<Arena>()), _parameters(parameters)
+        {
+            ArenaScope scope(_arena);
+            auto instrManager = std::make_shared<InstrumentManager>();
+            _marketDataManager = std::make_shared<MarketDataSimulationManager>(instrManager, store);
+            if (parameters.Conflation)
+                _marketDataManager->EnableConflation(parameters.Conflation);
+            if (parameters.Path)
+                _marketDataManager->EnablePath(parameters.Path);
+            _orderMatcher = std::make_shared<OrderMatcher>(parameters.Latencies);
+            if (parameters.StochasticLatencies)
+                _orderMatcher->SetLatencyModel(parameters.StochasticLatencies, parameters.Seed, parameters.Replication);
+            _strategy = std::make_shared<ArbitrageStrategy>(parameters.X, parameters.Y, parameters.Z, instrManager, parameters.Signal);
+            if (parameters.Conflation && _strategy->SamplesEveryUpdate())
+                throw Exception("Conflation drops updates which the ZScore and Ewma signals sample, use it with the Absolute signal");
+            if (parameters.ComputeTimeScale > 0)
+                _strategy->EnableComputeLatency(parameters.ComputeTimeScale);
+            if (parameters.AnalyticsBucketNs > 0)
+            {
+                //statistics only, equity samples are not kept
+                _analytics = std::make_shared<PerformanceAnalytics>(parameters.AnalyticsBucketNs, 0);
+                _strategy->EnableAnalytics(_analytics);
+            }
+
+            _strategy->AddSubscriber(_orderMatcher);
+            _orderMatcher->AddSubscriber(_strategy);
+            _marketDataManager->AddSubscriber(_orderMatcher);
+            _marketDataManager->AddSubscriber(_strategy);
+            if (parameters.Conflation && parameters.Conflation->GetOptions().SuppressUnchangedPrices)
+            {
+                _strategy->AddSubscriber(_marketDataManager);
+                _orderMatcher->AddSubscriber(_marketDataManager);
+            }
+        }
+
+        ~SimulationRun()
+        {
+            //the strategy may outlive the run (GetStrategy), the rest of the run and its arena are released
+            _strategy->ClearSubscribers();
+            _orderMatcher->ClearSubscribers();
+            _marketDataManager->ClearSubscribers();
+        }
+
+        inline bool Step()
+        {
+            if (!_marketDataManager->Step())
+                return false;
+            ++_ticks;
+            return true;
+        }
+
+        RunResult Run()
+        {
+            RunUntil(std::numeric_limits<size_t>::max());
+            if (_analytics)
+                _analytics->Finish();
+            return GetResult();
+        }
+
+        bool RunUntil(size_t ticks, bool stopWhenFinished = false)
+        {
+            /*
+            * Replays until `ticks` updates have been dispatched in total, the run can be resumed afterwards.
+            * Returns false once the replay is over: the data ended, the strategy failed
+            * or, with stopWhenFinished, the strategy can no longer change its PnL (see ArbitrageStrategy::IsFinished).
+            */
+            ArenaScope scope(_arena);
+            try
+            {
+                while (_ticks < ticks)
+                {
+                    if (stopWhenFinished && _strategy->IsFinished())
+                        return false;
+                    if (!Step())
+                        return false;
+                }
+            }
+            catch(StrategyException& ex)
+            {
+                _error = ex.what();
+                return false;
+            }
+            return !(stopWhenFinished && _strategy->IsFinished());
+        }
+
+        inline size_t GetTicks() const
+        {
+            return _ticks;
+        }
+
+        RunResult GetResult()
+        {
+            RunResult result;
+            result.Parameters = _parameters;
+            result.PnL = _strategy->GetFullPnL();
+            result.Trades = _strategy->GetTrades().size();
+            result.Ticks = _ticks;
+            result.Error = _error;
+            if (_analytics)
+            {
+                result.MaxDrawdown = _analytics->GetMaxDrawdown();
+                result.Sharpe = _analytics->GetSharpe();
+            }
+            return result;
+        }
+
+        inline ConflationStats GetConflationStats() const
+        {
+            return _marketDataManager->GetConflationStats();
+        }
+
+        inline std::shared_ptr<ArbitrageStrategy> GetStrategy() const
+        {
+            return _strategy;
+        }
+
+        inline const ArenaStats& GetArenaStats() const
+        {
+            return _arena->GetStats();
+        }
+
+    private:
+        ArenaPtr _arena;
+        RunParameters _parameters;
+        std::shared_ptr<MarketDataSimulationManager> _marketDataManager;
+        std::shared_ptr<OrderMatcher> _orderMatcher;
+        std::shared_ptr<ArbitrageStrategy> _strategy;
+        PerformanceAnalyticsPtr _analytics;
+        size_t _ticks = 0;
+        std::string _error;
+    };
+
+    struct ApproximateSweepResult
+    {
+        std::vector<RunResult> Results;                     //approximate, in grid order
+        std::vector<size_t> Checked;                        //grid indices replayed exactly as well
+        std::vector<RunResult> Exact;                       //exact results of Checked
+        size_t Best = 0;                                    //best approximate point (see SweepRunner::FindBest), always among Checked
+        u_int64_t ApproximateTicks = 0;
+        u_int64_t ExactTicks = 0;
+        u_int64_t FullGridTicks = 0;                        //estimate of an exact sweep: grid size times the mean exact run
+        double MeanAbsError = 0;                            //|approximate - exact| PnL over Checked
+        double MaxAbsError = 0;
+        double RmsError = 0;
+        double MeanAbsExactPnL = 0;
+
+        inline double GetSpeedup() const
+        {
+            u_int64_t replayed = ApproximateTicks + ExactTicks;
+            return replayed > 0 ? double(FullGridTicks) / replayed : 0;
+        }
+
+        inline double GetRelativeError() const
+        {
+            return MeanAbsExactPnL > 0 ? MeanAbsError / MeanAbsExactPnL : 0;
+        }
+    };
+
+    class SweepRunner
+    {
+    /*
+    * Runs a parameter grid in parallel over one shared TickStore
+    */
+    public:
+        SweepRunner(TickStorePtr store, size_t threads): _store(store), _threads(threads)
+        {}
+
+        static std::vector<RunParameters> MakeGrid(const std::vector<double>& xs, const std::vector<double>& ys, const std::vector<double>& zs,
+            const std::unordered_map<std::string, u_int64_t>& latencies)
+        {
+            std::vector<RunParameters> grid;
+            for (double x: xs)
+                for (double y: ys)
+                    for (double z: zs)
+                        grid.push_back(RunParameters{x, y, z, latencies});
+            return grid;
+        }
+
+        static size_t FindBest(const std::vector<RunResult>& results)
+        {
+            //index of the highest PnL among runs without an error (a failed run stopped early), of all runs if every one failed
+            return std::max_element(results.begin(), results.end(),
+                [](auto& a, auto& b){ return a.Error.empty() < b.Error.empty() || (a.Error.empty() == b.Error.empty() && a.PnL < b.PnL); })
+                - results.begin();
+        }
+
+        void SetMemo(RunMemo memo)
+        {
+            //runs (exact and decimated ones) are looked up in the memo before they are replayed
+            _memo = std::move(memo);
+        }
+
+        std::vector<RunResult> Run(const std::vector<RunParameters>& grid)
+        {
+            if (_memo)
+                return _memo(grid, [this](const std::vector<RunParameters>& batch){ return _replay(batch); });
+            return _replay(grid);
+        }
+
+        ApproximateSweepResult RunApproximate(const std::vector<RunParameters>& grid, ConflationSchedulePtr decimation, size_t exactEvery)
+        {
+            /*
+            * Replays every point over the decimated schedule (see ConflationOptions::BucketNs) and every exactEvery-th point
+            * also with its own parameters, to measure the PnL error of the approximation; 0 - no point but the best is checked.
+            * The best approximate point is always replayed exactly, so the reported best PnL is exact.
+            * Points must not set their own Conflation, the decimated schedule would replace it.
+            */
+            for (auto& parameters: grid)
+                if (parameters.Conflation)
+                    throw Exception("Approximate sweeps replay their own decimated schedule, points must not set Conflation");
+            ApproximateSweepResult result;
+            result.Results.resize(grid.size());
+            if (grid.empty())
+                return result;
+            for (size_t index = 0; exactEvery > 0 && index < grid.size(); index += exactEvery)
+                result.Checked.push_back(index);
+            result.Exact.resize(result.Checked.size());
+
+            //one batch: exact runs are the longest, they start first
+            std::vector<RunParameters> batch;
+            for (size_t index: result.Checked)
+                batch.push_back(grid[index]);
+            for (auto& parameters: grid)
+            {
+                batch.push_back(parameters);
+                batch.back().Conflation = decimation;
+            }
+            auto runs = Run(batch);
+            std::move(runs.begin(), runs.begin() + result.Checked.size(), result.Exact.begin());
+            for (size_t index = 0; index < grid.size(); ++index)
+            {
+                result.Results[index] = std::move(runs[result.Checked.size() + index]);
+                result.Results[index].Parameters = grid[index];
+            }
+
+            result.Best = FindBest(result.Results);
+            if (std::find(result.Checked.begin(), result.Checked.end(), result.Best) == result.Checked.end())
+            {
+                result.Checked.push_back(result.Best);
+                result.Exact.push_back(Run({grid[result.Best]}).front());
+            }
+
+            for (auto& approximate: result.Results)
+                result.ApproximateTicks += approximate.Ticks;
+            for (size_t i = 0; i < result.Checked.size(); ++i)
+            {
+                auto& exact = result.Exact[i];
+                double error = std::abs(result.Results[result.Checked[i]].PnL - exact.PnL);
+                result.ExactTicks += exact.Ticks;
+                result.MeanAbsError += error / result.Checked.size();
+                result.MaxAbsError = std::max(result.MaxAbsError, error);
+                result.RmsError += error * error / result.Checked.size();
+                result.MeanAbsExactPnL += std::abs(exact.PnL) / result.Checked.size();
+            }
+            result.RmsError = std::sqrt(result.RmsError);
+            result.FullGridTicks = grid.size() * (result.ExactTicks / result.Checked.size());
+            return result;
+        }
+
+        static std::vector<std::vector<std::string>> ToReport(const ApproximateSweepResult& result)
+        {
+            std::vector<std::vector<std::string>> lines{{"X", "Y", "Z", "PnL", "Trades", "Error", "ExactPnL"}};
+            for (size_t index = 0; index < result.Results.size(); ++index)
+            {
+                auto& approximate = result.Results[index];
+                auto checked = std::find(result.Checked.begin(), result.Checked.end(), index);
+                lines.push_back({
+                    std::to_string(approximate.Parameters.X),
+                    std::to_string(approximate.Parameters.Y),
+                    std::to_string(approximate.Parameters.Z),
+                    std::to_string(approximate.PnL),
+                    std::to_string(approximate.Trades),
+                    approximate.Error,
+                    checked == result.Checked.end() ? "" : std::to_string(result.Exact[checked - result.Checked.begin()].PnL)});
+            }
+            return lines;
+        }
+
+        static std::vector<std::vector<std::string>> ToReport(const std::vector<RunResult>& results)
+        {
+            //drawdown and Sharpe columns are added when the runs tracked them
+            bool analytics = !results.empty() && results.front().Parameters.AnalyticsBucketNs > 0;
+            std::vector<std::vector<std::string>> lines{{"X", "Y", "Z", "PnL", "Trades", "Error"}};
+            if (analytics)
+                lines.front().insert(lines.front().end(), {"MaxDrawdown", "Sharpe"});
+            for (auto& result: results)
+            {
+                lines.push_back({
+                    std::to_string(result.Parameters.X),
+                    std::to_string(result.Parameters.Y),
+                    std::to_string(result.Parameters.Z),
+                    std::to_string(result.PnL),
+                    std::to_string(result.Trades),
+                    result.Error});
+                if (analytics)
+                    lines.back().insert(lines.back().end(), {std::to_string(result.MaxDrawdown), std::to_string(result.Sharpe)});
+            }
+            return lines;
+        }
+
+    private:
+        std::vector<RunResult> _replay(const std::vector<RunParameters>& grid)
+        {
+            std::vector<RunResult> results(grid.size());
+            ParallelFor(grid.size(), _threads, [&](size_t index, size_t worker)
+            {
+                ARBSIM_PERF_THREAD("sweep worker " + std::to_string(worker));
+                SimulationRun run(_store, grid[index]);
+                results[index] = run.Run();
+            });
+            return results;
+        }
+
+    private:
+        TickStorePtr _store;
+        size_t _threads;
+        RunMemo _memo;
+    };
+
+    class MonteCarloRunner
+    {
+    /*
+    * Runs N replications of one parameter set with stochastic latencies in parallel over one shared TickStore.
+    * Replication i draws from the counter-based stream (Seed, i), so results do not depend on the number of threads.
+    */
+    public:
+        MonteCarloRunner(TickStorePtr store, size_t threads): _store(store), _threads(threads)
+        {}
+
+        std::vector<RunResult> Run(const RunParameters& parameters, size_t replications)
+        {
+            return Run(MakeReplications(parameters, replications));
+        }
+
+        std::vector<RunResult> Run(const std::vector<RunParameters>& replications)
+        {
+            std::vector<RunResult> results(replications.size());
+            ParallelFor(replications.size(), _threads, [&](size_t index, size_t worker)
+            {
+                SimulationRun run(_store, replications[index]);
+                results[index] = run.Run();
+            });
+            return results;
+        }
+
+        static std::vector<RunParameters> MakeReplications(const RunParameters& parameters, size_t replications)
+        {
+            std::vector<RunParameters> result(replications, parameters);
+            for (size_t index = 0; index < replications; ++index)
+                result[index].Replication = index;
+            return result;
+        }
+
+        static std::vector<double> Quantiles(std::vector<double> values, const std::vector<double>& levels)
+        {
+            //linear interpolation between order statistics
+            std::vector<double> quantiles;
+            if (values.empty())
+                return quantiles;
+            std::sort(values.begin(), values.end());
+            for (double level: levels)
+            {
+                double position = std::clamp(level, 0.0, 1.0) * (values.size() - 1);
+                size_t lower = size_t(position);
+                size_t upper = std::min(lower + 1, values.size() - 1);
+                quantiles.push_back(values[lower] + (values[upper] - values[lower]) * (position - lower));
+            }
+            return quantiles;
+        }
+
+        static std::vector<std::vector<std::string>> ToReport(const std::vector<RunResult>& results)
+        {
+            std::vector<std::vector<std::string>> lines{{"Replication", "Seed", "PnL", "Trades", "Error"}};
+            for (auto& result: results)
+                lines.push_back({
+                    std::to_string(result.Parameters.Replication),
+                    std::to_string(result.Parameters.Seed),
+                    std::to_string(result.PnL),
+                    std::to_string(result.Trades),
+                    result.Error});
+            return lines;
+        }
+
+        static std::vector<std::vector<std::string>> ToQuantileReport(const std::vector<RunResult>& results, const std::vector<double>& levels)
+        {
+            std::vector<double> pnls;
+            for (auto& result: results)
+                pnls.push_back(result.PnL);
+            auto quantiles = Quantiles(pnls, levels);
+
+            std::vector<std::vector<std::string>> lines{{"Quantile", "PnL"}};
+            for (size_t i = 0; i < quantiles.size(); ++i)
+                lines.push_back({std::to_string(levels[i]), std::to_string(quantiles[i])});
+            return lines;
+        }
+
+    private:
+        TickStorePtr _store;
+        size_t _threads;
+    };
+
+    struct BootstrapOptions
+    {
+        u_int64_t BlockNs = 60000000000ull;
+        size_t Paths = 100;
+        u_int64_t Seed = 0;
+        bool RebasePrices = true;                           //see BootstrapBlocks
+    };
+
+    struct BootstrapResult
+    {
+        size_t Path = 0;
+        double PnL = 0;
+        double MaxDrawdown = 0;
+        size_t Trades = 0;
+        std::string Error;
+    };
+
+    class BootstrapRunner
+    {
+    /*
+    * Replays N block-bootstrap paths of one parameter set in parallel over one shared TickStore.
+    * Blocks are found once; a path is a list of index ranges into the store, so ticks are never copied per path.
+    * Path i is drawn from the counter-based stream (Seed, i), results do not depend on the number of threads.
+    */
+    public:
+        BootstrapRunner(TickStorePtr store, size_t threads): _store(store), _threads(threads)
+        {}
+
+        void SetMemo(RunMemo memo)
+        {
+            //paths are looked up by their block order (ReplayPath::Key) before they are replayed
+            _memo = std::move(memo);
+        }
+
+        std::vector<BootstrapResult> Run(const RunParameters& parameters, const BootstrapOptions& options)
+        {
+            if (parameters.Conflation)
+                throw Exception("Bootstrap does not support conflation");
+            auto blocks = std::make_shared<const BootstrapBlocks>(*_store, options.BlockNs);
+            //paths are small (a segment per block), the records stay in the store
+            std::vector<RunParameters> paths(options.Paths, parameters);
+            for (size_t index = 0; index < paths.size(); ++index)
+            {
+                paths[index].Path = blocks->Resample(options.Seed, index, options.RebasePrices);
+                paths[index].AnalyticsBucketNs = options.BlockNs;
+            }
+            auto replay = [this](const std::vector<RunParameters>& batch)
+            {
+                std::vector<RunResult> runs(batch.size());
+                ParallelFor(batch.size(), _threads, [&](size_t index, size_t worker)
+                {
+                    runs[index] = SimulationRun(_store, batch[index]).Run();
+                });
+                return runs;
+            };
+            auto runs = _memo ? _memo(paths, replay) : replay(paths);
+
+            std::vector<BootstrapResult> results(runs.size());
+            for (size_t index = 0; index < runs.size(); ++index)
+                results[index] = BootstrapResult{index, runs[index].PnL, runs[index].MaxDrawdown, runs[index].Trades, runs[index].Error};
+            return results;
+        }
+
+        static std::vector<std::vector<std::string>> ToReport(const std::vector<BootstrapResult>& results)
+        {
+            std::vector<std::vector<std::string>> lines{{"Path", "PnL", "MaxDrawdown", "Trades", "Error"}};
+            for (auto& result: results)
+                lines.push_back({
+                    std::to_string(result.Path),
+                    std::to_string(result.PnL),
+                    std::to_string(result.MaxDrawdown),
+                    std::to_string(result.Trades),
+                    result.Error});
+            return lines;
+        }
+
+        static std::vector<std::vector<std::string>> ToQuantileReport(const std::vector<BootstrapResult>& results, const std::vector<double>& levels)
+        {
+            std::vector<double> pnls;
+            std::vector<double> drawdowns;
+            for (auto& result: results)
+            {
+                pnls.push_back(result.PnL);
+                drawdowns.push_back(result.MaxDrawdown);
+            }
+            auto pnlQuantiles = MonteCarloRunner::Quantiles(pnls, levels);
+            auto drawdownQuantiles = MonteCarloRunner::Quantiles(drawdowns, levels);
+
+            std::vector<std::vector<std::string>> lines{{"Quantile", "PnL", "MaxDrawdown"}};
+            for (size_t i = 0; i < pnlQuantiles.size(); ++i)
+                lines.push_back({std::to_string(levels[i]), std::to_string(pnlQuantiles[i]), std::to_string(drawdownQuantiles[i])});
+            return lines;
+        }
+
+    private:
+        TickStorePtr _store;
+        size_t _threads;
+        RunMemo _memo;
+    };
+}
\ No newline at end of file
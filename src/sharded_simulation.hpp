@@ -0,0 +1,289 @@
+#pragma once
+
+#include <exception>
+
+#include "spsc_queue.hpp"
+#include "strategy_base.hpp"
+#include "threading.hpp"
+
+namespace ArbSimulation
+{
+    class ShardedSimulation
+    {
+    /*
+    * Conservative parallel replay.
+    * Instruments are split between shards, each shard thread materializes its own updates and runs its own OrderMatcher.
+    * The calling thread drives the strategy in the global tick order and routes orders back to the shards.
+    *
+    * A shard may process its tick k when either every earlier tick is done (so every order that can precede k is queued),
+    * or when ts(k) <= ts(next tick of the strategy) + latency: an order sent later cannot be filled by tick k.
+    * Fills and updates are delivered to the strategy in the same order as the sequential chain,
+    * so results are identical to it.
+    */
+    public:
+        ShardedSimulation() = delete;
+        ShardedSimulation(ShardedSimulation&) = delete;
+        ShardedSimulation(const ShardedSimulation&) = delete;
+        ShardedSimulation(ShardedSimulation&&) = delete;
+
+        ShardedSimulation(std::shared_ptr<InstrumentManager> instrManager, TickStorePtr store, std::shared_ptr<BasicStrategy> strategy,
+            const std::unordered_map<std::string, u_int64_t>& latencies, size_t shards):
+            _store(store), _strategy(strategy)
+        {
+            //shards fill orders ahead of the strategy by the lookahead, which a measured compute delay would exceed
+            if (strategy->GetComputeTimeScale() > 0)
+                throw Exception("Compute latency is not supported by ShardedSimulation");
+            auto& securityIds = _store->GetSecurityIds();
+            shards = std::max<size_t>(1, std::min(shards, securityIds.size()));
+            for (size_t i = 0; i < shards; ++i)
+                _shards.push_back(std::make_unique<Shard>(*this, latencies));
+
+            for (u_int32_t id = 0; id < securityIds.size(); ++id)
+            {
+                auto& shard = *_shards[id % shards];
+                auto latency = latencies.find(securityIds[id]);
+                u_int64_t lookahead = latency != latencies.end() ? latency->second : 0;
+                shard.Lookahead = shard.Instruments.empty() ? lookahead : std::min(shard.Lookahead, lookahead);
+                shard.Instruments.push_back(id);
+                _instruments.push_back(instrManager->GetOrCreateInstrument(securityIds[id]));
+                _shardOf.push_back(id % shards);
+                _shardBySecurityId[securityIds[id]] = id % shards;
+            }
+            for (size_t i = 0; i < _store->Size(); ++i)
+                _shards[_shardOf[(*_store)[i].InstrumentId]]->Ticks.push_back(i);
+
+            _router = std::make_shared<OrderRouter>(*this);
+            _strategy->AddSubscriber(_router);
+        }
+
+        ~ShardedSimulation()
+        {
+            //the strategy may outlive the simulation, its router refers to it; other subscribers of the strategy are kept
+            _strategy->RemoveSubscriber(_router);
+        }
+
+        void Run()
+        {
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < _shards.size(); ++i)
+                threads.emplace_back([this, i](){ _shards[i]->Run(i + 1); });
+
+            std::exception_ptr error;
+            try
+            {
+                _coordinate();
+            }
+            catch(...)
+            {
+                error = std::current_exception();
+                _abort.store(true);
+            }
+            for (auto& thread: threads)
+                thread.join();
+
+            if (error)
+                std::rethrow_exception(error);
+            for (auto& shard: _shards)
+                if (shard->Error)
+                    std::rethrow_exception(shard->Error);
+        }
+
+        inline size_t GetShardsCount() const
+        {
+            return _shards.size();
+        }
+
+    private:
+        struct Event
+        {
+            size_t Sequence;
+            MessagePtr Message;
+        };
+
+        class Shard;
+
+        class FillCollector: public Subscriber
+        {
+        public:
+            FillCollector(Shard& shard): _shard(shard)
+            {}
+
+            void OnNewMessage(MessagePtr message) override
+            {
+                _shard.Push(message);
+            }
+
+        private:
+            Shard& _shard;
+        };
+
+        class Shard
+        {
+        public:
+            static constexpr size_t ORDER_QUEUE_SIZE = 1 << 12;
+            static constexpr size_t EVENT_QUEUE_SIZE = 1 << 14;
+
+            Shard(ShardedSimulation& owner, const std::unordered_map<std::string, u_int64_t>& latencies):
+                Matcher(std::make_shared<OrderMatcher>(latencies)), Orders(ORDER_QUEUE_SIZE), Events(EVENT_QUEUE_SIZE), _owner(owner)
+            {
+                Matcher->AddSubscriber(std::make_shared<FillCollector>(*this));
+            }
+
+            void Run(size_t core)
+            {
+                PinCurrentThread(core);
+                try
+                {
+                    for (size_t index: Ticks)
+                    {
+                        if (!_waitForPermission(index))
+                            break;
+                        _sequence = index;
+                        auto& record = (*_owner._store)[index];
+                        auto message = std::make_shared<MDUpdateMessage>();
+                        auto update = std::make_shared<L1Update>();
+                        update->Timestamp = record.Timestamp;
+                        update->Instrument = _owner._instruments[record.InstrumentId];
+                        update->BidSize = record.BidSize;
+                        update->BidPrice = record.BidPrice;
+                        update->AskPrice = record.AskPrice;
+                        update->AskSize = record.AskSize;
+                        message->Update = update;
+                        Matcher->ProcessL1Update(update);
+                        Push(message);
+                    }
+                }
+                catch(...)
+                {
+                    Error = std::current_exception();
+                    _owner._abort.store(true);
+                }
+                Finished.store(true, std::memory_order_release);
+            }
+
+            void Push(MessagePtr message)
+            {
+                Backoff backoff;
+                while (!Events.TryPush(Event{_sequence, message}))
+                {
+                    //keep draining orders, otherwise the coordinator may block on a full order queue
+                    _drainOrders();
+                    if (_owner._abort.load(std::memory_order_relaxed))
+                        throw Exception("Simulation is aborted");
+                    backoff.Pause();
+                }
+            }
+
+        public:
+            std::vector<u_int32_t> Instruments;
+            std::vector<size_t> Ticks;
+            u_int64_t Lookahead = 0;
+            std::shared_ptr<OrderMatcher> Matcher;
+            SPSCQueue<OrderPtr> Orders;
+            SPSCQueue<Event> Events;
+            std::exception_ptr Error;
+            std::atomic<bool> Finished{false};              //no more updates and no more orders are drained
+
+        private:
+            bool _waitForPermission(size_t index)
+            {
+                Backoff backoff;
+                u_int64_t timestamp = (*_owner._store)[index].Timestamp;
+                while (true)
+                {
+                    //orders of every completed tick are published before _done, so drain after reading it
+                    size_t done = _owner._done.load(std::memory_order_acquire);
+                    _drainOrders();
+                    if (index <= done || timestamp <= (*_owner._store)[done].Timestamp + Lookahead)
+                        return true;
+                    if (_owner._abort.load(std::memory_order_relaxed))
+                        return false;
+                    backoff.Pause();
+                }
+            }
+
+            inline void _drainOrders()
+            {
+                OrderPtr order;
+                while (Orders.TryPop(order))
+                    Matcher->EnqueueOrder(order);
+            }
+
+        private:
+            ShardedSimulation& _owner;
+            size_t _sequence = 0;
+        };
+
+        class OrderRouter: public Subscriber
+        {
+        public:
+            OrderRouter(ShardedSimulation& owner): _owner(owner)
+            {}
+
+            void OnNewMessage(MessagePtr message) override
+            {
+                if (message->Type != MessageType::NewOrder)
+                    throw MessagingError("Unexpected MessageType");
+                auto& order = std::static_pointer_cast<NewOrderMessage>(message)->Order;
+                order->SentTimestamp = _owner._currentTimestamp + order->ComputeDelay;
+
+                auto iter = _owner._shardBySecurityId.find(order->Instrument->SecurityId);
+                auto& shard = *_owner._shards[iter != _owner._shardBySecurityId.end() ? iter->second : 0];
+                Backoff backoff;
+                while (!shard.Orders.TryPush(order))
+                {
+                    //the shard has replayed the last update of the instrument: like in the sequential chain the order is never filled
+                    if (shard.Finished.load(std::memory_order_acquire))
+                        return;
+                    if (_owner._abort.load(std::memory_order_relaxed))
+                        throw Exception("Simulation is aborted");
+                    backoff.Pause();
+                }
+            }
+
+        private:
+            ShardedSimulation& _owner;
+        };
+
+        void _coordinate()
+        {
+            Backoff backoff;
+            Event event;
+            for (size_t index = 0; index < _store->Size(); ++index)
+            {
+                auto& record = (*_store)[index];
+                auto& shard = *_shards[_shardOf[record.InstrumentId]];
+                _currentTimestamp = record.Timestamp;
+                while (true)
+                {
+                    if (!shard.Events.TryPop(event))
+                    {
+                        if (_abort.load(std::memory_order_relaxed))
+                            return;
+                        backoff.Pause();
+                        continue;
+                    }
+                    backoff.Reset();
+                    if (event.Sequence != index)
+                        throw MessagingError("Shard is out of sync");
+                    _strategy->OnNewMessage(event.Message);
+                    if (event.Message->Type == MessageType::L1Update)
+                        break;
+                }
+                _done.store(index + 1, std::memory_order_release);
+            }
+        }
+
+    private:
+        TickStorePtr _store;
+        std::shared_ptr<BasicStrategy> _strategy;
+        std::shared_ptr<Subscriber> _router;
+        std::vector<std::unique_ptr<Shard>> _shards;
+        std::vector<InstrumentPtr> _instruments;
+        std::vector<size_t> _shardOf;
+        std::unordered_map<std::string, size_t> _shardBySecurityId;
+        u_int64_t _currentTimestamp = 0;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> _done{0};
+        alignas(CACHE_LINE_SIZE) std::atomic<bool> _abort{false};
+    };
+}
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "bootstrap.hpp"
+#include "conflation.hpp"
+#include "latency.hpp"
 #include "observer.hpp"
-#include "csv_io.hpp"
+#include "tick_store.hpp"
 
 namespace ArbSimulation
 {
@@ -15,73 +18,248 @@ namespace ArbSimulation
             {
                 auto result = std::make_shared<Instrument>();
                 result -> SecurityId = securityId;
+                result -> Id = _securityIds.size();
                 _instruments[securityId] = result;
+                _securityIds.push_back(securityId);
                 return result;
             }
             return iter->second;
         }
 
+        inline const std::vector<std::string>& GetSecurityIds() const
+        {
+            //indexed by Instrument::Id
+            return _securityIds;
+        }
+
     private:
         std::unordered_map<std::string, InstrumentPtr> _instruments;
+        std::vector<std::string> _securityIds;
     };
 
-    class MarketDataSimulationManager: public Publisher
+    class MarketDataSimulationManager: public Publisher, public Subscriber
     {
     public:
+        static constexpr size_t UPDATE_POOL_SIZE = 4;
+
         MarketDataSimulationManager();
         MarketDataSimulationManager(MarketDataSimulationManager&&) = delete;
         MarketDataSimulationManager(MarketDataSimulationManager&) = delete;
         MarketDataSimulationManager(const MarketDataSimulationManager&) = delete;
         MarketDataSimulationManager(std::shared_ptr<InstrumentManager> instrManager, std::vector<std::string> paths):
-        _instrumentManager(instrManager)
+            MarketDataSimulationManager(instrManager, TickStore::FromFiles(paths))
         {
-            for (auto& path: paths)
-                _loadData(path);
-            _sortData();
+        }
+
+        MarketDataSimulationManager(std::shared_ptr<InstrumentManager> instrManager, TickStorePtr store):
+        _instrumentManager(instrManager), _store(store)
+        {
+            for (auto& securityId: _store->GetSecurityIds())
+                _instruments.push_back(_instrumentManager->GetOrCreateInstrument(securityId));
+            _updatePools.resize(_instruments.size());
         }
 
         bool Step()
         {
-            if (_cursor < _data.size())
+            if (_conflation)
+                return _stepConflated();
+            if (_path)
+                return _stepPath();
+            if (_cursor < _store->Size())
             {
-                auto message = std::make_shared<MDUpdateMessage>();
-                message->Update = _data[_cursor];
+                _dispatch((*_store)[_cursor]);
                 ++_cursor;
-                SendMessage(message);
                 return true;
             }
             return false;
         }
 
+        void OnNewMessage(MessagePtr message)
+        {
+            //order flow is observed only to know when unchanged prices can be skipped safely
+            switch(message->Type)
+            {
+                case MessageType::NewOrder:
+                {
+                    ++_outstandingOrders;
+                    break;
+                }
+                case MessageType::OrderFilled:
+                {
+                    --_outstandingOrders;
+                    ++_version;
+                    break;
+                }
+                default:
+                    throw MessagingError("Unexpected MessageType");
+            }
+        }
+
+        void EnableConflation(ConflationSchedulePtr schedule)
+        {
+            /*
+            * Schedule must be built over the same store, replay then dispatches only the scheduled records.
+            * Suppressing unchanged prices also requires the manager to subscribe to the strategy and the matcher:
+            * an update is skipped only when no order is outstanding and nothing was dispatched or filled since
+            * the previous update of the instrument, so fills happen on the same updates and the strategy
+            * would see exactly the prices, positions and fills it has already acted on.
+            */
+            if (_cursor != 0 || _path)
+                throw Exception("Conflation must be enabled before the replay starts and without a replay path");
+            _conflation = schedule;
+            _lastDispatched.assign(_instruments.size(), DispatchedState{std::nan(""), std::nan(""), 0});
+            _unchanged = 0;
+            _dispatched = 0;
+        }
+
+        void EnableConflation(const ConflationOptions& options)
+        {
+            EnableConflation(std::make_shared<ConflationSchedule>(*_store, options));
+        }
+
+        void EnablePath(ReplayPathPtr path)
+        {
+            //replays the segments of the path (e.g. resampled blocks) instead of the store order
+            if (_cursor != 0 || _conflation)
+                throw Exception("Replay path must be set before the replay starts and without conflation");
+            _path = path;
+            _segment = 0;
+        }
+
+        inline ConflationSchedulePtr GetConflation() const
+        {
+            return _conflation;
+        }
+
+        ConflationStats GetConflationStats() const
+        {
+            ConflationStats stats;
+            if (_conflation)
+                stats = _conflation->GetStats();
+            else
+                stats.Input = _store->Size();
+            stats.Dispatched = _conflation || _path ? _dispatched : _cursor;
+            stats.Unchanged = _unchanged;
+            return stats;
+        }
+
+        inline TickStorePtr GetTickStore() const
+        {
+            return _store;
+        }
+
     private:
+        struct DispatchedState
+        {
+            double BidPrice;
+            double AskPrice;
+            u_int64_t Version;
+        };
 
-        void _loadData(const std::string& path)
+        bool _stepConflated()
         {
-            auto rawLines = CSVIO::ReadFile(path);
-            for(auto& line: rawLines)
+            bool suppress = _conflation->GetOptions().SuppressUnchangedPrices;
+            while (_cursor < _conflation->Size())
             {
-                auto update = std::make_shared<L1Update>();
-                update->Instrument = _instrumentManager->GetOrCreateInstrument(line[1]);
-                update->Timestamp = std::stol(line[0]);
-                update->BidSize = std::stod(line[3]);
-                update->BidPrice = std::stod(line[4]);
-                update->AskPrice = std::stod(line[5]);
-                update->AskSize = std::stod(line[6]);
-                _data.push_back(update);
+                auto& record = (*_store)[(*_conflation)[_cursor]];
+                ++_cursor;
+                auto& last = _lastDispatched[record.InstrumentId];
+                if (suppress && _outstandingOrders == 0 && last.Version == _version && last.BidPrice == record.BidPrice && last.AskPrice == record.AskPrice)
+                {
+                    ++_unchanged;
+                    continue;
+                }
+                last = {record.BidPrice, record.AskPrice, ++_version};
+                ++_dispatched;
+                _dispatch(record);
+                return true;
             }
+            return false;
         }
 
-        inline void _sortData()
+        bool _stepPath()
         {
-            //Quite time consuming, but this application is not latency-sensitive
-            std::sort(_data.begin(), _data.end(), [](L1UpdatePtr& a, L1UpdatePtr& b){ return a->Timestamp < b->Timestamp;});
+            while (_segment < _path->Segments.size())
+            {
+                auto& segment = _path->Segments[_segment];
+                size_t snapshots = segment.SnapshotEnd - segment.SnapshotBegin;
+                size_t size = snapshots + segment.End - segment.Begin;
+                if (_cursor >= size)
+                {
+                    ++_segment;
+                    _cursor = 0;
+                    continue;
+                }
+                //records are shifted on the stack, the store stays shared and read-only
+                TickRecord record = _cursor < snapshots ? (*_store)[(*_path->Snapshots)[segment.SnapshotBegin + _cursor]]
+                    : (*_store)[segment.Begin + _cursor - snapshots];
+                record.Timestamp = _cursor < snapshots ? segment.Start : record.Timestamp + segment.TimeShift;
+                record.BidPrice += segment.PriceShift;
+                record.AskPrice += segment.PriceShift;
+                ++_cursor;
+                ++_dispatched;
+                _dispatch(record);
+                return true;
+            }
+            return false;
+        }
+
+        inline void _dispatch(const TickRecord& record)
+        {
+            //the message is recycled when no subscriber kept it, so a replay does not allocate per tick
+            ARBSIM_PERF_SCOPE(Dispatch);
+            if (!_message || _message.use_count() != 1)
+                _message = std::make_shared<MDUpdateMessage>();
+            _message->Update = _makeUpdate(record);
+            SendMessage(_message);
+            if (_message.use_count() == 1)
+                _message->Update.reset();
+        }
+
+        inline L1UpdatePtr _makeUpdate(const TickRecord& record)
+        {
+            //subscribers may keep updates (matcher keeps the last one per instrument), so only released ones are overwritten
+            auto& pool = _updatePools[record.InstrumentId];
+            L1UpdatePtr update;
+            for (auto& candidate: pool)
+                if (candidate.use_count() == 1)
+                {
+                    update = candidate;
+                    break;
+                }
+            if (!update)
+            {
+                update = std::allocate_shared<L1Update>(ArenaAllocator<L1Update>());
+                update->Instrument = _instruments[record.InstrumentId];
+                if (pool.size() < UPDATE_POOL_SIZE)
+                    pool.push_back(update);
+                else
+                    pool[_poolVictim++ % UPDATE_POOL_SIZE] = update;
+            }
+            update->Timestamp = record.Timestamp;
+            update->BidSize = record.BidSize;
+            update->BidPrice = record.BidPrice;
+            update->AskPrice = record.AskPrice;
+            update->AskSize = record.AskSize;
+            return update;
         }
 
     private:
-        std::vector<L1UpdatePtr> _data;
         std::shared_ptr<InstrumentManager> _instrumentManager;
-        int _cursor{0};
-        int _size{0};
+        TickStorePtr _store;
+        ConflationSchedulePtr _conflation;
+        ReplayPathPtr _path;
+        size_t _segment{0};
+        std::vector<InstrumentPtr> _instruments;
+        size_t _cursor{0};
+        std::vector<std::vector<L1UpdatePtr>> _updatePools;
+        size_t _poolVictim{0};
+        std::shared_ptr<MDUpdateMessage> _message;
+        std::vector<DispatchedState> _lastDispatched;
+        size_t _outstandingOrders{0};
+        u_int64_t _version{0};
+        size_t _unchanged{0};
+        size_t _dispatched{0};
     };
 
     class OrderMatcher: public Subscriber, public Publisher
@@ -96,21 +274,40 @@ namespace ArbSimulation
         {
         }
 
+        void SetLatencyModel(LatencyModelPtr model, u_int64_t seed, u_int64_t stream = 0)
+        {
+            //instruments present in the model get a sampled latency per order, the others keep the constant one
+            _latencyModel = model;
+            _rng = CounterRng(seed, stream);
+        }
+
         void ProcessNewOrder(OrderPtr order)
+        {
+            order->SentTimestamp = _currentTimestamp + order->ComputeDelay;
+            EnqueueOrder(order);
+        }
+
+        void EnqueueOrder(OrderPtr order)
         {
             //putting orders into the queue in order to check on upcoming md updates
+            //SentTimestamp is expected to be set already
             std::string& securityId = order->Instrument->SecurityId;
-            order->SentTimestamp = _currentTimestamp;
+            u_int64_t arrival = order->SentTimestamp + _getLatency(securityId);
 
             auto iter = _orderQueues.find(securityId);
         
             if (iter == _orderQueues.end())
             {
-                _orderQueues.insert({securityId, std::queue<OrderPtr>{}});
-                _orderQueues[securityId].push(order);
+                _orderQueues.insert({securityId, OrderQueue{}});
+                _orderQueues[securityId].push({arrival, order});
             }
             else
-                iter->second.push(order);
+            {
+                //orders reach the venue in the order they were sent, a sampled latency cannot overtake a previous order
+                if (!iter->second.empty())
+                    arrival = std::max(arrival, iter->second.back().ArrivalTimestamp);
+                iter->second.push({arrival, order});
+            }
         }
 
         void ProcessL1Update(L1UpdatePtr update)
@@ -123,16 +320,16 @@ namespace ArbSimulation
             auto iterQueues = _orderQueues.find(securityId);
             if (iterQueues != _orderQueues.end() && iterUpdates != _lastUpdates.end())
             {
-                while (!iterQueues->second.empty() && iterQueues->second.front()->SentTimestamp + _latencies[securityId] < update->Timestamp)
+                while (!iterQueues->second.empty() && iterQueues->second.front().ArrivalTimestamp < update->Timestamp)
                 {
                     auto message = std::make_shared<OrderFilledMessage>();
-                    message->Order = iterQueues->second.front();
+                    message->Order = iterQueues->second.front().Order;
                     double execPrice = message->Order->Side == OrderSide::Buy ? iterUpdates->second->AskPrice : iterUpdates->second->BidPrice;
                     if (message->Order->Type == OrderType::StopLoss)
                         execPrice = (iterUpdates->second->AskPrice + iterUpdates->second->BidPrice) / 2;
 
                     message->Order->ExecPrice = execPrice;
-                    message->Order->ExecutedTimestamp = iterQueues->second.front()->SentTimestamp + _latencies[securityId]; // iterUpdates->second->Timestamp;
+                    message->Order->ExecutedTimestamp = iterQueues->second.front().ArrivalTimestamp; // iterUpdates->second->Timestamp;
                     iterQueues->second.pop();
                     SendMessage(message);
                 }
@@ -142,6 +339,7 @@ namespace ArbSimulation
 
         void OnNewMessage(MessagePtr message)
         {
+            ARBSIM_PERF_SCOPE(Matcher);
             //we should get only MDUpdates, any other message types are restricted
             switch(message->Type)
             {
@@ -161,11 +359,32 @@ namespace ArbSimulation
             }
         }
 
+    private:
+        struct PendingOrder
+        {
+            u_int64_t ArrivalTimestamp;
+            OrderPtr Order;
+        };
+        typedef std::queue<PendingOrder, std::deque<PendingOrder, ArenaAllocator<PendingOrder>>> OrderQueue;
+
+        inline u_int64_t _getLatency(const std::string& securityId)
+        {
+            if (_latencyModel)
+            {
+                auto iter = _latencyModel->find(securityId);
+                if (iter != _latencyModel->end())
+                    return iter->second.Sample(_rng);
+            }
+            return _latencies[securityId];
+        }
+
     private:
         u_int64_t _currentTimestamp{0};
-        std::unordered_map<std::string, std::queue<OrderPtr>> _orderQueues;
+        std::unordered_map<std::string, OrderQueue> _orderQueues;
         std::unordered_map<std::string, L1UpdatePtr> _lastUpdates;
         std::unordered_map<std::string, u_int64_t> _latencies;
+        LatencyModelPtr _latencyModel;
+        CounterRng _rng;
         int _latency{0};
     };
 }
\ No newline at end of file
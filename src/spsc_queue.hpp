@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+
+#include "definitions.h"
+
+namespace ArbSimulation
+{
+    constexpr size_t CACHE_LINE_SIZE = 64;
+
+    template<typename T>
+    class SPSCQueue
+    {
+    /*
+    * Bounded lock-free single-producer/single-consumer ring.
+    * Indices are free-running, each side keeps a cached copy of the other side's index
+    * to avoid touching the shared cache line on every operation.
+    */
+    public:
+        explicit SPSCQueue(size_t capacity)
+        {
+            size_t size = 1;
+            while (size < capacity)
+                size <<= 1;
+            _buffer.resize(size);
+            _mask = size - 1;
+        }
+
+        SPSCQueue(SPSCQueue&) = delete;
+        SPSCQueue(const SPSCQueue&) = delete;
+        SPSCQueue(SPSCQueue&&) = delete;
+
+        template<typename U>
+        inline bool TryPush(U&& value)
+        {
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail - _cachedHead > _mask)
+            {
+                _cachedHead = _head.load(std::memory_order_acquire);
+                if (tail - _cachedHead > _mask)
+                    return false;
+            }
+            _buffer[tail & _mask] = std::forward<U>(value);
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        inline bool TryPop(T& value)
+        {
+            size_t head = _head.load(std::memory_order_relaxed);
+            if (head == _cachedTail)
+            {
+                _cachedTail = _tail.load(std::memory_order_acquire);
+                if (head == _cachedTail)
+                    return false;
+            }
+            value = std::move(_buffer[head & _mask]);
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        inline size_t Capacity() const
+        {
+            return _mask + 1;
+        }
+
+    private:
+        std::vector<T> _buffer;
+        size_t _mask;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> _head{0};
+        size_t _cachedTail{0};
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> _tail{0};
+        size_t _cachedHead{0};
+    };
+}
@@ -1,9 +1,22 @@
 #pragma once
 
+#include <functional>
+
 #include "simulation.hpp"
+#include "analytics.hpp"
+#include "cycle_clock.hpp"
+#include "flight_recorder.hpp"
 
 namespace ArbSimulation
 {
+    struct ComputeTimeStats
+    {
+        size_t Callbacks = 0;
+        size_t Orders = 0;
+        u_int64_t TotalNs = 0;                  //scaled compute time over all measured callbacks
+        u_int64_t MaxNs = 0;
+    };
+
     class Position
     {
     public:
@@ -70,6 +83,22 @@ namespace ArbSimulation
         double _currentPrice = 0;
     };
 
+    struct TradeRecord
+    {
+        //flat copy of a fill, kept contiguous so the trade log can be exported without walking OrderPtrs
+        u_int64_t SentTimestamp;
+        u_int64_t ExecutedTimestamp;
+        double ExecPrice;
+        double Qty;
+        u_int32_t InstrumentIndex;                          //index in PositionKeeper::GetTradeInstruments()
+        u_int8_t Side;                                      //OrderSide
+        u_int8_t Type;                                      //OrderType
+        u_int16_t Reserved;
+    };
+    static_assert(sizeof(TradeRecord) == 40);
+    typedef std::vector<OrderPtr, ArenaAllocator<OrderPtr>> TradeList;
+    typedef std::vector<TradeRecord, ArenaAllocator<TradeRecord>> TradeLog;
+
     class PositionKeeper
     {
     public:
@@ -81,11 +110,21 @@ namespace ArbSimulation
             return result;
         }
 
-        inline const std::vector<OrderPtr>& GetTrades()
+        inline const TradeList& GetTrades()
         {
             return _trades;
         }
 
+        inline const TradeLog& GetTradeLog() const
+        {
+            return _tradeLog;
+        }
+
+        inline const std::vector<std::string>& GetTradeInstruments() const
+        {
+            return _tradeInstruments;
+        }
+
         inline const Position& GetPosition(const std::string& securityId)
         {
             if (_positionsMap.find(securityId) == _positionsMap.end())
@@ -97,17 +136,50 @@ namespace ArbSimulation
         inline void ProcessL1Update(L1UpdatePtr update)
         {
             const std::string& secId = update->Instrument->SecurityId;
-            _getOrCreatePosition(secId).OnNewCurrentPrice((update->BidPrice + update->AskPrice)/2);
+            auto& position = _getOrCreatePosition(secId);
+            double before = _trackEquity ? position.GetPnL() : 0;
+            position.OnNewCurrentPrice((update->BidPrice + update->AskPrice)/2);
+            if (_trackEquity)
+                _equity += position.GetPnL() - before;
         };
 
         inline void ProcessOrderFill(OrderPtr order)
         {
             _trades.push_back(order);
             const std::string& secId = order->Instrument->SecurityId;
-            _getOrCreatePosition(secId).OnNewTrade(order->Qty, order->ExecPrice, order->Side);
+            _appendTradeRecord(secId, order);
+            auto& position = _getOrCreatePosition(secId);
+            double before = _trackEquity ? position.GetPnL() : 0;
+            position.OnNewTrade(order->Qty, order->ExecPrice, order->Side);
+            if (_trackEquity)
+                _equity += position.GetPnL() - before;
         };
 
+        inline void EnableEquityTracking()
+        {
+            //equity is then maintained incrementally, so reading it is O(1) regardless of the number of positions
+            _trackEquity = true;
+            _equity = GetFullPnL();
+        }
+
+        inline double GetEquity() const
+        {
+            return _equity;
+        }
+
     private:
+        void _appendTradeRecord(const std::string& securityId, const OrderPtr& order)
+        {
+            auto iter = _tradeInstrumentIndices.find(securityId);
+            if (iter == _tradeInstrumentIndices.end())
+            {
+                iter = _tradeInstrumentIndices.insert({securityId, u_int32_t(_tradeInstruments.size())}).first;
+                _tradeInstruments.push_back(securityId);
+            }
+            _tradeLog.push_back(TradeRecord{order->SentTimestamp, order->ExecutedTimestamp, order->ExecPrice, order->Qty,
+                iter->second, u_int8_t(order->Side), u_int8_t(order->Type), 0});
+        }
+
         Position& _getOrCreatePosition(const std::string& securityId)
         {
             auto iter = _positionsMap.find(securityId);
@@ -121,7 +193,12 @@ namespace ArbSimulation
 
     private:
         std::unordered_map<std::string, Position> _positionsMap;
-        std::vector<OrderPtr> _trades;
+        TradeList _trades;
+        TradeLog _tradeLog;
+        std::vector<std::string> _tradeInstruments;
+        std::unordered_map<std::string, u_int32_t> _tradeInstrumentIndices;
+        bool _trackEquity = false;
+        double _equity = 0;
     };
 
     class BasicStrategy: public Subscriber, public Publisher
@@ -133,32 +210,36 @@ namespace ArbSimulation
         virtual void OnL1Update(L1UpdatePtr update) = 0;
         virtual void OnOrderFilled(OrderPtr order) = 0;
 
-        void SendSL(const std::string& securityId)
+        virtual bool SamplesEveryUpdate() const
+        {
+            //true when the strategy keeps statistics over the update stream: conflation would change them, so it is rejected
+            return false;
+        }
+
+        OrderPtr SendSL(const std::string& securityId)
         {
+            //nullptr when the position is flat and nothing is sent
             auto& position = _positionKeeper.GetPosition(securityId);
-            auto order = std::make_shared<Order>();
+            auto order = std::allocate_shared<Order>(ArenaAllocator<Order>());
             order->Qty = std::abs(position.GetNetQty());
             order->Side = position.GetNetQty() > 0 ? OrderSide::Sell: OrderSide::Buy;
             order->Type = OrderType::StopLoss;
             order->Instrument = _instrManager->GetOrCreateInstrument(securityId);
-            if (order->Qty > 0)
-            {
-                auto message = std::make_shared<NewOrderMessage>();
-                message->Order = order;
-                SendMessage(message);
-            }
+            if (order->Qty == 0)
+                return nullptr;
+            _sendOrder(order);
+            return order;
         }
 
-        void SendMarketOrder(const std::string& securityId, double qty, OrderSide side)
+        OrderPtr SendMarketOrder(const std::string& securityId, double qty, OrderSide side)
         {
-            auto order = std::make_shared<Order>();
+            auto order = std::allocate_shared<Order>(ArenaAllocator<Order>());
             order->Qty = qty;
             order->Side = side;
             order->Type = OrderType::Market;
             order->Instrument = _instrManager->GetOrCreateInstrument(securityId);
-            auto message = std::make_shared<NewOrderMessage>();
-            message->Order = order;
-            SendMessage(message);
+            _sendOrder(order);
+            return order;
         }
 
         inline const Position& GetPosition(const std::string& securityId)
@@ -171,25 +252,119 @@ namespace ArbSimulation
             return _positionKeeper.GetFullPnL();
         }
 
-        inline const std::vector<OrderPtr>& GetTrades()
+        inline const TradeList& GetTrades()
         {
             return _positionKeeper.GetTrades();
         }
 
+        inline const PositionKeeper& GetPositionKeeper() const
+        {
+            return _positionKeeper;
+        }
+
+        inline void EnableAnalytics(PerformanceAnalyticsPtr analytics)
+        {
+            _analytics = analytics;
+            _positionKeeper.EnableEquityTracking();
+        }
+
+        inline PerformanceAnalyticsPtr GetAnalytics() const
+        {
+            return _analytics;
+        }
+
+        typedef std::function<u_int64_t()> ComputeClock;     //nanoseconds
+
+        void EnableComputeLatency(double scale, ComputeClock clock = ThreadCpuClock::Now)
+        {
+            /*
+            * Measures every OnL1Update/OnOrderFilled call in CPU time of the thread and delays the orders it sends
+            * by the time the callback has spent until it sent them, multiplied by scale
+            * (e.g. 0.5 if production hardware runs the strategy twice as fast as this machine).
+            * The clock is paused while an order is sent: time in its subscribers (a matcher filling it synchronously,
+            * a nested callback) and in tracing does not delay later orders. Preemption is not counted either.
+            * Network latency is applied by OrderMatcher on top of the delayed send time.
+            * Results still depend on the speed of the machine running the backtest and are not reproducible run to run.
+            */
+            _computeScale = scale;
+            _computeClock = std::move(clock);
+        }
+
+        inline double GetComputeTimeScale() const
+        {
+            return _computeScale;
+        }
+
+        inline const ComputeTimeStats& GetComputeTimeStats() const
+        {
+            return _computeStats;
+        }
+
+        void DumpFlightRecord(const std::string& path, const std::string& reason = "On demand") const
+        {
+            //the ring of the calling thread, so call it from the thread running the strategy
+            if (auto recorder = FlightRecorder::Local())
+                recorder->Dump(path, reason, _instrManager->GetSecurityIds());
+        }
+
+        inline const std::string& GetFlightDumpPath() const
+        {
+            //written when the strategy threw StrategyException and FlightRecorder has a dump directory
+            return _flightDumpPath;
+        }
+
         void OnNewMessage(MessagePtr message)
         {
+            ARBSIM_PERF_SCOPE(Strategy);
+            try
+            {
+                _onNewMessage(message);
+            }
+            catch(StrategyException& ex)
+            {
+                _trace({_ticks, _lastTimestamp, 0, 0, 0, 0, FlightEvent::Exception});
+                if (_flightDumpPath.empty())
+                    _flightDumpPath = FlightRecorder::DumpOnFailure(ex.what(), _instrManager->GetSecurityIds());
+                throw;
+            }
+        }
+
+    private:
+        void _onNewMessage(const MessagePtr& message)
+        {
+            if (_ticks == 0 && _lastTimestamp == 0)
+                _trace({0, 0, 0, 0, 0, 0, FlightEvent::Start});
             switch(message->Type)
             {
                 case (MessageType::L1Update):
                 {
-                    _positionKeeper.ProcessL1Update(std::static_pointer_cast<MDUpdateMessage>(message)->Update);
-                    OnL1Update(std::static_pointer_cast<MDUpdateMessage>(message)->Update);
+                    auto& update = std::static_pointer_cast<MDUpdateMessage>(message)->Update;
+                    _lastTimestamp = update->Timestamp;
+                    _trace({++_ticks, update->Timestamp, update->BidPrice, update->AskPrice, 0, update->Instrument->Id, FlightEvent::L1Update});
+                    _positionKeeper.ProcessL1Update(update);
+                    if (_analytics)
+                        _analytics->OnEquity(update->Timestamp, _positionKeeper.GetEquity());
+                    if (_computeScale > 0)
+                        _measure([&](){ OnL1Update(update); });
+                    else
+                        OnL1Update(update);
                     break;
                 }
                 case (MessageType::OrderFilled):
                 {
-                    _positionKeeper.ProcessOrderFill(std::static_pointer_cast<OrderFilledMessage>(message)->Order);
-                    OnOrderFilled(std::static_pointer_cast<OrderFilledMessage>(message)->Order);
+                    auto& order = std::static_pointer_cast<OrderFilledMessage>(message)->Order;
+                    _trace({_ticks, order->ExecutedTimestamp, order->ExecPrice, order->Qty, order->Id, order->Instrument->Id,
+                        FlightEvent::OrderFilled, u_int8_t(order->Side), u_int8_t(order->Type)});
+                    _positionKeeper.ProcessOrderFill(order);
+                    if (_analytics)
+                    {
+                        _analytics->OnFill(order->Qty, order->ExecPrice);
+                        _analytics->OnEquity(order->ExecutedTimestamp, _positionKeeper.GetEquity());
+                    }
+                    if (_computeScale > 0)
+                        _measure([&](){ OnOrderFilled(order); });
+                    else
+                        OnOrderFilled(order);
                     break;
                 }
                 default:
@@ -197,8 +372,74 @@ namespace ArbSimulation
             }
         }
 
+        void _sendOrder(const OrderPtr& order)
+        {
+            bool measured = _computeScale > 0 && _measuring;
+            order->ComputeDelay = measured ? _pauseCompute() : 0;
+            order->Id = ++_ordersSent;
+            _trace({_ticks, _lastTimestamp, 0, order->Qty, order->Id, order->Instrument->Id,
+                FlightEvent::NewOrder, u_int8_t(order->Side), u_int8_t(order->Type)});
+            auto message = std::make_shared<NewOrderMessage>();
+            message->Order = order;
+            SendMessage(message);
+            if (measured)
+                _computeResumed = _computeClock();
+        }
+
+        static inline void _trace(const FlightRecord& record)
+        {
+            if (auto recorder = FlightRecorder::Local())
+                recorder->Record(record);
+        }
+
+        template<typename Callback>
+        inline void _measure(Callback&& callback)
+        {
+            //callbacks nest when a synchronous subscriber answers an order with a fill: the outer one is paused in _sendOrder meanwhile
+            u_int64_t outerElapsed = _computeElapsed;
+            bool outerMeasuring = _measuring;
+            _computeElapsed = 0;
+            _measuring = true;
+            _computeResumed = _computeClock();
+            try
+            {
+                callback();
+            }
+            catch(...)
+            {
+                _computeElapsed = outerElapsed;
+                _measuring = outerMeasuring;
+                throw;
+            }
+            u_int64_t elapsed = (_computeElapsed + _computeClock() - _computeResumed) * _computeScale;
+            _computeElapsed = outerElapsed;
+            _measuring = outerMeasuring;
+            ++_computeStats.Callbacks;
+            _computeStats.TotalNs += elapsed;
+            _computeStats.MaxNs = std::max(_computeStats.MaxNs, elapsed);
+        }
+
+        inline u_int64_t _pauseCompute()
+        {
+            //scaled compute time of the callback so far, the clock stays stopped until _sendOrder resumes it
+            _computeElapsed += _computeClock() - _computeResumed;
+            ++_computeStats.Orders;
+            return _computeElapsed * _computeScale;
+        }
+
     private:
         std::shared_ptr<InstrumentManager> _instrManager;
         PositionKeeper _positionKeeper;
+        PerformanceAnalyticsPtr _analytics;
+        double _computeScale = 0;
+        ComputeClock _computeClock;
+        bool _measuring = false;                            //inside a measured callback
+        u_int64_t _computeElapsed = 0;                      //unscaled compute time of the current callback before _computeResumed
+        u_int64_t _computeResumed = 0;
+        ComputeTimeStats _computeStats;
+        u_int64_t _ticks = 0;
+        u_int64_t _lastTimestamp = 0;
+        u_int64_t _ordersSent = 0;
+        std::string _flightDumpPath;
     };
 }
\ No newline at end of file
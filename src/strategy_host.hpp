@@ -0,0 +1,170 @@
+#pragma once
+
+#include <functional>
+
+#include "strategy_base.hpp"
+#include "threading.hpp"
+
+namespace ArbSimulation
+{
+    struct HostedResult
+    {
+        std::string Name;
+        double PnL = 0;
+        size_t Trades = 0;
+        size_t Ticks = 0;
+        std::string Error;
+    };
+
+    struct HostedOptions
+    {
+        LatencyModelPtr StochasticLatencies;                //optional, overrides the fixed latencies for the instruments it covers
+        u_int64_t Seed = 0;
+        ConflationSchedulePtr Conflation;                   //optional, may be shared by all hosted strategies
+        double ComputeTimeScale = 0;                        //> 0 delays orders by the measured strategy compute time times this
+    };
+
+    class StrategyHost
+    {
+    /*
+    * Replays one loaded TickStore to K independent strategies side by side.
+    * Every strategy gets its own thread pinned to its own core, its own InstrumentManager, OrderMatcher and positions.
+    * All of them read records straight from the shared, read-only store; the stream is not copied per consumer
+    * and updates and messages are recycled by MarketDataSimulationManager, so dispatch does not allocate per tick.
+    */
+    public:
+        typedef std::function<std::shared_ptr<BasicStrategy>(std::shared_ptr<InstrumentManager>)> StrategyFactory;
+
+        StrategyHost() = delete;
+        StrategyHost(StrategyHost&) = delete;
+        StrategyHost(const StrategyHost&) = delete;
+        StrategyHost(StrategyHost&&) = delete;
+
+        StrategyHost(TickStorePtr store, size_t firstCore = 0): _store(store), _firstCore(firstCore)
+        {}
+
+        ~StrategyHost()
+        {
+            //subscriptions are mutual, like in SimulationRun; strategies handed out by GetStrategy may outlive the host
+            for (auto& slot: _slots)
+            {
+                slot->Strategy->ClearSubscribers();
+                slot->Matcher->ClearSubscribers();
+                slot->MarketDataManager->ClearSubscribers();
+            }
+        }
+
+        size_t Add(const std::string& name, StrategyFactory factory, const std::unordered_map<std::string, u_int64_t>& latencies,
+            const HostedOptions& options = HostedOptions())
+        {
+            //wired like a SimulationRun, so a hosted ArbitrageStrategy replays exactly like a run of the same parameters
+            auto slot = std::make_unique<Slot>();
+            auto instrManager = std::make_shared<InstrumentManager>();
+            slot->Name = name;
+            slot->MarketDataManager = std::make_shared<MarketDataSimulationManager>(instrManager, _store);
+            if (options.Conflation)
+                slot->MarketDataManager->EnableConflation(options.Conflation);
+            slot->Matcher = std::make_shared<OrderMatcher>(latencies);
+            if (options.StochasticLatencies)
+                slot->Matcher->SetLatencyModel(options.StochasticLatencies, options.Seed);
+            slot->Strategy = factory(instrManager);
+            if (options.Conflation && slot->Strategy->SamplesEveryUpdate())
+                throw Exception("Conflation drops updates which the signal of " + name + " samples, use it with the Absolute signal");
+            if (options.ComputeTimeScale > 0)
+                slot->Strategy->EnableComputeLatency(options.ComputeTimeScale);
+
+            slot->Strategy->AddSubscriber(slot->Matcher);
+            slot->Matcher->AddSubscriber(slot->Strategy);
+            slot->MarketDataManager->AddSubscriber(slot->Matcher);
+            slot->MarketDataManager->AddSubscriber(slot->Strategy);
+            if (options.Conflation && options.Conflation->GetOptions().SuppressUnchangedPrices)
+            {
+                slot->Strategy->AddSubscriber(slot->MarketDataManager);
+                slot->Matcher->AddSubscriber(slot->MarketDataManager);
+            }
+            _slots.push_back(std::move(slot));
+            return _slots.size() - 1;
+        }
+
+        std::vector<HostedResult> Run()
+        {
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < _slots.size(); ++i)
+                threads.emplace_back([this, i]()
+                {
+                    PinCurrentThread(_firstCore + i);
+                    _slots[i]->Run();
+                });
+            for (auto& thread: threads)
+                thread.join();
+
+            std::vector<HostedResult> results;
+            for (auto& slot: _slots)
+            {
+                if (slot->Failure)
+                    std::rethrow_exception(slot->Failure);
+                results.push_back(slot->Result);
+            }
+            return results;
+        }
+
+        inline size_t GetStrategiesCount() const
+        {
+            return _slots.size();
+        }
+
+        inline std::shared_ptr<BasicStrategy> GetStrategy(size_t index) const
+        {
+            return _slots[index]->Strategy;
+        }
+
+        static std::vector<std::vector<std::string>> ToReport(const std::vector<HostedResult>& results)
+        {
+            std::vector<std::vector<std::string>> lines{{"Strategy", "PnL", "Trades", "Ticks", "Error"}};
+            for (auto& result: results)
+                lines.push_back({
+                    result.Name,
+                    std::to_string(result.PnL),
+                    std::to_string(result.Trades),
+                    std::to_string(result.Ticks),
+                    result.Error});
+            return lines;
+        }
+
+    private:
+        struct Slot
+        {
+            std::string Name;
+            std::shared_ptr<MarketDataSimulationManager> MarketDataManager;
+            std::shared_ptr<OrderMatcher> Matcher;
+            std::shared_ptr<BasicStrategy> Strategy;
+            HostedResult Result;
+            std::exception_ptr Failure;
+
+            void Run()
+            {
+                Result.Name = Name;
+                try
+                {
+                    while (MarketDataManager->Step())
+                        ++Result.Ticks;
+                }
+                catch(StrategyException& ex)
+                {
+                    Result.Error = ex.what();
+                }
+                catch(...)
+                {
+                    Failure = std::current_exception();
+                }
+                Result.PnL = Strategy->GetFullPnL();
+                Result.Trades = Strategy->GetTrades().size();
+            }
+        };
+
+    private:
+        TickStorePtr _store;
+        size_t _firstCore;
+        std::vector<std::unique_ptr<Slot>> _slots;
+    };
+}
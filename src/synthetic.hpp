@@ -0,0 +1,223 @@
+#pragma once
+
+#include <charconv>
+#include <cstring>
+
+#include "random.hpp"
+#include "threading.hpp"
+#include "tick_store.hpp"
+
+namespace ArbSimulation
+{
+    struct SyntheticConfig
+    {
+        u_int64_t Seed = 1;
+        size_t Instruments = 2;
+        std::vector<std::string> Names;                     //defaults to SYN00000, SYN00001...
+        u_int64_t StartTimestamp = 1544166000000000000ull;
+        u_int64_t DurationNs = 3600ull * 1000000000ull;
+
+        double UpdatesPerSecond = 20;                       //per instrument, outside of bursts
+        double BurstProbability = 0.3;                      //chance that the next update belongs to a burst
+        double BurstGapNs = 200000;                         //mean gap inside a burst
+        double SameTimestampProbability = 0.05;             //updates sharing the previous timestamp
+
+        double StartPrice = 10000;
+        double PriceStep = 0.5;
+        double FactorVolatility = 0.5;                      //common random walk, price units per sqrt(second)
+        u_int64_t FactorStepNs = 100000000;
+        double BasisReversion = 0.05;                       //mean reversion speed of the idiosyncratic basis, 1/second
+        double BasisVolatility = 0.5;                       //price units per sqrt(second)
+        double MeanExtraSpreadTicks = 0.3;                  //spread is 1 + geometric extra ticks
+        double MeanSize = 5;
+    };
+
+    class SyntheticMarket
+    {
+    /*
+    * Seeded, cointegrated L1 market:
+    *   mid_i(t) = StartPrice + beta_i * F(t) + B_i(t)
+    * where F is a random walk shared by all instruments and B_i is an Ornstein-Uhlenbeck basis.
+    * Every instrument is an independent counter-based stream, so output depends only on the seed,
+    * never on the number of threads used to produce it.
+    */
+    public:
+        explicit SyntheticMarket(const SyntheticConfig& config): _config(config)
+        {
+            if (_config.Instruments == 0 || _config.FactorStepNs == 0 || _config.UpdatesPerSecond <= 0)
+                throw Exception("Invalid synthetic market configuration");
+            if (!_config.Names.empty() && _config.Names.size() != _config.Instruments)
+                throw Exception("Number of names does not match the number of instruments");
+
+            size_t steps = _config.DurationNs / _config.FactorStepNs + 2;
+            _factor.resize(steps);
+            CounterRng rng(_config.Seed, 0);
+            double stepVolatility = _config.FactorVolatility * std::sqrt(_config.FactorStepNs / 1e9);
+            for (size_t i = 1; i < steps; ++i)
+                _factor[i] = _factor[i - 1] + stepVolatility * rng.Normal();
+        }
+
+        inline const SyntheticConfig& GetConfig() const
+        {
+            return _config;
+        }
+
+        std::string GetName(size_t instrument) const
+        {
+            if (!_config.Names.empty())
+                return _config.Names[instrument];
+            char name[32];
+            std::snprintf(name, sizeof(name), "SYN%05zu", instrument);
+            return name;
+        }
+
+        inline double GetFactor(u_int64_t timestamp) const
+        {
+            u_int64_t offset = timestamp - _config.StartTimestamp;
+            size_t step = offset / _config.FactorStepNs;
+            if (step + 1 >= _factor.size())
+                return _factor.back();
+            double weight = double(offset % _config.FactorStepNs) / _config.FactorStepNs;
+            return _factor[step] * (1 - weight) + _factor[step + 1] * weight;
+        }
+
+        class Stream
+        {
+        public:
+            Stream(const SyntheticMarket& market, size_t instrument, u_int32_t instrumentId):
+                _market(market), _config(market.GetConfig()), _rng(_config.Seed, instrument + 1),
+                _instrumentId(instrumentId), _timestamp(_config.StartTimestamp)
+            {
+                _beta = 0.8 + 0.4 * _rng.Uniform();
+                _basis = _config.BasisVolatility * _rng.Normal();
+                _endTimestamp = _config.StartTimestamp + _config.DurationNs;
+            }
+
+            bool Next(TickRecord& record)
+            {
+                u_int64_t gap = 0;
+                if (_rng.Uniform() >= _config.SameTimestampProbability)
+                {
+                    double meanGap = _rng.Uniform() < _config.BurstProbability ? _config.BurstGapNs : 1e9 / _config.UpdatesPerSecond;
+                    gap = 1 + u_int64_t(_rng.Exponential(meanGap));
+                }
+                if (_timestamp + gap >= _endTimestamp)
+                    return false;
+                _timestamp += gap;
+
+                if (gap > 0)
+                {
+                    //exact OU transition over the gap
+                    double dt = gap / 1e9;
+                    double decay = std::exp(-_config.BasisReversion * dt);
+                    double deviation = _config.BasisVolatility * std::sqrt((1 - decay * decay) / (2 * _config.BasisReversion));
+                    _basis = _basis * decay + deviation * _rng.Normal();
+                }
+
+                double step = _config.PriceStep;
+                double mid = _config.StartPrice + _beta * _market.GetFactor(_timestamp) + _basis;
+                u_int64_t spreadTicks = 1 + _rng.Geometric(_config.MeanExtraSpreadTicks);
+                double bid = std::floor((mid - spreadTicks * step / 2) / step + 0.5) * step;
+
+                record.Timestamp = _timestamp;
+                record.InstrumentId = _instrumentId;
+                record.Flags = 0;
+                record.BidPrice = bid;
+                record.AskPrice = bid + spreadTicks * step;
+                record.BidSize = 1 + _rng.Geometric(_config.MeanSize - 1);
+                record.AskSize = 1 + _rng.Geometric(_config.MeanSize - 1);
+                return true;
+            }
+
+        private:
+            const SyntheticMarket& _market;
+            const SyntheticConfig& _config;
+            CounterRng _rng;
+            u_int32_t _instrumentId;
+            u_int64_t _timestamp;
+            u_int64_t _endTimestamp;
+            double _beta;
+            double _basis;
+        };
+
+        class MergedStream
+        {
+        /*
+        * Time-ordered merge of several instrument streams, ties are broken by instrument index
+        */
+        public:
+            MergedStream(const SyntheticMarket& market, size_t firstInstrument, size_t lastInstrument)
+            {
+                for (size_t instrument = firstInstrument; instrument < lastInstrument; ++instrument)
+                {
+                    _streams.emplace_back(market, instrument, instrument - firstInstrument);
+                    TickRecord record;
+                    if (_streams.back().Next(record))
+                        _heap.push_back(record);
+                }
+                std::make_heap(_heap.begin(), _heap.end(), _later);
+            }
+
+            inline bool Next(TickRecord& record)
+            {
+                if (_heap.empty())
+                    return false;
+                std::pop_heap(_heap.begin(), _heap.end(), _later);
+                record = _heap.back();
+                if (_streams[record.InstrumentId].Next(_heap.back()))
+                    std::push_heap(_heap.begin(), _heap.end(), _later);
+                else
+                    _heap.pop_back();
+                return true;
+            }
+
+        private:
+            static inline bool _later(const TickRecord& a, const TickRecord& b)
+            {
+                return a.Timestamp != b.Timestamp ? a.Timestamp > b.Timestamp : a.InstrumentId > b.InstrumentId;
+            }
+
+        private:
+            std::vector<Stream> _streams;
+            std::vector<TickRecord> _heap;
+        };
+
+        std::shared_ptr<TickStore> GenerateStore() const
+        {
+            auto store = std::make_shared<TickStore>();
+            for (size_t instrument = 0; instrument < _config.Instruments; ++instrument)
+                store->GetOrAddInstrument(GetName(instrument));
+            MergedStream stream(*this, 0, _config.Instruments);
+            TickRecord record;
+            while (stream.Next(record))
+                store->Append(record);
+            return store;
+        }
+
+        static size_t FormatCSV(const TickRecord& record, const std::string& securityId, char* out)
+        {
+            //same layout as the recorder files: timestamp,security,type,bid size,bid,ask,ask size
+            char* p = out;
+            p = std::to_chars(p, p + 24, record.Timestamp).ptr;
+            *p++ = ',';
+            std::memcpy(p, securityId.data(), securityId.size());
+            p += securityId.size();
+            *p++ = ',';
+            *p++ = '2';
+            *p++ = ',';
+            p = std::to_chars(p, p + 32, record.BidSize).ptr;
+            *p++ = ',';
+            p = std::to_chars(p, p + 32, record.BidPrice).ptr;
+            *p++ = ',';
+            p = std::to_chars(p, p + 32, record.AskPrice).ptr;
+            *p++ = ',';
+            p = std::to_chars(p, p + 32, record.AskSize).ptr;
+            *p++ = '\n';
+            return p - out;
+        }
+
+    private:
+        SyntheticConfig _config;
+        std::vector<double> _factor;
+    };
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+
+#include "definitions.h"
+
+namespace ArbSimulation
+{
+    inline size_t GetHardwareThreads()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    inline bool PinCurrentThread(size_t core)
+    {
+        //best effort: pinning is an optimisation, failures (containers, restricted cpusets) are ignored
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core % GetHardwareThreads(), &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    template<typename Function>
+    void ParallelFor(size_t count, size_t threads, Function function)
+    {
+        /*
+        * Calls function(index, worker) for every index in [0, count) on up to `threads` workers.
+        * Indices are handed out dynamically, the first exception is rethrown after all workers stop.
+        */
+        threads = std::max<size_t>(1, std::min(threads, count));
+        std::atomic<size_t> next{0};
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        auto worker = [&](size_t workerId)
+        {
+            for (size_t index = next++; index < count; index = next++)
+            {
+                try
+                {
+                    function(index, workerId);
+                }
+                catch(...)
+                {
+                    std::lock_guard lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                    next = count;
+                }
+            }
+        };
+        if (threads == 1)
+            worker(0);
+        else
+        {
+            std::vector<std::thread> pool;
+            for (size_t i = 0; i < threads; ++i)
+                pool.emplace_back(worker, i);
+            for (auto& thread: pool)
+                thread.join();
+        }
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    class Backoff
+    {
+    /*
+    * Busy-wait helper: spins for a while, then starts yielding
+    * so oversubscribed machines still make progress.
+    */
+    public:
+        inline void Pause()
+        {
+            if (_spins < SPIN_LIMIT)
+            {
+                ++_spins;
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#endif
+            }
+            else
+                std::this_thread::yield();
+        }
+
+        inline void Reset()
+        {
+            _spins = 0;
+        }
+
+    private:
+        static constexpr size_t SPIN_LIMIT = 256;
+        size_t _spins = 0;
+    };
+}
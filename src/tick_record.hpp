@@ -0,0 +1,24 @@
+#pragma once
+
+#include "DTO.hpp"
+#include "arena.hpp"
+
+namespace ArbSimulation
+{
+    struct TickRecord
+    {
+    /*
+    * Flat representation of an L1Update, instruments are referenced by index in TickStore.
+    * This layout is written to disk as is (see data_cache.hpp), do not reorder fields.
+    */
+        u_int64_t Timestamp;
+        u_int32_t InstrumentId;
+        u_int32_t Flags;                    //cleaning rules the update broke (see TickCleaner), 0 for clean data
+        double BidSize;
+        double BidPrice;
+        double AskPrice;
+        double AskSize;
+    };
+    static_assert(sizeof(TickRecord) == 48, "TickRecord layout is a part of the cache format");
+    typedef std::vector<TickRecord, HugePageAllocator<TickRecord>> TickRecords;
+}
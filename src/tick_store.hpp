@@ -0,0 +1,363 @@
+#pragma once
+
+#include <charconv>
+
+#include "compressed_input.hpp"
+#include "csv_io.hpp"
+#include "data_cleaning.hpp"
+#include "perf_counters.hpp"
+
+namespace ArbSimulation
+{
+    class TickCSVParser
+    {
+    /*
+    * Parses recorder lines "timestamp,securityId,_,bidSize,bidPrice,askPrice,askSize" straight from memory with std::from_chars.
+    * Instruments get local ids in order of first appearance, TickStore remaps them when the records are appended.
+    * Empty lines are skipped, a trailing '\r' is ignored. Malformed lines and broken quotes are handled by Policy
+    * in the same pass (see TickCleaner), counted in Report.
+    */
+    public:
+        void Parse(const char* begin, const char* end)
+        {
+            //whole lines only, the last one may lack '\n'
+            while (begin < end)
+            {
+                auto lineEnd = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+                if (lineEnd == nullptr)
+                    lineEnd = end;
+                _parseLine(begin, lineEnd);
+                begin = lineEnd + 1;
+            }
+        }
+
+        void Feed(const char* data, size_t size)
+        {
+            //streaming input: a line split between two pieces is kept until its end arrives
+            const char* end = data + size;
+            if (!_carry.empty())
+            {
+                auto lineEnd = static_cast<const char*>(std::memchr(data, '\n', size));
+                if (lineEnd == nullptr)
+                {
+                    _carry.append(data, size);
+                    return;
+                }
+                _carry.append(data, lineEnd);
+                _parseLine(_carry.data(), _carry.data() + _carry.size());
+                _carry.clear();
+                data = lineEnd + 1;
+            }
+            auto last = static_cast<const char*>(memrchr(data, '\n', end - data));
+            if (last == nullptr)
+            {
+                _carry.assign(data, end);
+                return;
+            }
+            Parse(data, last);
+            _carry.assign(last + 1, end);
+            if (_expectedBytes > 0 && !Records.empty())
+            {
+                Records.reserve(Records.size() * (_expectedBytes / double(last - data + 1)) * 1.05);
+                _expectedBytes = 0;
+            }
+        }
+
+        inline void SetExpectedSize(size_t bytes)
+        {
+            //records are reserved from the line length seen in the first piece fed
+            _expectedBytes = bytes;
+        }
+
+        void Finish()
+        {
+            Parse(_carry.data(), _carry.data() + _carry.size());
+            _carry.clear();
+        }
+
+        TickRecords Records;
+        std::vector<std::string> SecurityIds;
+        CleaningPolicy Policy;
+        CleaningReport Report;
+
+    private:
+        void _parseLine(const char* begin, const char* end)
+        {
+            if (end > begin && end[-1] == '\r')
+                --end;
+            if (begin == end)
+                return;
+            ++Report.Lines;
+
+            TickRecord record{};
+            const char* cursor = begin;
+            auto field = [&]()
+            {
+                auto fieldEnd = static_cast<const char*>(std::memchr(cursor, ',', end - cursor));
+                if (fieldEnd == nullptr)
+                    fieldEnd = end;
+                std::string_view value(cursor, fieldEnd - cursor);
+                cursor = fieldEnd < end ? fieldEnd + 1 : end;
+                return value;
+            };
+            auto number = [&](auto& target)
+            {
+                auto value = field();
+                auto [ptr, error] = std::from_chars(value.data(), value.data() + value.size(), target);
+                return error == std::errc() && !value.empty();
+            };
+            bool parsed = number(record.Timestamp);
+            auto securityId = field();
+            field();
+            parsed = number(record.BidSize) && number(record.BidPrice) && number(record.AskPrice) && number(record.AskSize) && parsed;
+            if (!parsed)
+            {
+                ++Report[CleaningRule::Malformed].Matched;
+                if (Policy[CleaningRule::Malformed] != CleaningAction::Drop)
+                    throw Exception("Malformed tick line: " + std::string(begin, end));
+                ++Report[CleaningRule::Malformed].Dropped;
+                return;
+            }
+            if (!TickCleaner::CheckQuote(record, Policy, Report, std::string_view(begin, end - begin)))
+                return;
+            record.InstrumentId = _getInstrumentId(securityId);
+            Records.push_back(record);
+        }
+
+        inline u_int32_t _getInstrumentId(std::string_view securityId)
+        {
+            //consecutive lines mostly belong to the same instrument
+            if (!SecurityIds.empty() && SecurityIds[_lastId] == securityId)
+                return _lastId;
+            auto [iter, inserted] = _ids.try_emplace(std::string(securityId), SecurityIds.size());
+            if (inserted)
+                SecurityIds.emplace_back(securityId);
+            _lastId = iter->second;
+            return _lastId;
+        }
+
+    private:
+        std::unordered_map<std::string, u_int32_t> _ids;
+        u_int32_t _lastId{0};
+        std::string _carry;
+        size_t _expectedBytes{0};
+    };
+
+    class TickStore
+    {
+    /*
+    * Contiguous, time-sorted tick dataset.
+    * Records are either owned by the store (on huge pages when large, see HugePages) or live in an external read-only mapping.
+    */
+    public:
+        TickStore() = default;
+        TickStore(TickStore&) = delete;
+        TickStore(const TickStore&) = delete;
+        TickStore(TickStore&&) = delete;
+
+        TickStore(std::vector<std::string> securityIds, const TickRecord* records, size_t size, std::shared_ptr<const void> mapping):
+            _securityIds(std::move(securityIds)), _external(records), _externalSize(size), _mapping(std::move(mapping))
+        {
+            for (u_int32_t id = 0; id < _securityIds.size(); ++id)
+                _instrumentIds[_securityIds[id]] = id;
+        }
+
+        static std::shared_ptr<TickStore> FromFiles(const std::vector<std::string>& paths, size_t threads = GetHardwareThreads())
+        {
+            auto store = std::make_shared<TickStore>();
+            for (auto& path: paths)
+                store->LoadFile(path, threads);
+            store->Sort();
+            return store;
+        }
+
+        void LoadFile(const std::string& path, size_t threads = GetHardwareThreads())
+        {
+            /*
+            * Plain, gzip and zstd recorder files are accepted, the format is detected from the content.
+            * Plain files and multi-frame zstd archives are parsed in parallel chunks, other archives while they are decompressed.
+            * Updates are validated and cleaned in the same pass (see SetCleaning).
+            */
+            ARBSIM_PERF_SCOPE(Load);
+            _cleaner.Restart();
+            try
+            {
+                MappedFile file(path);
+                auto compression = CompressedInput::Detect(file.Data(), file.Size());
+                CompressedInput::Buffer buffer;
+                if (compression == Compression::None)
+                    _loadBuffer(file.Data(), file.Size(), threads);
+                else if (compression == Compression::Zstd && CompressedInput::DecompressFrames(file.Data(), file.Size(), threads, buffer))
+                    _loadBuffer(buffer.Data.get(), buffer.Size, threads);
+                else
+                {
+                    TickCSVParser parser;
+                    parser.Policy = _cleaner.GetPolicy();
+                    parser.SetExpectedSize(CompressedInput::GetContentSize(file.Data(), file.Size(), compression));
+                    CompressedInput::Stream(file.Data(), file.Size(), compression, [&](const char* data, size_t size)
+                    {
+                        parser.Feed(data, size);
+                    });
+                    parser.Finish();
+                    _append(parser);
+                }
+            }
+            catch(Exception& ex)
+            {
+                throw Exception(path + ": " + ex.what());
+            }
+        }
+
+        inline void Sort()
+        {
+            //Quite time consuming, but this application is not latency-sensitive
+            ARBSIM_PERF_SCOPE(Sort);
+            std::sort(_owned.begin(), _owned.end(), [](const TickRecord& a, const TickRecord& b){ return a.Timestamp < b.Timestamp;});
+        }
+
+        u_int32_t GetOrAddInstrument(const std::string& securityId)
+        {
+            auto iter = _instrumentIds.find(securityId);
+            if (iter != _instrumentIds.end())
+                return iter->second;
+            u_int32_t id = _securityIds.size();
+            _securityIds.push_back(securityId);
+            _instrumentIds[securityId] = id;
+            return id;
+        }
+
+        inline void SetCleaning(const CleaningPolicy& policy)
+        {
+            //applies to the files loaded afterwards
+            _cleaner.SetPolicy(policy);
+        }
+
+        inline const CleaningPolicy& GetCleaningPolicy() const
+        {
+            return _cleaner.GetPolicy();
+        }
+
+        inline const CleaningReport& GetCleaningReport() const
+        {
+            return _cleaning;
+        }
+
+        inline void MergeCleaningReport(const CleaningReport& report)
+        {
+            //of data cleaned before it got here, e.g. when the image it is mapped from was built
+            _cleaning.Merge(report);
+        }
+
+        inline void Append(const TickRecord& record)
+        {
+            _owned.push_back(record);
+        }
+
+        inline const TickRecord* Data() const
+        {
+            return _external != nullptr ? _external : _owned.data();
+        }
+
+        inline size_t Size() const
+        {
+            return _external != nullptr ? _externalSize : _owned.size();
+        }
+
+        inline const TickRecord& operator[](size_t index) const
+        {
+            return Data()[index];
+        }
+
+        inline const std::vector<std::string>& GetSecurityIds() const
+        {
+            return _securityIds;
+        }
+
+        inline bool IsMapped() const
+        {
+            return _external != nullptr;
+        }
+
+    private:
+        static constexpr size_t MIN_PARSE_CHUNK = 1 << 20;
+
+        void _loadBuffer(const char* data, size_t size, size_t threads)
+        {
+            //chunks end on line boundaries, they are appended in file order so the result does not depend on threads
+            size_t chunks = std::max<size_t>(1, std::min(threads, size / MIN_PARSE_CHUNK));
+            std::vector<const char*> bounds{data};
+            for (size_t i = 1; i < chunks; ++i)
+            {
+                const char* guess = std::max(bounds.back(), data + size * i / chunks);
+                auto lineEnd = static_cast<const char*>(std::memchr(guess, '\n', data + size - guess));
+                bounds.push_back(lineEnd == nullptr ? data + size : lineEnd + 1);
+            }
+            bounds.push_back(data + size);
+
+            std::vector<TickCSVParser> parsers(bounds.size() - 1);
+            for (auto& parser: parsers)
+                parser.Policy = _cleaner.GetPolicy();
+            ParallelFor(parsers.size(), threads, [&](size_t index, size_t)
+            {
+                ARBSIM_PERF_SCOPE(Load);
+                //counting lines first is far cheaper than growing the records vector
+                size_t lines = 1;
+                for (const char* p = bounds[index]; (p = static_cast<const char*>(std::memchr(p, '\n', bounds[index + 1] - p))) != nullptr; ++p)
+                    ++lines;
+                parsers[index].Records.reserve(lines);
+                parsers[index].Parse(bounds[index], bounds[index + 1]);
+            });
+            for (auto& parser: parsers)
+                _append(parser);
+        }
+
+        void _append(TickCSVParser& parser)
+        {
+            std::vector<u_int32_t> ids;
+            bool identity = true;
+            for (auto& securityId: parser.SecurityIds)
+            {
+                ids.push_back(GetOrAddInstrument(securityId));
+                identity = identity && ids.back() == ids.size() - 1;
+            }
+            _cleaning.Merge(parser.Report);
+            bool sequential = _cleaner.GetPolicy().IsSequential();
+            size_t size = _owned.size();
+            if (identity && _owned.empty())
+            {
+                //the first chunk is cleaned in place
+                if (sequential)
+                {
+                    size_t kept = 0;
+                    for (auto& record: parser.Records)
+                        if (_cleaner.Apply(record, _cleaning, _securityIds))
+                            parser.Records[kept++] = record;
+                    parser.Records.resize(kept);
+                }
+                _owned = std::move(parser.Records);
+            }
+            else
+            {
+                _owned.reserve(_owned.size() + parser.Records.size());
+                for (auto record: parser.Records)
+                {
+                    record.InstrumentId = ids[record.InstrumentId];
+                    if (!sequential || _cleaner.Apply(record, _cleaning, _securityIds))
+                        _owned.push_back(record);
+                }
+            }
+            _cleaning.Kept += _owned.size() - size;
+        }
+
+    private:
+        std::vector<std::string> _securityIds;
+        std::unordered_map<std::string, u_int32_t> _instrumentIds;
+        TickRecords _owned;
+        TickCleaner _cleaner;
+        CleaningReport _cleaning;
+        const TickRecord* _external{nullptr};
+        size_t _externalSize{0};
+        std::shared_ptr<const void> _mapping;
+    };
+    typedef std::shared_ptr<const TickStore> TickStorePtr;
+}
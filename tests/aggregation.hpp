@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include "../src/aggregation.hpp"
+#include "../src/synthetic.hpp"
+
+TEST(aggregation, BarAggregator_MatchesNaiveResampling)
+{
+    /*
+    * Test verifies that BarAggregator:
+    * 1) builds instrument bars equal to a straightforward pass over the ticks
+    * 2) builds pair bars from the as-of joined mids, including the state carried over from earlier buckets
+    * 3) returns the same bars whatever the number of threads
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    config.DurationNs = 1200ull * 1000000000ull;
+    config.UpdatesPerSecond = 0.5;
+    TickStorePtr store = SyntheticMarket(config).GenerateStore();
+    const u_int64_t bucketNs = 5000000000ull;
+
+    auto bars = BarAggregator(store, 1).GetInstrumentBars("FutureA", bucketNs);
+    auto pair = BarAggregator(store, 3).GetPairBars("FutureA", "FutureB", bucketNs);
+    ASSERT_EQ(bars.Size(), pair.Size());
+    ASSERT_GT(bars.Size(), 200);
+
+    std::vector<size_t> counts(bars.Size()), pairCounts(bars.Size());
+    std::vector<double> open(bars.Size()), close(bars.Size()), low(bars.Size(), 1e18), high(bars.Size(), -1e18), spreadMax(bars.Size(), 0);
+    std::vector<double> pairOpen(bars.Size()), pairClose(bars.Size()), pairSum(bars.Size()), notional(bars.Size()), size(bars.Size());
+    double midA = 0, midB = 0;
+    bool hasA = false, hasB = false;
+    for (size_t i = 0; i < store->Size(); ++i)
+    {
+        auto& record = (*store)[i];
+        size_t bucket = (record.Timestamp - bars.Timestamps[0]) / bucketNs;
+        double mid = (record.BidPrice + record.AskPrice) / 2;
+        if (record.InstrumentId == 0)
+        {
+            if (counts[bucket]++ == 0)
+                open[bucket] = mid;
+            close[bucket] = mid;
+            low[bucket] = std::min(low[bucket], mid);
+            high[bucket] = std::max(high[bucket], mid);
+            spreadMax[bucket] = std::max(spreadMax[bucket], record.AskPrice - record.BidPrice);
+            notional[bucket] += record.BidPrice * record.BidSize + record.AskPrice * record.AskSize;
+            size[bucket] += record.BidSize + record.AskSize;
+            midA = mid;
+            hasA = true;
+        }
+        else
+        {
+            midB = mid;
+            hasB = true;
+        }
+        if (hasA && hasB)
+        {
+            if (pairCounts[bucket]++ == 0)
+                pairOpen[bucket] = midA - midB;
+            pairClose[bucket] = midA - midB;
+            pairSum[bucket] += midA - midB;
+        }
+    }
+
+    size_t empty = 0;
+    for (size_t bucket = 0; bucket < bars.Size(); ++bucket)
+    {
+        ASSERT_EQ(bars.Counts[bucket], counts[bucket]);
+        ASSERT_EQ(pair.Counts[bucket], pairCounts[bucket]);
+        if (counts[bucket] == 0)
+        {
+            EXPECT_TRUE(std::isnan(bars.Open[bucket]));
+            ++empty;
+        }
+        else
+        {
+            EXPECT_EQ(bars.Open[bucket], open[bucket]);
+            EXPECT_EQ(bars.Close[bucket], close[bucket]);
+            EXPECT_EQ(bars.Low[bucket], low[bucket]);
+            EXPECT_EQ(bars.High[bucket], high[bucket]);
+            EXPECT_EQ(bars.SpreadMax[bucket], spreadMax[bucket]);
+            EXPECT_NEAR(bars.VwapOfTop[bucket], notional[bucket] / size[bucket], 1e-9);
+        }
+        if (pairCounts[bucket] > 0)
+        {
+            EXPECT_EQ(pair.Open[bucket], pairOpen[bucket]);
+            EXPECT_EQ(pair.Close[bucket], pairClose[bucket]);
+            EXPECT_NEAR(pair.Mean[bucket], pairSum[bucket] / pairCounts[bucket], 1e-9);
+            EXPECT_LE(pair.Low[bucket], pair.Mean[bucket] + 1e-9);
+        }
+    }
+    EXPECT_GT(empty, 0);
+
+    auto parallel = BarAggregator(store, 4).GetInstrumentBars("FutureA", bucketNs);
+    EXPECT_EQ(parallel.Counts, bars.Counts);
+    EXPECT_EQ(std::memcmp(parallel.SpreadMean.data(), bars.SpreadMean.data(), bars.Size() * sizeof(double)), 0);
+    EXPECT_THROW(BarAggregator(store, 1).GetInstrumentBars("FutureC", bucketNs), Exception);
+}
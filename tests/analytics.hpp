@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include "../src/arbitrage.hpp"
+
+TEST(analytics, PerformanceAnalytics_EquityCurveStatistics)
+{
+    /*
+    * Test verifies that PerformanceAnalytics:
+    * 1) tracks max drawdown and time under water
+    * 2) samples the curve at bucket boundaries, including empty buckets
+    * 3) computes bucket return statistics
+    */
+    using namespace ArbSimulation;
+    PerformanceAnalytics analytics(10, PerformanceAnalytics::GetCapacity(0, 45, 10));
+    analytics.OnEquity(0, 0);
+    analytics.OnEquity(5, 10);
+    analytics.OnEquity(12, 4);
+    analytics.OnEquity(18, 7);
+    analytics.OnEquity(31, 12);
+    analytics.OnEquity(33, 9);
+    analytics.OnEquity(45, 10);
+    analytics.Finish();
+
+    EXPECT_DOUBLE_EQ(analytics.GetMaxDrawdown(), 6);
+    EXPECT_EQ(analytics.GetTimeUnderWater(), 6 + 13 + 12);
+    EXPECT_EQ(analytics.GetLongestUnderWater(), 31 - 12);
+
+    std::vector<u_int64_t> timestamps{10, 20, 30, 40, 50};
+    std::vector<double> equity{10, 7, 7, 9, 10};
+    EXPECT_EQ(analytics.GetSampleTimestamps(), timestamps);
+    EXPECT_EQ(analytics.GetSampleEquity(), equity);
+
+    std::vector<double> returns{10, -3, 0, 2, 1};
+    double mean = 2;
+    double variance = 0;
+    for (auto r: returns)
+        variance += (r - mean) * (r - mean) / (returns.size() - 1);
+    EXPECT_EQ(analytics.GetReturnsCount(), 5);
+    EXPECT_DOUBLE_EQ(analytics.GetMeanReturn(), mean);
+    EXPECT_NEAR(analytics.GetSharpe(), mean / std::sqrt(variance), 1e-12);
+    EXPECT_NEAR(analytics.GetSortino(), mean / std::sqrt(9.0 / 5), 1e-12);
+}
+
+TEST(analytics, PerformanceAnalytics_MatchesStrategyPnL)
+{
+    /*
+    * Test verifies that equity tracked incrementally during replay
+    * ends at the same value as GetFullPnL() and turnover covers every fill
+    */
+    using namespace ArbSimulation;
+    auto instrManager = std::make_shared<InstrumentManager>();
+    auto marketDataManager = std::make_shared<MarketDataSimulationManager>(instrManager,
+        std::vector<std::string>{"../../tests/data/arb_strategy_test_A.csv", "../../tests/data/arb_strategy_test_B.csv"});
+    std::unordered_map<std::string, u_int64_t> latencies({{"FutureA", 0}, {"FutureB", 0}});
+    auto orderMatcher = std::make_shared<OrderMatcher>(latencies);
+    auto arbStrategy = std::make_shared<ArbitrageStrategy>(5, 2, -150, instrManager);
+    auto analytics = std::make_shared<PerformanceAnalytics>(4, 16);
+    arbStrategy->EnableAnalytics(analytics);
+
+    arbStrategy->AddSubscriber(orderMatcher);
+    orderMatcher->AddSubscriber(arbStrategy);
+    marketDataManager->AddSubscriber(orderMatcher);
+    marketDataManager->AddSubscriber(arbStrategy);
+    while(marketDataManager->Step());
+    analytics->Finish();
+
+    EXPECT_NEAR(analytics->GetFinalEquity(), arbStrategy->GetFullPnL(), 1e-6);
+    double turnover = 0;
+    for (auto& trade: arbStrategy->GetTrades())
+        turnover += trade->Qty * trade->ExecPrice;
+    EXPECT_DOUBLE_EQ(analytics->GetTurnover(), turnover);
+    EXPECT_EQ(analytics->GetFills(), arbStrategy->GetTrades().size());
+    EXPECT_GE(analytics->GetMaxDrawdown(), 0);
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include "../src/runner.hpp"
+#include "../src/synthetic.hpp"
+
+TEST(arena, Arena_AlignsAndReusesBlocks)
+{
+    /*
+    * Test verifies that arena blocks are cache-line aligned and do not overlap,
+    * freed blocks are reused by their size class and large blocks get their own mapping
+    */
+    using namespace ArbSimulation;
+    Arena arena;
+    std::vector<std::pair<std::byte*, size_t>> blocks;
+    for (size_t bytes: {1, 40, 64, 65, 200, 1000, 5000, 70000})
+    {
+        auto block = static_cast<std::byte*>(arena.Allocate(bytes));
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(block) % Arena::CACHE_LINE, 0);
+        std::memset(block, 0xAB, bytes);
+        blocks.push_back({block, bytes});
+    }
+    for (size_t i = 0; i < blocks.size(); ++i)
+        for (size_t j = i + 1; j < blocks.size(); ++j)
+            EXPECT_TRUE(blocks[i].first + blocks[i].second <= blocks[j].first || blocks[j].first + blocks[j].second <= blocks[i].first);
+    EXPECT_EQ(arena.GetStats().Chunks, 2);
+    EXPECT_EQ(arena.GetStats().UsedBytes, 64 + 64 + 64 + 128 + 256 + 1024 + 8192 + 131072);
+
+    arena.Deallocate(blocks[4].first, blocks[4].second);
+    EXPECT_EQ(arena.Allocate(129), blocks[4].first);
+    EXPECT_EQ(arena.GetStats().Reused, 1);
+
+    size_t reserved = arena.GetStats().ReservedBytes;
+    void* large = arena.Allocate(3 << 20);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(large) % HugePages::HUGE_PAGE, 0);
+    EXPECT_EQ(arena.GetStats().ReservedBytes, reserved + (4 << 20));
+    arena.Deallocate(large, 3 << 20);
+    EXPECT_EQ(arena.GetStats().ReservedBytes, reserved);
+    EXPECT_EQ(arena.GetStats().PeakBytes, arena.GetStats().UsedBytes + (4 << 20));
+}
+
+TEST(arena, HugePages_MapsLargeArraysAndFallsBack)
+{
+    /*
+    * Test verifies that large arrays are mapped on 2MB boundaries, are reported while they live,
+    * that small ones are cache-line aligned, and that disabling huge pages falls back to regular pages
+    */
+    using namespace ArbSimulation;
+    for (size_t size: {1, 3, 100, 1000})
+    {
+        std::vector<double, HugePageAllocator<double>> column(size);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(column.data()) % HugePageAllocator<double>::ALIGNMENT, 0);
+    }
+    auto before = HugePages::GetUsage();
+    {
+        TickRecords records(100000);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(records.data()) % HugePages::HUGE_PAGE, 0);
+        auto usage = HugePages::GetUsage();
+        EXPECT_EQ(usage.Mappings, before.Mappings + 1);
+        size_t mapped = 0;
+        for (size_t i = 0; i < 3; ++i)
+            mapped += usage.Bytes[i] - before.Bytes[i];
+        EXPECT_EQ(mapped, 6 << 20);
+        records.back().Timestamp = 1;
+    }
+    EXPECT_EQ(HugePages::GetUsage().Mappings, before.Mappings);
+
+    HugePages::SetEnabled(false);
+    auto block = HugePages::Map(HugePages::HUGE_PAGE);
+    HugePages::SetEnabled(true);
+    EXPECT_EQ(block.Backing, PageBacking::Normal);
+    EXPECT_EQ(HugePages::Unmap(block.Address), HugePages::HUGE_PAGE);
+}
+
+TEST(arena, SimulationRun_KeepsHotStateInItsArena)
+{
+    /*
+    * Test verifies that orders, trades and matcher queues of a run come from its arena,
+    * results do not change, and the strategy stays usable after the run is gone
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    auto store = SyntheticMarket(config).GenerateStore();
+    std::unordered_map<std::string, u_int64_t> latencies{{"FutureA", 0}, {"FutureB", 5000000}};
+    RunParameters parameters{1, 2, -150, latencies};
+
+    auto instrManager = std::make_shared<InstrumentManager>();
+    auto expected = std::make_shared<ArbitrageStrategy>(1, 2, -150, instrManager);
+    auto manager = std::make_shared<MarketDataSimulationManager>(instrManager, store);
+    auto matcher = std::make_shared<OrderMatcher>(latencies);
+    expected->AddSubscriber(matcher);
+    matcher->AddSubscriber(expected);
+    manager->AddSubscriber(matcher);
+    manager->AddSubscriber(expected);
+    while (manager->Step());
+    EXPECT_FALSE(expected->GetTrades().get_allocator().GetArena());
+
+    std::shared_ptr<ArbitrageStrategy> strategy;
+    {
+        SimulationRun run(store, parameters);
+        auto result = run.Run();
+        strategy = run.GetStrategy();
+        auto& stats = run.GetArenaStats();
+        EXPECT_EQ(result.PnL, expected->GetFullPnL());
+        EXPECT_EQ(result.Trades, expected->GetTrades().size());
+        EXPECT_GT(stats.Allocations, result.Trades);
+        EXPECT_GT(stats.Reused, 0);
+        EXPECT_GE(stats.ReservedBytes, stats.PeakBytes);
+        EXPECT_EQ(Arena::GetCurrent(), nullptr);
+    }
+    EXPECT_TRUE(strategy->GetTrades().get_allocator().GetArena());
+    EXPECT_EQ(strategy->GetFullPnL(), expected->GetFullPnL());
+    EXPECT_EQ(strategy->GetTrades().back()->ExecPrice, expected->GetTrades().back()->ExecPrice);
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include <set>
+#include "../src/runner.hpp"
+#include "../src/synthetic.hpp"
+
+TEST(bootstrap, BootstrapBlocks_OriginalOrderReproducesReplay)
+{
+    /*
+    * Test verifies that a path of all blocks in their original order replays exactly like the store
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    auto store = SyntheticMarket(config).GenerateStore();
+    BootstrapBlocks blocks(*store, 60000000000ull);
+    ASSERT_EQ(blocks.Size(), 60);
+
+    std::vector<size_t> order(blocks.Size());
+    std::iota(order.begin(), order.end(), 0);
+    std::unordered_map<std::string, u_int64_t> latencies{{"FutureA", 0}, {"FutureB", 5000000}};
+    RunParameters parameters{1, 2, -150, latencies};
+    auto expected = SimulationRun(store, parameters).Run();
+    parameters.Path = blocks.MakePath(order);
+    auto actual = SimulationRun(store, parameters).Run();
+    EXPECT_GT(expected.Trades, 0);
+    EXPECT_EQ(actual.PnL, expected.PnL);
+    EXPECT_EQ(actual.Trades, expected.Trades);
+    EXPECT_EQ(actual.Ticks, store->Size());
+}
+
+TEST(bootstrap, BootstrapBlocks_SeamsCarryConsistentBooks)
+{
+    /*
+    * Test verifies that at a seam:
+    * 1) time keeps going forward and every instrument's book is re-sent as it was at the start of the new block
+    * 2) rebasing moves all instruments by one offset, so spreads between them are kept
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    auto store = SyntheticMarket(config).GenerateStore();
+    BootstrapBlocks blocks(*store, 60000000000ull);
+    auto path = blocks.MakePath({10, 3, 4});
+    ASSERT_EQ(path->Segments.size(), 3);
+    auto& seam = path->Segments[1];
+    EXPECT_EQ(path->Segments[0].SnapshotEnd - path->Segments[0].SnapshotBegin, 2);
+    EXPECT_EQ(seam.SnapshotEnd - seam.SnapshotBegin, 2);
+    EXPECT_EQ(path->Segments[2].SnapshotEnd - path->Segments[2].SnapshotBegin, 0);
+    EXPECT_EQ(path->Segments[2].PriceShift, seam.PriceShift);
+
+    struct Recorder: public Subscriber
+    {
+        void OnNewMessage(MessagePtr message) override
+        {
+            auto& update = std::static_pointer_cast<MDUpdateMessage>(message)->Update;
+            Updates.push_back({update->Timestamp, update->Instrument->SecurityId, update->BidPrice, update->AskPrice});
+        }
+        std::vector<std::tuple<u_int64_t, std::string, double, double>> Updates;
+    };
+    auto recorder = std::make_shared<Recorder>();
+    MarketDataSimulationManager manager(std::make_shared<InstrumentManager>(), store);
+    manager.EnablePath(path);
+    manager.AddSubscriber(recorder);
+    while (manager.Step());
+
+    //the first block of a path also starts from the books before it
+    size_t expected = 0;
+    for (auto& segment: path->Segments)
+        expected += segment.SnapshotEnd - segment.SnapshotBegin + segment.End - segment.Begin;
+    ASSERT_EQ(recorder->Updates.size(), expected);
+    size_t firstBlock = path->Segments[0].SnapshotEnd - path->Segments[0].SnapshotBegin + path->Segments[0].End - path->Segments[0].Begin;
+    for (size_t i = 1; i < recorder->Updates.size(); ++i)
+        EXPECT_LE(std::get<0>(recorder->Updates[i - 1]), std::get<0>(recorder->Updates[i]));
+
+    //the snapshot is the last record of each instrument before block 3, shifted to the seam
+    for (size_t i = 0; i < 2; ++i)
+    {
+        auto& [timestamp, securityId, bid, ask] = recorder->Updates[firstBlock + i];
+        auto& original = (*store)[(*path->Snapshots)[seam.SnapshotBegin + i]];
+        EXPECT_LT(original.Timestamp, (*store)[seam.Begin].Timestamp);
+        EXPECT_EQ(timestamp, seam.Start);
+        EXPECT_EQ(securityId, store->GetSecurityIds()[original.InstrumentId]);
+        EXPECT_DOUBLE_EQ(bid, original.BidPrice + seam.PriceShift);
+        EXPECT_DOUBLE_EQ(ask - bid, original.AskPrice - original.BidPrice);
+    }
+    auto& first = (*store)[seam.Begin];
+    EXPECT_EQ(std::get<0>(recorder->Updates[firstBlock + 2]), first.Timestamp + seam.TimeShift);
+    EXPECT_DOUBLE_EQ(std::get<2>(recorder->Updates[firstBlock + 2]), first.BidPrice + seam.PriceShift);
+}
+
+TEST(bootstrap, BootstrapRunner_ReportsIntervalsIndependentlyOfThreads)
+{
+    /*
+    * Test verifies that bootstrap paths differ from each other, do not depend on the number of threads,
+    * and that PnL and drawdown quantiles are reported
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    auto store = SyntheticMarket(config).GenerateStore();
+    std::unordered_map<std::string, u_int64_t> latencies{{"FutureA", 0}, {"FutureB", 0}};
+    RunParameters parameters{1, 2, -150, latencies};
+    BootstrapOptions options;
+    options.Paths = 12;
+    options.Seed = 5;
+
+    auto single = BootstrapRunner(store, 1).Run(parameters, options);
+    auto parallel = BootstrapRunner(store, 3).Run(parameters, options);
+    ASSERT_EQ(single.size(), options.Paths);
+    std::set<double> pnls;
+    for (size_t i = 0; i < single.size(); ++i)
+    {
+        EXPECT_EQ(single[i].Path, i);
+        EXPECT_EQ(single[i].PnL, parallel[i].PnL);
+        EXPECT_EQ(single[i].MaxDrawdown, parallel[i].MaxDrawdown);
+        EXPECT_GE(single[i].MaxDrawdown, 0);
+        EXPECT_GT(single[i].Trades, 0);
+        pnls.insert(single[i].PnL);
+    }
+    EXPECT_GT(pnls.size(), 1);
+
+    auto quantiles = BootstrapRunner::ToQuantileReport(single, {0.05, 0.5, 0.95});
+    ASSERT_EQ(quantiles.size(), 4);
+    EXPECT_EQ(quantiles[0], (std::vector<std::string>{"Quantile", "PnL", "MaxDrawdown"}));
+    EXPECT_LE(std::stod(quantiles[1][1]), std::stod(quantiles[3][1]));
+    EXPECT_LE(std::stod(quantiles[1][2]), std::stod(quantiles[3][2]));
+}
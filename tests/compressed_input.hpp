@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include "../src/synthetic.hpp"
+
+TEST(compressed_input, TickStore_ParserMatchesCSVIO)
+{
+    /*
+    * Test verifies that the buffer parser reads recorder files exactly like CSVIO with std::stod,
+    * in file order and independently of the number of threads
+    */
+    using namespace ArbSimulation;
+    for (auto path: {"../../tests/data/arb_strategy_test_A.csv", "../../tests/data/csv_io_test_case_1.csv",
+        "../../tests/data/csv_io_test_case_2.csv", "../../tests/data/csv_io_test_case_3.csv", "../../tests/data/order_matcher_test_2.csv"})
+    {
+        auto lines = CSVIO::ReadFile(path);
+        TickStore single;
+        single.LoadFile(path, 1);
+        TickStore parallel;
+        parallel.LoadFile(path, 4);
+        ASSERT_EQ(single.Size(), lines.size());
+        ASSERT_EQ(parallel.Size(), lines.size());
+        EXPECT_EQ(std::memcmp(single.Data(), parallel.Data(), single.Size() * sizeof(TickRecord)), 0);
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            EXPECT_EQ(single[i].Timestamp, std::stoull(lines[i][0]));
+            EXPECT_EQ(single.GetSecurityIds()[single[i].InstrumentId], lines[i][1]);
+            EXPECT_EQ(single[i].BidSize, std::stod(lines[i][3]));
+            EXPECT_EQ(single[i].BidPrice, std::stod(lines[i][4]));
+            EXPECT_EQ(single[i].AskPrice, std::stod(lines[i][5]));
+            EXPECT_EQ(single[i].AskSize, std::stod(lines[i][6]));
+        }
+    }
+}
+
+#if defined(ARBSIM_HAS_ZLIB) && defined(ARBSIM_HAS_ZSTD)
+TEST(compressed_input, TickStore_LoadsCompressedFiles)
+{
+    /*
+    * Test verifies that gzip (one or several members), single-frame and multi-frame zstd files
+    * load into the same records as the plain file, and that damaged archives are reported
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    auto generated = SyntheticMarket(config).GenerateStore();
+    std::string text;
+    char line[256];
+    for (size_t i = 0; i < generated->Size(); ++i)
+        text.append(line, SyntheticMarket::FormatCSV((*generated)[i], generated->GetSecurityIds()[(*generated)[i].InstrumentId], line));
+    ASSERT_GT(text.size(), 2 * CompressedInput::CHUNK_SIZE);
+
+    auto gzip = [](std::string_view input)
+    {
+        z_stream stream{};
+        deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        std::string output(deflateBound(&stream, input.size()), '\0');
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream.avail_in = input.size();
+        stream.next_out = reinterpret_cast<Bytef*>(output.data());
+        stream.avail_out = output.size();
+        deflate(&stream, Z_FINISH);
+        output.resize(stream.total_out);
+        deflateEnd(&stream);
+        return output;
+    };
+    auto zstdFrame = [](std::string_view input, bool recordSize)
+    {
+        std::string output(ZSTD_compressBound(input.size()), '\0');
+        std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+        ZSTD_inBuffer in{input.data(), input.size(), 0};
+        ZSTD_outBuffer out{output.data(), output.size(), 0};
+        if (recordSize)
+            ZSTD_CCtx_setPledgedSrcSize(context.get(), input.size());
+        else
+            ZSTD_CCtx_setParameter(context.get(), ZSTD_c_contentSizeFlag, 0);
+        ZSTD_compressStream2(context.get(), &out, &in, ZSTD_e_end);
+        output.resize(out.pos);
+        return output;
+    };
+
+    //frames and members are split in the middle of lines on purpose
+    std::string_view view(text);
+    size_t half = view.size() / 2 + 7;
+    std::string multiFrame;
+    for (size_t offset = 0; offset < view.size(); offset += 1000003)
+        multiFrame += zstdFrame(view.substr(offset, 1000003), true);
+
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_compressed_test";
+    std::filesystem::create_directories(directory);
+    std::vector<std::pair<std::string, std::string>> files{
+        {"plain.csv", text},
+        {"single.csv.gz", gzip(view)},
+        {"members.csv.gz", gzip(view.substr(0, half)) + gzip(view.substr(half))},
+        {"stream.csv.zst", zstdFrame(view, false)},
+        {"frames.csv.zst", multiFrame}};
+    for (auto& [name, content]: files)
+        std::ofstream((directory / name).string(), std::ios::binary).write(content.data(), content.size());
+
+    TickStore expected;
+    expected.LoadFile((directory / "plain.csv").string());
+    ASSERT_EQ(expected.Size(), generated->Size());
+    for (auto& [name, content]: files)
+    {
+        TickStore store;
+        store.LoadFile((directory / name).string(), 3);
+        ASSERT_EQ(store.Size(), expected.Size()) << name;
+        EXPECT_EQ(store.GetSecurityIds(), expected.GetSecurityIds()) << name;
+        EXPECT_EQ(std::memcmp(store.Data(), expected.Data(), expected.Size() * sizeof(TickRecord)), 0) << name;
+    }
+
+    auto truncated = std::get<1>(files[1]).substr(0, std::get<1>(files[1]).size() / 2);
+    std::ofstream((directory / "truncated.csv.gz").string(), std::ios::binary).write(truncated.data(), truncated.size());
+    TickStore damaged;
+    EXPECT_THROW(damaged.LoadFile((directory / "truncated.csv.gz").string()), Exception);
+    std::filesystem::remove_all(directory);
+}
+#endif
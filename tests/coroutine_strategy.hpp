@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#include "../src/coroutine_strategy.hpp"
+#include "../src/runner.hpp"
+#include "../src/synthetic.hpp"
+
+namespace
+{
+    using namespace ArbSimulation;
+
+    class CoroutineArbitrage: public CoroutineStrategy
+    {
+    /*
+    * ArbitrageStrategy with absolute spreads written as coroutines: one workflow keeps the last FutureA update,
+    * the other trades on FutureB updates and waits for both legs before looking at the next update
+    */
+    public:
+        CoroutineArbitrage(double X, double Y, double Z, std::shared_ptr<InstrumentManager> instrManager):
+            CoroutineStrategy(instrManager), _parameterX(X), _parameterY(Y), _parameterZ(Z)
+        {}
+
+        Task<> Run() override
+        {
+            Spawn(TrackA());
+            for (auto update = GetLastUpdate();; update = co_await NextTick())
+            {
+                if (update->Instrument->SecurityId != "FutureB" || !_lastA)
+                    continue;
+                auto& positionA = GetPosition("FutureA");
+                auto& positionB = GetPosition("FutureB");
+                if (positionA.GetNetQty() != -positionB.GetNetQty())
+                    throw StrategyException("Legs are not in sync");
+
+                if (positionA.GetNetQty() != 0 && positionA.GetPnL() + positionB.GetPnL() < _parameterZ)
+                {
+                    co_await Hedge(SendSL("FutureA"), SendSL("FutureB"));
+                    co_return;
+                }
+                if (positionA.GetNetQty() > -_parameterY && _lastA->BidPrice - update->AskPrice >= _parameterX)
+                    Hedges += co_await Hedge(SendMarketOrder("FutureA", 1, OrderSide::Sell), SendMarketOrder("FutureB", 1, OrderSide::Buy));
+                else if (positionA.GetNetQty() < _parameterY && update->BidPrice - _lastA->AskPrice >= _parameterX)
+                    Hedges += co_await Hedge(SendMarketOrder("FutureA", 1, OrderSide::Buy), SendMarketOrder("FutureB", 1, OrderSide::Sell));
+            }
+        }
+
+        Task<> TrackA()
+        {
+            for (auto update = GetLastUpdate();; update = co_await NextTick())
+                if (update->Instrument->SecurityId == "FutureA")
+                    _lastA = update;
+        }
+
+        Task<size_t> Hedge(OrderPtr a, OrderPtr b)
+        {
+            co_await WaitFill(a);
+            co_await WaitFill(b);
+            co_return 1;
+        }
+
+        size_t Hedges = 0;
+
+    private:
+        L1UpdatePtr _lastA;
+        double _parameterX;
+        double _parameterY;
+        double _parameterZ;
+    };
+
+    template<typename Strategy>
+    void Replay(TickStorePtr store, std::shared_ptr<InstrumentManager> instrManager, std::shared_ptr<Strategy> strategy,
+        const std::unordered_map<std::string, u_int64_t>& latencies, size_t ticks = std::numeric_limits<size_t>::max())
+    {
+        auto manager = std::make_shared<MarketDataSimulationManager>(instrManager, store);
+        auto matcher = std::make_shared<OrderMatcher>(latencies);
+        strategy->AddSubscriber(matcher);
+        matcher->AddSubscriber(strategy);
+        manager->AddSubscriber(matcher);
+        manager->AddSubscriber(strategy);
+        for (size_t i = 0; i < ticks && manager->Step(); ++i);
+    }
+}
+
+TEST(coroutine_strategy, CoroutineStrategy_ReproducesCallbackStrategy)
+{
+    /*
+    * Test verifies that the coroutine port of ArbitrageStrategy trades exactly like the callback version
+    */
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    auto store = SyntheticMarket(config).GenerateStore();
+    std::unordered_map<std::string, u_int64_t> latencies{{"FutureA", 0}, {"FutureB", 5000000}};
+    for (double z: {-150.0, -1.0})
+    {
+        auto expected = SimulationRun(store, RunParameters{2, 2, z, latencies}).Run();
+        auto instrManager = std::make_shared<InstrumentManager>();
+        auto strategy = std::make_shared<CoroutineArbitrage>(2, 2, z, instrManager);
+        Replay(store, instrManager, strategy, latencies);
+        EXPECT_GT(expected.Trades, 0);
+        EXPECT_EQ(strategy->GetTrades().size(), expected.Trades);
+        EXPECT_EQ(strategy->GetFullPnL(), expected.PnL);
+        EXPECT_EQ(strategy->Hedges * 2 + (z == -1.0 ? 2 : 0), expected.Trades);
+    }
+}
+
+TEST(coroutine_strategy, FramePool_ReusesFramesWithoutHeap)
+{
+    /*
+    * Test verifies that frames of finished workflows are reused: once warmed up,
+    * thousands of hedges do not add chunks, and nothing falls back to the heap
+    */
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    auto store = SyntheticMarket(config).GenerateStore();
+    std::unordered_map<std::string, u_int64_t> latencies{{"FutureA", 0}, {"FutureB", 0}};
+    auto instrManager = std::make_shared<InstrumentManager>();
+    auto strategy = std::make_shared<CoroutineArbitrage>(0.5, 2, -1e9, instrManager);
+    auto manager = std::make_shared<MarketDataSimulationManager>(instrManager, store);
+    auto matcher = std::make_shared<OrderMatcher>(latencies);
+    strategy->AddSubscriber(matcher);
+    matcher->AddSubscriber(strategy);
+    manager->AddSubscriber(matcher);
+    manager->AddSubscriber(strategy);
+
+    for (size_t i = 0; i < 1000 && manager->Step(); ++i);
+    auto warm = strategy->GetFramePool().GetStats();
+    size_t hedges = strategy->Hedges;
+    while (manager->Step());
+    auto& stats = strategy->GetFramePool().GetStats();
+    EXPECT_GT(strategy->Hedges - hedges, 100);
+    EXPECT_EQ(stats.Allocations - warm.Allocations, strategy->Hedges - hedges);
+    EXPECT_EQ(stats.Chunks, warm.Chunks);
+    EXPECT_EQ(stats.HeapFallbacks, 0);
+    EXPECT_EQ(stats.InUse, 2);
+    EXPECT_EQ(strategy->GetWorkflows(), 2);
+}
+
+TEST(coroutine_strategy, CoroutineStrategy_TimeoutsAndErrors)
+{
+    /*
+    * Test verifies that:
+    * 1) a fill wait returns nullptr once replay time passes its timeout, and the fill can be awaited again
+    * 2) Sleep resumes on the first update at or after its deadline, counted from the fill
+    * 3) an exception thrown in a nested task reaches the caller and is rethrown from the strategy callback
+    */
+    struct Workflow: public CoroutineStrategy
+    {
+        Workflow(std::shared_ptr<InstrumentManager> instrManager): CoroutineStrategy(instrManager)
+        {}
+
+        Task<> Run() override
+        {
+            auto order = SendMarketOrder("FutureA", 1, OrderSide::Buy);
+            auto filled = co_await WaitFill(order, 1500);
+            Events.push_back({"timeout", filled ? 1 : 0, GetLastUpdate()->Timestamp});
+            filled = co_await WaitFill(order);
+            Events.push_back({"fill", filled == order ? 1 : 0, filled->ExecutedTimestamp});
+            auto update = co_await Sleep(2500);
+            Events.push_back({"sleep", 1, update->Timestamp});
+            co_await Fail();
+        }
+
+        Task<> Fail()
+        {
+            co_await NextTick();
+            throw StrategyException("Retries are exhausted");
+        }
+
+        std::vector<std::tuple<std::string, int, u_int64_t>> Events;
+    };
+
+    auto instrManager = std::make_shared<InstrumentManager>();
+    auto strategy = std::make_shared<Workflow>(instrManager);
+    auto matcher = std::make_shared<OrderMatcher>(std::unordered_map<std::string, u_int64_t>{{"FutureA", 2500}});
+    strategy->AddSubscriber(matcher);
+    matcher->AddSubscriber(strategy);
+    auto send = [&](u_int64_t timestamp)
+    {
+        auto message = std::make_shared<MDUpdateMessage>();
+        message->Update = std::make_shared<L1Update>();
+        message->Update->Instrument = instrManager->GetOrCreateInstrument("FutureA");
+        message->Update->Timestamp = timestamp;
+        message->Update->BidPrice = 100;
+        message->Update->AskPrice = 101;
+        matcher->OnNewMessage(message);
+        strategy->OnNewMessage(message);
+    };
+    for (u_int64_t timestamp: {1000, 2000, 3000, 4000, 5000, 6000})
+        send(timestamp);
+    EXPECT_THROW(send(7000), StrategyException);
+
+    using Event = std::tuple<std::string, int, u_int64_t>;
+    EXPECT_EQ(strategy->Events, (std::vector<Event>{{"timeout", 0, 3000}, {"fill", 1, 3500}, {"sleep", 1, 6000}}));
+    EXPECT_EQ(strategy->GetWorkflows(), 0);
+    EXPECT_EQ(strategy->GetFramePool().GetStats().InUse, 0);
+}
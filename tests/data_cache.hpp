@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+#include <csignal>
+#include <sys/resource.h>
+#include "../src/data_cache.hpp"
+
+TEST(data_cache, DataCache_WarmLoadMatchesParsedData)
+{
+    /*
+    * Test verifies that DataCache:
+    * 1) builds an entry on the first load
+    * 2) maps the entry on the second load instead of parsing
+    * 3) returns exactly the same sorted dataset
+    */
+    using namespace ArbSimulation;
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_cache_test_1";
+    std::filesystem::remove_all(directory);
+    std::vector<std::string> datasets{"../../tests/data/csv_io_test_case_2.csv", "../../tests/data/csv_io_test_case_3.csv"};
+
+    DataCache cache(directory.string());
+    auto cold = cache.LoadOrBuild(datasets);
+    EXPECT_EQ(cache.GetLastStatus(), "miss");
+    EXPECT_FALSE(cold->IsMapped());
+
+    auto warm = cache.LoadOrBuild(datasets);
+    EXPECT_EQ(cache.GetLastStatus(), "hit");
+    EXPECT_TRUE(warm->IsMapped());
+
+    ASSERT_EQ(cold->Size(), warm->Size());
+    EXPECT_EQ(cold->GetSecurityIds(), warm->GetSecurityIds());
+    EXPECT_EQ(std::memcmp(cold->Data(), warm->Data(), cold->Size() * sizeof(TickRecord)), 0);
+    for (size_t i = 1; i < warm->Size(); ++i)
+        EXPECT_LE((*warm)[i - 1].Timestamp, (*warm)[i].Timestamp);
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(data_cache, DataCache_DetectsStaleAndCorruptEntries)
+{
+    /*
+    * Test verifies that DataCache:
+    * 1) accepts a touched but unchanged source through its content hash
+    * 2) records the new mtime and size of such a source in the entry
+    * 3) rebuilds an entry whose source has changed
+    * 4) rebuilds an entry with a damaged payload, which it verifies by default
+    */
+    using namespace ArbSimulation;
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_cache_test_2";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    auto source = (directory / "source.csv").string();
+    std::filesystem::copy_file("../../tests/data/order_matcher_test_1.csv", source);
+
+    DataCache cache((directory / "cache").string());
+    auto initial = cache.LoadOrBuild({source});
+    EXPECT_EQ(cache.GetLastStatus(), "miss");
+
+    std::filesystem::last_write_time(source, std::filesystem::last_write_time(source) + std::chrono::seconds(5));
+    cache.LoadOrBuild({source});
+    EXPECT_EQ(cache.GetLastStatus(), "hit");
+
+    auto touched = SourceInfo::Stat(source);
+    auto entry = TickImage::Map(cache.GetEntryPath({touched}), true);
+    ASSERT_EQ(entry.Sources.size(), 1u);
+    EXPECT_EQ(entry.Sources[0].MTime, touched.MTime);
+    EXPECT_EQ(entry.Sources[0].Size, touched.Size);
+    EXPECT_EQ(entry.Sources[0].ContentHash, Hasher::HashFile(source));
+    cache.LoadOrBuild({source});
+    EXPECT_EQ(cache.GetLastStatus(), "hit");
+
+    {
+        std::ofstream file{source, std::ios::app};
+        file << "\n100,FutureA,2,6,1000,1001,2";
+    }
+    auto changed = cache.LoadOrBuild({source});
+    EXPECT_EQ(cache.GetLastStatus(), "stale");
+    EXPECT_EQ(changed->Size(), initial->Size() + 1);
+
+    auto entryPath = cache.GetEntryPath({SourceInfo::Stat(source)});
+    {
+        std::fstream file{entryPath, std::ios::in | std::ios::out | std::ios::binary};
+        file.seekp(-sizeof(TickImage::Footer) - 3, std::ios::end);
+        file.put('\x7f');
+    }
+    auto rebuilt = cache.LoadOrBuild({source});
+    EXPECT_EQ(cache.GetLastStatus().rfind("corrupt", 0), 0);
+    EXPECT_EQ(rebuilt->Size(), changed->Size());
+
+    cache.LoadOrBuild({source});
+    EXPECT_EQ(cache.GetLastStatus(), "hit");
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(data_cache, DataCache_RemovesPartialEntry)
+{
+    /*
+    * Test verifies that an entry which cannot be written completely (here: over the file size limit) fails the load
+    * without leaving its temporary file behind, and that the next load builds it
+    */
+    using namespace ArbSimulation;
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_cache_test_3";
+    std::filesystem::remove_all(directory);
+    std::vector<std::string> datasets{"../../tests/data/csv_io_test_case_2.csv"};
+    DataCache cache(directory.string());
+
+    auto handler = std::signal(SIGXFSZ, SIG_IGN);
+    rlimit saved;
+    ::getrlimit(RLIMIT_FSIZE, &saved);
+    rlimit limited{4096, saved.rlim_max};
+    ::setrlimit(RLIMIT_FSIZE, &limited);
+    EXPECT_THROW(cache.LoadOrBuild(datasets), CacheError);
+    ::setrlimit(RLIMIT_FSIZE, &saved);
+    std::signal(SIGXFSZ, handler);
+    EXPECT_TRUE(std::filesystem::is_empty(directory));
+
+    cache.LoadOrBuild(datasets);
+    EXPECT_EQ(cache.GetLastStatus(), "miss");
+    cache.LoadOrBuild(datasets);
+    EXPECT_EQ(cache.GetLastStatus(), "hit");
+    std::filesystem::remove_all(directory);
+}
+
+TEST(data_cache, SharedTickStore_AttachMatchesPublished)
+{
+    /*
+    * Test verifies that SharedTickStore:
+    * 1) attaches to a published dataset read-only without parsing, both through POSIX names and file paths
+    * 2) keeps existing attachments intact when the name is republished
+    * 3) refuses names which are not published
+    * 4) throws and removes the segment when there is no room for it (here: over the file size limit)
+    */
+    using namespace ArbSimulation;
+    std::vector<std::string> datasets{"../../tests/data/csv_io_test_case_2.csv", "../../tests/data/csv_io_test_case_3.csv"};
+    auto parsed = LoadTickStore(datasets);
+    auto file = (std::filesystem::temp_directory_path() / "arbsim_shared_test").string();
+    std::string posix = "/arbsim_shared_test_" + std::to_string(::getpid());
+
+    for (auto& name: {posix, file})
+    {
+        SharedTickStore::Publish(name, *parsed, {});
+        auto first = SharedTickStore::Attach(name, true);
+        auto second = LoadTickStore({SharedTickStore::PREFIX + name});
+        EXPECT_TRUE(first->IsMapped());
+        ASSERT_EQ(first->Size(), parsed->Size());
+        ASSERT_EQ(second->Size(), parsed->Size());
+        EXPECT_EQ(first->GetSecurityIds(), parsed->GetSecurityIds());
+        EXPECT_EQ(std::memcmp(first->Data(), parsed->Data(), parsed->Size() * sizeof(TickRecord)), 0);
+        EXPECT_EQ(std::memcmp(second->Data(), parsed->Data(), parsed->Size() * sizeof(TickRecord)), 0);
+
+        auto other = LoadTickStore({"../../tests/data/order_matcher_test_1.csv"});
+        SharedTickStore::Publish(name, *other, {});
+        EXPECT_EQ(SharedTickStore::Attach(name)->Size(), other->Size());
+        EXPECT_EQ(std::memcmp(first->Data(), parsed->Data(), parsed->Size() * sizeof(TickRecord)), 0);
+
+        SharedTickStore::Remove(name);
+        EXPECT_THROW(SharedTickStore::Attach(name), CacheError);
+    }
+
+    auto handler = std::signal(SIGXFSZ, SIG_IGN);
+    rlimit saved;
+    ::getrlimit(RLIMIT_FSIZE, &saved);
+    rlimit limited{4096, saved.rlim_max};
+    ::setrlimit(RLIMIT_FSIZE, &limited);
+    EXPECT_THROW(SharedTickStore::Publish(file, *parsed, {}), CacheError);
+    ::setrlimit(RLIMIT_FSIZE, &saved);
+    std::signal(SIGXFSZ, handler);
+    EXPECT_FALSE(std::filesystem::exists(file));
+}
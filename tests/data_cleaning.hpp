@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include "../src/data_cache.hpp"
+#include "../src/synthetic.hpp"
+
+TEST(data_cleaning, TickStore_AppliesCleaningRulesWhileParsing)
+{
+    /*
+    * Test verifies that every rule drops, repairs or flags the broken updates it is configured for,
+    * that counters match, and that the default policy still fails on malformed lines
+    */
+    using namespace ArbSimulation;
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_cleaning_test";
+    std::filesystem::create_directories(directory);
+    auto path = (directory / "dirty.csv").string();
+    std::ofstream(path) <<
+        "1,A,0,5,100,101,5\n"
+        "2,A,0,5,100,101,5\n"
+        "2,A,0,5,100,101,5\n"           //duplicate
+        "3,A,0,5,0,101,5\n"             //bad price
+        "4,A,0,-1,100,101,5\n"          //bad size
+        "5,A,0,5,102,101,5\n"           //crossed
+        "1,B,0,5,200,201,5\n"
+        "4,A,0,5,100,102,5\n"           //out of order
+        "3,A,0,7,100,101,5\n"           //out of order
+        "x,A,0,5,100,101,5\n"           //malformed
+        "6,A,0,5\n";                    //malformed
+
+    EXPECT_THROW(LoadTickStore({path}), Exception);
+    CleaningPolicy failing;
+    failing.Set(CleaningRule::Malformed, CleaningAction::Drop);
+    failing.Set(CleaningRule::CrossedBook, CleaningAction::Fail);
+    EXPECT_THROW(LoadTickStore({path}, failing), Exception);
+    EXPECT_THROW(failing.Set(CleaningRule::Duplicate, CleaningAction::Repair), Exception);
+
+    CleaningPolicy policy;
+    policy.Set(CleaningRule::Malformed, CleaningAction::Drop);
+    policy.Set(CleaningRule::BadPrice, CleaningAction::Repair);
+    policy.Set(CleaningRule::BadSize, CleaningAction::Drop);
+    policy.Set(CleaningRule::CrossedBook, CleaningAction::Flag);
+    policy.Set(CleaningRule::Duplicate, CleaningAction::Drop);
+    policy.Set(CleaningRule::OutOfOrder, CleaningAction::Repair);
+    auto store = LoadTickStore({path}, policy);
+    auto& report = store->GetCleaningReport();
+    EXPECT_EQ(report.Lines, 11);
+    EXPECT_EQ(report.Kept, 7);
+    ASSERT_EQ(store->Size(), 7);
+    EXPECT_EQ(report[CleaningRule::Malformed].Dropped, 2);
+    EXPECT_EQ(report[CleaningRule::BadPrice].Repaired, 1);
+    EXPECT_EQ(report[CleaningRule::BadSize].Dropped, 1);
+    EXPECT_EQ(report[CleaningRule::CrossedBook].Flagged, 1);
+    EXPECT_EQ(report[CleaningRule::Duplicate].Dropped, 1);
+    EXPECT_EQ(report[CleaningRule::OutOfOrder].Matched, 2);
+    EXPECT_EQ(report[CleaningRule::OutOfOrder].Repaired, 2);
+    EXPECT_EQ(report.ToReport(policy).size(), CLEANING_RULES + 3);
+
+    std::vector<std::pair<u_int64_t, u_int32_t>> rows;
+    for (size_t i = 0; i < store->Size(); ++i)
+    {
+        auto& record = (*store)[i];
+        if (store->GetSecurityIds()[record.InstrumentId] == "B")
+            continue;
+        rows.push_back({record.Timestamp, record.Flags});
+        if (record.Flags & TickCleaner::GetFlag(CleaningRule::BadPrice))
+        {
+            EXPECT_EQ(record.BidPrice, 100);
+            EXPECT_EQ(record.AskPrice, 101);
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    u_int32_t outOfOrder = TickCleaner::GetFlag(CleaningRule::OutOfOrder);
+    std::vector<std::pair<u_int64_t, u_int32_t>> expected{{1, 0}, {2, 0}, {3, TickCleaner::GetFlag(CleaningRule::BadPrice)},
+        {5, TickCleaner::GetFlag(CleaningRule::CrossedBook)}, {5, outOfOrder}, {5, outOfOrder}};
+    EXPECT_EQ(rows, expected);
+    std::filesystem::remove_all(directory);
+}
+
+TEST(data_cleaning, TickStore_CleaningDoesNotDependOnThreads)
+{
+    /*
+    * Test verifies that a file parsed in parallel chunks is cleaned exactly like one parsed on a single thread,
+    * including duplicates and repairs which depend on updates of another chunk
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    auto generated = SyntheticMarket(config).GenerateStore();
+    std::string text;
+    char line[256];
+    for (size_t i = 0; i < generated->Size(); ++i)
+    {
+        auto record = (*generated)[i];
+        if (i % 997 == 5)
+            record.BidPrice = -1;
+        if (i % 1009 == 7)
+            record.AskSize = 0;
+        if (i % 1013 == 11)
+            std::swap(record.BidPrice, record.AskPrice);
+        if (i % 1019 == 13 && i > 100)
+            record.Timestamp -= 1000000;
+        text.append(line, SyntheticMarket::FormatCSV(record, generated->GetSecurityIds()[record.InstrumentId], line));
+        if (i % 1021 == 17)
+            text.append(line, SyntheticMarket::FormatCSV(record, generated->GetSecurityIds()[record.InstrumentId], line));
+        if (i % 1031 == 19)
+            text += "garbage\n";
+    }
+    ASSERT_GT(text.size(), 4u << 20);
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_cleaning_threads_test";
+    std::filesystem::create_directories(directory);
+    auto path = (directory / "dirty.csv").string();
+    std::ofstream(path, std::ios::binary).write(text.data(), text.size());
+
+    CleaningPolicy policy;
+    policy.Set(CleaningRule::Malformed, CleaningAction::Drop);
+    policy.Set(CleaningRule::BadPrice, CleaningAction::Repair);
+    policy.Set(CleaningRule::BadSize, CleaningAction::Flag);
+    policy.Set(CleaningRule::CrossedBook, CleaningAction::Repair);
+    policy.Set(CleaningRule::Duplicate, CleaningAction::Drop);
+    policy.Set(CleaningRule::OutOfOrder, CleaningAction::Repair);
+    TickStore single;
+    single.SetCleaning(policy);
+    single.LoadFile(path, 1);
+    TickStore parallel;
+    parallel.SetCleaning(policy);
+    parallel.LoadFile(path, 4);
+
+    ASSERT_EQ(single.Size(), parallel.Size());
+    EXPECT_EQ(std::memcmp(single.Data(), parallel.Data(), single.Size() * sizeof(TickRecord)), 0);
+    EXPECT_EQ(single.GetCleaningReport().ToReport(policy), parallel.GetCleaningReport().ToReport(policy));
+    auto& report = single.GetCleaningReport();
+    EXPECT_GT(report[CleaningRule::Malformed].Dropped, 0);
+    EXPECT_GT(report[CleaningRule::BadPrice].Repaired, 0);
+    EXPECT_GT(report[CleaningRule::BadSize].Flagged, 0);
+    EXPECT_GT(report[CleaningRule::CrossedBook].Repaired, 0);
+    EXPECT_GT(report[CleaningRule::Duplicate].Dropped, 0);
+    EXPECT_GT(report[CleaningRule::OutOfOrder].Repaired, 0);
+    EXPECT_EQ(report.Kept, single.Size());
+    for (size_t i = 0; i < single.Size(); ++i)
+        ASSERT_FALSE(single[i].Flags & TickCleaner::PENDING_REPAIR);
+    std::filesystem::remove_all(directory);
+}
+
+TEST(data_cleaning, TickImage_KeepsCleaningReport)
+{
+    /*
+    * Test verifies that the cleaning policy and report of a load survive a DataCache hit and a shared segment,
+    * so a run which does not parse its data can still report how it was cleaned
+    */
+    using namespace ArbSimulation;
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_cleaning_image_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    auto path = (directory / "dirty.csv").string();
+    std::ofstream(path) <<
+        "1,A,0,5,100,101,5\n"
+        "2,A,0,5,100,101,5\n"
+        "2,A,0,5,100,101,5\n"
+        "3,A,0,5,0,101,5\n"
+        "x,A,0,5,100,101,5\n";
+    CleaningPolicy policy;
+    policy.Set(CleaningRule::Malformed, CleaningAction::Drop);
+    policy.Set(CleaningRule::BadPrice, CleaningAction::Repair);
+    policy.Set(CleaningRule::Duplicate, CleaningAction::Drop);
+
+    DataCache cache((directory / "cache").string(), true, policy);
+    auto parsed = cache.LoadOrBuild({path});
+    auto mapped = cache.LoadOrBuild({path});
+    ASSERT_EQ(cache.GetLastStatus(), "hit");
+    EXPECT_EQ(parsed->GetCleaningReport().Lines, 5);
+    EXPECT_EQ(mapped->GetCleaningPolicy().Actions, policy.Actions);
+    EXPECT_EQ(mapped->GetCleaningReport().ToReport(policy), parsed->GetCleaningReport().ToReport(policy));
+
+    std::string name = "/arbsim_cleaning_image_test_" + std::to_string(::getpid());
+    SharedTickStore::Publish(name, *parsed, {});
+    auto attached = SharedTickStore::Attach(name);
+    SharedTickStore::Remove(name);
+    EXPECT_EQ(attached->GetCleaningReport().ToReport(policy), parsed->GetCleaningReport().ToReport(policy));
+
+    auto unparsed = std::make_shared<TickStore>(parsed->GetSecurityIds(), parsed->Data(), parsed->Size(), nullptr);
+    TickImage::Write((directory / "plain.ticks").string(), *unparsed, {});
+    EXPECT_EQ(TickImage::Map((directory / "plain.ticks").string(), true).Store->GetCleaningReport().Lines, 0);
+    std::filesystem::remove_all(directory);
+}
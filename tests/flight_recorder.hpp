@@ -0,0 +1,116 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "../src/strategy_base.hpp"
+
+TEST(flight_recorder, FlightRecorder_RingKeepsLatestRecords)
+{
+    /*
+    * Test verifies that the ring keeps the latest records once it wraps around
+    * and that a dump reads back oldest first with its reason and instrument names
+    */
+    using namespace ArbSimulation;
+    FlightRecorder recorder(5);
+    for (u_int64_t i = 0; i < 20; ++i)
+        recorder.Record({i, 1000 + i, 1.5 * i, 2.5 * i, i, u_int32_t(i % 2), FlightEvent::L1Update});
+    EXPECT_EQ(recorder.Size(), 8);
+    EXPECT_EQ(recorder.GetRecorded(), 20);
+    auto snapshot = recorder.Snapshot();
+    ASSERT_EQ(snapshot.size(), 8);
+    for (size_t i = 0; i < snapshot.size(); ++i)
+        EXPECT_EQ(snapshot[i].Tick, 12 + i);
+
+    auto path = (std::filesystem::temp_directory_path() / "arbsim_flight_ring.bin").string();
+    recorder.Dump(path, "Test", {"FutureA", "FutureB"});
+    auto dump = FlightRecorder::Read(path);
+    std::filesystem::remove(path);
+    EXPECT_EQ(dump.Reason, "Test");
+    EXPECT_EQ(dump.Recorded, 20);
+    EXPECT_EQ(dump.Instruments, (std::vector<std::string>{"FutureA", "FutureB"}));
+    ASSERT_EQ(dump.Records.size(), snapshot.size());
+    EXPECT_EQ(std::memcmp(dump.Records.data(), snapshot.data(), snapshot.size() * sizeof(FlightRecord)), 0);
+}
+
+TEST(flight_recorder, BasicStrategy_DumpsOnStrategyException)
+{
+    /*
+    * Test verifies that a StrategyException thrown from a callback dumps the ring of the strategy thread:
+    * the updates, the order and its fill lead to the failure, which is the last event
+    */
+    using namespace ArbSimulation;
+
+    struct FailingStrategy: public BasicStrategy
+    {
+        FailingStrategy(std::shared_ptr<InstrumentManager> instrManager): BasicStrategy(instrManager)
+        {}
+
+        void OnL1Update(L1UpdatePtr update) override
+        {
+            if (Filled)
+                throw StrategyException("Legs are not in sync");
+            if (!Sent)
+                SendMarketOrder("FutureB", 2, OrderSide::Sell);
+            Sent = true;
+        }
+
+        void OnOrderFilled(OrderPtr order) override
+        {
+            Filled = true;
+        }
+
+        bool Sent = false;
+        bool Filled = false;
+    };
+
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_flight_test";
+    std::filesystem::remove_all(directory);
+    FlightRecorder::Configure(FlightRecorder::DEFAULT_CAPACITY, directory.string());
+
+    auto instrManager = std::make_shared<InstrumentManager>();
+    auto strategy = std::make_shared<FailingStrategy>(instrManager);
+    auto matcher = std::make_shared<OrderMatcher>(std::unordered_map<std::string, u_int64_t>{{"FutureA", 0}, {"FutureB", 0}});
+    strategy->AddSubscriber(matcher);
+    matcher->AddSubscriber(strategy);
+    auto send = [&](const std::string& securityId, u_int64_t timestamp, double bid)
+    {
+        auto message = std::make_shared<MDUpdateMessage>();
+        message->Update = std::make_shared<L1Update>();
+        message->Update->Instrument = instrManager->GetOrCreateInstrument(securityId);
+        message->Update->Timestamp = timestamp;
+        message->Update->BidPrice = bid;
+        message->Update->AskPrice = bid + 1;
+        matcher->OnNewMessage(message);
+        strategy->OnNewMessage(message);
+    };
+    send("FutureA", 1000, 100);
+    send("FutureB", 2000, 200);
+    EXPECT_THROW(send("FutureB", 3000, 201), StrategyException);
+    FlightRecorder::Configure(FlightRecorder::DEFAULT_CAPACITY, "");
+
+    ASSERT_FALSE(strategy->GetFlightDumpPath().empty());
+    auto dump = FlightRecorder::Read(strategy->GetFlightDumpPath());
+    std::filesystem::remove_all(directory);
+    EXPECT_EQ(dump.Reason, "Legs are not in sync");
+    EXPECT_EQ(dump.Instruments, (std::vector<std::string>{"FutureA", "FutureB"}));
+
+    //the ring of the thread also holds events of earlier tests, this strategy starts at the last Start
+    auto start = std::find_if(dump.Records.rbegin(), dump.Records.rend(), [](auto& record){ return record.Event == FlightEvent::Start; });
+    ASSERT_NE(start, dump.Records.rend());
+    std::vector<FlightRecord> events(start.base() - 1, dump.Records.end());
+    std::vector<FlightEvent> types;
+    for (auto& event: events)
+        types.push_back(event.Event);
+    EXPECT_EQ(types, (std::vector<FlightEvent>{FlightEvent::Start, FlightEvent::L1Update, FlightEvent::NewOrder,
+        FlightEvent::L1Update, FlightEvent::OrderFilled, FlightEvent::L1Update, FlightEvent::Exception}));
+
+    auto& order = events[2];
+    EXPECT_EQ(order.Tick, 1);
+    EXPECT_EQ(order.OrderId, 1);
+    EXPECT_EQ(dump.Instruments[order.InstrumentId], "FutureB");
+    EXPECT_EQ(OrderSide(order.Side), OrderSide::Sell);
+    EXPECT_EQ(order.Value, 2);
+    auto& fill = events[4];
+    EXPECT_EQ(fill.OrderId, 1);
+    EXPECT_EQ(fill.Price, 200);
+    EXPECT_EQ(events[3].Price, 200);
+    EXPECT_EQ(events.back().Tick, 3);
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include "../src/runner.hpp"
+
+TEST(latency, LatencyDistribution_Sample)
+{
+    /*
+    * Test verifies that LatencyDistribution:
+    * 1) returns constant latency as is
+    * 2) samples lognormal latency around its median above the shift
+    * 3) samples empirical latency inside the buckets with their weights
+    * 4) samples mixture components with their weights
+    */
+    using namespace ArbSimulation;
+    CounterRng rng(7);
+    const size_t samples = 20000;
+
+    EXPECT_EQ(LatencyDistribution::Constant(1000).Sample(rng), 1000);
+
+    auto logNormal = LatencyDistribution::LogNormal(1000000, 0.5, 200000);
+    std::vector<u_int64_t> values;
+    for (size_t i = 0; i < samples; ++i)
+        values.push_back(logNormal.Sample(rng));
+    std::sort(values.begin(), values.end());
+    EXPECT_GE(values.front(), 200000);
+    EXPECT_NEAR(double(values[samples / 2]), 1200000, 30000);
+
+    auto empirical = LatencyDistribution::Empirical({100, 200, 1000}, {3, 1});
+    EXPECT_EQ(empirical.GetMinimum(), 100);
+    size_t low = 0;
+    for (size_t i = 0; i < samples; ++i)
+    {
+        auto value = empirical.Sample(rng);
+        ASSERT_GE(value, 100);
+        ASSERT_LT(value, 1000);
+        low += value < 200;
+    }
+    EXPECT_NEAR(double(low) / samples, 0.75, 0.02);
+
+    auto mixture = LatencyDistribution::Mixture({LatencyDistribution::Constant(10), LatencyDistribution::Constant(500)}, {0.9, 0.1});
+    EXPECT_EQ(mixture.GetMinimum(), 10);
+    size_t tail = 0;
+    for (size_t i = 0; i < samples; ++i)
+        tail += mixture.Sample(rng) == 500;
+    EXPECT_NEAR(double(tail) / samples, 0.1, 0.01);
+
+    EXPECT_THROW(LatencyDistribution::Empirical({100, 200}, {1, 1}), Exception);
+    EXPECT_THROW(LatencyDistribution::Mixture({LatencyDistribution::Constant(1)}, {0}), Exception);
+}
+
+TEST(latency, MonteCarloRunner_IsReproducible)
+{
+    /*
+    * Test verifies that MonteCarloRunner:
+    * 1) matches the deterministic run when the model is constant
+    * 2) returns the same replications whatever the number of threads
+    * 3) produces different outcomes across replications with jitter
+    * 4) computes interpolated quantiles
+    */
+    using namespace ArbSimulation;
+    auto store = TickStore::FromFiles({"../../tests/data/arb_strategy_test_A.csv", "../../tests/data/arb_strategy_test_B.csv"});
+    std::unordered_map<std::string, u_int64_t> latencies({{"FutureA", 0}, {"FutureB", 0}});
+
+    auto constant = std::make_shared<LatencyModel>();
+    constant->insert({"FutureA", LatencyDistribution::Constant(0)});
+    constant->insert({"FutureB", LatencyDistribution::Constant(0)});
+    auto results = MonteCarloRunner(store, 2).Run(RunParameters{5, 2, -150, latencies, constant, 1}, 3);
+    for (auto& result: results)
+        EXPECT_EQ(result.PnL, 77);
+
+    auto jitter = std::make_shared<LatencyModel>();
+    jitter->insert({"FutureA", LatencyDistribution::LogNormal(3, 1)});
+    jitter->insert({"FutureB", LatencyDistribution::Mixture(
+        {LatencyDistribution::Constant(0), LatencyDistribution::Empirical({2, 10}, {1})}, {0.5, 0.5})});
+    RunParameters parameters{5, 2, -150, latencies, jitter, 11};
+    auto single = MonteCarloRunner(store, 1).Run(parameters, 16);
+    auto parallel = MonteCarloRunner(store, 4).Run(parameters, 16);
+    ASSERT_EQ(single.size(), 16);
+    std::set<double> pnls;
+    for (size_t i = 0; i < single.size(); ++i)
+    {
+        EXPECT_EQ(single[i].PnL, parallel[i].PnL);
+        EXPECT_EQ(single[i].Trades, parallel[i].Trades);
+        EXPECT_EQ(single[i].Parameters.Replication, i);
+        pnls.insert(single[i].PnL);
+    }
+    EXPECT_GT(pnls.size(), 1);
+
+    auto quantiles = MonteCarloRunner::Quantiles({4, 1, 3, 2, 5}, {0, 0.25, 0.5, 0.9, 1});
+    EXPECT_EQ(quantiles, std::vector<double>({1, 2, 3, 4.6, 5}));
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include "../src/parameter_search.hpp"
+#include "../src/synthetic.hpp"
+
+TEST(parameter_search, HalvingSearch_FindsBestOfFullGridWithFewerTicks)
+{
+    /*
+    * Test verifies that successive halving picks the same best point as the full sweep
+    * while replaying fewer ticks, and that results do not depend on the number of threads
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    auto store = SyntheticMarket(config).GenerateStore();
+    std::unordered_map<std::string, u_int64_t> latencies{{"FutureA", 0}, {"FutureB", 0}};
+    auto grid = SweepRunner::MakeGrid({0.5, 1, 2}, {1, 2, 4}, {-150, -1e9}, latencies);
+
+    auto full = SweepRunner(store, 2).Run(grid);
+    auto best = std::max_element(full.begin(), full.end(), [](auto& a, auto& b){ return a.PnL < b.PnL; }) - full.begin();
+    SearchOptions options;
+    options.MinSurvivors = 2;
+    auto single = HalvingSearch(store, 1).Run(grid, options);
+    auto parallel = HalvingSearch(store, 3).Run(grid, options);
+
+    ASSERT_EQ(single.Candidates.size(), grid.size());
+    EXPECT_EQ(single.Best, best);
+    EXPECT_EQ(single.Candidates[single.Best].PnL, full[best].PnL);
+    EXPECT_EQ(single.FullGridTicks, grid.size() * store->Size());
+    EXPECT_LT(single.EvaluatedTicks, single.FullGridTicks);
+    EXPECT_GT(single.GetSavedShare(), 0);
+    size_t eliminated = 0;
+    for (size_t i = 0; i < grid.size(); ++i)
+    {
+        EXPECT_EQ(single.Candidates[i].Status, parallel.Candidates[i].Status);
+        EXPECT_EQ(single.Candidates[i].PnL, parallel.Candidates[i].PnL);
+        EXPECT_EQ(single.Candidates[i].Ticks, parallel.Candidates[i].Ticks);
+        if (single.Candidates[i].Status == CandidateStatus::Eliminated)
+        {
+            EXPECT_LT(single.Candidates[i].Ticks, store->Size());
+            ++eliminated;
+        }
+        else
+        {
+            EXPECT_EQ(single.Candidates[i].PnL, full[i].PnL);
+        }
+    }
+    EXPECT_GT(eliminated, 0);
+    EXPECT_EQ(HalvingSearch::ToReport(single).size(), grid.size() + 1);
+}
+
+TEST(parameter_search, HalvingSearch_StopsFinishedRunsWithFinalPnL)
+{
+    /*
+    * Test verifies that a run whose stop-loss has been hit and filled stops replaying at once
+    * and keeps the PnL of the full replay
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    auto store = SyntheticMarket(config).GenerateStore();
+    std::unordered_map<std::string, u_int64_t> latencies{{"FutureA", 0}, {"FutureB", 0}};
+    std::vector<RunParameters> grid{RunParameters{2, 2, -1, latencies}, RunParameters{2, 2, -1e9, latencies}};
+
+    auto full = SweepRunner(store, 1).Run(grid);
+    SearchOptions options;
+    options.MinSurvivors = 1;
+    options.Checkpoints = 2;
+    auto result = HalvingSearch(store, 1).Run(grid, options);
+    auto& stopped = result.Candidates[0];
+    ASSERT_EQ(stopped.Status, CandidateStatus::Finished);
+    EXPECT_LT(stopped.Ticks, store->Size());
+    EXPECT_GT(stopped.Trades, 0);
+    EXPECT_EQ(stopped.PnL, full[0].PnL);
+    EXPECT_EQ(stopped.Trades, full[0].Trades);
+}
@@ -0,0 +1,404 @@
+/*
+* End-to-end performance regression harness.
+* Generates pinned reference datasets, runs canonical scenarios and compares
+* wall time, throughput, peak RSS and allocation counts against a checked-in baseline.
+* Every scenario runs on an explicit number of threads, so allocations do not depend on the core count; the baseline
+* records the threads and the host, and is only compared on the same ones.
+*
+* Usage: ./PerfRegression [--baseline path] [--update] [--repeat N] [--threads N]
+* Exit code: 0 - within tolerances, 1 - regression, 2 - error (including dataset drift or another host)
+*/
+#include <simdjson.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <new>
+
+#include "../../src/hashing.hpp"
+#include "../../src/runner.hpp"
+
+namespace
+{
+    std::atomic<u_int64_t> allocations{0};
+    std::atomic<u_int64_t> allocatedBytes{0};
+
+    inline void* allocate(std::size_t size)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        if (void* pointer = std::malloc(size ? size : 1))
+            return pointer;
+        throw std::bad_alloc();
+    }
+
+    inline void* allocateAligned(std::size_t size, std::align_val_t alignment)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        size_t align = std::max(size_t(alignment), sizeof(void*));
+        if (void* pointer = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align))
+            return pointer;
+        throw std::bad_alloc();
+    }
+}
+
+//interposed allocator: every C++ allocation of the process is counted
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { try { return allocate(size); } catch(...) { return nullptr; } }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { try { return allocate(size); } catch(...) { return nullptr; } }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+
+namespace
+{
+    using namespace ArbSimulation;
+
+    struct Metrics
+    {
+        double WallMs = 0;
+        double TicksPerSec = 0;
+        double PeakRssMb = 0;
+        double Allocations = 0;
+    };
+
+    struct Scenario
+    {
+        std::string Name;
+        std::function<size_t()> Body; //returns number of ticks processed
+    };
+
+    class ReferenceDataset
+    {
+    /*
+    * Two cointegrated futures: a shared random walk plus a mean-reverting basis.
+    * Random numbers come from splitmix64 and hand-written transforms instead of std distributions,
+    * so files do not depend on the standard library implementation.
+    */
+    public:
+        static std::vector<std::string> Write(const std::string& directory, size_t ticksPerInstrument, u_int64_t seed)
+        {
+            std::filesystem::create_directories(directory);
+            std::vector<std::string> paths{directory + "/reference_A.csv", directory + "/reference_B.csv"};
+            std::ofstream fileA{paths[0]};
+            std::ofstream fileB{paths[1]};
+            u_int64_t state = seed;
+            double fair = 10000;
+            double basis = 0;
+            u_int64_t timestampA = 1544166000000000000ull;
+            u_int64_t timestampB = timestampA;
+            char line[128];
+            for (size_t i = 0; i < ticksPerInstrument; ++i)
+            {
+                fair += 0.25 * _normal(state);
+                basis += -0.01 * basis + 0.3 * _normal(state);
+                timestampA += 1 + u_int64_t(-std::log(1 - _uniform(state)) * 50e6);
+                timestampB += 1 + u_int64_t(-std::log(1 - _uniform(state)) * 50e6);
+
+                double midA = std::round((fair + basis / 2) * 2) / 2;
+                double midB = std::round((fair - basis / 2) * 2) / 2;
+                double halfSpreadA = 0.5 * (1 + (_next(state) % 2));
+                double halfSpreadB = 0.5 * (1 + (_next(state) % 2));
+                std::snprintf(line, sizeof(line), "%llu,FutureA,2,%llu,%.1f,%.1f,%llu\n", (unsigned long long)timestampA,
+                    (unsigned long long)(1 + _next(state) % 20), midA - halfSpreadA, midA + halfSpreadA, (unsigned long long)(1 + _next(state) % 20));
+                fileA << line;
+                std::snprintf(line, sizeof(line), "%llu,FutureB,2,%llu,%.1f,%.1f,%llu\n", (unsigned long long)timestampB,
+                    (unsigned long long)(1 + _next(state) % 20), midB - halfSpreadB, midB + halfSpreadB, (unsigned long long)(1 + _next(state) % 20));
+                fileB << line;
+            }
+            return paths;
+        }
+
+    private:
+        static inline u_int64_t _next(u_int64_t& state)
+        {
+            //splitmix64
+            u_int64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        static inline double _uniform(u_int64_t& state)
+        {
+            return (_next(state) >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        static inline double _normal(u_int64_t& state)
+        {
+            //sum of 4 uniforms, rescaled to unit variance: cheap and fully deterministic
+            double sum = _uniform(state) + _uniform(state) + _uniform(state) + _uniform(state);
+            return (sum - 2) * std::sqrt(3.0);
+        }
+    };
+
+    struct Host
+    {
+        std::string Cpu;
+        size_t HardwareThreads = 0;
+        std::string Compiler;
+
+        static Host Current()
+        {
+            Host host{"unknown", GetHardwareThreads(), __VERSION__};
+            std::ifstream cpuInfo{"/proc/cpuinfo"};
+            std::string line;
+            while (std::getline(cpuInfo, line))
+                if (line.rfind("model name", 0) == 0 && line.find(':') != std::string::npos)
+                {
+                    host.Cpu = line.substr(line.find(':') + 1);
+                    host.Cpu.erase(0, host.Cpu.find_first_not_of(' '));
+                    break;
+                }
+            return host;
+        }
+
+        inline bool operator==(const Host& other) const = default;
+    };
+
+    std::string escapeJson(const std::string& text)
+    {
+        std::string escaped;
+        for (char c: text)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    double readPeakRssMb()
+    {
+        std::ifstream status{"/proc/self/status"};
+        std::string line;
+        while (std::getline(status, line))
+            if (line.rfind("VmHWM:", 0) == 0)
+                return std::stod(line.substr(6)) / 1024;
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss / 1024.0;
+    }
+
+    void resetPeakRss()
+    {
+        //Linux resets VmHWM to the current RSS on "5", otherwise the peak is process-wide
+        std::ofstream clearRefs{"/proc/self/clear_refs"};
+        if (clearRefs)
+            clearRefs << "5";
+    }
+
+    Metrics measure(Scenario& scenario, size_t repeat)
+    {
+        Metrics metrics;
+        metrics.WallMs = std::numeric_limits<double>::max();
+        for (size_t i = 0; i < repeat; ++i)
+        {
+            resetPeakRss();
+            u_int64_t allocationsBefore = allocations.load();
+            auto start = std::chrono::steady_clock::now();
+            size_t ticks = scenario.Body();
+            double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (wallMs < metrics.WallMs)
+            {
+                metrics.WallMs = wallMs;
+                metrics.TicksPerSec = ticks / (wallMs / 1000);
+            }
+            metrics.PeakRssMb = std::max(metrics.PeakRssMb, readPeakRssMb());
+            metrics.Allocations = allocations.load() - allocationsBefore;
+        }
+        return metrics;
+    }
+
+    void writeBaseline(const std::string& path, u_int64_t datasetHash, size_t threads, const Host& host,
+        const std::vector<std::pair<std::string, Metrics>>& results)
+    {
+        std::ofstream file{path};
+        file << std::fixed << std::setprecision(1);
+        file << "{\n\t\"DatasetHash\": \"" << Hasher::ToHex(datasetHash) << "\",\n";
+        file << "\t\"Threads\": " << threads << ",\n";
+        file << "\t\"Host\": {\"Cpu\": \"" << escapeJson(host.Cpu) << "\", \"HardwareThreads\": " << host.HardwareThreads
+            << ", \"Compiler\": \"" << escapeJson(host.Compiler) << "\"},\n";
+        //the peak RSS includes allocator caches and thread stacks, which vary with the libc and the kernel
+        file << "\t\"Tolerances\": {\"WallMs\": 0.35, \"TicksPerSec\": 0.35, \"PeakRssMb\": 0.5, \"Allocations\": 0.02},\n";
+        file << "\t\"Scenarios\": {\n";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            auto& [name, metrics] = results[i];
+            file << "\t\t\"" << name << "\": {\"WallMs\": " << metrics.WallMs << ", \"TicksPerSec\": " << metrics.TicksPerSec
+                << ", \"PeakRssMb\": " << metrics.PeakRssMb << ", \"Allocations\": " << metrics.Allocations << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        file << "\t}\n}\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string baselinePath = "../../tests/perf/baseline.json";
+    bool update = false;
+    size_t repeat = 3;
+    size_t threads = 2;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--update")
+            update = true;
+        else if (arg == "--baseline" && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (arg == "--repeat" && i + 1 < argc)
+            repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = std::max(1, std::atoi(argv[++i]));
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--baseline path] [--update] [--repeat N] [--threads N]\n";
+            return 2;
+        }
+    }
+
+    try
+    {
+        auto directory = (std::filesystem::temp_directory_path() / "arbsim_perf").string();
+        auto paths = ReferenceDataset::Write(directory, 250000, 20240904);
+        Hasher datasetHasher;
+        for (auto& path: paths)
+            datasetHasher.Add(Hasher::HashFile(path));
+        u_int64_t datasetHash = datasetHasher.Digest();
+
+        auto host = Host::Current();
+        auto store = TickStore::FromFiles(paths, threads);
+        std::unordered_map<std::string, u_int64_t> noLatency{{"FutureA", 0}, {"FutureB", 0}};
+        std::unordered_map<std::string, u_int64_t> highLatency{{"FutureA", 40000000}, {"FutureB", 40000000}};
+
+        std::vector<Scenario> scenarios{
+            {"load", [&](){ return TickStore::FromFiles(paths, threads)->Size(); }},
+            {"single_run", [&]()
+                {
+                    SimulationRun run(store, RunParameters{0.5, 1, -75, noLatency});
+                    return run.Run().Ticks;
+                }},
+            {"small_sweep", [&]()
+                {
+                    auto grid = SweepRunner::MakeGrid({0.5, 1, 2}, {1, 2}, {-75, -150}, noLatency);
+                    size_t ticks = 0;
+                    for (auto& result: SweepRunner(store, threads).Run(grid))
+                        ticks += result.Ticks;
+                    return ticks;
+                }},
+            {"high_latency", [&]()
+                {
+                    SimulationRun run(store, RunParameters{0.5, 1, -75, highLatency});
+                    return run.Run().Ticks;
+                }},
+            {"zscore_run", [&]()
+                {
+                    RunParameters parameters{2, 1, -75, noLatency};
+                    parameters.Signal.Type = SignalType::ZScore;
+                    parameters.Signal.Window.Count = 1000;
+                    SimulationRun run(store, parameters);
+                    return run.Run().Ticks;
+                }}};
+
+        std::vector<std::pair<std::string, Metrics>> results;
+        std::cout << std::left << std::setw(16) << "Scenario" << std::right << std::setw(12) << "WallMs" << std::setw(16) << "TicksPerSec"
+            << std::setw(12) << "PeakRssMb" << std::setw(14) << "Allocations" << "\n";
+        for (auto& scenario: scenarios)
+        {
+            auto metrics = measure(scenario, repeat);
+            results.push_back({scenario.Name, metrics});
+            std::cout << std::left << std::setw(16) << scenario.Name << std::right << std::fixed << std::setprecision(1)
+                << std::setw(12) << metrics.WallMs << std::setw(16) << metrics.TicksPerSec
+                << std::setw(12) << metrics.PeakRssMb << std::setw(14) << metrics.Allocations << "\n";
+        }
+
+        if (update)
+        {
+            writeBaseline(baselinePath, datasetHash, threads, host, results);
+            std::cout << "\nBaseline is saved: " << baselinePath << "\n";
+            return 0;
+        }
+
+        simdjson::dom::parser parser;
+        simdjson::dom::object baseline;
+        if (parser.load(baselinePath).get(baseline) != simdjson::SUCCESS)
+        {
+            std::cerr << "Unable to read baseline " << baselinePath << "\n";
+            return 2;
+        }
+        if (std::string(std::string_view(baseline["DatasetHash"])) != Hasher::ToHex(datasetHash))
+        {
+            std::cerr << "Reference datasets differ from the baseline ones, regenerate the baseline deliberately\n";
+            return 2;
+        }
+        int64_t recordedThreads = 0, recordedHardwareThreads = 0;
+        std::string_view cpu, compiler;
+        simdjson::dom::object recordedHost;
+        if (baseline["Threads"].get(recordedThreads) != simdjson::SUCCESS || baseline["Host"].get(recordedHost) != simdjson::SUCCESS
+            || recordedHost["Cpu"].get(cpu) != simdjson::SUCCESS || recordedHost["HardwareThreads"].get(recordedHardwareThreads) != simdjson::SUCCESS
+            || recordedHost["Compiler"].get(compiler) != simdjson::SUCCESS)
+        {
+            std::cerr << "The baseline does not record its threads and host, regenerate it with --update\n";
+            return 2;
+        }
+        Host recorded{std::string(cpu), size_t(recordedHardwareThreads), std::string(compiler)};
+        if (size_t(recordedThreads) != threads || !(recorded == host))
+        {
+            std::cerr << "The baseline was recorded with " << recordedThreads << " threads on " << recorded.Cpu << " ("
+                << recorded.HardwareThreads << " hardware threads, " << recorded.Compiler << "), this run uses " << threads
+                << " threads on " << host.Cpu << " (" << host.HardwareThreads << " hardware threads, " << host.Compiler
+                << "): numbers are not comparable, run with --threads " << recordedThreads << " on that host or record a baseline for this one\n";
+            return 2;
+        }
+
+        simdjson::dom::object tolerances = baseline["Tolerances"];
+        simdjson::dom::object scenariosBaseline = baseline["Scenarios"];
+        bool regressed = false;
+        std::cout << "\n";
+        for (auto& [name, metrics]: results)
+        {
+            simdjson::dom::object expected;
+            if (scenariosBaseline[name].get(expected) != simdjson::SUCCESS)
+            {
+                std::cout << name << ": no baseline\n";
+                continue;
+            }
+            auto check = [&](const char* metric, double actual, bool higherIsBetter)
+            {
+                double reference = double(expected[metric]);
+                double tolerance = double(tolerances[metric]);
+                bool failed = higherIsBetter ? actual < reference * (1 - tolerance) : actual > reference * (1 + tolerance);
+                if (failed)
+                {
+                    regressed = true;
+                    std::cout << "REGRESSION " << name << "." << metric << ": " << actual << " vs baseline " << reference
+                        << " (tolerance " << tolerance * 100 << "%)\n";
+                }
+            };
+            check("WallMs", metrics.WallMs, false);
+            check("TicksPerSec", metrics.TicksPerSec, true);
+            check("PeakRssMb", metrics.PeakRssMb, false);
+            check("Allocations", metrics.Allocations, false);
+        }
+        std::cout << (regressed ? "Performance regression detected\n" : "All scenarios are within tolerances\n");
+        return regressed ? 1 : 0;
+    }
+    catch(std::exception& ex)
+    {
+        std::cerr << ex.what() << "\n";
+        return 2;
+    }
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "../src/perf_counters.hpp"
+#include "../src/runner.hpp"
+#include "../src/synthetic.hpp"
+
+TEST(perf_counters, PerfCounters_ReportsIpcAndMissesPerTick)
+{
+    /*
+    * Test verifies that the report has a line per thread and used stage, normalizes misses
+    * by loaded ticks for Load and Sort, by dispatched ticks otherwise, and sums the replay stages
+    */
+    using namespace ArbSimulation;
+    PerfThreadProfile worker;
+    worker.Name = "sweep worker 0";
+    auto& load = worker.Stages[size_t(PerfStage::Load)];
+    load.Counts = {1000, 3000, 50, 20, 10};
+    load.Calls = 1;
+    auto& dispatch = worker.Stages[size_t(PerfStage::Dispatch)];
+    dispatch.Counts = {400, 800, 10, 4, 2};
+    dispatch.Calls = 2;
+    auto& matcher = worker.Stages[size_t(PerfStage::Matcher)];
+    matcher.Counts = {600, 600, 30, 6, 8};
+    matcher.Calls = 4;
+
+    auto report = PerfCounters::ToReport({worker}, 100);
+    ASSERT_EQ(report.size(), 5);
+    EXPECT_EQ(report[1][1], "Load");
+    EXPECT_DOUBLE_EQ(std::stod(report[1][5]), 3);
+    EXPECT_DOUBLE_EQ(std::stod(report[1][6]), 0.5);
+    EXPECT_EQ(report[2][1], "Dispatch");
+    EXPECT_DOUBLE_EQ(std::stod(report[2][5]), 2);
+    EXPECT_DOUBLE_EQ(std::stod(report[2][7]), 2);
+    EXPECT_EQ(report[3][1], "Matcher");
+    EXPECT_DOUBLE_EQ(std::stod(report[3][6]), 15);
+    EXPECT_EQ(report[4][0], "All");
+    EXPECT_EQ(report[4][2], "2");
+    EXPECT_EQ(report[4][3], "1000");
+    EXPECT_DOUBLE_EQ(std::stod(report[4][5]), 1.4);
+    EXPECT_DOUBLE_EQ(std::stod(report[4][8]), 5);
+}
+
+TEST(perf_counters, PerfCounters_CountsStagesPerSweepWorker)
+{
+    /*
+    * Test verifies that with counters compiled in every dispatched tick is attributed to a named sweep worker
+    * (counts are 0 where the kernel gives no access to the PMU), and that nothing is recorded otherwise
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    auto store = SyntheticMarket(config).GenerateStore();
+    std::unordered_map<std::string, u_int64_t> latencies{{"FutureA", 0}, {"FutureB", 0}};
+    auto grid = SweepRunner::MakeGrid({0.5, 1}, {1, 2}, {-150}, latencies);
+
+    PerfCounters::Reset();
+    SweepRunner(store, 2).Run(grid);
+    auto profiles = PerfCounters::Collect();
+    if (!PerfCounters::IsCompiled())
+    {
+        EXPECT_TRUE(profiles.empty());
+        EXPECT_FALSE(PerfCounters::IsAvailable());
+        return;
+    }
+    u_int64_t dispatched = 0, matched = 0, handled = 0;
+    for (auto& profile: profiles)
+    {
+        EXPECT_EQ(profile.Name.rfind("sweep worker ", 0), 0);
+        dispatched += profile.Stages[size_t(PerfStage::Dispatch)].Calls;
+        matched += profile.Stages[size_t(PerfStage::Matcher)].Calls;
+        handled += profile.Stages[size_t(PerfStage::Strategy)].Calls;
+        if (PerfCounters::IsAvailable())
+        {
+            EXPECT_GT(profile.Stages[size_t(PerfStage::Dispatch)][PerfEvent::Instructions], 0);
+        }
+    }
+    EXPECT_EQ(dispatched, grid.size() * store->Size());
+    EXPECT_GE(matched, dispatched);
+    EXPECT_GE(handled, dispatched);
+}
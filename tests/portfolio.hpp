@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "../src/portfolio.hpp"
+#include "../src/random.hpp"
+#include "../src/strategy_base.hpp"
+
+TEST(portfolio, Portfolio_MatchesPositionKeeper)
+{
+    /*
+    * Test verifies that positions kept in arrays give the same PnL, net qty and average prices as Position objects,
+    * whether they are marked per update, in a batch of records or from bid / ask arrays
+    */
+    using namespace ArbSimulation;
+    const size_t count = 37;
+    CounterRng rng(7, 0);
+    InstrumentManager manager;
+    PositionKeeper keeper;
+    Portfolio portfolio;
+    std::vector<InstrumentPtr> instruments;
+    for (size_t i = 0; i < count; ++i)
+        instruments.push_back(manager.GetOrCreateInstrument("I" + std::to_string(i)));
+
+    std::vector<TickRecord> records;
+    std::vector<double> bids(count), asks(count);
+    for (size_t step = 0; step < 2000; ++step)
+    {
+        auto instrument = instruments[rng.Uniform() * count];
+        if (rng.Uniform() < 0.3)
+        {
+            auto fill = std::make_shared<Order>();
+            fill->Instrument = instrument;
+            fill->Qty = 1 + std::floor(rng.Uniform() * 5);
+            fill->ExecPrice = 100 + std::floor(rng.Uniform() * 400) * 0.25;
+            fill->Side = rng.Uniform() < 0.5 ? OrderSide::Buy : OrderSide::Sell;
+            keeper.ProcessOrderFill(fill);
+            portfolio.OnFill(fill);
+        }
+        auto update = std::make_shared<L1Update>();
+        update->Instrument = instrument;
+        update->BidPrice = 100 + std::floor(rng.Uniform() * 400) * 0.25;
+        update->AskPrice = update->BidPrice + 0.25;
+        keeper.ProcessL1Update(update);
+        portfolio.OnL1Update(update);
+        records.push_back(TickRecord{step, instrument->Id, 0, 1, update->BidPrice, update->AskPrice, 1});
+        bids[instrument->Id] = update->BidPrice;
+        asks[instrument->Id] = update->AskPrice;
+    }
+
+    ASSERT_EQ(portfolio.Size(), count);
+    double net = 0, gross = 0;
+    for (auto& instrument: instruments)
+    {
+        auto& position = keeper.GetPosition(instrument->SecurityId);
+        EXPECT_NEAR(portfolio.GetPnL(instrument->Id), position.GetPnL(), 1e-6);
+        EXPECT_EQ(portfolio.GetNetQty(instrument->Id), position.GetNetQty());
+        net += position.GetNetQty() * portfolio.GetMark(instrument->Id);
+        gross += std::abs(position.GetNetQty() * portfolio.GetMark(instrument->Id));
+    }
+    EXPECT_NEAR(portfolio.GetPnL(), keeper.GetFullPnL(), 1e-6);
+    EXPECT_NEAR(portfolio.GetNetExposure(), net, 1e-6);
+    EXPECT_NEAR(portfolio.GetGrossExposure(), gross, 1e-6);
+
+    std::vector<double> pnls(count);
+    portfolio.GetPnLs(pnls.data());
+    Portfolio batched = portfolio;
+    batched.MarkRecords(records.data(), records.size());
+    EXPECT_EQ(batched.GetPnL(), portfolio.GetPnL());
+    batched.MarkAll(bids.data(), asks.data());
+    for (u_int32_t i = 0; i < count; ++i)
+        EXPECT_EQ(batched.GetPnL(i), pnls[i]);
+}
+
+TEST(portfolio, Portfolio_AveragePricesAndGrowth)
+{
+    /*
+    * Test verifies average prices of both sides, that trading an unknown instrument id grows the arrays
+    * and that unknown ids read as flat positions
+    */
+    using namespace ArbSimulation;
+    Portfolio portfolio(2);
+    portfolio.OnTrade(1, 10, 100, OrderSide::Buy);
+    portfolio.OnTrade(1, 10, 105, OrderSide::Buy);
+    portfolio.OnTrade(1, 5, 110, OrderSide::Sell);
+    portfolio.Mark(1, 108);
+    EXPECT_DOUBLE_EQ(portfolio.GetAvgPriceBought(1), 102.5);
+    EXPECT_DOUBLE_EQ(portfolio.GetAvgPriceSold(1), 110);
+    EXPECT_DOUBLE_EQ(portfolio.GetNetQty(1), 15);
+    EXPECT_DOUBLE_EQ(portfolio.GetPnL(), 5 * 110 - 2050 + 15 * 108);
+
+    portfolio.OnTrade(9, 3, 50, OrderSide::Sell);
+    EXPECT_GE(portfolio.Size(), 10);
+    portfolio.Mark(9, 40);
+    EXPECT_DOUBLE_EQ(portfolio.GetPnL(9), 30);
+    EXPECT_DOUBLE_EQ(portfolio.GetNetExposure(), 15 * 108 - 3 * 40);
+    EXPECT_DOUBLE_EQ(portfolio.GetGrossExposure(), 15 * 108 + 3 * 40);
+    EXPECT_EQ(portfolio.GetNetQty(1000), 0);
+    EXPECT_EQ(portfolio.GetPnL(1000), 0);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include "../src/process_sweep.hpp"
+
+TEST(process_sweep, ProcessSweep_MatchesThreadSweep)
+{
+    /*
+    * Test verifies that ProcessSweep:
+    * 1) returns in grid order the same results as SweepRunner
+    * 2) streams every result once and replays a read-only shared mapping of a parsed store
+    */
+    using namespace ArbSimulation;
+    auto store = TickStore::FromFiles({"../../tests/data/arb_strategy_test_A.csv", "../../tests/data/arb_strategy_test_B.csv"});
+    auto grid = SweepRunner::MakeGrid({1, 5}, {1, 2}, {-10, -150}, {{"FutureA", 0}, {"FutureB", 0}});
+    auto expected = SweepRunner(store, 1).Run(grid);
+
+    ProcessSweepOptions options;
+    options.Processes = 3;
+    std::vector<size_t> streamed(grid.size(), 0);
+    auto result = ProcessSweep(store, options).Run(grid, [&](size_t index, const RunResult&){ ++streamed[index]; });
+    EXPECT_TRUE(result.SharedDataset);
+    EXPECT_EQ(result.Crashes, 0);
+    ASSERT_EQ(result.Results.size(), grid.size());
+    for (size_t i = 0; i < grid.size(); ++i)
+    {
+        EXPECT_EQ(streamed[i], 1);
+        EXPECT_EQ(result.Results[i].Parameters.X, grid[i].X);
+        EXPECT_EQ(result.Results[i].Parameters.Z, grid[i].Z);
+        EXPECT_EQ(result.Results[i].PnL, expected[i].PnL);
+        EXPECT_EQ(result.Results[i].Trades, expected[i].Trades);
+        EXPECT_EQ(result.Results[i].Ticks, store->Size());
+        EXPECT_EQ(result.Results[i].Error, "");
+    }
+}
+
+TEST(process_sweep, ProcessSweep_SurvivesCrashingRuns)
+{
+    /*
+    * Test verifies that ProcessSweep:
+    * 1) restarts a crashed worker and gives up a job which crashes 1 + Retries workers, with the reason as its error
+    * 2) reports exceptions of a run as its error without losing the worker
+    * 3) kills a worker stuck longer than JobTimeoutMs
+    * 4) finishes every other job with its normal result
+    */
+    using namespace ArbSimulation;
+    auto store = TickStore::FromFiles({"../../tests/data/arb_strategy_test_A.csv", "../../tests/data/arb_strategy_test_B.csv"});
+    auto grid = SweepRunner::MakeGrid({1, 2, 3, 4, 5, 6}, {2}, {-150}, {{"FutureA", 0}, {"FutureB", 0}});
+    auto expected = SweepRunner(store, 1).Run(grid);
+
+    ProcessSweepOptions options;
+    options.Processes = 2;
+    options.Retries = 1;
+    options.JobTimeoutMs = 500;
+    ProcessSweep sweep(store, options);
+    sweep.SetJob([](const TickStorePtr& store, const RunParameters& parameters)
+    {
+        rlimit noCore{0, 0};
+        ::setrlimit(RLIMIT_CORE, &noCore);
+        if (parameters.X == 2)
+            std::abort();
+        if (parameters.X == 3)
+            throw StrategyException("Broken parameters");
+        if (parameters.X == 4)
+            ::pause();
+        return SimulationRun(store, parameters).Run();
+    });
+    auto result = sweep.Run(grid);
+
+    EXPECT_EQ(result.Crashes, 4);
+    EXPECT_EQ(result.Failed, 2);
+    //retried crashes always restart their worker, a given-up job only while other jobs wait
+    EXPECT_GE(result.Restarts, 2);
+    EXPECT_LE(result.Restarts, result.Crashes);
+    EXPECT_NE(result.Results[1].Error.find("killed by signal " + std::to_string(SIGABRT)), std::string::npos);
+    EXPECT_EQ(result.Results[2].Error, "Broken parameters");
+    EXPECT_NE(result.Results[3].Error.find("timed out"), std::string::npos);
+    for (size_t i: {0, 4, 5})
+    {
+        EXPECT_EQ(result.Results[i].Error, "");
+        EXPECT_EQ(result.Results[i].PnL, expected[i].PnL);
+        EXPECT_EQ(result.Results[i].Trades, expected[i].Trades);
+    }
+    EXPECT_EQ(result.Results[4].PnL, 77);
+}
+
+TEST(process_sweep, ProcessSweep_ReapsWorkersWhenCoordinatorFails)
+{
+    /*
+    * Test verifies that when the coordinator throws (here: out of descriptors for the sockets of new workers)
+    * the workers already started are killed and reaped, not left running
+    */
+    using namespace ArbSimulation;
+    auto store = TickStore::FromFiles({"../../tests/data/arb_strategy_test_A.csv", "../../tests/data/arb_strategy_test_B.csv"});
+    auto grid = SweepRunner::MakeGrid({1, 5}, {1, 2}, {-10, -150}, {{"FutureA", 0}, {"FutureB", 0}});
+    ProcessSweepOptions options;
+    options.Processes = grid.size();
+
+    //descriptors for the shared dataset and a few workers, not for all of them
+    int highest = 0;
+    for (auto& entry: std::filesystem::directory_iterator("/proc/self/fd"))
+        highest = std::max(highest, std::stoi(entry.path().filename().string()));
+    rlimit saved;
+    ::getrlimit(RLIMIT_NOFILE, &saved);
+    rlimit limited{rlim_t(highest + 5), saved.rlim_max};
+    ::setrlimit(RLIMIT_NOFILE, &limited);
+    bool thrown = false;
+    try
+    {
+        ProcessSweep(store, options).Run(grid);
+    }
+    catch(Exception&)
+    {
+        thrown = true;
+    }
+    ::setrlimit(RLIMIT_NOFILE, &saved);
+
+    EXPECT_TRUE(thrown);
+    int status = 0;
+    EXPECT_EQ(::waitpid(-1, &status, WNOHANG), -1);
+    EXPECT_EQ(errno, ECHILD);
+}
@@ -0,0 +1,263 @@
+#include <gtest/gtest.h>
+#include "../src/result_cache.hpp"
+#include "../src/parameter_search.hpp"
+#include "../src/process_sweep.hpp"
+#include "../src/synthetic.hpp"
+
+TEST(result_cache, ResultCache_ComputesOnlyNewPoints)
+{
+    /*
+    * Test verifies that ResultCache:
+    * 1) replays a grid once and serves it from the file to a new instance, with the same results and analytics
+    * 2) replays only the points added to a grid, and counts lookups and hits
+    * 3) misses on changed data, latencies, window capacity or analytics and never caches compute-timed runs
+    */
+    using namespace ArbSimulation;
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_result_cache_test_1";
+    std::filesystem::remove_all(directory);
+    auto store = TickStore::FromFiles({"../../tests/data/arb_strategy_test_A.csv", "../../tests/data/arb_strategy_test_B.csv"});
+    std::unordered_map<std::string, u_int64_t> latencies{{"FutureA", 0}, {"FutureB", 0}};
+    auto grid = SweepRunner::MakeGrid({1, 5}, {1, 2}, {-150}, latencies);
+    for (auto& parameters: grid)
+        parameters.AnalyticsBucketNs = 1000000000;
+    u_int64_t dataset = ResultCache::HashDataset(*store);
+
+    size_t computed = 0;
+    auto compute = [&](const std::vector<RunParameters>& missing)
+    {
+        computed += missing.size();
+        return SweepRunner(store, 2).Run(missing);
+    };
+    std::vector<RunResult> first;
+    {
+        ResultCache cache(directory.string());
+        first = cache.Run(dataset, grid, compute);
+        EXPECT_EQ(computed, grid.size());
+        EXPECT_EQ(cache.GetStats().Hits, 0);
+        EXPECT_EQ(cache.GetStats().Stored, grid.size());
+    }
+    EXPECT_EQ(first[3].PnL, 77);
+    EXPECT_GT(first[3].MaxDrawdown, 0);
+
+    ResultCache cache(directory.string());
+    EXPECT_EQ(cache.Size(), grid.size());
+    auto second = cache.Run(dataset, grid, compute);
+    EXPECT_EQ(computed, grid.size());
+    for (size_t i = 0; i < grid.size(); ++i)
+    {
+        EXPECT_EQ(second[i].Parameters.X, grid[i].X);
+        EXPECT_EQ(second[i].PnL, first[i].PnL);
+        EXPECT_EQ(second[i].Trades, first[i].Trades);
+        EXPECT_EQ(second[i].Ticks, first[i].Ticks);
+        EXPECT_EQ(second[i].MaxDrawdown, first[i].MaxDrawdown);
+        EXPECT_EQ(second[i].Sharpe, first[i].Sharpe);
+    }
+
+    auto extended = grid;
+    extended.push_back(grid[0]);
+    extended.back().Y = 3;
+    extended.push_back(grid[0]);
+    extended.back().Latencies["FutureA"] = 1000;
+    auto third = cache.Run(dataset, extended, compute);
+    EXPECT_EQ(computed, grid.size() + 2);
+    EXPECT_EQ(third[3].PnL, 77);
+    EXPECT_EQ(cache.GetStats().Lookups, grid.size() * 2 + 2);
+    EXPECT_EQ(cache.GetStats().Hits, grid.size() * 2);
+
+    auto plain = grid[0];
+    plain.AnalyticsBucketNs = 0;
+    EXPECT_NE(ResultCache::MakeKey(dataset, plain), ResultCache::MakeKey(dataset, grid[0]));
+    auto windowed = grid[0];
+    windowed.Signal.Window.DurationNs = 1000000000;
+    auto resized = windowed;
+    resized.Signal.Window.Capacity = 16;
+    EXPECT_NE(ResultCache::MakeKey(dataset, resized), ResultCache::MakeKey(dataset, windowed));
+    EXPECT_NE(ResultCache::MakeKey(dataset + 1, grid[0]), ResultCache::MakeKey(dataset, grid[0]));
+    auto timed = grid[0];
+    timed.ComputeTimeScale = 1;
+    cache.Run(dataset, {timed}, compute);
+    cache.Run(dataset, {timed}, compute);
+    EXPECT_EQ(computed, grid.size() + 4);
+    EXPECT_EQ(cache.GetStats().Uncacheable, 2);
+    std::filesystem::remove_all(directory);
+}
+
+TEST(result_cache, ResultCache_SkipsTornRecords)
+{
+    /*
+    * Test verifies that ResultCache:
+    * 1) keeps the records before and after a damaged one and drops the damaged one
+    * 2) ignores a record cut short by a killed writer at the end of the file
+    * 3) ignores a record whose error size points past the end of the file (wrapping around the offset)
+    */
+    using namespace ArbSimulation;
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_result_cache_test_2";
+    std::filesystem::remove_all(directory);
+    std::string path;
+    {
+        ResultCache cache(directory.string());
+        for (u_int64_t key = 1; key <= 3; ++key)
+        {
+            RunResult result;
+            result.PnL = key * 10;
+            result.Error = key == 2 ? "Broken parameters" : "";
+            cache.Store(key, result);
+        }
+        path = cache.GetPath();
+    }
+    auto size = std::filesystem::file_size(path);
+    {
+        //flip a byte of the second record's error text, then append half a record
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(size - size / 3 - 4);
+        file.put('#');
+        file.seekp(0, std::ios::end);
+        file.write(ResultCache::MAGIC, 8);
+        file.write("torn", 4);
+
+        //magic, key, 5 outcome fields, error size, checksum
+        u_int64_t garbage[9] = {};
+        std::memcpy(garbage, ResultCache::MAGIC, 8);
+        garbage[7] = u_int64_t(0) - (size + 12) - sizeof(garbage) + 1;
+        file.write(reinterpret_cast<const char*>(garbage), sizeof(garbage));
+    }
+
+    ResultCache cache(directory.string());
+    RunResult result;
+    EXPECT_EQ(cache.Size(), 2);
+    EXPECT_TRUE(cache.Find(1, result));
+    EXPECT_EQ(result.PnL, 10);
+    EXPECT_FALSE(cache.Find(2, result));
+    EXPECT_TRUE(cache.Find(3, result));
+    EXPECT_EQ(result.PnL, 30);
+    EXPECT_EQ(result.Error, "");
+    std::filesystem::remove_all(directory);
+}
+
+TEST(result_cache, ResultCache_ReplaysFailedRuns)
+{
+    /*
+    * Test verifies that ResultCache:
+    * 1) does not store a run whose worker crashed, the next Run replays it
+    * 2) stores the other runs of the same sweep
+    */
+    using namespace ArbSimulation;
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_result_cache_test_3";
+    std::filesystem::remove_all(directory);
+    auto store = TickStore::FromFiles({"../../tests/data/arb_strategy_test_A.csv", "../../tests/data/arb_strategy_test_B.csv"});
+    auto grid = SweepRunner::MakeGrid({1, 2, 5}, {2}, {-150}, {{"FutureA", 0}, {"FutureB", 0}});
+    u_int64_t dataset = ResultCache::HashDataset(*store);
+
+    bool crash = true;
+    size_t computed = 0;
+    auto compute = [&](const std::vector<RunParameters>& missing)
+    {
+        computed += missing.size();
+        ProcessSweepOptions options;
+        options.Processes = 2;
+        options.Retries = 0;
+        ProcessSweep sweep(store, options);
+        sweep.SetJob([crash](const TickStorePtr& store, const RunParameters& parameters)
+        {
+            rlimit noCore{0, 0};
+            ::setrlimit(RLIMIT_CORE, &noCore);
+            if (crash && parameters.X == 2)
+                std::abort();
+            return SimulationRun(store, parameters).Run();
+        });
+        return sweep.Run(missing).Results;
+    };
+
+    ResultCache cache(directory.string());
+    auto first = cache.Run(dataset, grid, compute);
+    EXPECT_NE(first[1].Error.find("killed by signal"), std::string::npos);
+    EXPECT_EQ(cache.GetStats().Stored, 2);
+
+    crash = false;
+    auto second = cache.Run(dataset, grid, compute);
+    EXPECT_EQ(computed, grid.size() + 1);
+    EXPECT_EQ(second[1].Error, "");
+    EXPECT_EQ(second[1].PnL, second[0].PnL);
+    EXPECT_EQ(second[2].PnL, 77);
+    EXPECT_EQ(cache.GetStats().Hits, 2);
+    EXPECT_EQ(cache.GetStats().Stored, 3);
+    std::filesystem::remove_all(directory);
+}
+
+TEST(result_cache, ResultCache_MemoizesApproximateBootstrapAndSearchRuns)
+{
+    /*
+    * Test verifies that:
+    * 1) a repeated approximate sweep takes its decimated and exact runs from the cache, with the same results
+    * 2) bootstrap paths are keyed by their block order: a repeated bootstrap is served from the cache, a new seed is not
+    * 3) the full-length survivors of a search are stored and served to the next search, which picks the same best point
+    */
+    using namespace ArbSimulation;
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_result_cache_test_4";
+    std::filesystem::remove_all(directory);
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    config.DurationNs = 1800ull * 1000000000ull;
+    TickStorePtr store = SyntheticMarket(config).GenerateStore();
+    u_int64_t dataset = ResultCache::HashDataset(*store);
+    auto cache = std::make_shared<ResultCache>(directory.string());
+    std::unordered_map<std::string, u_int64_t> latencies{{"FutureA", 0}, {"FutureB", 0}};
+    auto grid = SweepRunner::MakeGrid({0.5, 1, 2}, {1, 2}, {-75, -150}, latencies);
+
+    ConflationOptions options;
+    options.BucketNs = 1000000000;
+    auto decimation = std::make_shared<ConflationSchedule>(*store, options);
+    SweepRunner sweep(store, 2);
+    sweep.SetMemo(ResultCache::MakeMemo(cache, dataset));
+    auto first = sweep.RunApproximate(grid, decimation, 5);
+    size_t runs = grid.size() + first.Checked.size();
+    EXPECT_EQ(cache->GetStats().Stored, runs);
+    auto second = sweep.RunApproximate(grid, decimation, 5);
+    EXPECT_EQ(cache->GetStats().Hits, runs);
+    EXPECT_EQ(cache->GetStats().Stored, runs);
+    EXPECT_EQ(second.Checked, first.Checked);
+    for (size_t i = 0; i < grid.size(); ++i)
+        EXPECT_EQ(second.Results[i].PnL, first.Results[i].PnL);
+    for (size_t i = 0; i < first.Exact.size(); ++i)
+        EXPECT_EQ(second.Exact[i].PnL, first.Exact[i].PnL);
+
+    BootstrapOptions bootstrapOptions;
+    bootstrapOptions.Paths = 4;
+    bootstrapOptions.Seed = 5;
+    auto plain = BootstrapRunner(store, 1).Run(grid[0], bootstrapOptions);
+    BootstrapRunner bootstrap(store, 2);
+    bootstrap.SetMemo(ResultCache::MakeMemo(cache, dataset));
+    bootstrap.Run(grid[0], bootstrapOptions);
+    auto cached = bootstrap.Run(grid[0], bootstrapOptions);
+    EXPECT_EQ(cache->GetStats().Hits, runs + bootstrapOptions.Paths);
+    for (size_t i = 0; i < plain.size(); ++i)
+    {
+        EXPECT_EQ(cached[i].Path, i);
+        EXPECT_EQ(cached[i].PnL, plain[i].PnL);
+        EXPECT_EQ(cached[i].MaxDrawdown, plain[i].MaxDrawdown);
+        EXPECT_EQ(cached[i].Trades, plain[i].Trades);
+    }
+    bootstrapOptions.Seed = 6;
+    bootstrap.Run(grid[0], bootstrapOptions);
+    EXPECT_EQ(cache->GetStats().Hits, runs + 4);
+
+    SearchOptions searchOptions;
+    searchOptions.MinSurvivors = 2;
+    auto uncached = HalvingSearch(store, 2).Run(grid, searchOptions);
+    HalvingSearch search(store, 2);
+    search.SetResultCache(cache, dataset);
+    auto stored = search.Run(grid, searchOptions);
+    size_t hits = cache->GetStats().Hits;
+    auto served = search.Run(grid, searchOptions);
+    EXPECT_GT(cache->GetStats().Hits, hits);
+    EXPECT_LT(served.EvaluatedTicks, stored.EvaluatedTicks);
+    EXPECT_EQ(stored.EvaluatedTicks, uncached.EvaluatedTicks);
+    EXPECT_EQ(served.Best, uncached.Best);
+    for (size_t i = 0; i < grid.size(); ++i)
+    {
+        EXPECT_EQ(served.Candidates[i].PnL, uncached.Candidates[i].PnL);
+        EXPECT_EQ(served.Candidates[i].MaxDrawdown, uncached.Candidates[i].MaxDrawdown);
+        EXPECT_EQ(served.Candidates[i].Trades, uncached.Candidates[i].Trades);
+    }
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <numeric>
+#include "../src/rolling_stats.hpp"
+#include "../src/runner.hpp"
+
+TEST(rolling_stats, RollingStats_MatchesRecomputedWindow)
+{
+    /*
+    * Test verifies that count and time windows report the same mean, variance, min and max
+    * as a recomputation over the retained samples, and that a full time window counts overflows
+    */
+    using namespace ArbSimulation;
+    CounterRng rng(7, 0);
+    std::vector<std::pair<double, u_int64_t>> samples;
+    u_int64_t timestamp = 0;
+    for (size_t i = 0; i < 5000; ++i)
+    {
+        //a drifting level keeps the means of consecutive windows apart
+        timestamp += 1 + rng.Next() % 100;
+        samples.push_back({1e4 + i * 0.01 + (rng.Next() % 1000) / 100.0, timestamp});
+    }
+
+    auto check = [&](const WindowOptions& options)
+    {
+        RollingStats stats(options);
+        for (size_t i = 0; i < samples.size(); ++i)
+        {
+            stats.Add(samples[i].first, samples[i].second);
+            std::vector<double> window;
+            for (size_t j = 0; j <= i; ++j)
+            {
+                bool inTime = options.DurationNs == 0 || samples[j].second + options.DurationNs > samples[i].second;
+                if (inTime)
+                    window.push_back(samples[j].first);
+            }
+            size_t limit = options.Count > 0 ? options.Count : options.Capacity;
+            if (window.size() > limit)
+                window.erase(window.begin(), window.end() - limit);
+
+            EXPECT_EQ(stats.Size(), window.size());
+            if (stats.Size() != window.size())
+                break;
+            double mean = std::accumulate(window.begin(), window.end(), 0.0) / window.size();
+            EXPECT_NEAR(stats.GetMean(), mean, 1e-9);
+            if (window.size() > 1)
+            {
+                double m2 = 0;
+                for (auto value: window)
+                    m2 += (value - mean) * (value - mean);
+                EXPECT_NEAR(stats.GetVariance(), m2 / (window.size() - 1), 1e-6);
+            }
+            EXPECT_EQ(stats.GetMin(), *std::min_element(window.begin(), window.end()));
+            EXPECT_EQ(stats.GetMax(), *std::max_element(window.begin(), window.end()));
+        }
+        return stats.GetOverflows();
+    };
+
+    EXPECT_EQ(check({100, 0, 0}), 0);
+    EXPECT_EQ(check({0, 1500, 64}), 0);
+    EXPECT_GT(check({0, 5000, 64}), 0);
+    EXPECT_THROW(RollingStats({0, 1000, 0}), Exception);
+}
+
+TEST(rolling_stats, Ewma_DecaysByAlphaAndHalfLife)
+{
+    /*
+    * Test verifies that:
+    * 1) a fixed alpha gives the textbook recursion
+    * 2) with a half-life an old sample weighs half after one half-life of market time,
+    *    however many ticks arrived, and samples sharing a timestamp are averaged
+    */
+    using namespace ArbSimulation;
+    auto fixed = Ewma::FromAlpha(0.25);
+    fixed.Add(10);
+    fixed.Add(20);
+    EXPECT_DOUBLE_EQ(fixed.GetMean(), 12.5);
+    EXPECT_DOUBLE_EQ(fixed.GetVariance(), 0.75 * 0.25 * 100);
+
+    auto timed = Ewma::FromHalfLife(1000);
+    timed.Add(0, 0);
+    timed.Add(3, 1000);
+    //weights 0.5 and 1
+    EXPECT_NEAR(timed.GetMean(), 2, 1e-12);
+
+    auto sameTime = Ewma::FromHalfLife(1000);
+    sameTime.Add(1, 500);
+    sameTime.Add(2, 500);
+    sameTime.Add(6, 500);
+    EXPECT_NEAR(sameTime.GetMean(), 3, 1e-12);
+    EXPECT_TRUE(std::isnan(Ewma::FromAlpha(0.5).GetMean()));
+    EXPECT_THROW(Ewma::FromAlpha(0), Exception);
+}
+
+TEST(rolling_stats, ArbitrageStrategy_ZScoreSignals)
+{
+    /*
+    * Test verifies that the absolute signal is the default behaviour, and that z-score and EWMA signals
+    * trade a mean-reverting spread and react to the threshold
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    auto store = SyntheticMarket(config).GenerateStore();
+    std::unordered_map<std::string, u_int64_t> latencies{{"FutureA", 0}, {"FutureB", 0}};
+
+    RunParameters absolute{1, 2, -150, latencies};
+    RunParameters explicitAbsolute = absolute;
+    explicitAbsolute.Signal.Type = SignalType::Absolute;
+    auto expected = SimulationRun(store, absolute).Run();
+    auto actual = SimulationRun(store, explicitAbsolute).Run();
+    EXPECT_EQ(actual.PnL, expected.PnL);
+    EXPECT_EQ(actual.Trades, expected.Trades);
+
+    RunParameters zScore{1.5, 2, -150, latencies};
+    zScore.Signal.Type = SignalType::ZScore;
+    zScore.Signal.Window.Count = 500;
+    auto loose = SimulationRun(store, zScore).Run();
+    zScore.X = 3;
+    auto strict = SimulationRun(store, zScore).Run();
+    EXPECT_TRUE(loose.Error.empty()) << loose.Error;
+    EXPECT_GT(loose.Trades, 0);
+    EXPECT_LT(strict.Trades, loose.Trades);
+
+    RunParameters ewma{1.5, 2, -150, latencies};
+    ewma.Signal.Type = SignalType::Ewma;
+    ewma.Signal.HalfLifeNs = 30000000000ull;
+    ewma.Signal.WarmUp = 100;
+    auto decayed = SimulationRun(store, ewma).Run();
+    EXPECT_TRUE(decayed.Error.empty()) << decayed.Error;
+    EXPECT_GT(decayed.Trades, 0);
+}
@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+#include "../src/runner.hpp"
+#include "../src/synthetic.hpp"
+
+TEST(runner, SweepRunner_MatchesIndividualRuns)
+{
+    /*
+    * Test verifies that SweepRunner:
+    * 1) builds the full X/Y/Z grid
+    * 2) returns the same result for every point as a standalone run, whatever the number of threads
+    */
+    using namespace ArbSimulation;
+    auto store = TickStore::FromFiles({"../../tests/data/arb_strategy_test_A.csv", "../../tests/data/arb_strategy_test_B.csv"});
+    std::unordered_map<std::string, u_int64_t> latencies({{"FutureA", 0}, {"FutureB", 0}});
+    auto grid = SweepRunner::MakeGrid({1, 5}, {1, 2}, {-10, -150}, latencies);
+    ASSERT_EQ(grid.size(), 8);
+
+    auto results = SweepRunner(store, 3).Run(grid);
+    ASSERT_EQ(results.size(), grid.size());
+    for (size_t i = 0; i < grid.size(); ++i)
+    {
+        SimulationRun run(store, grid[i]);
+        auto expected = run.Run();
+        EXPECT_EQ(results[i].Parameters.X, grid[i].X);
+        EXPECT_EQ(results[i].PnL, expected.PnL);
+        EXPECT_EQ(results[i].Trades, expected.Trades);
+        EXPECT_EQ(results[i].Ticks, store->Size());
+    }
+
+    auto reference = std::find_if(results.begin(), results.end(), [](auto& r){ return r.Parameters.X == 5 && r.Parameters.Y == 2 && r.Parameters.Z == -150; });
+    EXPECT_EQ(reference->PnL, 77);
+
+    //the best run is the most profitable one which completed
+    size_t best = SweepRunner::FindBest(results);
+    for (auto& result: results)
+        EXPECT_LE(result.PnL, results[best].PnL);
+    results[best].Error = "Worker crashed";
+    results[best].PnL += 1000;
+    EXPECT_NE(SweepRunner::FindBest(results), best);
+    EXPECT_TRUE(results[SweepRunner::FindBest(results)].Error.empty());
+}
+
+TEST(runner, SimulationRun_ConflationKeepsTrades)
+{
+    /*
+    * Test verifies that conflation:
+    * 1) keeps trades of a price-reading strategy identical when unchanged prices are suppressed
+    * 2) removes same-timestamp and size-only updates and reports them
+    * 3) is rejected for ZScore and Ewma signals, whose statistics sample every update
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    config.DurationNs = 1800ull * 1000000000ull;
+    config.SameTimestampProbability = 0.2;
+    config.MeanExtraSpreadTicks = 0.05;
+    TickStorePtr store = SyntheticMarket(config).GenerateStore();
+
+    RunParameters parameters{0.5, 1, -75, {{"FutureA", 40000000}, {"FutureB", 1000000}}};
+    SimulationRun full(store, parameters);
+    auto expected = full.Run();
+
+    parameters.Conflation = std::make_shared<ConflationSchedule>(*store, ConflationOptions{false, true});
+    SimulationRun conflated(store, parameters);
+    auto result = conflated.Run();
+
+    auto stats = conflated.GetConflationStats();
+    EXPECT_GT(stats.Unchanged, store->Size() / 2);
+    EXPECT_EQ(result.Ticks, stats.Dispatched);
+    EXPECT_EQ(stats.Input, stats.Dispatched + stats.Unchanged);
+    ASSERT_GT(expected.Trades, 0);
+    ASSERT_EQ(result.Trades, expected.Trades);
+    EXPECT_DOUBLE_EQ(result.PnL, expected.PnL);
+    auto& expectedLog = full.GetStrategy()->GetPositionKeeper().GetTradeLog();
+    auto& log = conflated.GetStrategy()->GetPositionKeeper().GetTradeLog();
+    for (size_t i = 0; i < log.size(); ++i)
+    {
+        EXPECT_EQ(log[i].SentTimestamp, expectedLog[i].SentTimestamp);
+        EXPECT_EQ(log[i].ExecutedTimestamp, expectedLog[i].ExecutedTimestamp);
+        EXPECT_EQ(log[i].ExecPrice, expectedLog[i].ExecPrice);
+    }
+
+    parameters.Conflation = std::make_shared<ConflationSchedule>(*store, ConflationOptions{true, true});
+    SimulationRun coalesced(store, parameters);
+    coalesced.Run();
+    auto coalescedStats = coalesced.GetConflationStats();
+    EXPECT_GT(coalescedStats.Coalesced, 0);
+    EXPECT_EQ(coalescedStats.Input, coalescedStats.Dispatched + coalescedStats.Coalesced + coalescedStats.Unchanged);
+
+    for (auto type: {SignalType::ZScore, SignalType::Ewma})
+    {
+        auto signalled = parameters;
+        signalled.Signal.Type = type;
+        signalled.Signal.Window.Count = 50;
+        signalled.Signal.Alpha = 0.05;
+        EXPECT_THROW(SimulationRun(store, signalled), Exception);
+        signalled.Conflation = nullptr;
+        EXPECT_NO_THROW(SimulationRun(store, signalled));
+    }
+}
+
+TEST(runner, SweepRunner_ApproximateSweepReportsError)
+{
+    /*
+    * Test verifies that an approximate sweep:
+    * 1) decimates the store to one update per instrument and bucket, and a 1ns bucket is plain timestamp coalescing
+    * 2) replays every Nth point and the best point exactly, with the same results as a full sweep
+    * 3) reports the PnL error of the checked points and replays far fewer ticks than the full grid
+    * 4) picks the best point among runs without an error
+    * 5) refuses points which set their own conflation
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    config.DurationNs = 1800ull * 1000000000ull;
+    TickStorePtr store = SyntheticMarket(config).GenerateStore();
+
+    ConflationSchedule coalesced(*store, ConflationOptions{true, false});
+    ConflationOptions options;
+    options.BucketNs = 1;
+    ConflationSchedule nanosecond(*store, options);
+    ASSERT_EQ(nanosecond.Size(), coalesced.Size());
+    for (size_t i = 0; i < coalesced.Size(); ++i)
+        ASSERT_EQ(nanosecond[i], coalesced[i]);
+
+    options.BucketNs = 1000000000;
+    auto decimation = std::make_shared<ConflationSchedule>(*store, options);
+    EXPECT_TRUE(decimation->IsApproximate());
+    EXPECT_LE(decimation->Size(), 2 * 1800);
+    for (size_t i = 1; i < decimation->Size(); ++i)
+    {
+        auto& previous = (*store)[(*decimation)[i - 1]];
+        auto& record = (*store)[(*decimation)[i]];
+        EXPECT_LE(previous.Timestamp, record.Timestamp);
+        EXPECT_FALSE(previous.InstrumentId == record.InstrumentId && previous.Timestamp / options.BucketNs == record.Timestamp / options.BucketNs);
+    }
+
+    std::unordered_map<std::string, u_int64_t> latencies{{"FutureA", 0}, {"FutureB", 0}};
+    auto grid = SweepRunner::MakeGrid({0.5, 1, 2}, {1, 2}, {-75, -150}, latencies);
+    auto full = SweepRunner(store, 2).Run(grid);
+    auto result = SweepRunner(store, 3).RunApproximate(grid, decimation, 5);
+
+    ASSERT_EQ(result.Results.size(), grid.size());
+    EXPECT_EQ(std::vector<size_t>(result.Checked.begin(), result.Checked.begin() + 3), std::vector<size_t>({0, 5, 10}));
+    EXPECT_NE(std::find(result.Checked.begin(), result.Checked.end(), result.Best), result.Checked.end());
+    double maxError = 0;
+    for (size_t i = 0; i < result.Checked.size(); ++i)
+    {
+        EXPECT_EQ(result.Exact[i].PnL, full[result.Checked[i]].PnL);
+        maxError = std::max(maxError, std::abs(result.Results[result.Checked[i]].PnL - full[result.Checked[i]].PnL));
+    }
+    for (size_t i = 0; i < grid.size(); ++i)
+    {
+        EXPECT_EQ(result.Results[i].Parameters.X, grid[i].X);
+        EXPECT_EQ(result.Results[i].Ticks, decimation->Size());
+    }
+    EXPECT_EQ(result.MaxAbsError, maxError);
+    EXPECT_LE(result.MeanAbsError, result.RmsError);
+    EXPECT_EQ(result.FullGridTicks, grid.size() * store->Size());
+    EXPECT_GT(result.GetSpeedup(), 2.5);
+    EXPECT_EQ(SweepRunner::ToReport(result).size(), grid.size() + 1);
+
+    //a failed approximate run with the highest PnL is not the best point
+    SweepRunner failing(store, 2);
+    failing.SetMemo([&](const std::vector<RunParameters>& batch, const RunBatch& replay)
+    {
+        auto runs = replay(batch);
+        for (auto& run: runs)
+            if (run.Parameters.Conflation && run.Parameters.X == grid[result.Best].X && run.Parameters.Y == grid[result.Best].Y
+                && run.Parameters.Z == grid[result.Best].Z)
+            {
+                run.PnL += 1e9;
+                run.Error = "failed";
+            }
+        return runs;
+    });
+    auto failed = failing.RunApproximate(grid, decimation, 5);
+    EXPECT_EQ(failed.Results[result.Best].Error, "failed");
+    EXPECT_NE(failed.Best, result.Best);
+    EXPECT_TRUE(failed.Results[failed.Best].Error.empty());
+
+    auto conflated = grid;
+    conflated[1].Conflation = decimation;
+    EXPECT_THROW(SweepRunner(store, 2).RunApproximate(conflated, decimation, 5), Exception);
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "../src/arbitrage.hpp"
+#include "../src/sharded_simulation.hpp"
+
+TEST(sharded_simulation, ShardedSimulation_MatchesSequentialRun)
+{
+    /*
+    * Test verifies that ShardedSimulation:
+    * 1) produces exactly the same trades as the sequential chain
+    * 2) does so for zero and non-zero latencies and any number of shards
+    * 3) detaches from the strategy when it is destroyed, so the strategy can be replayed by another simulation
+    */
+    using namespace ArbSimulation;
+    auto store = TickStore::FromFiles({"../../tests/data/csv_io_test_case_3.csv", "../../tests/data/csv_io_test_case_2.csv"});
+    std::vector<std::unordered_map<std::string, u_int64_t>> latencySets{
+        {{"FutureA", 0}, {"FutureB", 0}},
+        {{"FutureA", 40000000}, {"FutureB", 1000000}},
+        {{"FutureA", 1000}, {"FutureB", 5000000}}};
+
+    for (auto& latencies: latencySets)
+    {
+        auto instrManager = std::make_shared<InstrumentManager>();
+        auto marketDataManager = std::make_shared<MarketDataSimulationManager>(instrManager, store);
+        auto orderMatcher = std::make_shared<OrderMatcher>(latencies);
+        auto expected = std::make_shared<ArbitrageStrategy>(0.5, 1, -75, instrManager);
+        expected->AddSubscriber(orderMatcher);
+        orderMatcher->AddSubscriber(expected);
+        marketDataManager->AddSubscriber(orderMatcher);
+        marketDataManager->AddSubscriber(expected);
+        while(marketDataManager->Step());
+        ASSERT_GT(expected->GetTrades().size(), 0);
+
+        for (size_t shards: {1, 2, 4})
+        {
+            auto shardedInstrManager = std::make_shared<InstrumentManager>();
+            auto actual = std::make_shared<ArbitrageStrategy>(0.5, 1, -75, shardedInstrManager);
+            ShardedSimulation simulation(shardedInstrManager, store, actual, latencies, shards);
+            simulation.Run();
+
+            EXPECT_EQ(actual->GetFullPnL(), expected->GetFullPnL());
+            ASSERT_EQ(actual->GetTrades().size(), expected->GetTrades().size());
+            for (size_t i = 0; i < expected->GetTrades().size(); ++i)
+            {
+                auto& a = actual->GetTrades()[i];
+                auto& e = expected->GetTrades()[i];
+                EXPECT_EQ(a->Instrument->SecurityId, e->Instrument->SecurityId);
+                EXPECT_EQ(a->SentTimestamp, e->SentTimestamp);
+                EXPECT_EQ(a->ExecutedTimestamp, e->ExecutedTimestamp);
+                EXPECT_EQ(a->ExecPrice, e->ExecPrice);
+                EXPECT_EQ(a->Qty, e->Qty);
+                EXPECT_EQ(a->Side, e->Side);
+            }
+        }
+    }
+
+    //a router left behind would route later orders to a destroyed simulation, and twice with a second one
+    auto instrManager = std::make_shared<InstrumentManager>();
+    auto strategy = std::make_shared<ArbitrageStrategy>(0.5, 1, -75, instrManager);
+    strategy->AddSubscriber(std::make_shared<Subscriber>());
+    for (size_t run = 0; run < 2; ++run)
+    {
+        ShardedSimulation simulation(instrManager, store, strategy, latencySets[0], 2);
+        EXPECT_EQ(strategy->GetSubscribersCount(), 2);
+        simulation.Run();
+    }
+    EXPECT_EQ(strategy->GetSubscribersCount(), 1);
+}
+
+TEST(sharded_simulation, ShardedSimulation_DropsOrdersToFinishedShards)
+{
+    /*
+    * Test verifies that orders for an instrument whose shard has replayed all of its updates do not block the replay
+    * once they fill the shard's order queue: they are never filled, like in the sequential chain
+    */
+    using namespace ArbSimulation;
+    struct FloodingStrategy: public BasicStrategy
+    {
+        using BasicStrategy::BasicStrategy;
+        size_t Updates = 0;
+        void OnL1Update(L1UpdatePtr update) override
+        {
+            ++Updates;
+            if (update->Instrument->SecurityId == "FutureB")
+                for (size_t i = 0; i < 1000; ++i)
+                    SendMarketOrder("FutureA", 1, OrderSide::Buy);
+        }
+        void OnOrderFilled(OrderPtr order) override
+        {}
+    };
+    auto store = std::make_shared<TickStore>();
+    u_int32_t a = store->GetOrAddInstrument("FutureA");
+    u_int32_t b = store->GetOrAddInstrument("FutureB");
+    for (u_int64_t i = 0; i < 2; ++i)
+        store->Append(TickRecord{1000 + i, a, 0, 1, 100, 101, 1});
+    for (u_int64_t i = 0; i < 10; ++i)
+        store->Append(TickRecord{2000 + i, b, 0, 1, 100, 101, 1});
+    store->Sort();
+
+    auto instrManager = std::make_shared<InstrumentManager>();
+    auto strategy = std::make_shared<FloodingStrategy>(instrManager);
+    ShardedSimulation simulation(instrManager, store, strategy, {{"FutureA", 0}, {"FutureB", 0}}, 2);
+    simulation.Run();
+    EXPECT_EQ(strategy->Updates, store->Size());
+    EXPECT_TRUE(strategy->GetTrades().empty());
+}
+
+TEST(sharded_simulation, ShardedSimulation_PropagatesStrategyException)
+{
+    /*
+    * Test verifies that:
+    * 1) an exception thrown by the strategy stops all shards and reaches the caller
+    * 2) a strategy with compute latency is rejected
+    */
+    using namespace ArbSimulation;
+    struct ThrowingStrategy: public BasicStrategy
+    {
+        using BasicStrategy::BasicStrategy;
+        size_t Updates = 0;
+        void OnL1Update(L1UpdatePtr update) override
+        {
+            if (++Updates == 100)
+                throw StrategyException("Stop");
+        }
+        void OnOrderFilled(OrderPtr order) override
+        {}
+    };
+    auto store = TickStore::FromFiles({"../../tests/data/csv_io_test_case_3.csv", "../../tests/data/csv_io_test_case_2.csv"});
+    auto instrManager = std::make_shared<InstrumentManager>();
+    auto strategy = std::make_shared<ThrowingStrategy>(instrManager);
+    ShardedSimulation simulation(instrManager, store, strategy, {{"FutureA", 0}, {"FutureB", 0}}, 2);
+    EXPECT_THROW(simulation.Run(), StrategyException);
+    EXPECT_EQ(strategy->Updates, 100);
+
+    //compute delays are measured on the coordinating thread and would exceed the lookahead of the shards
+    auto timed = std::make_shared<ThrowingStrategy>(instrManager);
+    timed->EnableComputeLatency(1);
+    EXPECT_THROW(ShardedSimulation(instrManager, store, timed, {{"FutureA", 0}, {"FutureB", 0}}, 2), Exception);
+}
@@ -190,4 +190,73 @@ TEST(simulation, OrderMatcher_TwoInstrumentsTraded)
         EXPECT_EQ(timestamps[i], sub->ordersSent[i]->SentTimestamp);
         EXPECT_EQ(timestamps[i] + 4, sub->ordersSent[i]->ExecutedTimestamp);
     }
-}
\ No newline at end of file
+}
+TEST(simulation, MarketDataSimulationManager_Conflation)
+{
+    /*
+    * Test verifies that conflation in MarketDataSimulationManager:
+    * 1) dispatches one final state per instrument and timestamp
+    * 2) drops updates which do not change prices when requested and no order is outstanding
+    * 3) accounts for every removed update
+    */
+    using namespace ArbSimulation;
+
+    struct MockSubscriber: public Subscriber
+    {
+        std::vector<L1Update> Updates;
+
+        void OnNewMessage(MessagePtr message) final
+        {
+            Updates.push_back(*std::static_pointer_cast<MDUpdateMessage>(message)->Update);
+        }
+    };
+    auto store = TickStore::FromFiles({"../../tests/data/csv_io_test_case_2.csv", "../../tests/data/csv_io_test_case_3.csv"});
+    auto replay = [&](const ConflationOptions* options)
+    {
+        auto sub = std::make_shared<MockSubscriber>();
+        MarketDataSimulationManager manager{std::make_shared<InstrumentManager>(), store};
+        if (options)
+            manager.EnableConflation(*options);
+        manager.AddSubscriber(sub);
+        while(manager.Step());
+        return std::make_pair(sub->Updates, manager.GetConflationStats());
+    };
+    auto [full, fullStats] = replay(nullptr);
+    EXPECT_EQ(full.size(), store->Size());
+    EXPECT_EQ(fullStats.Dispatched, store->Size());
+
+    ConflationOptions coalesce;
+    auto [coalesced, stats] = replay(&coalesce);
+    EXPECT_EQ(stats.Input, store->Size());
+    EXPECT_EQ(stats.Dispatched, coalesced.size());
+    EXPECT_EQ(stats.Unchanged, 0);
+    EXPECT_GT(stats.Coalesced, 0);
+    EXPECT_EQ(stats.Input, stats.Dispatched + stats.Coalesced);
+
+    std::map<std::pair<u_int64_t, std::string>, L1Update> finalStates;
+    for (auto& update: full)
+        finalStates[{update.Timestamp, update.Instrument->SecurityId}] = update;
+    ASSERT_EQ(finalStates.size(), coalesced.size());
+    for (auto& update: coalesced)
+    {
+        auto& expected = finalStates[{update.Timestamp, update.Instrument->SecurityId}];
+        EXPECT_EQ(update.BidPrice, expected.BidPrice);
+        EXPECT_EQ(update.AskPrice, expected.AskPrice);
+        EXPECT_EQ(update.BidSize, expected.BidSize);
+        EXPECT_EQ(update.AskSize, expected.AskSize);
+    }
+
+    ConflationOptions prices{true, true};
+    auto [priced, priceStats] = replay(&prices);
+    EXPECT_GT(priceStats.Unchanged, 0);
+    EXPECT_EQ(priceStats.Input, priceStats.Dispatched + priceStats.Coalesced + priceStats.Unchanged);
+    EXPECT_EQ(priced.size(), priceStats.Dispatched);
+    //without orders an update is skipped only when the previous dispatched one is the same instrument at the same prices
+    for (size_t i = 1; i < priced.size(); ++i)
+    {
+        if (priced[i].Instrument == priced[i - 1].Instrument)
+        {
+            EXPECT_TRUE(priced[i].BidPrice != priced[i - 1].BidPrice || priced[i].AskPrice != priced[i - 1].AskPrice);
+        }
+    }
+}
@@ -207,3 +207,128 @@ TEST(strategy, PositionKeeper_TwoInstrumentsTraded)
     EXPECT_EQ(pnl, -2.5);
 }
 
+
+TEST(strategy, PositionKeeper_TradeLog)
+{
+    /*
+    * Test verifies that the flat trade log keeps a snapshot of every fill with instrument indices
+    */
+    using namespace ArbSimulation;
+    PositionKeeper keeper;
+    InstrumentManager manager;
+    auto order = std::make_shared<Order>();
+    order->Instrument = manager.GetOrCreateInstrument("FutureB");
+    order->SentTimestamp = 10;
+    order->ExecutedTimestamp = 15;
+    order->ExecPrice = 100;
+    order->Qty = 2;
+    order->Side = OrderSide::Sell;
+    keeper.ProcessOrderFill(order);
+
+    order->Instrument = manager.GetOrCreateInstrument("FutureA");
+    order->ExecPrice = 101;
+    order->Side = OrderSide::Buy;
+    order->Type = OrderType::StopLoss;
+    keeper.ProcessOrderFill(order);
+
+    auto& log = keeper.GetTradeLog();
+    ASSERT_EQ(log.size(), 2);
+    EXPECT_EQ(keeper.GetTradeInstruments(), std::vector<std::string>({"FutureB", "FutureA"}));
+    EXPECT_EQ(log[0].InstrumentIndex, 0);
+    EXPECT_EQ(log[0].ExecPrice, 100);
+    EXPECT_EQ(log[0].Side, u_int8_t(OrderSide::Sell));
+    EXPECT_EQ(log[0].Type, u_int8_t(OrderType::Market));
+    EXPECT_EQ(log[1].InstrumentIndex, 1);
+    EXPECT_EQ(log[1].ExecPrice, 101);
+    EXPECT_EQ(log[1].Type, u_int8_t(OrderType::StopLoss));
+    EXPECT_EQ(log[1].ExecutedTimestamp, 15);
+}
+
+TEST(strategy, BasicStrategy_ComputeLatencyDelaysOrders)
+{
+    /*
+    * Test verifies that with compute latency enabled:
+    * 1) the send time of an order is delayed by the scaled time the strategy spent before sending it
+    * 2) time spent by the subscribers of an order does not delay later orders of the same callback
+    * 3) the delayed order misses an update it would have been filled on otherwise
+    * The compute clock is a counter advanced by the test, so delays are exact.
+    */
+    using namespace ArbSimulation;
+    static u_int64_t clock = 0;
+
+    struct SlowStrategy: public BasicStrategy
+    {
+        SlowStrategy(std::shared_ptr<InstrumentManager> instrManager): BasicStrategy(instrManager)
+        {}
+
+        void OnL1Update(L1UpdatePtr update) override
+        {
+            if (Sent)
+                return;
+            clock += 1000000;
+            SendMarketOrder("FutureA", 1, OrderSide::Buy);
+            clock += 200000;
+            SendMarketOrder("FutureB", 1, OrderSide::Buy);
+            Sent = true;
+        }
+
+        void OnOrderFilled(OrderPtr order) override
+        {}
+
+        bool Sent = false;
+    };
+
+    struct SlowSubscriber: public Subscriber
+    {
+        void OnNewMessage(MessagePtr message) override
+        {
+            clock += 10000000;
+        }
+    };
+
+    auto replay = [](double scale)
+    {
+        auto instrManager = std::make_shared<InstrumentManager>();
+        auto strategy = std::make_shared<SlowStrategy>(instrManager);
+        auto matcher = std::make_shared<OrderMatcher>(std::unordered_map<std::string, u_int64_t>{{"FutureA", 1000}, {"FutureB", 1000}});
+        if (scale > 0)
+            strategy->EnableComputeLatency(scale, [](){ return clock; });
+        strategy->AddSubscriber(matcher);
+        strategy->AddSubscriber(std::make_shared<SlowSubscriber>());
+        matcher->AddSubscriber(strategy);
+        for (u_int64_t timestamp: {1000, 501000, 5001000})
+            for (auto securityId: {"FutureA", "FutureB"})
+            {
+                auto message = std::make_shared<MDUpdateMessage>();
+                message->Update = std::make_shared<L1Update>();
+                message->Update->Instrument = instrManager->GetOrCreateInstrument(securityId);
+                message->Update->Timestamp = timestamp;
+                message->Update->BidPrice = timestamp / 1000;
+                message->Update->AskPrice = timestamp / 1000 + 1;
+                matcher->OnNewMessage(message);
+                strategy->OnNewMessage(message);
+            }
+        return strategy;
+    };
+
+    auto instant = replay(0);
+    ASSERT_EQ(instant->GetTrades().size(), 2);
+    EXPECT_EQ(instant->GetTrades()[0]->SentTimestamp, 1000);
+    EXPECT_EQ(instant->GetTrades()[0]->ExecPrice, 2);
+    EXPECT_EQ(instant->GetComputeTimeStats().Callbacks, 0);
+
+    auto delayed = replay(0.5);
+    ASSERT_EQ(delayed->GetTrades().size(), 2);
+    auto& first = delayed->GetTrades()[0];
+    auto& second = delayed->GetTrades()[1];
+    EXPECT_EQ(first->ComputeDelay, 500000);
+    EXPECT_EQ(second->ComputeDelay, 600000);
+    EXPECT_EQ(first->SentTimestamp, 1000 + 500000);
+    EXPECT_EQ(first->ExecutedTimestamp, 1000 + 500000 + 1000);
+    EXPECT_EQ(first->ExecPrice, 502);
+    auto& stats = delayed->GetComputeTimeStats();
+    EXPECT_EQ(stats.Callbacks, 8);
+    EXPECT_EQ(stats.Orders, 2);
+    EXPECT_EQ(stats.MaxNs, 600000);
+    EXPECT_EQ(stats.TotalNs, 600000);
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <set>
+#include "../src/runner.hpp"
+#include "../src/strategy_host.hpp"
+
+TEST(strategy_host, StrategyHost_MatchesIndividualRuns)
+{
+    /*
+    * Test verifies that StrategyHost:
+    * 1) runs every hosted strategy over the whole stream independently
+    * 2) returns the same results as standalone runs
+    * 3) recycles updates instead of allocating one per tick
+    */
+    using namespace ArbSimulation;
+
+    struct CountingStrategy: public BasicStrategy
+    {
+        CountingStrategy(std::shared_ptr<InstrumentManager> instrManager): BasicStrategy(instrManager)
+        {}
+
+        void OnL1Update(L1UpdatePtr update) override
+        {
+            ++Updates;
+            Addresses.insert(update.get());
+            Checksum += update->Timestamp + update->BidPrice;
+        }
+
+        void OnOrderFilled(OrderPtr order) override
+        {}
+
+        size_t Updates = 0;
+        double Checksum = 0;
+        std::set<const L1Update*> Addresses;
+    };
+
+    auto store = TickStore::FromFiles({"../../tests/data/csv_io_test_case_2.csv", "../../tests/data/csv_io_test_case_3.csv"});
+    std::unordered_map<std::string, u_int64_t> latencies({{"FutureA", 40000000}, {"FutureB", 1000000}});
+    std::vector<RunParameters> variants{{0.5, 1, -75, latencies}, {1, 2, -150, latencies}, {2, 1, -10, latencies}};
+
+    StrategyHost host(store);
+    for (auto& variant: variants)
+        host.Add("arb_" + std::to_string(variant.X), [variant](std::shared_ptr<InstrumentManager> instrManager)
+        {
+            return std::make_shared<ArbitrageStrategy>(variant.X, variant.Y, variant.Z, instrManager);
+        }, variant.Latencies);
+    auto counting = host.Add("counting", [](std::shared_ptr<InstrumentManager> instrManager)
+    {
+        return std::make_shared<CountingStrategy>(instrManager);
+    }, latencies);
+    ASSERT_EQ(host.GetStrategiesCount(), 4);
+
+    auto results = host.Run();
+    ASSERT_EQ(results.size(), 4);
+    for (size_t i = 0; i < variants.size(); ++i)
+    {
+        SimulationRun run(store, variants[i]);
+        auto expected = run.Run();
+        EXPECT_EQ(results[i].Name, "arb_" + std::to_string(variants[i].X));
+        EXPECT_EQ(results[i].PnL, expected.PnL);
+        EXPECT_EQ(results[i].Trades, expected.Trades);
+        EXPECT_EQ(results[i].Error, expected.Error);
+    }
+
+    auto strategy = std::static_pointer_cast<CountingStrategy>(host.GetStrategy(counting));
+    double checksum = 0;
+    for (size_t i = 0; i < store->Size(); ++i)
+        checksum += (*store)[i].Timestamp + (*store)[i].BidPrice;
+    EXPECT_EQ(results[counting].Ticks, store->Size());
+    EXPECT_EQ(strategy->Updates, store->Size());
+    EXPECT_DOUBLE_EQ(strategy->Checksum, checksum);
+    EXPECT_LE(strategy->Addresses.size(), MarketDataSimulationManager::UPDATE_POOL_SIZE * store->GetSecurityIds().size());
+}
+
+TEST(strategy_host, MarketDataSimulationManager_KeepsRetainedUpdates)
+{
+    /*
+    * Test verifies that recycled updates are never overwritten while a subscriber still holds them
+    */
+    using namespace ArbSimulation;
+
+    struct RetainingSubscriber: public Subscriber
+    {
+        std::vector<L1UpdatePtr> Updates;
+        std::vector<L1Update> Copies;
+
+        void OnNewMessage(MessagePtr message) final
+        {
+            auto& update = std::static_pointer_cast<MDUpdateMessage>(message)->Update;
+            if (Copies.size() % 3 == 0)
+                Updates.push_back(update);
+            Copies.push_back(*update);
+        }
+    };
+    auto store = TickStore::FromFiles({"../../tests/data/csv_io_test_case_3.csv"});
+    auto sub = std::make_shared<RetainingSubscriber>();
+    MarketDataSimulationManager manager{std::make_shared<InstrumentManager>(), store};
+    manager.AddSubscriber(sub);
+    while(manager.Step());
+
+    ASSERT_EQ(sub->Copies.size(), store->Size());
+    for (size_t i = 0; i < sub->Updates.size(); ++i)
+    {
+        EXPECT_EQ(sub->Updates[i]->Timestamp, sub->Copies[i * 3].Timestamp);
+        EXPECT_EQ(sub->Updates[i]->BidPrice, sub->Copies[i * 3].BidPrice);
+        EXPECT_EQ(sub->Updates[i]->AskSize, sub->Copies[i * 3].AskSize);
+    }
+}
+
+TEST(strategy_host, StrategyHost_AppliesRunOptions)
+{
+    /*
+    * Test verifies that:
+    * 1) a hosted strategy with stochastic latencies and conflation replays exactly like a SimulationRun of the same parameters
+    * 2) a strategy sampling every update (a ZScore signal) is not hosted with conflation
+    */
+    using namespace ArbSimulation;
+    auto store = TickStore::FromFiles({"../../tests/data/csv_io_test_case_2.csv", "../../tests/data/csv_io_test_case_3.csv"});
+    auto jitter = std::make_shared<LatencyModel>();
+    jitter->insert({"FutureA", LatencyDistribution::LogNormal(20000000, 1)});
+    jitter->insert({"FutureB", LatencyDistribution::Constant(1000000)});
+    auto conflation = std::make_shared<ConflationSchedule>(*store, ConflationOptions{true, true});
+    std::vector<RunParameters> variants{{0.5, 1, -75, {}, jitter, 7, 0, conflation}, {1, 2, -150, {}, jitter, 7, 0, conflation}};
+
+    StrategyHost host(store);
+    for (auto& variant: variants)
+        host.Add("arb_" + std::to_string(variant.X), [variant](std::shared_ptr<InstrumentManager> instrManager)
+        {
+            return std::make_shared<ArbitrageStrategy>(variant.X, variant.Y, variant.Z, instrManager);
+        }, variant.Latencies, HostedOptions{variant.StochasticLatencies, variant.Seed, variant.Conflation});
+    auto results = host.Run();
+    ASSERT_EQ(results.size(), variants.size());
+    for (size_t i = 0; i < variants.size(); ++i)
+    {
+        auto expected = SimulationRun(store, variants[i]).Run();
+        EXPECT_EQ(results[i].PnL, expected.PnL);
+        EXPECT_EQ(results[i].Trades, expected.Trades);
+        EXPECT_EQ(results[i].Ticks, expected.Ticks);
+        EXPECT_LT(results[i].Ticks, store->Size());
+    }
+
+    SignalOptions zScore;
+    zScore.Type = SignalType::ZScore;
+    zScore.Window.Count = 50;
+    EXPECT_THROW(host.Add("zscore", [zScore](std::shared_ptr<InstrumentManager> instrManager)
+        {
+            return std::make_shared<ArbitrageStrategy>(1, 1, -75, instrManager, zScore);
+        }, {}, HostedOptions{nullptr, 0, conflation}), Exception);
+    EXPECT_EQ(host.GetStrategiesCount(), variants.size());
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "../src/data_cache.hpp"
+#include "../src/synthetic.hpp"
+
+TEST(synthetic, SyntheticMarket_IsReproducibleAndConsistent)
+{
+    /*
+    * Test verifies that SyntheticMarket:
+    * 1) produces identical output for the same seed and different output for another seed
+    * 2) produces sorted, uncrossed books on the price grid
+    * 3) produces the same instrument stream whatever other instruments are generated along with it
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Instruments = 3;
+    config.DurationNs = 600ull * 1000000000ull;
+    config.Seed = 42;
+
+    auto first = SyntheticMarket(config).GenerateStore();
+    auto second = SyntheticMarket(config).GenerateStore();
+    ASSERT_GT(first->Size(), 3 * 600 * 10);
+    ASSERT_EQ(first->Size(), second->Size());
+    EXPECT_EQ(std::memcmp(first->Data(), second->Data(), first->Size() * sizeof(TickRecord)), 0);
+
+    config.Seed = 43;
+    auto other = SyntheticMarket(config).GenerateStore();
+    EXPECT_TRUE(other->Size() != first->Size() || std::memcmp(first->Data(), other->Data(), first->Size() * sizeof(TickRecord)) != 0);
+
+    for (size_t i = 0; i < first->Size(); ++i)
+    {
+        auto& record = (*first)[i];
+        if (i > 0)
+        {
+            EXPECT_LE((*first)[i - 1].Timestamp, record.Timestamp);
+        }
+        EXPECT_LT(record.BidPrice, record.AskPrice);
+        EXPECT_DOUBLE_EQ(record.BidPrice, std::round(record.BidPrice / config.PriceStep) * config.PriceStep);
+        EXPECT_GE(record.BidSize, 1);
+    }
+
+    config.Seed = 42;
+    SyntheticMarket market(config);
+    SyntheticMarket::MergedStream alone(market, 1, 2);
+    TickRecord record;
+    size_t matched = 0;
+    for (size_t i = 0; i < first->Size(); ++i)
+    {
+        if ((*first)[i].InstrumentId != 1)
+            continue;
+        ASSERT_TRUE(alone.Next(record));
+        EXPECT_EQ(record.Timestamp, (*first)[i].Timestamp);
+        EXPECT_EQ(record.BidPrice, (*first)[i].BidPrice);
+        ++matched;
+    }
+    EXPECT_FALSE(alone.Next(record));
+    EXPECT_GT(matched, 0);
+}
+
+TEST(synthetic, SyntheticMarket_CSVAndImageRoundTrip)
+{
+    /*
+    * Test verifies that generated data written as CSV and as a streamed tick image
+    * loads back through LoadTickStore into the same dataset
+    */
+    using namespace ArbSimulation;
+    SyntheticConfig config;
+    config.Names = {"FutureA", "FutureB"};
+    config.DurationNs = 120ull * 1000000000ull;
+    SyntheticMarket market(config);
+    auto expected = market.GenerateStore();
+
+    auto directory = std::filesystem::temp_directory_path() / "arbsim_synthetic_test";
+    std::filesystem::create_directories(directory);
+    auto csvPath = (directory / "synthetic.csv").string();
+    auto imagePath = (directory / "synthetic.ticks").string();
+    {
+        std::ofstream file{csvPath};
+        char line[256];
+        for (size_t i = 0; i < expected->Size(); ++i)
+            file.write(line, SyntheticMarket::FormatCSV((*expected)[i], expected->GetSecurityIds()[(*expected)[i].InstrumentId], line));
+    }
+    TickImage::Writer writer(imagePath, expected->GetSecurityIds(), {});
+    writer.Append(expected->Data(), expected->Size() / 2);
+    writer.Append(expected->Data() + expected->Size() / 2, expected->Size() - expected->Size() / 2);
+    writer.Close();
+
+    auto fromCSV = LoadTickStore({csvPath});
+    auto fromImage = LoadTickStore({imagePath});
+    EXPECT_TRUE(fromImage->IsMapped());
+    ASSERT_EQ(fromCSV->Size(), expected->Size());
+    ASSERT_EQ(fromImage->Size(), expected->Size());
+    EXPECT_EQ(fromImage->GetSecurityIds(), expected->GetSecurityIds());
+    //rows sharing a timestamp may come back in another order, compare them as sorted tuples
+    auto rows = [](const TickStore& store)
+    {
+        std::vector<std::tuple<u_int64_t, std::string, double, double, double, double>> result;
+        for (size_t i = 0; i < store.Size(); ++i)
+            result.emplace_back(store[i].Timestamp, store.GetSecurityIds()[store[i].InstrumentId],
+                store[i].BidSize, store[i].BidPrice, store[i].AskPrice, store[i].AskSize);
+        std::sort(result.begin(), result.end());
+        return result;
+    };
+    EXPECT_EQ(rows(*fromCSV), rows(*expected));
+    EXPECT_EQ(std::memcmp(fromImage->Data(), expected->Data(), expected->Size() * sizeof(TickRecord)), 0);
+
+    std::filesystem::remove_all(directory);
+}
@@ -2,6 +2,26 @@
 #include "simulation.hpp"
 #include "strategy_base.hpp"
 #include "arbitrage_strategy.hpp"
+#include "data_cache.hpp"
+#include "analytics.hpp"
+#include "sharded_simulation.hpp"
+#include "runner.hpp"
+#include "synthetic.hpp"
+#include "latency.hpp"
+#include "strategy_host.hpp"
+#include "aggregation.hpp"
+#include "compressed_input.hpp"
+#include "rolling_stats.hpp"
+#include "flight_recorder.hpp"
+#include "bootstrap.hpp"
+#include "parameter_search.hpp"
+#include "coroutine_strategy.hpp"
+#include "arena.hpp"
+#include "perf_counters.hpp"
+#include "data_cleaning.hpp"
+#include "portfolio.hpp"
+#include "process_sweep.hpp"
+#include "result_cache.hpp"
 
 int main(int argc, char* argv[])
 {
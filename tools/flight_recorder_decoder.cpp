@@ -0,0 +1,71 @@
+/*
+* Prints a flight recorder dump written on StrategyException or by BasicStrategy::DumpFlightRecord.
+*
+* Usage: ./FlightRecorderDecoder [--last N] [--csv] dump.bin
+*
+* One line per event, oldest first: tick, timestamp, event, instrument, order id, side, order type, price, value.
+* Price/value are bid/ask for updates, 0/qty for new orders and exec price/qty for fills.
+*/
+#include <iomanip>
+
+#include "../src/DTO.hpp"
+#include "../src/flight_recorder.hpp"
+
+int main(int argc, char* argv[])
+{
+    using namespace ArbSimulation;
+    std::string path;
+    size_t last = 0;
+    bool csv = false;
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--csv")
+                csv = true;
+            else if (arg == "--last" && i + 1 < argc)
+                last = std::stoull(argv[++i]);
+            else if (arg.rfind("--", 0) != 0 && path.empty())
+                path = arg;
+            else
+                throw Exception("Unknown argument " + arg);
+        }
+        if (path.empty())
+            throw Exception("Usage: FlightRecorderDecoder [--last N] [--csv] dump.bin");
+
+        auto dump = FlightRecorder::Read(path);
+        size_t first = last > 0 && last < dump.Records.size() ? dump.Records.size() - last : 0;
+        if (!csv)
+        {
+            std::cout << "Reason: " << dump.Reason << "\n";
+            std::cout << "Thread: " << dump.ThreadId << ", dumped at " << dump.DumpedAt << " ns\n";
+            std::cout << "Events: " << dump.Records.size() << " kept of " << dump.Recorded << " recorded\n\n";
+        }
+        char separator = csv ? ',' : '\t';
+        std::cout << "Tick" << separator << "Timestamp" << separator << "Event" << separator << "Instrument" << separator
+            << "OrderId" << separator << "Side" << separator << "Type" << separator << "Price" << separator << "Value\n";
+        std::cout << std::fixed << std::setprecision(6);
+        for (size_t i = first; i < dump.Records.size(); ++i)
+        {
+            auto& record = dump.Records[i];
+            bool isOrder = record.Event == FlightEvent::NewOrder || record.Event == FlightEvent::OrderFilled;
+            bool hasInstrument = isOrder || record.Event == FlightEvent::L1Update;
+            std::string instrument;
+            if (hasInstrument)
+                instrument = record.InstrumentId < dump.Instruments.size() ? dump.Instruments[record.InstrumentId] : std::to_string(record.InstrumentId);
+            std::cout << record.Tick << separator << record.Timestamp << separator << FlightRecorder::GetEventName(record.Event) << separator
+                << instrument << separator
+                << (isOrder ? std::to_string(record.OrderId) : "") << separator
+                << (isOrder ? (OrderSide(record.Side) == OrderSide::Buy ? "BUY" : "SELL") : "") << separator
+                << (isOrder ? (OrderType(record.OrderType) == OrderType::StopLoss ? "StopLoss" : "Market") : "") << separator
+                << record.Price << separator << record.Value << "\n";
+        }
+    }
+    catch(std::exception& ex)
+    {
+        std::cerr << ex.what() << "\n";
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+/*
+* Synthetic L1 market-data generator for scale testing.
+*
+* Usage: ./MarketDataGenerator --out dir [--instruments N] [--files F] [--hours H] [--rate updates/sec]
+*                              [--seed S] [--threads T] [--format csv|bin] [--names A,B,...]
+*
+* Instruments are split into F files, every file is time-sorted and written by one worker.
+* Output depends only on the seed and the parameters, not on the number of threads.
+*/
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+#include "../src/data_cache.hpp"
+#include "../src/synthetic.hpp"
+
+namespace
+{
+    using namespace ArbSimulation;
+
+    size_t writeCSV(const SyntheticMarket& market, size_t first, size_t last, const std::string& path)
+    {
+        std::vector<std::string> names;
+        for (size_t instrument = first; instrument < last; ++instrument)
+            names.push_back(market.GetName(instrument));
+
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr)
+            throw Exception("Unable to create " + path);
+        std::vector<char> buffer(1 << 22);
+        size_t used = 0;
+        size_t rows = 0;
+        bool written = true;
+        SyntheticMarket::MergedStream stream(market, first, last);
+        TickRecord record;
+        while (written && stream.Next(record))
+        {
+            if (used + 256 > buffer.size())
+            {
+                written = std::fwrite(buffer.data(), 1, used, file) == used;
+                used = 0;
+            }
+            used += SyntheticMarket::FormatCSV(record, names[record.InstrumentId], buffer.data() + used);
+            ++rows;
+        }
+        written = written && std::fwrite(buffer.data(), 1, used, file) == used;
+        //fclose flushes the stdio buffer, so a full disk may only show up here
+        written = std::fclose(file) == 0 && written;
+        if (!written)
+        {
+            //e.g. a full disk: no truncated file is left behind
+            std::error_code error;
+            std::filesystem::remove(path, error);
+            throw Exception("Unable to write " + path);
+        }
+        return rows;
+    }
+
+    size_t writeImage(const SyntheticMarket& market, size_t first, size_t last, const std::string& path)
+    {
+        std::vector<std::string> names;
+        for (size_t instrument = first; instrument < last; ++instrument)
+            names.push_back(market.GetName(instrument));
+
+        TickImage::Writer writer(path, names, {});
+        std::vector<TickRecord> buffer;
+        buffer.reserve(1 << 16);
+        size_t rows = 0;
+        SyntheticMarket::MergedStream stream(market, first, last);
+        TickRecord record;
+        while (stream.Next(record))
+        {
+            buffer.push_back(record);
+            if (buffer.size() == buffer.capacity())
+            {
+                writer.Append(buffer.data(), buffer.size());
+                rows += buffer.size();
+                buffer.clear();
+            }
+        }
+        writer.Append(buffer.data(), buffer.size());
+        rows += buffer.size();
+        writer.Close();
+        return rows;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    SyntheticConfig config;
+    std::string out;
+    std::string format = "csv";
+    size_t files = 0;
+    size_t threads = GetHardwareThreads();
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+                throw Exception("Missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--out")
+                out = value;
+            else if (arg == "--instruments")
+                config.Instruments = std::stoull(value);
+            else if (arg == "--files")
+                files = std::stoull(value);
+            else if (arg == "--hours")
+                config.DurationNs = u_int64_t(std::stod(value) * 3600e9);
+            else if (arg == "--rate")
+                config.UpdatesPerSecond = std::stod(value);
+            else if (arg == "--seed")
+                config.Seed = std::stoull(value);
+            else if (arg == "--threads")
+                threads = std::max<size_t>(1, std::stoull(value));
+            else if (arg == "--format")
+                format = value;
+            else if (arg == "--names")
+            {
+                std::stringstream ss{value};
+                std::string name;
+                while (std::getline(ss, name, ','))
+                    config.Names.push_back(name);
+                config.Instruments = config.Names.size();
+            }
+            else
+                throw Exception("Unknown argument " + arg);
+        }
+        if (out.empty() || (format != "csv" && format != "bin"))
+            throw Exception("Usage: MarketDataGenerator --out dir [--instruments N] [--files F] [--hours H] [--rate R] "
+                "[--seed S] [--threads T] [--format csv|bin] [--names A,B,...]");
+
+        files = files == 0 ? config.Instruments : std::min(files, config.Instruments);
+        std::filesystem::create_directories(out);
+
+        auto start = std::chrono::steady_clock::now();
+        SyntheticMarket market(config);
+        std::vector<size_t> rows(files);
+        ParallelFor(files, threads, [&](size_t index, size_t)
+        {
+            size_t first = index * config.Instruments / files;
+            size_t last = (index + 1) * config.Instruments / files;
+            char name[64];
+            std::snprintf(name, sizeof(name), "synthetic_%05zu.%s", index, format == "csv" ? "csv" : "ticks");
+            std::string path = (std::filesystem::path(out) / name).string();
+            rows[index] = format == "csv" ? writeCSV(market, first, last, path) : writeImage(market, first, last, path);
+        });
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        size_t total = 0;
+        for (auto count: rows)
+            total += count;
+        std::cout << "Generated " << total << " updates for " << config.Instruments << " instruments in " << files << " files ("
+            << seconds << " s, " << size_t(total / seconds) << " updates/s)\n";
+    }
+    catch(std::exception& ex)
+    {
+        std::cerr << ex.what() << "\n";
+        return -1;
+    }
+    return 0;
+}
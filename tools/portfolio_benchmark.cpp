@@ -0,0 +1,119 @@
+/*
+* Compares mark-to-market of many positions in PositionKeeper (one Position per instrument in a map)
+* and in Portfolio (structure of arrays).
+*
+* Usage: ./PortfolioBenchmark [--instruments N,N,...] [--updates U]
+*
+* For every instrument count all positions are opened, then every round marks every instrument and reads the portfolio PnL:
+*   keeper    - PositionKeeper::ProcessL1Update per instrument, GetFullPnL
+*   portfolio - Portfolio::OnL1Update per instrument, GetPnL
+*   batched   - Portfolio::MarkAll from bid / ask arrays, GetPnL and GetGrossExposure
+* Times are ns per instrument and round, about U instrument updates are replayed per count.
+*/
+#include <chrono>
+
+#include "../src/portfolio.hpp"
+#include "../src/random.hpp"
+#include "../src/strategy_base.hpp"
+
+int main(int argc, char* argv[])
+{
+    using namespace ArbSimulation;
+    std::vector<size_t> counts{2, 10, 100, 1000, 10000};
+    size_t updates = 20000000;
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+                throw Exception("Missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--instruments")
+            {
+                counts.clear();
+                std::stringstream stream(value);
+                for (std::string item; std::getline(stream, item, ',');)
+                    counts.push_back(std::max<size_t>(1, std::stoull(item)));
+            }
+            else if (arg == "--updates")
+                updates = std::stoull(value);
+            else
+                throw Exception("Unknown argument " + arg);
+        }
+    }
+    catch(std::exception& ex)
+    {
+        std::cerr << ex.what() << "\n";
+        return -1;
+    }
+
+    std::cout << "Instruments   Rounds   keeper ns   portfolio ns   batched ns   speedup   PnL difference   gross exposure\n";
+    for (size_t count: counts)
+    {
+        CounterRng rng(count, 0);
+        InstrumentManager manager;
+        //two sets of quotes, rounds alternate between them so nothing is hoisted out of the loops
+        std::vector<L1UpdatePtr> quotes[2];
+        std::vector<double> bids[2], asks[2];
+        PositionKeeper keeper;
+        Portfolio portfolio(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto instrument = manager.GetOrCreateInstrument("I" + std::to_string(i));
+            auto fill = std::make_shared<Order>();
+            fill->Instrument = instrument;
+            fill->Qty = 1 + std::floor(rng.Uniform() * 10);
+            fill->ExecPrice = 100 + std::floor(rng.Uniform() * 100);
+            fill->Side = rng.Uniform() < 0.5 ? OrderSide::Buy : OrderSide::Sell;
+            keeper.ProcessOrderFill(fill);
+            portfolio.OnFill(fill);
+
+            for (size_t set = 0; set < 2; ++set)
+            {
+                auto quote = std::make_shared<L1Update>();
+                quote->Instrument = instrument;
+                quote->BidPrice = 100 + std::floor(rng.Uniform() * 100);
+                quote->AskPrice = quote->BidPrice + 1;
+                quotes[set].push_back(quote);
+                bids[set].push_back(quote->BidPrice);
+                asks[set].push_back(quote->AskPrice);
+            }
+        }
+
+        size_t rounds = std::max<size_t>(10, updates / count);
+        auto measure = [&](auto&& round)
+        {
+            double sink = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t r = 0; r < rounds; ++r)
+                sink += round(r % 2);
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            return std::make_pair(double(ns) / rounds / count, sink);
+        };
+
+        auto [keeperNs, keeperPnL] = measure([&](size_t set)
+        {
+            for (auto& quote: quotes[set])
+                keeper.ProcessL1Update(quote);
+            return keeper.GetFullPnL();
+        });
+        auto [portfolioNs, portfolioPnL] = measure([&](size_t set)
+        {
+            for (auto& quote: quotes[set])
+                portfolio.OnL1Update(quote);
+            return portfolio.GetPnL();
+        });
+        double exposure = 0;
+        auto [batchedNs, batchedPnL] = measure([&](size_t set)
+        {
+            portfolio.MarkAll(bids[set].data(), asks[set].data());
+            exposure += portfolio.GetGrossExposure();
+            return portfolio.GetPnL();
+        });
+
+        std::printf("%11zu %8zu %11.2f %14.2f %12.2f %8.1fx %16.2e %16.0f\n", count, rounds, keeperNs, portfolioNs, batchedNs,
+            keeperNs / batchedNs, std::max(std::abs(keeperPnL - portfolioPnL), std::abs(keeperPnL - batchedPnL)) / rounds, exposure / rounds);
+    }
+    return 0;
+}
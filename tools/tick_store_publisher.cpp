@@ -0,0 +1,99 @@
+/*
+* Publishes a parsed dataset into shared memory for simulation processes to attach to (DataFiles: ["shm:<name>"]).
+*
+* Usage: ./TickStorePublisher --name /arbsim_day1 [--cache-dir dir] [--hold] files...
+*        ./TickStorePublisher --name /arbsim_day1 --remove
+*
+* Names like /arbsim_day1 are POSIX shared memory objects, paths like /dev/hugepages/arbsim_day1 are files on hugetlbfs.
+* The segment outlives the publisher unless --hold is given: then it is removed on SIGINT/SIGTERM.
+*/
+#include <chrono>
+#include <csignal>
+
+#include "../src/data_cache.hpp"
+
+namespace
+{
+    volatile std::sig_atomic_t stopRequested = 0;
+
+    void onSignal(int)
+    {
+        stopRequested = 1;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace ArbSimulation;
+    std::string name;
+    std::string cacheDir;
+    bool hold = false;
+    bool remove = false;
+    std::vector<std::string> files;
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--hold")
+                hold = true;
+            else if (arg == "--remove")
+                remove = true;
+            else if (arg.rfind("--", 0) != 0)
+                files.push_back(arg);
+            else
+            {
+                if (i + 1 >= argc)
+                    throw Exception("Missing value for " + arg);
+                std::string value = argv[++i];
+                if (arg == "--name")
+                    name = value;
+                else if (arg == "--cache-dir")
+                    cacheDir = value;
+                else
+                    throw Exception("Unknown argument " + arg);
+            }
+        }
+        if (name.empty() || (files.empty() && !remove))
+            throw Exception("Usage: TickStorePublisher --name /segment [--cache-dir dir] [--hold] files... | --name /segment --remove");
+
+        if (remove)
+        {
+            SharedTickStore::Remove(name);
+            std::cout << "Removed " << name << "\n";
+            return 0;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<SourceInfo> sources;
+        for (auto& file: files)
+            sources.push_back(SourceInfo::Stat(file));
+        TickStorePtr store = cacheDir.empty() ? LoadTickStore(files) : DataCache(cacheDir).LoadOrBuild(files);
+        auto loaded = std::chrono::steady_clock::now();
+        size_t size = SharedTickStore::Publish(name, *store, sources);
+        auto published = std::chrono::steady_clock::now();
+
+        auto ms = [](auto from, auto to){ return std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count(); };
+        std::cout << "Published " << store->Size() << " updates of " << store->GetSecurityIds().size() << " instruments to "
+            << name << " (" << size / (1 << 20) << " MiB), loaded in " << ms(start, loaded) << " ms, published in "
+            << ms(loaded, published) << " ms\n";
+        std::cout << "Attach with \"DataFiles\": [\"" << SharedTickStore::PREFIX << name << "\"]\n";
+
+        if (hold)
+        {
+            std::signal(SIGINT, onSignal);
+            std::signal(SIGTERM, onSignal);
+            std::cout << "Holding, interrupt to remove the segment\n";
+            while (!stopRequested)
+                ::pause();
+            SharedTickStore::Remove(name);
+            std::cout << "Removed " << name << "\n";
+        }
+    }
+    catch(std::exception& ex)
+    {
+        std::cerr << ex.what() << "\n";
+        return -1;
+    }
+    return 0;
+}